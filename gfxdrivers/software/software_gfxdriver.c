@@ -0,0 +1,614 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <core/core.h>
+#include <core/graphics_driver.h>
+#include <core/surface.h>
+#include <direct/memcpy.h>
+#include <gfx/generic/generic.h>
+#include <gfx/generic/generic_blit.h>
+#include <gfx/generic/generic_fill_rectangle.h>
+#include <gfx/generic/generic_stretch_blit.h>
+
+#include "software_gfxdriver.h"
+
+D_DEBUG_DOMAIN( Software_Driver, "Software/Driver", "Software Driver" );
+D_DEBUG_DOMAIN( Software_Exec,   "Software/Exec",   "Software Execution" );
+
+DFB_GRAPHICS_DRIVER( software )
+
+/**********************************************************************************************************************/
+
+#define SOFTWARE_SUPPORTED_DRAWINGFLAGS      (DSDRAW_BLEND | DSDRAW_DST_COLORKEY | DSDRAW_SRC_PREMULTIPLY | \
+                                              DSDRAW_DST_PREMULTIPLY | DSDRAW_DEMULTIPLY | DSDRAW_XOR)
+
+#define SOFTWARE_SUPPORTED_DRAWINGFUNCTIONS  (DFXL_FILLRECTANGLE)
+
+/* Everything but the index translation, its table is not part of the state. */
+#define SOFTWARE_SUPPORTED_BLITTINGFLAGS     (DSBLIT_BLEND_ALPHACHANNEL | DSBLIT_BLEND_COLORALPHA |   \
+                                              DSBLIT_COLORIZE | DSBLIT_SRC_COLORKEY |                \
+                                              DSBLIT_DST_COLORKEY | DSBLIT_SRC_PREMULTIPLY |         \
+                                              DSBLIT_DST_PREMULTIPLY | DSBLIT_DEMULTIPLY |           \
+                                              DSBLIT_DEINTERLACE | DSBLIT_SRC_PREMULTCOLOR |         \
+                                              DSBLIT_XOR | DSBLIT_ROTATE180 | DSBLIT_ROTATE90 |      \
+                                              DSBLIT_ROTATE270 | DSBLIT_COLORKEY_PROTECT |           \
+                                              DSBLIT_SRC_COLORKEY_EXTENDED |                         \
+                                              DSBLIT_DST_COLORKEY_EXTENDED | DSBLIT_SRC_MASK_ALPHA | \
+                                              DSBLIT_SRC_MASK_COLOR | DSBLIT_FLIP_HORIZONTAL |       \
+                                              DSBLIT_FLIP_VERTICAL | DSBLIT_SRC_COLORMATRIX |        \
+                                              DSBLIT_SRC_CONVOLUTION)
+
+#define SOFTWARE_SUPPORTED_BLITTINGFUNCTIONS (DFXL_BLIT | DFXL_STRETCHBLIT)
+
+/**********************************************************************************************************************/
+
+static void
+state_unref( SoftwareState *state )
+{
+     D_ASSERT( state->refs > 0 );
+
+     if (--state->refs == 0)
+          D_FREE( state );
+}
+
+/*
+ * Execute a command with Genefx, setting up the pipeline only when the command uses another state than the previous.
+ */
+static void
+execute_command( SoftwareDriverData *sdrv,
+                 SoftwareCommand    *command )
+{
+     SoftwareState *snapshot = command->state;
+     CardState     *state    = &snapshot->state;
+
+     if (sdrv->acquired_id != snapshot->id) {
+          state->gfxs = sdrv->gfxs;
+
+          sdrv->acquired    = gAcquireLocked( state, snapshot->accel );
+          sdrv->acquired_id = snapshot->id;
+          sdrv->gfxs        = state->gfxs;
+
+          if (!sdrv->acquired)
+               D_WARN( "software driver could not set up Genefx for 0x%08x", snapshot->accel );
+     }
+
+     if (!sdrv->acquired)
+          return;
+
+     state->gfxs = sdrv->gfxs;
+
+     switch (command->type) {
+          case SCT_FILLRECTANGLE:
+               D_DEBUG_AT( Software_Exec, "  -> fill %4d,%4d-%4dx%4d\n", DFB_RECTANGLE_VALS( &command->rect ) );
+
+               gFillRectangle( state, &command->rect );
+               break;
+
+          case SCT_BLIT:
+               D_DEBUG_AT( Software_Exec, "  -> blit %4d,%4d-%4dx%4d -> %4d,%4d\n",
+                           DFB_RECTANGLE_VALS( &command->rect ), command->drect.x, command->drect.y );
+
+               gBlit( state, &command->rect, command->drect.x, command->drect.y );
+               break;
+
+          case SCT_STRETCHBLIT:
+               D_DEBUG_AT( Software_Exec, "  -> stretch %4d,%4d-%4dx%4d -> %4d,%4d-%4dx%4d\n",
+                           DFB_RECTANGLE_VALS( &command->rect ), DFB_RECTANGLE_VALS( &command->drect ) );
+
+               gStretchBlit( state, &command->rect, &command->drect );
+               break;
+
+          default:
+               D_BUG( "unexpected command type %u", command->type );
+     }
+}
+
+static void *
+software_executor( DirectThread *thread,
+                   void         *arg )
+{
+     SoftwareDriverData *sdrv = arg;
+     SoftwareDeviceData *sdev = sdrv->dev;
+
+     D_DEBUG_AT( Software_Exec, "%s()\n", __FUNCTION__ );
+
+     direct_mutex_lock( &sdrv->lock );
+
+     while (!sdrv->quit) {
+          SoftwareCommand *command;
+
+          if (sdev->done == sdev->queued) {
+               direct_waitqueue_wait( &sdrv->queue_cond, &sdrv->lock );
+               continue;
+          }
+
+          /* The entry is not reused before the serial has been increased. */
+          command = &sdrv->ring[sdev->done % SOFTWARE_RING_SIZE];
+
+          direct_mutex_unlock( &sdrv->lock );
+
+          execute_command( sdrv, command );
+
+          direct_mutex_lock( &sdrv->lock );
+
+          state_unref( command->state );
+
+          sdev->done++;
+
+          direct_waitqueue_broadcast( &sdrv->done_cond );
+     }
+
+     direct_mutex_unlock( &sdrv->lock );
+
+     return NULL;
+}
+
+/*
+ * Wait for the serial to be executed. Called with the lock held.
+ */
+static void
+wait_done( SoftwareDriverData *sdrv,
+           u64                 serial )
+{
+     SoftwareDeviceData *sdev = sdrv->dev;
+
+     while (sdev->done < serial)
+          direct_waitqueue_wait( &sdrv->done_cond, &sdrv->lock );
+}
+
+/*
+ * Take a copy of the state for the commands queued from now on.
+ */
+static bool
+snapshot_state( SoftwareDriverData  *sdrv,
+                CardState           *state,
+                DFBAccelerationMask  accel )
+{
+     SoftwareState *snapshot;
+
+     snapshot = D_MALLOC( sizeof(SoftwareState) );
+     if (!snapshot) {
+          D_OOM();
+          return false;
+     }
+
+     direct_memcpy( &snapshot->state, state, sizeof(CardState) );
+
+     snapshot->refs  = 1;
+     snapshot->id    = ++sdrv->snapshot_id ?: ++sdrv->snapshot_id;
+     snapshot->accel = accel;
+
+     /* The executor uses its own Genefx state. */
+     snapshot->state.gfxs = NULL;
+
+     direct_mutex_lock( &sdrv->lock );
+
+     if (sdrv->snapshot)
+          state_unref( sdrv->snapshot );
+
+     sdrv->snapshot = snapshot;
+
+     direct_mutex_unlock( &sdrv->lock );
+
+     return true;
+}
+
+static bool
+queue_command( SoftwareDriverData  *sdrv,
+               SoftwareCommandType  type,
+               const DFBRectangle  *rect,
+               const DFBRectangle  *drect )
+{
+     SoftwareDeviceData *sdev = sdrv->dev;
+     SoftwareState      *snapshot;
+     SoftwareCommand    *command;
+
+     D_ASSERT( sdrv->current != NULL );
+
+     snapshot = sdrv->snapshot;
+
+     /* The buffers may have changed without the state being modified, e.g. after flipping. */
+     if (!snapshot                                                  ||
+         snapshot->state.dst.addr      != sdrv->current->dst.addr   ||
+         snapshot->state.dst.pitch     != sdrv->current->dst.pitch  ||
+         (DFB_BLITTING_FUNCTION( snapshot->accel ) &&
+          (snapshot->state.src.addr      != sdrv->current->src.addr      ||
+           snapshot->state.src.pitch     != sdrv->current->src.pitch     ||
+           snapshot->state.src_mask.addr != sdrv->current->src_mask.addr))) {
+          if (!snapshot_state( sdrv, sdrv->current, snapshot ? snapshot->accel : sdrv->current->set ))
+               return false;
+
+          snapshot = sdrv->snapshot;
+     }
+
+     if (!snapshot->state.dst.addr)
+          return false;
+
+     direct_mutex_lock( &sdrv->lock );
+
+     /* Wait for a free entry. */
+     if (sdev->queued - sdev->done == SOFTWARE_RING_SIZE)
+          wait_done( sdrv, sdev->done + 1 );
+
+     command = &sdrv->ring[sdev->queued % SOFTWARE_RING_SIZE];
+
+     command->type  = type;
+     command->state = snapshot;
+     command->rect  = *rect;
+     command->drect = *drect;
+
+     snapshot->refs++;
+
+     sdev->queued++;
+
+     direct_waitqueue_signal( &sdrv->queue_cond );
+
+     direct_mutex_unlock( &sdrv->lock );
+
+     return true;
+}
+
+/**********************************************************************************************************************/
+
+static DFBResult
+softwareEngineSync( void *driver_data,
+                    void *device_data )
+{
+     SoftwareDriverData *sdrv = driver_data;
+     SoftwareDeviceData *sdev = device_data;
+
+     D_DEBUG_AT( Software_Driver, "%s()\n", __FUNCTION__ );
+
+     /* Slaves do not queue commands, but need to wait for the ones of the master. */
+     if (!sdrv->master) {
+          while (sdev->done < sdev->queued)
+               direct_thread_sleep( 1000 );
+
+          return DFB_OK;
+     }
+
+     direct_mutex_lock( &sdrv->lock );
+
+     wait_done( sdrv, sdev->queued );
+
+     direct_mutex_unlock( &sdrv->lock );
+
+     return DFB_OK;
+}
+
+static void
+softwareInvalidateState( void *driver_data,
+                         void *device_data )
+{
+     SoftwareDriverData *sdrv = driver_data;
+
+     D_DEBUG_AT( Software_Driver, "%s()\n", __FUNCTION__ );
+
+     direct_mutex_lock( &sdrv->lock );
+
+     if (sdrv->snapshot) {
+          state_unref( sdrv->snapshot );
+
+          sdrv->snapshot = NULL;
+     }
+
+     direct_mutex_unlock( &sdrv->lock );
+}
+
+static void
+softwareGetSerial( void               *driver_data,
+                   void               *device_data,
+                   CoreGraphicsSerial *serial )
+{
+     SoftwareDeviceData *sdev = device_data;
+
+     serial->serial     = sdev->queued & 0xffffffff;
+     serial->generation = sdev->queued >> 32;
+}
+
+static DFBResult
+softwareWaitSerial( void                     *driver_data,
+                    void                     *device_data,
+                    const CoreGraphicsSerial *serial )
+{
+     SoftwareDriverData *sdrv   = driver_data;
+     SoftwareDeviceData *sdev   = device_data;
+     u64                 target = ((u64) serial->generation << 32) | serial->serial;
+
+     D_DEBUG_AT( Software_Driver, "%s( %llu ) <- done %llu\n", __FUNCTION__,
+                 (unsigned long long) target, (unsigned long long) sdev->done );
+
+     if (!sdrv->master) {
+          while (sdev->done < target)
+               direct_thread_sleep( 1000 );
+
+          return DFB_OK;
+     }
+
+     direct_mutex_lock( &sdrv->lock );
+
+     wait_done( sdrv, target );
+
+     direct_mutex_unlock( &sdrv->lock );
+
+     return DFB_OK;
+}
+
+static void
+softwareEmitCommands( void *driver_data,
+                      void *device_data )
+{
+     SoftwareDriverData *sdrv = driver_data;
+
+     /* Commands are executed as soon as they are queued, only make sure the executor is awake. */
+     direct_mutex_lock( &sdrv->lock );
+
+     direct_waitqueue_signal( &sdrv->queue_cond );
+
+     direct_mutex_unlock( &sdrv->lock );
+}
+
+static void
+softwareCheckState( void                *driver_data,
+                    void                *device_data,
+                    CardState           *state,
+                    DFBAccelerationMask  accel )
+{
+     CoreSurface *destination = state->destination;
+     CoreSurface *source       = state->source;
+
+     D_DEBUG_AT( Software_Driver, "%s( %p, 0x%08x )\n", __FUNCTION__, state, accel );
+
+     /* Indexed formats depend on the palette at the time of execution. */
+     if (DFB_PIXELFORMAT_IS_INDEXED( destination->config.format ))
+          return;
+
+     if (DFB_DRAWING_FUNCTION( accel )) {
+          if (accel & ~SOFTWARE_SUPPORTED_DRAWINGFUNCTIONS)
+               return;
+
+          if (state->drawingflags & ~SOFTWARE_SUPPORTED_DRAWINGFLAGS)
+               return;
+
+          state->accel |= SOFTWARE_SUPPORTED_DRAWINGFUNCTIONS;
+     }
+     else {
+          if (accel & ~SOFTWARE_SUPPORTED_BLITTINGFUNCTIONS)
+               return;
+
+          if (state->blittingflags & ~SOFTWARE_SUPPORTED_BLITTINGFLAGS)
+               return;
+
+          if (DFB_PIXELFORMAT_IS_INDEXED( source->config.format ))
+               return;
+
+          if (state->blittingflags & (DSBLIT_SRC_MASK_ALPHA | DSBLIT_SRC_MASK_COLOR) &&
+              DFB_PIXELFORMAT_IS_INDEXED( state->source_mask->config.format ))
+               return;
+
+          state->accel |= SOFTWARE_SUPPORTED_BLITTINGFUNCTIONS;
+     }
+}
+
+static void
+softwareSetState( void                *driver_data,
+                  void                *device_data,
+                  GraphicsDeviceFuncs *funcs,
+                  CardState           *state,
+                  DFBAccelerationMask  accel )
+{
+     SoftwareDriverData *sdrv = driver_data;
+
+     D_DEBUG_AT( Software_Driver, "%s( %p, 0x%08x ) <- mod_hw 0x%08x\n", __FUNCTION__, state, accel, state->mod_hw );
+
+     sdrv->current = state;
+
+     /* The Genefx setup depends on the function, so only this one is set. */
+     if (snapshot_state( sdrv, state, accel ))
+          state->set = accel;
+     else
+          state->set = DFXL_NONE;
+
+     state->mod_hw = 0;
+}
+
+static bool
+softwareFillRectangle( void         *driver_data,
+                       void         *device_data,
+                       DFBRectangle *rect )
+{
+     SoftwareDriverData *sdrv = driver_data;
+
+     return queue_command( sdrv, SCT_FILLRECTANGLE, rect, rect );
+}
+
+static bool
+softwareBlit( void         *driver_data,
+              void         *device_data,
+              DFBRectangle *rect,
+              int           dx,
+              int           dy )
+{
+     SoftwareDriverData *sdrv  = driver_data;
+     DFBRectangle        drect = { dx, dy, rect->w, rect->h };
+
+     return queue_command( sdrv, SCT_BLIT, rect, &drect );
+}
+
+static bool
+softwareStretchBlit( void         *driver_data,
+                     void         *device_data,
+                     DFBRectangle *srect,
+                     DFBRectangle *drect )
+{
+     SoftwareDriverData *sdrv = driver_data;
+
+     return queue_command( sdrv, SCT_STRETCHBLIT, srect, drect );
+}
+
+static void
+softwareStateDestroy( void      *driver_data,
+                      void      *device_data,
+                      CardState *state )
+{
+     SoftwareDriverData *sdrv = driver_data;
+
+     /* The snapshot stays valid, it does not refer to the state. */
+     if (sdrv->current == state)
+          sdrv->current = NULL;
+}
+
+/**********************************************************************************************************************/
+
+static int
+driver_probe()
+{
+     /* Not bound to any hardware, so only used if requested. */
+     return dfb_config->software_driver;
+}
+
+static void
+driver_get_info( GraphicsDriverInfo *info )
+{
+     /* Fill driver info structure. */
+     snprintf( info->name,    DFB_GRAPHICS_DRIVER_INFO_NAME_LENGTH,    "Software Driver" );
+     snprintf( info->vendor,  DFB_GRAPHICS_DRIVER_INFO_VENDOR_LENGTH,  "DirectFB" );
+     snprintf( info->url,     DFB_GRAPHICS_DRIVER_INFO_URL_LENGTH,     "www.directfb.org" );
+     snprintf( info->license, DFB_GRAPHICS_DRIVER_INFO_LICENSE_LENGTH, "LGPL" );
+
+     info->version.major = 0;
+     info->version.minor = 1;
+
+     info->driver_data_size = sizeof(SoftwareDriverData);
+     info->device_data_size = sizeof(SoftwareDeviceData);
+}
+
+static DFBResult
+driver_init_driver( GraphicsDeviceFuncs *funcs,
+                    void                *driver_data,
+                    void                *device_data,
+                    CoreDFB             *core )
+{
+     SoftwareDriverData *sdrv = driver_data;
+     SoftwareDeviceData *sdev = device_data;
+
+     D_DEBUG_AT( Software_Driver, "%s()\n", __FUNCTION__ );
+
+     sdrv->dev    = sdev;
+     sdrv->master = dfb_core_is_master( core );
+
+     /* Slaves only wait for the commands queued by the master. */
+     funcs->EngineSync = softwareEngineSync;
+     funcs->WaitSerial = softwareWaitSerial;
+
+     if (!sdrv->master)
+          return DFB_OK;
+
+     direct_mutex_init( &sdrv->lock );
+     direct_waitqueue_init( &sdrv->queue_cond );
+     direct_waitqueue_init( &sdrv->done_cond );
+
+     sdrv->thread = direct_thread_create( DTT_DEFAULT, software_executor, sdrv, "Software Exec" );
+     if (!sdrv->thread) {
+          direct_waitqueue_deinit( &sdrv->done_cond );
+          direct_waitqueue_deinit( &sdrv->queue_cond );
+          direct_mutex_deinit( &sdrv->lock );
+          return DFB_INIT;
+     }
+
+     funcs->InvalidateState = softwareInvalidateState;
+     funcs->GetSerial       = softwareGetSerial;
+     funcs->EmitCommands    = softwareEmitCommands;
+     funcs->CheckState      = softwareCheckState;
+     funcs->SetState        = softwareSetState;
+     funcs->FillRectangle   = softwareFillRectangle;
+     funcs->Blit            = softwareBlit;
+     funcs->StretchBlit     = softwareStretchBlit;
+     funcs->StateDestroy    = softwareStateDestroy;
+
+     return DFB_OK;
+}
+
+static DFBResult
+driver_init_device( GraphicsDeviceInfo *device_info,
+                    void               *driver_data,
+                    void               *device_data )
+{
+     D_DEBUG_AT( Software_Driver, "%s()\n", __FUNCTION__ );
+
+     /* Fill device info. */
+     snprintf( device_info->name,   DFB_GRAPHICS_DEVICE_INFO_NAME_LENGTH,   "Threaded Genefx" );
+     snprintf( device_info->vendor, DFB_GRAPHICS_DEVICE_INFO_VENDOR_LENGTH, "DirectFB" );
+
+     /* Stretched blits are clipped by Genefx. */
+     device_info->caps.flags    = 0;
+     device_info->caps.accel    = SOFTWARE_SUPPORTED_DRAWINGFUNCTIONS | SOFTWARE_SUPPORTED_BLITTINGFUNCTIONS;
+     device_info->caps.drawing  = SOFTWARE_SUPPORTED_DRAWINGFLAGS;
+     device_info->caps.blitting = SOFTWARE_SUPPORTED_BLITTINGFLAGS;
+     device_info->caps.clip     = DFXL_STRETCHBLIT;
+
+     return DFB_OK;
+}
+
+static void
+driver_close_device( void *driver_data,
+                     void *device_data )
+{
+     D_DEBUG_AT( Software_Driver, "%s()\n", __FUNCTION__ );
+
+     softwareEngineSync( driver_data, device_data );
+}
+
+static void
+driver_close_driver( void *driver_data )
+{
+     SoftwareDriverData *sdrv = driver_data;
+
+     D_DEBUG_AT( Software_Driver, "%s()\n", __FUNCTION__ );
+
+     if (!sdrv->master)
+          return;
+
+     direct_mutex_lock( &sdrv->lock );
+
+     sdrv->quit = true;
+
+     direct_waitqueue_signal( &sdrv->queue_cond );
+
+     direct_mutex_unlock( &sdrv->lock );
+
+     direct_thread_join( sdrv->thread );
+     direct_thread_destroy( sdrv->thread );
+
+     if (sdrv->snapshot)
+          state_unref( sdrv->snapshot );
+
+     if (sdrv->gfxs) {
+          if (sdrv->gfxs->ABstart)
+               D_FREE( sdrv->gfxs->ABstart );
+
+          if (sdrv->gfxs->convolution.rows_start)
+               D_FREE( sdrv->gfxs->convolution.rows_start );
+
+          D_FREE( sdrv->gfxs );
+     }
+
+     direct_waitqueue_deinit( &sdrv->done_cond );
+     direct_waitqueue_deinit( &sdrv->queue_cond );
+     direct_mutex_deinit( &sdrv->lock );
+}
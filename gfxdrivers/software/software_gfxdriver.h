@@ -0,0 +1,79 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#ifndef __SOFTWARE_GFXDRIVER_H__
+#define __SOFTWARE_GFXDRIVER_H__
+
+#include <core/state.h>
+#include <direct/thread.h>
+
+/**********************************************************************************************************************/
+
+#define SOFTWARE_RING_SIZE 1024                   /* number of queued commands */
+
+typedef enum {
+     SCT_FILLRECTANGLE,
+     SCT_BLIT,
+     SCT_STRETCHBLIT
+} SoftwareCommandType;
+
+typedef struct {
+     int                      refs;               /* commands using the state, plus one while it is the current */
+     unsigned int             id;                 /* identifies the state for the Genefx setup by the executor */
+     DFBAccelerationMask      accel;
+
+     CardState                state;              /* copy of the state including the locks of the buffers */
+} SoftwareState;
+
+typedef struct {
+     SoftwareCommandType      type;
+     SoftwareState           *state;
+
+     DFBRectangle             rect;               /* rectangle to fill, source of a blit */
+     DFBRectangle             drect;              /* destination of a blit, only the position for SCT_BLIT */
+} SoftwareCommand;
+
+typedef struct {
+     u64                      queued;             /* serial of the last queued command */
+     u64                      done;               /* serial of the last executed command */
+} SoftwareDeviceData;
+
+typedef struct {
+     SoftwareDeviceData      *dev;
+
+     bool                     master;
+
+     DirectMutex              lock;
+     DirectWaitQueue          queue_cond;         /* signaled when commands are queued */
+     DirectWaitQueue          done_cond;          /* signaled when commands are executed */
+
+     DirectThread            *thread;             /* executor */
+     bool                     quit;
+
+     SoftwareCommand          ring[SOFTWARE_RING_SIZE];
+
+     CardState               *current;            /* state passed to SetState() */
+     SoftwareState           *snapshot;           /* copy of it used by the commands being queued */
+     unsigned int             snapshot_id;
+
+     GenefxState             *gfxs;               /* Genefx state of the executor */
+     unsigned int             acquired_id;        /* state set up in 'gfxs', zero if none */
+     bool                     acquired;           /* set up succeeded */
+} SoftwareDriverData;
+
+#endif
@@ -37,4 +37,37 @@ typedef struct {
      uint32_t              framerate_den;
 } DFVFFHeader;
 
+/*
+ * Flags of the header.
+ */
+#define DFVFF_FLAG_DELTA 0x01 /* frames are keyframes or delta frames */
+
+/*
+ * With DFVFF_FLAG_DELTA, the header is followed by a DFVFFDeltaHeader, a table of 'num_frames' 64 bit offsets of the
+ * frames from the start of the file in ascending order, and the frames, each one starting with a DFVFFFrameHeader.
+ *
+ * The picture is divided into tiles of 'tile_width' x 'tile_height' pixels, clipped at the right and bottom edges.
+ * A keyframe holds the complete picture like a frame without DFVFF_FLAG_DELTA.
+ * A delta frame holds a bitmap with one bit per tile in row order, starting with the least significant bit of the
+ * first byte, followed by the pixel data of each tile whose bit is set, the lines of a tile without padding.
+ * The first frame is a keyframe.
+ */
+typedef struct {
+     uint32_t              tile_width;
+     uint32_t              tile_height;
+     uint32_t              num_frames;
+
+     uint32_t              __pad;
+} DFVFFDeltaHeader;
+
+/*
+ * Flags of a frame.
+ */
+#define DFVFF_FRAME_KEY  0x00000001 /* keyframe */
+
+typedef struct {
+     uint32_t              flags;
+     uint32_t              size;          /* size of the frame data following */
+} DFVFFFrameHeader;
+
 #endif
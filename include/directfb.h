@@ -54,6 +54,11 @@ D_DECLARE_INTERFACE( IDirectFBSurface )
  */
 D_DECLARE_INTERFACE( IDirectFBSurfaceAllocation )
 
+/*
+ * Interface to a display list, being recorded drawing and blitting operations that can be replayed to a surface.
+ */
+D_DECLARE_INTERFACE( IDirectFBDisplayList )
+
 /*
  * Interface for read/write access to the colors of a palette object and for cloning it.
  */
@@ -1313,6 +1318,22 @@ typedef DFBEnumerationResult (*DFBInputDeviceCallback) (
      void                                   *callbackdata
 );
 
+/*
+ * Counters of a graphics operation for a combination of source and destination pixel format and flags.
+ */
+typedef struct {
+     DFBAccelerationMask                     accel;              /* Function, e.g. DFXL_BLIT */
+     DFBSurfacePixelFormat                   source_format;      /* Source format, DSPF_UNKNOWN for drawing */
+     DFBSurfacePixelFormat                   destination_format; /* Destination format */
+     DFBSurfaceDrawingFlags                  drawing_flags;      /* Drawing flags, DSDRAW_NOFX for blitting */
+     DFBSurfaceBlittingFlags                 blitting_flags;     /* Blitting flags, DSBLIT_NOFX for drawing */
+
+     unsigned long long                      calls;              /* Number of calls */
+     unsigned long long                      pixels;             /* Number of pixels touched */
+     unsigned long long                      time;               /* Time spent in microseconds */
+     unsigned long long                      software;           /* Calls using the software fallback */
+} DFBGraphicsOperationStats;
+
 /*
  * IDirectFB is the main interface. It can be retrieved by a
  * call to DirectFBCreate(). It's the only interface with a
@@ -1706,6 +1727,28 @@ D_DEFINE_INTERFACE( IDirectFB,
           DFBSurfaceID                       surface_id,
           IDirectFBSurface                 **ret_interface
      );
+
+   /** Statistics **/
+
+     /*
+      * Retrieve counters of the graphics operations.
+      *
+      * Up to 'max' entries are written to 'ret_stats', one for
+      * each combination of function, pixel formats and flags
+      * used so far by the session. The number of entries written
+      * is returned in 'ret_num' and the total number of entries
+      * in 'ret_total'.
+      *
+      * Counting needs to be enabled with the 'gfxcard-stats'
+      * option, otherwise DFB_UNSUPPORTED is returned.
+      */
+     DFBResult (*GetGraphicsStats) (
+          IDirectFB                         *thiz,
+          DFBGraphicsOperationStats         *ret_stats,
+          unsigned int                       max,
+          unsigned int                      *ret_num,
+          unsigned int                      *ret_total
+     );
 )
 
 /*******************
@@ -4485,6 +4528,32 @@ D_DEFINE_INTERFACE( IDirectFBSurface,
      DFBResult (*Flush) (
           IDirectFBSurface                  *thiz
      );
+
+   /** Display lists **/
+
+     /*
+      * Start recording a display list.
+      *
+      * Until EndDisplayList() is called, the rectangle fills,
+      * rectangle outlines, blits and stretch blits are recorded
+      * together with the current state instead of being
+      * executed. Consecutive operations using the same state
+      * are merged into batches.
+      *
+      * Other drawing and blitting operations return
+      * DFB_UNSUPPORTED while recording.
+      */
+     DFBResult (*BeginDisplayList) (
+          IDirectFBSurface                  *thiz
+     );
+
+     /*
+      * Stop recording and return the display list.
+      */
+     DFBResult (*EndDisplayList) (
+          IDirectFBSurface                  *thiz,
+          IDirectFBDisplayList             **ret_interface
+     );
 )
 
 /******************************
@@ -4535,6 +4604,50 @@ D_DEFINE_INTERFACE( IDirectFBSurfaceAllocation,
      );
 )
 
+/************************
+ * IDirectFBDisplayList *
+ ************************/
+
+/*
+ * IDirectFBDisplayList is the display list interface.
+ */
+D_DEFINE_INTERFACE( IDirectFBDisplayList,
+
+   /** Retrieving information **/
+
+     /*
+      * Get the number of batches and the number of rectangles
+      * in the display list.
+      */
+     DFBResult (*GetSize) (
+          IDirectFBDisplayList              *thiz,
+          unsigned int                      *ret_batches,
+          unsigned int                      *ret_rects
+     );
+
+   /** Rendering **/
+
+     /*
+      * Replay the display list to a surface.
+      *
+      * The destination coordinates are translated by 'dx' and
+      * 'dy'. The optional 'clip' is relative to the destination
+      * and intersected with its clipping region.
+      *
+      * The recorded state is applied to the destination and
+      * restored afterwards. State that is not recorded, like
+      * the source mask, color matrix or convolution, is taken
+      * from the destination.
+      */
+     DFBResult (*Replay) (
+          IDirectFBDisplayList              *thiz,
+          IDirectFBSurface                  *destination,
+          int                                dx,
+          int                                dy,
+          const DFBRegion                   *clip
+     );
+)
+
 /********************
  * IDirectFBPalette *
  ********************/
@@ -6666,6 +6779,16 @@ typedef struct {
      } audio;                                                    /* Audio buffer occupancy. */
 } DFBBufferOccupancy;
 
+/*
+ * Playback statistics of a video provider.
+ */
+typedef struct {
+     unsigned int                            presented;          /* Number of frames presented. */
+     unsigned int                            dropped;            /* Number of frames skipped to catch up. */
+     unsigned int                            late;               /* Number of frames presented more than a frame
+                                                                    period after their presentation time. */
+} DFBVideoProviderStatistics;
+
 /*
  * Buffer thresholds for audio/video.
  */
@@ -6966,6 +7089,16 @@ D_DEFINE_INTERFACE( IDirectFBVideoProvider,
           IDirectFBSurface                  *destination,
           const DFBRectangle                *dest_rect
      );
+
+   /** Statistics **/
+
+     /*
+      * Get the playback statistics since the last PlayTo().
+      */
+     DFBResult (*GetStatistics) (
+          IDirectFBVideoProvider            *thiz,
+          DFBVideoProviderStatistics        *ret_stats
+     );
 )
 
 /***********************
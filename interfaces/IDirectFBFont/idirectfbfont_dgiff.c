@@ -264,6 +264,9 @@ Construct( IDirectFBFont              *thiz,
                goto error;
           }
 
+          glyph_data->font     = font;
+          glyph_data->index    = glyph->unicode;
+          glyph_data->layer    = 0;
           glyph_data->surface  = data->rows[glyph->row];
           glyph_data->start    = glyph->offset;
           glyph_data->width    = glyph->width;
@@ -277,7 +280,9 @@ Construct( IDirectFBFont              *thiz,
 
           direct_hash_insert( font->layers[0].glyph_hash, glyph->unicode, glyph_data );
 
-          if (glyph->unicode < 128)
+          glyph_data->inserted = true;
+
+          if (glyph->unicode < font->direct_glyphs)
                font->layers[0].glyph_data[glyph->unicode] = glyph_data;
      }
 
@@ -20,7 +20,9 @@
 #include <direct/filesystem.h>
 #include <direct/list.h>
 #include <direct/memcpy.h>
+#include <direct/system.h>
 #include <direct/thread.h>
+#include <directfb_util.h>
 #include <display/idirectfbsurface.h>
 #include <media/idirectfbdatabuffer.h>
 #include <media/idirectfbvideoprovider.h>
@@ -41,6 +43,12 @@ DIRECT_INTERFACE_IMPLEMENTATION( IDirectFBVideoProvider, DFVFF )
 
 /**********************************************************************************************************************/
 
+/* maximum number of frames prefetched ahead */
+#define DFVFF_QUEUE_FRAMES 8
+
+/* maximum size of the frames prefetched ahead, at least two frames are prefetched */
+#define DFVFF_QUEUE_BYTES  (32 * 1024 * 1024)
+
 typedef struct {
      DirectLink            link;
      IDirectFBEventBuffer *buffer;
@@ -60,16 +68,41 @@ typedef struct {
      DFBVideoProviderStatus         status;
      double                         speed;
      DFBVideoProviderPlaybackFlags  flags;
+     int                            pitch;                  /* bytes per line of a frame */
      int                            frame_size;
      long                           nb_frames;
      long                           frame;
 
-     DirectThread                  *thread;
+     bool                           delta;                  /* keyframes and delta frames */
+     const u64                     *offsets;                /* offsets of the frames (delta) */
+     int                            tile_width;
+     int                            tile_height;
+     int                            tiles_x;
+     int                            tiles_y;
+     u8                            *canvas;                 /* picture of the decoded frame (delta) */
+     long                           decoded;                /* decoded frame, -1 if none */
+     u8                            *dirty;                  /* tiles changed since the last presentation */
+     bool                           redraw;                 /* the whole picture needs to be presented */
+     DFBRectangle                  *rects;                  /* source and destination rectangles of the tiles */
+
+     DirectThread                  *thread;                 /* presenter */
      DirectMutex                    lock;
      DirectWaitQueue                cond;
 
      int                            seeked;
 
+     DirectThread                  *prefetch_thread;        /* producer */
+     DirectWaitQueue                prefetch_cond;
+     long                           prefetch_frame;         /* next frame to prefetch */
+     unsigned int                   prefetch_serial;        /* incremented when prefetching is restarted */
+
+     long                           queue[DFVFF_QUEUE_FRAMES];
+     int                            queue_size;             /* number of frames prefetched ahead */
+     int                            queue_head;
+     int                            queue_count;
+
+     DFBVideoProviderStatistics     stats;
+
      IDirectFBSurface              *dest;
      DFBRectangle                   rect;
 
@@ -105,28 +138,400 @@ dispatch_event( IDirectFBVideoProvider_DFVFF_data *data,
      direct_mutex_unlock( &data->events_lock );
 }
 
+static __inline__ const void *
+frame_data( IDirectFBVideoProvider_DFVFF_data *data,
+            long                               frame,
+            int                               *ret_size )
+{
+     if (data->delta) {
+          u64 next = (frame + 1 < data->nb_frames) ? data->offsets[frame+1] : data->len;
+
+          *ret_size = next - data->offsets[frame];
+
+          return data->ptr + data->offsets[frame];
+     }
+
+     *ret_size = data->frame_size;
+
+     return data->ptr + sizeof(DFVFFHeader) + frame * data->frame_size;
+}
+
+/*
+ * Discard the prefetched frames and restart prefetching at the current frame. Called with the lock held.
+ */
+static void
+queue_reset( IDirectFBVideoProvider_DFVFF_data *data )
+{
+     data->queue_count    = 0;
+     data->prefetch_frame = data->frame;
+     data->prefetch_serial++;
+
+     direct_waitqueue_signal( &data->prefetch_cond );
+}
+
+/*
+ * Remove the frame from the queue along with the dropped frames before it. If the frame has not been prefetched yet,
+ * prefetching is restarted after it. Called with the lock held.
+ */
+static void
+queue_take( IDirectFBVideoProvider_DFVFF_data *data,
+            long                               frame )
+{
+     while (data->queue_count) {
+          long queued = data->queue[data->queue_head];
+
+          data->queue_head = (data->queue_head + 1) % data->queue_size;
+          data->queue_count--;
+
+          direct_waitqueue_signal( &data->prefetch_cond );
+
+          if (queued == frame)
+               return;
+     }
+
+     D_DEBUG_AT( VideoProvider_DFVFF, "  -> frame %ld not prefetched\n", frame );
+
+     data->prefetch_frame = frame + 1;
+     data->prefetch_serial++;
+}
+
+static void *
+DFVFFPrefetch( DirectThread *thread,
+               void         *arg )
+{
+     IDirectFBVideoProvider_DFVFF_data *data     = arg;
+     long                               pagesize = direct_pagesize();
+
+     direct_mutex_lock( &data->lock );
+
+     while (data->status != DVSTATE_STOP) {
+          long               frame;
+          unsigned int       serial;
+          const volatile u8 *ptr;
+          int                size;
+          int                i;
+
+          if (data->prefetch_frame >= data->nb_frames && (data->flags & DVPLAY_LOOPING))
+               data->prefetch_frame = 0;
+
+          if (data->queue_count == data->queue_size || data->prefetch_frame >= data->nb_frames) {
+               direct_waitqueue_wait( &data->prefetch_cond, &data->lock );
+               continue;
+          }
+
+          frame  = data->prefetch_frame++;
+          serial = data->prefetch_serial;
+
+          direct_mutex_unlock( &data->lock );
+
+          ptr = frame_data( data, frame, &size );
+
+          direct_file_prefetch( (const void*) ptr, size );
+
+          /* Fault in the pages here rather than in the presenter, the advice only starts reading them. */
+          for (i = 0; i < size; i += pagesize)
+               (void) ptr[i];
+
+          direct_mutex_lock( &data->lock );
+
+          if (serial == data->prefetch_serial) {
+               data->queue[(data->queue_head + data->queue_count) % data->queue_size] = frame;
+               data->queue_count++;
+          }
+     }
+
+     direct_mutex_unlock( &data->lock );
+
+     return NULL;
+}
+
+/*
+ * Apply a keyframe or the tiles of a delta frame to the canvas, marking the changed tiles as dirty.
+ */
+static void
+apply_frame( IDirectFBVideoProvider_DFVFF_data *data,
+             long                               frame )
+{
+     const DFVFFFrameHeader *header;
+     const u8               *bitmap;
+     const u8               *src;
+     const u8               *end;
+     int                     size;
+     int                     tx, ty;
+
+     header = frame_data( data, frame, &size );
+
+     if (size < sizeof(DFVFFFrameHeader) || header->size > size - sizeof(DFVFFFrameHeader))
+          goto invalid;
+
+     src = (const u8*) (header + 1);
+     end = src + header->size;
+
+     if (header->flags & DFVFF_FRAME_KEY) {
+          if (header->size < data->frame_size)
+               goto invalid;
+
+          direct_memcpy( data->canvas, src, data->frame_size );
+
+          data->redraw = true;
+
+          return;
+     }
+
+     bitmap = src;
+     src   += (data->tiles_x * data->tiles_y + 7) / 8;
+
+     if (src > end)
+          goto invalid;
+
+     for (ty = 0; ty < data->tiles_y; ty++) {
+          int y = ty * data->tile_height;
+          int h = MIN( data->tile_height, data->desc.height - y );
+
+          for (tx = 0; tx < data->tiles_x; tx++) {
+               int  n = ty * data->tiles_x + tx;
+               int  x = tx * data->tile_width;
+               int  bytes;
+               int  i;
+               u8  *dst;
+
+               if (!(bitmap[n >> 3] & (1 << (n & 7))))
+                    continue;
+
+               bytes = DFB_BYTES_PER_LINE( data->desc.pixelformat, MIN( data->tile_width, data->desc.width - x ) );
+
+               if (end - src < bytes * h)
+                    goto invalid;
+
+               dst = data->canvas + y * data->pitch + DFB_BYTES_PER_LINE( data->desc.pixelformat, x );
+
+               for (i = 0; i < h; i++) {
+                    direct_memcpy( dst, src, bytes );
+
+                    src += bytes;
+                    dst += data->pitch;
+               }
+
+               data->dirty[n] = 1;
+          }
+     }
+
+     return;
+
+invalid:
+     D_ERROR( "VideoProvider/DFVFF: Invalid frame %ld!\n", frame );
+}
+
+/*
+ * Bring the canvas to the frame, starting at the decoded frame or at the keyframe preceding the frame.
+ */
+static void
+decode_frame( IDirectFBVideoProvider_DFVFF_data *data,
+              long                               frame )
+{
+     long start;
+     long i;
+     int  size;
+
+     if (frame == data->decoded)
+          return;
+
+     start = (data->decoded < 0 || frame < data->decoded) ? 0 : data->decoded + 1;
+
+     /* Skip the frames before the last keyframe. */
+     for (i = frame; i > start; i--) {
+          const DFVFFFrameHeader *header = frame_data( data, i, &size );
+
+          if (size >= sizeof(DFVFFFrameHeader) && (header->flags & DFVFF_FRAME_KEY)) {
+               start = i;
+               break;
+          }
+     }
+
+     D_DEBUG_AT( VideoProvider_DFVFF, "  -> decoding frames %ld-%ld\n", start, frame );
+
+     for (i = start; i <= frame; i++)
+          apply_frame( data, i );
+
+     data->decoded = frame;
+}
+
+/*
+ * Present a picture without an intermediate copy, either a frame from the mapped file or the canvas. It is written to
+ * the destination if neither scaling, conversion nor render options are involved and the format has a single plane,
+ * otherwise it is blitted from a surface using the picture data in place. If 'rects' is not NULL, only these areas of
+ * the picture are presented.
+ */
+static void
+present_frame( IDirectFBVideoProvider_DFVFF_data *data,
+               const void                        *ptr,
+               DFBRectangle                      *rects,
+               int                                num )
+{
+     DFBResult              ret;
+     IDirectFBSurface_data *dst_data;
+     DFBSurfacePixelFormat  format;
+     DFBSurfaceColorSpace   colorspace;
+     DFBSurfaceDescription  desc;
+     IDirectFBSurface      *source;
+     int                    i;
+
+     dst_data = data->dest->priv;
+     if (!dst_data)
+          return;
+
+     if (data->rect.w == data->desc.width && data->rect.h == data->desc.height     &&
+         dst_data->state.blittingflags == DSBLIT_NOFX                              &&
+         dst_data->state.render_options == DSRO_NONE                               &&
+         !DFB_PLANAR_PIXELFORMAT( data->desc.pixelformat )                         &&
+         data->dest->GetPixelFormat( data->dest, &format ) == DFB_OK               &&
+         data->dest->GetColorSpace( data->dest, &colorspace ) == DFB_OK            &&
+         format == data->desc.pixelformat && colorspace == data->desc.colorspace) {
+          DFBRectangle rect    = data->rect;
+          DFBRectangle clipped;
+
+          rect.x += dst_data->area.wanted.x;
+          rect.y += dst_data->area.wanted.y;
+
+          clipped = rect;
+
+          if (dfb_rectangle_intersect( &clipped, &dst_data->area.current )           &&
+              dfb_rectangle_intersect_by_region( &clipped, &dst_data->state.clip ) &&
+              DFB_RECTANGLE_EQUAL( rect, clipped )) {
+               if (!rects) {
+                    if (data->dest->Write( data->dest, &rect, ptr, data->pitch ) == DFB_OK)
+                         return;
+               }
+               else {
+                    for (i = 0; i < num; i++) {
+                         DFBRectangle area = rects[i];
+
+                         area.x += rect.x;
+                         area.y += rect.y;
+
+                         data->dest->Write( data->dest, &area, ptr + rects[i].y * data->pitch +
+                                            DFB_BYTES_PER_LINE( data->desc.pixelformat, rects[i].x ), data->pitch );
+                    }
+
+                    return;
+               }
+          }
+     }
+
+     desc = data->desc;
+
+     desc.flags                 |= DSDESC_PREALLOCATED;
+     desc.preallocated[0].data   = (void*) ptr;
+     desc.preallocated[0].pitch  = data->pitch;
+
+     ret = data->idirectfb->CreateSurface( data->idirectfb, &desc, &source );
+     if (ret) {
+          D_DERROR( ret, "VideoProvider/DFVFF: Failed to create surface for frame!\n" );
+          return;
+     }
+
+     if (!rects) {
+          data->dest->StretchBlit( data->dest, source, NULL, &data->rect );
+     }
+     else {
+          DFBRectangle *dest_rects = rects + num;
+          int           n          = 0;
+
+          /* Scale the edges rather than the sizes, so that adjacent areas stay adjacent. */
+          for (i = 0; i < num; i++) {
+               int x1 = data->rect.x + rects[i].x * data->rect.w / data->desc.width;
+               int y1 = data->rect.y + rects[i].y * data->rect.h / data->desc.height;
+               int x2 = data->rect.x + (rects[i].x + rects[i].w) * data->rect.w / data->desc.width;
+               int y2 = data->rect.y + (rects[i].y + rects[i].h) * data->rect.h / data->desc.height;
+
+               if (x2 > x1 && y2 > y1) {
+                    rects[n] = rects[i];
+
+                    dest_rects[n] = (DFBRectangle) { x1, y1, x2 - x1, y2 - y1 };
+
+                    n++;
+               }
+          }
+
+          if (n)
+               data->dest->BatchStretchBlit( data->dest, source, rects, dest_rects, n );
+     }
+
+     data->dest->ReleaseSource( data->dest );
+
+     source->Release( source );
+}
+
+/*
+ * Decode a frame and present the tiles that changed, or the whole picture after a keyframe or if the destination does
+ * not keep its content.
+ */
+static void
+present_delta_frame( IDirectFBVideoProvider_DFVFF_data *data,
+                     long                               frame )
+{
+     IDirectFBSurface_data *dst_data;
+     int                    num = 0;
+     int                    tx, ty;
+
+     decode_frame( data, frame );
+
+     dst_data = data->dest->priv;
+     if (!dst_data)
+          return;
+
+     if (data->redraw || (dst_data->caps & DSCAPS_FLIPPING)) {
+          memset( data->dirty, 0, data->tiles_x * data->tiles_y );
+
+          data->redraw = false;
+
+          present_frame( data, data->canvas, NULL, 0 );
+
+          return;
+     }
+
+     /* Merge the dirty tiles of each row into spans. */
+     for (ty = 0; ty < data->tiles_y; ty++) {
+          u8 *dirty = data->dirty + ty * data->tiles_x;
+
+          for (tx = 0; tx < data->tiles_x; tx++) {
+               int x, y, n;
+
+               if (!dirty[tx])
+                    continue;
+
+               for (n = 0; tx + n < data->tiles_x && dirty[tx+n]; n++)
+                    dirty[tx+n] = 0;
+
+               x = tx * data->tile_width;
+               y = ty * data->tile_height;
+
+               data->rects[num++] = (DFBRectangle) { x, y,
+                                                     MIN( (tx + n) * data->tile_width, data->desc.width ) - x,
+                                                     MIN( data->tile_height, data->desc.height - y ) };
+
+               tx += n;
+          }
+     }
+
+     D_DEBUG_AT( VideoProvider_DFVFF, "  -> frame %ld, %d areas changed\n", frame, num );
+
+     if (num)
+          present_frame( data, data->canvas, data->rects, num );
+}
+
 static void *
 DFVFFVideo( DirectThread *thread,
             void         *arg )
 {
-     DFBResult                          ret;
      IDirectFBVideoProvider_DFVFF_data *data = arg;
-     IDirectFBSurface                  *source;
-     void                              *source_ptr;
-     int                                source_pitch;
-     void                              *frame_ptr;
+     double                             rate = data->rate / 1000000.0;
      long                               start_frame;
      long long                          start;
      int                                drop = 0;
 
-     ret = data->idirectfb->CreateSurface( data->idirectfb, &data->desc, &source );
-     if (ret)
-          return NULL;
-
-     frame_ptr = data->ptr + sizeof(DFVFFHeader);
-
-     start_frame = 0;
-     start = direct_clock_get_abs_millis();
+     start_frame = data->frame;
+     start       = direct_clock_get_abs_micros();
 
      dispatch_event( data, DVPET_STARTED );
 
@@ -134,9 +539,13 @@ DFVFFVideo( DirectThread *thread,
           direct_mutex_lock( &data->lock );
 
           if (drop) {
+               long frame = data->frame;
+
                data->frame += drop;
                data->frame  = MIN( data->frame, data->nb_frames - 1 );
 
+               data->stats.dropped += data->frame - frame;
+
                drop = 0;
 
                if (data->seeked) {
@@ -145,23 +554,47 @@ DFVFFVideo( DirectThread *thread,
                }
           }
           else {
+               long frame;
+
                if (data->seeked) {
                     if (data->status == DVSTATE_FINISHED)
                          data->status = DVSTATE_PLAY;
 
-                    frame_ptr = data->ptr + sizeof(DFVFFHeader) + data->frame * data->frame_size;
-
                     start_frame = data->frame;
-                    start = direct_clock_get_abs_millis();
+                    start       = direct_clock_get_abs_micros();
 
                     data->seeked = false;
                }
 
-               source->Lock( source, DSLF_WRITE, &source_ptr, &source_pitch );
-               direct_memcpy( source_ptr, frame_ptr, data->frame_size );
-               source->Unlock( source );
+               frame = data->frame;
 
-               data->dest->StretchBlit( data->dest, source, NULL, &data->rect );
+               queue_take( data, frame );
+
+               direct_mutex_unlock( &data->lock );
+
+               /* Present the frame right after the vertical retrace. */
+               data->idirectfb->WaitForSync( data->idirectfb );
+
+               if (data->delta) {
+                    present_delta_frame( data, frame );
+               }
+               else {
+                    int size;
+
+                    present_frame( data, frame_data( data, frame, &size ), NULL, 0 );
+               }
+
+               direct_mutex_lock( &data->lock );
+
+               data->stats.presented++;
+
+               if (data->speed && direct_clock_get_abs_micros() - start > (frame - start_frame + 1) / rate)
+                    data->stats.late++;
+
+               if (data->seeked) {
+                    direct_mutex_unlock( &data->lock );
+                    continue;
+               }
 
                if (data->frame_callback)
                     data->frame_callback( data->frame_callback_context );
@@ -176,14 +609,13 @@ DFVFFVideo( DirectThread *thread,
                }
 
                start_frame = data->frame + 1;
-               start = direct_clock_get_abs_millis();
+               start       = direct_clock_get_abs_micros();
           }
           else {
-               double rate  = data->rate / 1000.0;
-               long   delay = direct_clock_get_abs_millis() - start;
-               long   frame = delay * rate + start_frame;
+               long long delay = direct_clock_get_abs_micros() - start;
+               long      frame = delay * rate + start_frame;
 
-               if ( data->frame < frame ) {
+               if (data->frame < frame) {
                     drop = frame - data->frame;
                     direct_mutex_unlock( &data->lock );
                     continue;
@@ -191,7 +623,8 @@ DFVFFVideo( DirectThread *thread,
 
                delay = (data->frame - start_frame + 1) / rate - delay;
 
-               direct_waitqueue_wait_timeout( &data->cond, &data->lock, delay * 1000 );
+               if (delay > 0)
+                    direct_waitqueue_wait_timeout( &data->cond, &data->lock, delay );
 
                if (data->seeked) {
                     direct_mutex_unlock( &data->lock );
@@ -201,14 +634,12 @@ DFVFFVideo( DirectThread *thread,
 
           data->frame++;
 
-          if (data->frame == data->nb_frames ) {
+          if (data->frame == data->nb_frames) {
                if (data->flags & DVPLAY_LOOPING) {
                     data->frame = 0;
 
-                    frame_ptr = data->ptr + sizeof(DFVFFHeader);
-
                     start_frame = 0;
-                    start = direct_clock_get_abs_millis();
+                    start       = direct_clock_get_abs_micros();
                }
                else {
                     data->status = DVSTATE_FINISHED;
@@ -216,14 +647,10 @@ DFVFFVideo( DirectThread *thread,
                     direct_waitqueue_wait( &data->cond, &data->lock );
                }
           }
-          else
-               frame_ptr = data->ptr + sizeof(DFVFFHeader) + data->frame * data->frame_size;
 
           direct_mutex_unlock( &data->lock );
      }
 
-     source->Release( source );
-
      return NULL;
 }
 
@@ -240,6 +667,7 @@ IDirectFBVideoProvider_DFVFF_Destruct( IDirectFBVideoProvider *thiz )
 
      thiz->Stop( thiz );
 
+     direct_waitqueue_deinit( &data->prefetch_cond );
      direct_waitqueue_deinit( &data->cond );
      direct_mutex_deinit( &data->lock );
 
@@ -251,6 +679,15 @@ IDirectFBVideoProvider_DFVFF_Destruct( IDirectFBVideoProvider *thiz )
 
      direct_mutex_deinit( &data->events_lock );
 
+     if (data->rects)
+          D_FREE( data->rects );
+
+     if (data->dirty)
+          D_FREE( data->dirty );
+
+     if (data->canvas)
+          D_FREE( data->canvas );
+
      direct_file_unmap( data->ptr, data->len );
 
      DIRECT_DEALLOCATE_INTERFACE( thiz );
@@ -330,7 +767,7 @@ IDirectFBVideoProvider_DFVFF_GetStreamDescription( IDirectFBVideoProvider *thiz,
 
      ret_desc->video.framerate = data->rate;
      ret_desc->video.aspect    = (double) data->desc.width / data->desc.height;
-     ret_desc->video.bitrate   = data->rate * data->frame_size;
+     ret_desc->video.bitrate   = data->rate * (data->delta ? (double) data->len / data->nb_frames : data->frame_size);
 
      return DFB_OK;
 }
@@ -376,6 +813,13 @@ IDirectFBVideoProvider_DFVFF_PlayTo( IDirectFBVideoProvider *thiz,
      data->frame_callback_context = ctx;
 
      data->status = DVSTATE_PLAY;
+     data->redraw = true;
+
+     memset( &data->stats, 0, sizeof(data->stats) );
+
+     queue_reset( data );
+
+     data->prefetch_thread = direct_thread_create( DTT_DEFAULT, DFVFFPrefetch, data, "DFVFF Prefetch" );
 
      data->thread = direct_thread_create( DTT_DEFAULT, DFVFFVideo, data, "DFVFF Video" );
 
@@ -394,15 +838,27 @@ IDirectFBVideoProvider_DFVFF_Stop( IDirectFBVideoProvider *thiz )
      if (data->status == DVSTATE_STOP)
           return DFB_OK;
 
+     direct_mutex_lock( &data->lock );
+
      data->status = DVSTATE_STOP;
 
+     direct_waitqueue_signal( &data->cond );
+     direct_waitqueue_signal( &data->prefetch_cond );
+
+     direct_mutex_unlock( &data->lock );
+
      if (data->thread) {
-          direct_waitqueue_signal( &data->cond );
           direct_thread_join( data->thread );
           direct_thread_destroy( data->thread );
           data->thread = NULL;
      }
 
+     if (data->prefetch_thread) {
+          direct_thread_join( data->prefetch_thread );
+          direct_thread_destroy( data->prefetch_thread );
+          data->prefetch_thread = NULL;
+     }
+
      data->frame = 0;
 
      dispatch_event( data, DVPET_STOPPED );
@@ -444,6 +900,8 @@ IDirectFBVideoProvider_DFVFF_SeekTo( IDirectFBVideoProvider *thiz,
 
      data->seeked = true;
 
+     queue_reset( data );
+
      direct_waitqueue_signal( &data->cond );
 
      direct_mutex_unlock( &data->lock );
@@ -498,8 +956,15 @@ IDirectFBVideoProvider_DFVFF_SetPlaybackFlags( IDirectFBVideoProvider        *th
      if (flags & ~DVPLAY_LOOPING)
           return DFB_UNSUPPORTED;
 
+     direct_mutex_lock( &data->lock );
+
      data->flags = flags;
 
+     /* Prefetching may continue at the beginning. */
+     direct_waitqueue_signal( &data->prefetch_cond );
+
+     direct_mutex_unlock( &data->lock );
+
      return DFB_OK;
 }
 
@@ -673,6 +1138,30 @@ IDirectFBVideoProvider_DFVFF_DetachEventBuffer( IDirectFBVideoProvider *thiz,
      return ret;
 }
 
+static DFBResult
+IDirectFBVideoProvider_DFVFF_GetBufferOccupancy( IDirectFBVideoProvider *thiz,
+                                                 DFBBufferOccupancy     *ret_occ )
+{
+     DIRECT_INTERFACE_GET_DATA( IDirectFBVideoProvider_DFVFF )
+
+     D_DEBUG_AT( VideoProvider_DFVFF, "%s( %p )\n", __FUNCTION__, thiz );
+
+     if (!ret_occ)
+          return DFB_INVARG;
+
+     memset( ret_occ, 0, sizeof(DFBBufferOccupancy) );
+
+     direct_mutex_lock( &data->lock );
+
+     ret_occ->valid               = DVSCAPS_VIDEO;
+     ret_occ->video.buffer_size   = data->queue_size * data->frame_size;
+     ret_occ->video.current_level = data->queue_count * data->frame_size;
+
+     direct_mutex_unlock( &data->lock );
+
+     return DFB_OK;
+}
+
 static DFBResult
 IDirectFBVideoProvider_DFVFF_SetDestination( IDirectFBVideoProvider *thiz,
                                              IDirectFBSurface       *destination,
@@ -689,7 +1178,88 @@ IDirectFBVideoProvider_DFVFF_SetDestination( IDirectFBVideoProvider *thiz,
      if (dest_rect->w < 1 || dest_rect->h < 1)
           return DFB_INVARG;
 
-     data->rect = *dest_rect;
+     data->rect   = *dest_rect;
+     data->redraw = true;
+
+     return DFB_OK;
+}
+
+static DFBResult
+IDirectFBVideoProvider_DFVFF_GetStatistics( IDirectFBVideoProvider     *thiz,
+                                            DFBVideoProviderStatistics *ret_stats )
+{
+     DIRECT_INTERFACE_GET_DATA( IDirectFBVideoProvider_DFVFF )
+
+     D_DEBUG_AT( VideoProvider_DFVFF, "%s( %p )\n", __FUNCTION__, thiz );
+
+     if (!ret_stats)
+          return DFB_INVARG;
+
+     direct_mutex_lock( &data->lock );
+
+     *ret_stats = data->stats;
+
+     direct_mutex_unlock( &data->lock );
+
+     return DFB_OK;
+}
+
+/**********************************************************************************************************************/
+
+/*
+ * Set up playback of keyframes and delta frames, validating the frame offsets.
+ */
+static DFBResult
+setup_delta( IDirectFBVideoProvider_DFVFF_data *data )
+{
+     const DFVFFDeltaHeader *header = data->ptr + sizeof(DFVFFHeader);
+     DFBSurfacePixelFormat   format = data->desc.pixelformat;
+     long                    start  = sizeof(DFVFFHeader) + sizeof(DFVFFDeltaHeader);
+     long                    i;
+     int                     tiles;
+
+     if (data->len < start || !header->tile_width || !header->tile_height || !header->num_frames ||
+         (data->len - start) / sizeof(u64) < header->num_frames) {
+          D_ERROR( "VideoProvider/DFVFF: Invalid delta header!\n" );
+          return DFB_FAILURE;
+     }
+
+     if (DFB_PLANAR_PIXELFORMAT( format ) || !DFB_BYTES_PER_PIXEL( format ) ||
+         header->tile_width % (DFB_PIXELFORMAT_ALIGNMENT( format ) + 1)) {
+          D_ERROR( "VideoProvider/DFVFF: Delta frames are not supported with %s format!\n",
+                   dfb_pixelformat_name( format ) );
+          return DFB_UNSUPPORTED;
+     }
+
+     data->delta       = true;
+     data->offsets     = data->ptr + start;
+     data->nb_frames   = header->num_frames;
+     data->tile_width  = MIN( header->tile_width, data->desc.width );
+     data->tile_height = MIN( header->tile_height, data->desc.height );
+     data->tiles_x     = (data->desc.width  + data->tile_width  - 1) / data->tile_width;
+     data->tiles_y     = (data->desc.height + data->tile_height - 1) / data->tile_height;
+
+     start += data->nb_frames * sizeof(u64);
+
+     for (i = 0; i < data->nb_frames; i++) {
+          if (data->offsets[i] < start || data->offsets[i] > data->len) {
+               D_ERROR( "VideoProvider/DFVFF: Invalid offset of frame %ld!\n", i );
+               return DFB_FAILURE;
+          }
+
+          start = data->offsets[i];
+     }
+
+     tiles = data->tiles_x * data->tiles_y;
+
+     data->canvas = D_CALLOC( 1, data->frame_size );
+     data->dirty  = D_CALLOC( tiles, 1 );
+     data->rects  = D_CALLOC( 2 * tiles, sizeof(DFBRectangle) );
+     if (!data->canvas || !data->dirty || !data->rects)
+          return D_OOM();
+
+     D_DEBUG_AT( VideoProvider_DFVFF, "  -> %ld frames, %dx%d tiles of %dx%d\n",
+                 data->nb_frames, data->tiles_x, data->tiles_y, data->tile_width, data->tile_height );
 
      return DFB_OK;
 }
@@ -763,15 +1333,38 @@ Construct( IDirectFBVideoProvider *thiz,
      data->rate             = (double) header->framerate_num / header->framerate_den;
      data->status           = DVSTATE_STOP;
      data->speed            = 1.0;
-     data->frame_size       = DFB_BYTES_PER_LINE( data->desc.pixelformat, data->desc.width ) *
-                              DFB_PLANE_MULTIPLY( data->desc.pixelformat, data->desc.height );
+     data->pitch            = DFB_BYTES_PER_LINE( data->desc.pixelformat, data->desc.width );
+     data->frame_size       = data->pitch * DFB_PLANE_MULTIPLY( data->desc.pixelformat, data->desc.height );
      data->nb_frames        = (data->len - sizeof(DFVFFHeader)) / data->frame_size;
+     data->queue_size       = CLAMP( DFVFF_QUEUE_BYTES / data->frame_size, 2, DFVFF_QUEUE_FRAMES );
+     data->decoded          = -1;
      data->events_mask      = DVPET_ALL;
 
+     if (header->flags & DFVFF_FLAG_DELTA) {
+          ret = setup_delta( data );
+          if (ret) {
+               if (data->rects)
+                    D_FREE( data->rects );
+
+               if (data->dirty)
+                    D_FREE( data->dirty );
+
+               if (data->canvas)
+                    D_FREE( data->canvas );
+
+               direct_file_unmap( data->ptr, data->len );
+
+               DIRECT_DEALLOCATE_INTERFACE( thiz );
+
+               return ret;
+          }
+     }
+
      direct_mutex_init( &data->events_lock );
 
      direct_mutex_init( &data->lock );
      direct_waitqueue_init( &data->cond );
+     direct_waitqueue_init( &data->prefetch_cond );
 
      thiz->AddRef                = IDirectFBVideoProvider_DFVFF_AddRef;
      thiz->Release               = IDirectFBVideoProvider_DFVFF_Release;
@@ -792,7 +1385,9 @@ Construct( IDirectFBVideoProvider *thiz,
      thiz->EnableEvents          = IDirectFBVideoProvider_DFVFF_EnableEvents;
      thiz->DisableEvents         = IDirectFBVideoProvider_DFVFF_DisableEvents;
      thiz->DetachEventBuffer     = IDirectFBVideoProvider_DFVFF_DetachEventBuffer;
+     thiz->GetBufferOccupancy    = IDirectFBVideoProvider_DFVFF_GetBufferOccupancy;
      thiz->SetDestination        = IDirectFBVideoProvider_DFVFF_SetDestination;
+     thiz->GetStatistics         = IDirectFBVideoProvider_DFVFF_GetStatistics;
 
      return DFB_OK;
 
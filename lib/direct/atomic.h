@@ -24,4 +24,10 @@
 #define D_SYNC_ADD_AND_FETCH(ptr,value) \
      __sync_add_and_fetch( ptr, value )
 
+#define D_SYNC_LOAD_ACQUIRE(ptr) \
+     __atomic_load_n( ptr, __ATOMIC_ACQUIRE )
+
+#define D_SYNC_STORE_RELEASE(ptr,value) \
+     __atomic_store_n( ptr, value, __ATOMIC_RELEASE )
+
 #endif
@@ -37,17 +37,19 @@ typedef enum {
 } DirectFilePermission;
 
 typedef enum {
-     DFIF_NONE = 0x00000000,
+     DFIF_NONE  = 0x00000000,
 
-     DFIF_SIZE = 0x00000001,
+     DFIF_SIZE  = 0x00000001,
+     DFIF_MTIME = 0x00000002,
 
-     DFIF_ALL  = 0x00000001
+     DFIF_ALL   = 0x00000003
 } DirectFileInfoFlags;
 
 typedef struct {
      DirectFileInfoFlags flags;
 
      size_t              size;
+     time_t              mtime;   /* time of last modification */
 } DirectFileInfo;
 
 #define R_OK 4
@@ -109,6 +111,9 @@ DirectResult DIRECT_API direct_file_map       ( DirectFile            *file,
 DirectResult DIRECT_API direct_file_unmap     ( void                  *addr,
                                                 size_t                 bytes );
 
+DirectResult DIRECT_API direct_file_prefetch  ( const void            *addr,
+                                                size_t                 bytes );
+
 DirectResult DIRECT_API direct_file_get_info  ( DirectFile            *file,
                                                 DirectFileInfo        *ret_info );
 
@@ -149,6 +154,9 @@ DirectResult DIRECT_API direct_readlink       ( const char            *name,
 
 DirectResult DIRECT_API direct_unlink         ( const char            *name );
 
+DirectResult DIRECT_API direct_rename         ( const char            *oldname,
+                                                const char            *newname );
+
 DirectResult DIRECT_API direct_filesystem_size( const char            *name,
                                                 size_t                *size );
 
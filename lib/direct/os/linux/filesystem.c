@@ -288,6 +288,18 @@ direct_file_unmap( void   *addr,
      return DR_OK;
 }
 
+DirectResult
+direct_file_prefetch( const void *addr,
+                      size_t      bytes )
+{
+     unsigned long start = (unsigned long) addr & ~(sysconf( _SC_PAGESIZE ) - 1);
+
+     if (madvise( (void*) start, (unsigned long) addr + bytes - start, MADV_WILLNEED ) < 0)
+          return errno2result( errno );
+
+     return DR_OK;
+}
+
 DirectResult
 direct_file_get_info( DirectFile     *file,
                       DirectFileInfo *ret_info )
@@ -300,8 +312,9 @@ direct_file_get_info( DirectFile     *file,
      if (fstat( file->fd, &st ) < 0)
           return errno2result( errno );
 
-     ret_info->flags = DFIF_SIZE;
+     ret_info->flags = DFIF_SIZE | DFIF_MTIME;
      ret_info->size  = st.st_size;
+     ret_info->mtime = st.st_mtime;
 
      return DR_OK;
 }
@@ -464,6 +477,19 @@ direct_unlink( const char *name )
      return DR_OK;
 }
 
+DirectResult
+direct_rename( const char *oldname,
+               const char *newname )
+{
+     D_ASSERT( oldname != NULL );
+     D_ASSERT( newname != NULL );
+
+     if (rename( oldname, newname ) < 0)
+          return errno2result( errno );
+
+     return DR_OK;
+}
+
 DirectResult
 direct_filesystem_size( const char *name,
                         size_t     *size )
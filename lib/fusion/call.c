@@ -376,6 +376,9 @@ fusion_call_execute( FusionCall          *call,
           execute.flags    = flags | FCEF_RESUMABLE;
           execute.serial   = 0;
 
+          if (world->flush_callback)
+               world->flush_callback( world, world->flush_ctx );
+
           fusion_world_flush_calls( world, 1 );
 
           while (ioctl( world->fusion_fd, FUSION_CALL_EXECUTE, &execute )) {
@@ -433,7 +436,8 @@ fusion_call_execute2( FusionCall          *call,
                *ret_val = res;
      }
      else {
-          FusionCallExecute2 execute;
+          FusionCallExecute2  execute;
+          FusionWorld        *world = _fusion_world( call->shared );
 
           execute.call_id  = call->call_id;
           execute.call_arg = call_arg;
@@ -442,7 +446,10 @@ fusion_call_execute2( FusionCall          *call,
           execute.flags    = flags | FCEF_RESUMABLE;
           execute.serial   = 0;
 
-          fusion_world_flush_calls( _fusion_world( call->shared ), 1 );
+          if (world->flush_callback)
+               world->flush_callback( world, world->flush_ctx );
+
+          fusion_world_flush_calls( world, 1 );
 
           while (ioctl( _fusion_fd( call->shared ), FUSION_CALL_EXECUTE2, &execute )) {
                switch (errno) {
@@ -515,6 +522,10 @@ fusion_call_execute3( FusionCall          *call,
           FusionCallExecute3  execute;
           DirectResult        ret = DR_OK;
 
+          /* Send requests buffered by the caller before this call. */
+          if (world->flush_callback)
+               world->flush_callback( world, world->flush_ctx );
+
           /* Check whether we can cache this call. */
           if (flags & FCEF_QUEUE && fusion_config->call_bin_max_num > 0 && length < 10000) {
                if (call_tls->bins_data_len + length > fusion_config->call_bin_max_data) {
@@ -1184,6 +1195,10 @@ fusion_call_execute_internal( FusionCall          *call,
           return DR_OK;
      }
 
+     /* Send requests buffered by the caller before this call. */
+     if (world->flush_callback)
+          world->flush_callback( world, world->flush_ctx );
+
      msg->type        = FMT_CALL;
      msg->caller      = world->fusion_id;
      msg->call_id     = call->call_id;
@@ -3099,6 +3099,17 @@ fusion_world_set_leave_callback( FusionWorld         *world,
      world->leave_ctx      = ctx;
 }
 
+void
+fusion_world_set_flush_callback( FusionWorld         *world,
+                                 FusionFlushCallback  callback,
+                                 void                *ctx )
+{
+     D_MAGIC_ASSERT( world, FusionWorld );
+
+     world->flush_callback = callback;
+     world->flush_ctx      = ctx;
+}
+
 int
 fusion_world_index( const FusionWorld *world )
 {
@@ -3830,6 +3841,14 @@ fusion_world_set_leave_callback( FusionWorld         *world,
      D_MAGIC_ASSERT( world, FusionWorld );
 }
 
+void
+fusion_world_set_flush_callback( FusionWorld         *world,
+                                 FusionFlushCallback  callback,
+                                 void                *ctx )
+{
+     D_MAGIC_ASSERT( world, FusionWorld );
+}
+
 int
 fusion_world_index( const FusionWorld *world )
 {
@@ -45,6 +45,8 @@ typedef void (*FusionForkCallback) ( FusionForkAction action, FusionForkState st
 
 typedef void (*FusionLeaveCallback)( FusionWorld *world, FusionID fusion_id, void *ctx );
 
+typedef void (*FusionFlushCallback)( FusionWorld *world, void *ctx );
+
 typedef void (*FusionDispatchCleanupFunc)( void *ctx );
 
 typedef struct {
@@ -175,6 +177,14 @@ void             FUSION_API  fusion_world_set_leave_callback( FusionWorld
                                                               FusionLeaveCallback         callback,
                                                               void                       *ctx );
 
+/*
+ * Registers a callback called before a call to another fusionee is executed or queued, e.g. to send requests that are
+ * buffered outside of Fusion first.
+ */
+void             FUSION_API  fusion_world_set_flush_callback( FusionWorld                *world,
+                                                              FusionFlushCallback         callback,
+                                                              void                       *ctx );
+
 /*
  * Returns the index of the specified world.
  */
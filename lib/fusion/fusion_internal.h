@@ -100,6 +100,9 @@ struct __Fusion_FusionWorld {
      FusionLeaveCallback   leave_callback;
      void                 *leave_ctx;
 
+     FusionFlushCallback   flush_callback;
+     void                 *flush_ctx;
+
      DirectLink           *dispatch_cleanups;
 
      DirectMutex           refs_lock;
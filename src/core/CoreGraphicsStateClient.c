@@ -21,6 +21,7 @@
 #include <core/CoreGraphicsStateClient.h>
 #include <core/core.h>
 #include <core/graphics_state.h>
+#include <direct/memcpy.h>
 #include <fusion/conf.h>
 
 D_DEBUG_DOMAIN(
@@ -103,6 +104,110 @@ RemoveClient( CoreGraphicsStateClient *client )
 
 /**********************************************************************************************************************/
 
+DFBResult
+CoreGraphicsStateClient_FlushCommands( CoreGraphicsStateClient *client )
+{
+     DFBResult  ret;
+     CoreTLS   *core_tls = client->tls;
+
+     if (core_tls) {
+          D_MAGIC_ASSERT( core_tls, CoreTLS );
+
+          if (core_tls->pending == client)
+               core_tls->pending = NULL;
+
+          client->tls = NULL;
+     }
+
+     if (!client->length)
+          return DFB_OK;
+
+     D_DEBUG_AT( Core_GraphicsStateClient_Flush, "%s( %p ) <- length %u\n", __FUNCTION__, client, client->length );
+
+     ret = CoreGraphicsState_Execute( client->gfx_state, client->commands, client->length );
+
+     client->length = 0;
+
+     return ret;
+}
+
+/*
+ * Execute the pending commands of the calling thread, which may belong to another client, and those of the client
+ * itself, which may have been encoded by another thread. Called before any regular call to keep the order of requests.
+ */
+static DFBResult
+CoreGraphicsStateClient_FlushPending( CoreGraphicsStateClient *client )
+{
+     DFBResult  ret = DFB_OK;
+     CoreTLS   *core_tls;
+
+     if (!client->commands)
+          return DFB_OK;
+
+     core_tls = Core_GetTLS();
+     if (core_tls && core_tls->pending && core_tls->pending != client)
+          ret = CoreGraphicsStateClient_FlushCommands( core_tls->pending );
+
+     if (client->length || client->tls) {
+          DFBResult result = CoreGraphicsStateClient_FlushCommands( client );
+          if (result)
+               ret = result;
+     }
+
+     return ret;
+}
+
+/*
+ * Append a command to the command buffer and return the location of its payload. If the command buffer is not used or
+ * the command does not fit into it, pending commands are executed and NULL is returned for a regular call.
+ * Only one client per thread has pending commands, those of another client are executed before encoding this one.
+ */
+static void *
+CoreGraphicsStateClient_AddCommand( CoreGraphicsStateClient      *client,
+                                    CoreGraphicsStateCommandType  type,
+                                    u32                           num,
+                                    s32                           arg,
+                                    size_t                        payload )
+{
+     CoreGraphicsStateCommand *command;
+     unsigned int              size;
+     CoreTLS                  *core_tls;
+
+     if (!client->commands)
+          return NULL;
+
+     core_tls = Core_GetTLS();
+
+     if (!core_tls || core_tls->pending != client)
+          CoreGraphicsStateClient_FlushPending( client );
+
+     if (!core_tls || payload > CORE_GRAPHICS_STATE_COMMANDS_SIZE - sizeof(CoreGraphicsStateCommand)) {
+          CoreGraphicsStateClient_FlushCommands( client );
+          return NULL;
+     }
+
+     size = sizeof(CoreGraphicsStateCommand) + ((payload + 3) & ~3);
+
+     if (client->length + size > CORE_GRAPHICS_STATE_COMMANDS_SIZE)
+          CoreGraphicsStateClient_FlushCommands( client );
+
+     core_tls->pending = client;
+     client->tls       = core_tls;
+
+     command = (CoreGraphicsStateCommand*) (client->commands + client->length);
+
+     command->type = type;
+     command->size = size;
+     command->num  = num;
+     command->arg  = arg;
+
+     client->length += size;
+
+     return command + 1;
+}
+
+/**********************************************************************************************************************/
+
 DFBResult
 CoreGraphicsStateClient_Init( CoreGraphicsStateClient *client,
                               CardState               *state )
@@ -119,10 +224,24 @@ CoreGraphicsStateClient_Init( CoreGraphicsStateClient *client,
      client->core      = state->core;
      client->state     = state;
      client->gfx_state = NULL;
+     client->commands  = NULL;
+     client->length    = 0;
+     client->tls       = NULL;
+
+     /* Slaves going through the master encode state changes and operations into a command buffer. */
+     if (!dfb_core_is_master( state->core ) && (dfb_config->call_nodirect || fusion_config->secure_fusion)) {
+          client->commands = D_MALLOC( CORE_GRAPHICS_STATE_COMMANDS_SIZE );
+          if (!client->commands)
+               return D_OOM();
+     }
 
      ret = CoreDFB_CreateState( state->core, &client->gfx_state );
-     if (ret)
+     if (ret) {
+          if (client->commands)
+               D_FREE( client->commands );
+
           return ret;
+     }
 
      D_DEBUG_AT( Core_GraphicsStateClient, "  -> gfxstate id 0x%x\n",
                  (unsigned int) client->gfx_state->object.ref.multi.id );
@@ -151,6 +270,9 @@ CoreGraphicsStateClient_Deinit( CoreGraphicsStateClient *client )
 
      dfb_graphics_state_unref( client->gfx_state );
 
+     if (client->commands)
+          D_FREE( client->commands );
+
      RemoveClient( client );
 
      D_MAGIC_CLEAR( client );
@@ -167,6 +289,8 @@ CoreGraphicsStateClient_Flush( CoreGraphicsStateClient *client )
            dfb_gfxcard_flush();
       }
       else {
+           CoreGraphicsStateClient_FlushPending( client );
+
            CoreGraphicsState_Flush( client->gfx_state );
       }
 }
@@ -178,6 +302,8 @@ CoreGraphicsStateClient_ReleaseSource( CoreGraphicsStateClient *client )
 
      D_MAGIC_ASSERT( client, CoreGraphicsStateClient );
 
+     CoreGraphicsStateClient_FlushPending( client );
+
      CoreGraphicsState_ReleaseSource( client->gfx_state );
 
      return DFB_OK;
@@ -192,23 +318,107 @@ CoreGraphicsStateClient_SetColorAndIndex( CoreGraphicsStateClient *client,
 
      D_MAGIC_ASSERT( client, CoreGraphicsStateClient );
 
+     CoreGraphicsStateClient_FlushPending( client );
+
      CoreGraphicsState_SetColorAndIndex( client->gfx_state, color, index );
 
      return DFB_OK;
 }
 
+static void
+CoreGraphicsStateClient_EncodeState( CoreGraphicsStateClient *client,
+                                     CardState               *state,
+                                     StateModificationFlags   flags )
+{
+     void *payload;
+
+     if (flags & SMF_DRAWING_FLAGS)
+          CoreGraphicsStateClient_AddCommand( client, CGSC_DRAWING_FLAGS, 0, state->drawingflags, 0 );
+
+     if (flags & SMF_BLITTING_FLAGS)
+          CoreGraphicsStateClient_AddCommand( client, CGSC_BLITTING_FLAGS, 0, state->blittingflags, 0 );
+
+     if (flags & SMF_CLIP) {
+          payload = CoreGraphicsStateClient_AddCommand( client, CGSC_CLIP, 0, 0, sizeof(DFBRegion) );
+          direct_memcpy( payload, &state->clip, sizeof(DFBRegion) );
+     }
+
+     if (flags & SMF_COLOR) {
+          payload = CoreGraphicsStateClient_AddCommand( client, CGSC_COLOR, 0, 0, sizeof(DFBColor) );
+          direct_memcpy( payload, &state->color, sizeof(DFBColor) );
+     }
+
+     if (flags & SMF_SRC_BLEND)
+          CoreGraphicsStateClient_AddCommand( client, CGSC_SRC_BLEND, 0, state->src_blend, 0 );
+
+     if (flags & SMF_DST_BLEND)
+          CoreGraphicsStateClient_AddCommand( client, CGSC_DST_BLEND, 0, state->dst_blend, 0 );
+
+     if (flags & SMF_SRC_COLORKEY)
+          CoreGraphicsStateClient_AddCommand( client, CGSC_SRC_COLORKEY, 0, state->src_colorkey, 0 );
+
+     if (flags & SMF_DST_COLORKEY)
+          CoreGraphicsStateClient_AddCommand( client, CGSC_DST_COLORKEY, 0, state->dst_colorkey, 0 );
+
+     if (flags & SMF_SOURCE_MASK_VALS) {
+          payload = CoreGraphicsStateClient_AddCommand( client, CGSC_SOURCE_MASK_VALS, 0, state->src_mask_flags,
+                                                        sizeof(DFBPoint) );
+          direct_memcpy( payload, &state->src_mask_offset, sizeof(DFBPoint) );
+     }
+
+     if (flags & SMF_COLORKEY) {
+          payload = CoreGraphicsStateClient_AddCommand( client, CGSC_COLORKEY, 0, 0, sizeof(DFBColorKey) );
+          direct_memcpy( payload, &state->colorkey, sizeof(DFBColorKey) );
+     }
+
+     if (flags & SMF_RENDER_OPTIONS)
+          CoreGraphicsStateClient_AddCommand( client, CGSC_RENDER_OPTIONS, 0, state->render_options, 0 );
+
+     if (flags & SMF_MATRIX) {
+          payload = CoreGraphicsStateClient_AddCommand( client, CGSC_MATRIX, 0, 0, sizeof(state->matrix) );
+          direct_memcpy( payload, state->matrix, sizeof(state->matrix) );
+     }
+
+     if (flags & SMF_FROM)
+          CoreGraphicsStateClient_AddCommand( client, CGSC_FROM, state->from_eye, state->from, 0 );
+
+     if (flags & SMF_TO)
+          CoreGraphicsStateClient_AddCommand( client, CGSC_TO, state->to_eye, state->to, 0 );
+
+     if (flags & SMF_SRC_CONVOLUTION) {
+          payload = CoreGraphicsStateClient_AddCommand( client, CGSC_SRC_CONVOLUTION, 0, 0,
+                                                        sizeof(DFBConvolutionFilter) );
+          direct_memcpy( payload, &state->src_convolution, sizeof(DFBConvolutionFilter) );
+     }
+}
+
 static DFBResult
 CoreGraphicsStateClient_SetState( CoreGraphicsStateClient *client,
                                   CardState               *state,
                                   StateModificationFlags   flags )
 {
-     DFBResult ret;
+     DFBResult              ret;
+     StateModificationFlags objects = SMF_DESTINATION | SMF_SOURCE | SMF_SOURCE_MASK | SMF_SOURCE2 |
+                                      SMF_INDEX_TRANSLATION;
 
      D_DEBUG_AT( Core_GraphicsStateClient, "%s( %p, %p, flags 0x%08x )\n", __FUNCTION__, client, state, flags );
 
      D_MAGIC_ASSERT( client, CoreGraphicsStateClient );
      D_MAGIC_ASSERT( state, CardState );
 
+     if (client->commands) {
+          /* Surfaces and the index translation are still set by regular calls, after the pending commands. */
+          if (flags & objects) {
+               ret = CoreGraphicsStateClient_FlushPending( client );
+               if (ret)
+                    return ret;
+          }
+
+          CoreGraphicsStateClient_EncodeState( client, state, flags & ~objects );
+
+          flags &= objects;
+     }
+
      if (flags & SMF_DRAWING_FLAGS) {
           ret = CoreGraphicsState_SetDrawingFlags( client->gfx_state, state->drawingflags );
           if (ret)
@@ -422,6 +632,8 @@ CoreGraphicsStateClient_GetAccelerationMask( CoreGraphicsStateClient *client,
                                           (client->state->source2 ? DFXL_BLIT2 : DFXL_BLIT) : DFXL_FILLRECTANGLE,
                                           client->state );
 
+          CoreGraphicsStateClient_FlushPending( client );
+
           ret = CoreGraphicsState_GetAccelerationMask( client->gfx_state, ret_accel );
           if (ret)
                return ret;
@@ -444,10 +656,18 @@ CoreGraphicsStateClient_FillRectangles( CoreGraphicsStateClient *client,
           dfb_gfxcard_fillrectangles( (DFBRectangle*) rects, num, client->state );
      }
      else {
-          DFBResult ret;
+          DFBResult     ret;
+          DFBRectangle *payload;
 
           CoreGraphicsStateClient_Update( client, DFXL_FILLRECTANGLE, client->state );
 
+          payload = CoreGraphicsStateClient_AddCommand( client, CGSC_FILLRECTANGLES, num, 0,
+                                                        sizeof(DFBRectangle) * num );
+          if (payload) {
+               direct_memcpy( payload, rects, sizeof(DFBRectangle) * num );
+               return DFB_OK;
+          }
+
           ret = CoreGraphicsState_FillRectangles( client->gfx_state, rects, num );
           if (ret)
                return ret;
@@ -473,10 +693,18 @@ CoreGraphicsStateClient_DrawRectangles( CoreGraphicsStateClient *client,
                dfb_gfxcard_drawrectangle( (DFBRectangle*) &rects[i], client->state );
      }
      else {
-          DFBResult ret;
+          DFBResult     ret;
+          DFBRectangle *payload;
 
           CoreGraphicsStateClient_Update( client, DFXL_DRAWRECTANGLE, client->state );
 
+          payload = CoreGraphicsStateClient_AddCommand( client, CGSC_DRAWRECTANGLES, num, 0,
+                                                        sizeof(DFBRectangle) * num );
+          if (payload) {
+               direct_memcpy( payload, rects, sizeof(DFBRectangle) * num );
+               return DFB_OK;
+          }
+
           ret = CoreGraphicsState_DrawRectangles( client->gfx_state, rects, num );
           if (ret)
                return ret;
@@ -499,10 +727,17 @@ CoreGraphicsStateClient_DrawLines( CoreGraphicsStateClient *client,
           dfb_gfxcard_drawlines( (DFBRegion*) lines, num, client->state );
      }
      else {
-          DFBResult ret;
+          DFBResult  ret;
+          DFBRegion *payload;
 
           CoreGraphicsStateClient_Update( client, DFXL_DRAWLINE, client->state );
 
+          payload = CoreGraphicsStateClient_AddCommand( client, CGSC_DRAWLINES, num, 0, sizeof(DFBRegion) * num );
+          if (payload) {
+               direct_memcpy( payload, lines, sizeof(DFBRegion) * num );
+               return DFB_OK;
+          }
+
           ret = CoreGraphicsState_DrawLines( client->gfx_state, lines, num );
           if (ret)
                return ret;
@@ -525,10 +760,17 @@ CoreGraphicsStateClient_FillTriangles( CoreGraphicsStateClient *client,
           dfb_gfxcard_filltriangles( (DFBTriangle*) triangles, num, client->state );
      }
      else {
-          DFBResult ret;
+          DFBResult    ret;
+          DFBTriangle *payload;
 
           CoreGraphicsStateClient_Update( client, DFXL_FILLTRIANGLE, client->state );
 
+          payload = CoreGraphicsStateClient_AddCommand( client, CGSC_FILLTRIANGLES, num, 0, sizeof(DFBTriangle) * num );
+          if (payload) {
+               direct_memcpy( payload, triangles, sizeof(DFBTriangle) * num );
+               return DFB_OK;
+          }
+
           ret = CoreGraphicsState_FillTriangles( client->gfx_state, triangles, num );
           if (ret)
                return ret;
@@ -551,10 +793,18 @@ CoreGraphicsStateClient_FillTrapezoids( CoreGraphicsStateClient *client,
           dfb_gfxcard_filltrapezoids( (DFBTrapezoid*) trapezoids, num, client->state );
      }
      else {
-          DFBResult ret;
+          DFBResult     ret;
+          DFBTrapezoid *payload;
 
           CoreGraphicsStateClient_Update( client, DFXL_FILLTRAPEZOID, client->state );
 
+          payload = CoreGraphicsStateClient_AddCommand( client, CGSC_FILLTRAPEZOIDS, num, 0,
+                                                        sizeof(DFBTrapezoid) * num );
+          if (payload) {
+               direct_memcpy( payload, trapezoids, sizeof(DFBTrapezoid) * num );
+               return DFB_OK;
+          }
+
           ret = CoreGraphicsState_FillTrapezoids( client->gfx_state, trapezoids, num );
           if (ret)
                return ret;
@@ -578,9 +828,16 @@ CoreGraphicsStateClient_FillQuadrangles( CoreGraphicsStateClient *client,
      }
      else {
           DFBResult ret;
+          DFBPoint *payload;
 
           CoreGraphicsStateClient_Update( client, DFXL_FILLQUADRANGLE, client->state );
 
+          payload = CoreGraphicsStateClient_AddCommand( client, CGSC_FILLQUADRANGLES, num, 0, sizeof(DFBPoint) * num );
+          if (payload) {
+               direct_memcpy( payload, points, sizeof(DFBPoint) * num );
+               return DFB_OK;
+          }
+
           ret = CoreGraphicsState_FillQuadrangles( client->gfx_state, points, num );
           if (ret)
                return ret;
@@ -605,9 +862,16 @@ CoreGraphicsStateClient_FillSpans( CoreGraphicsStateClient *client,
      }
      else {
           DFBResult ret;
+          DFBSpan  *payload;
 
           CoreGraphicsStateClient_Update( client, DFXL_FILLRECTANGLE, client->state );
 
+          payload = CoreGraphicsStateClient_AddCommand( client, CGSC_FILLSPANS, num, y, sizeof(DFBSpan) * num );
+          if (payload) {
+               direct_memcpy( payload, spans, sizeof(DFBSpan) * num );
+               return DFB_OK;
+          }
+
           ret = CoreGraphicsState_FillSpans( client->gfx_state, y, spans, num );
           if (ret)
                return ret;
@@ -632,11 +896,20 @@ CoreGraphicsStateClient_Blit( CoreGraphicsStateClient *client,
           dfb_gfxcard_batchblit( (DFBRectangle*) rects, (DFBPoint*) points, num, client->state );
      }
      else {
-          DFBResult    ret;
-          unsigned int i;
+          DFBResult     ret;
+          unsigned int  i;
+          DFBRectangle *payload;
 
           CoreGraphicsStateClient_Update( client, DFXL_BLIT, client->state );
 
+          payload = CoreGraphicsStateClient_AddCommand( client, CGSC_BLIT, num, 0,
+                                                        (sizeof(DFBRectangle) + sizeof(DFBPoint)) * num );
+          if (payload) {
+               direct_memcpy( payload, rects, sizeof(DFBRectangle) * num );
+               direct_memcpy( payload + num, points, sizeof(DFBPoint) * num );
+               return DFB_OK;
+          }
+
           for (i = 0; i < num; i += 200) {
                ret = CoreGraphicsState_Blit( client->gfx_state, &rects[i], &points[i], MIN( 200, num - i ) );
                if (ret)
@@ -665,10 +938,20 @@ CoreGraphicsStateClient_Blit2( CoreGraphicsStateClient *client,
           dfb_gfxcard_batchblit2( (DFBRectangle*) rects, (DFBPoint*) points1, (DFBPoint*) points2, num, client->state );
      }
      else {
-          DFBResult ret;
+          DFBResult     ret;
+          DFBRectangle *payload;
 
           CoreGraphicsStateClient_Update( client, DFXL_BLIT2, client->state );
 
+          payload = CoreGraphicsStateClient_AddCommand( client, CGSC_BLIT2, num, 0,
+                                                        (sizeof(DFBRectangle) + sizeof(DFBPoint) * 2) * num );
+          if (payload) {
+               direct_memcpy( payload, rects, sizeof(DFBRectangle) * num );
+               direct_memcpy( payload + num, points1, sizeof(DFBPoint) * num );
+               direct_memcpy( (DFBPoint*) (payload + num) + num, points2, sizeof(DFBPoint) * num );
+               return DFB_OK;
+          }
+
           ret = CoreGraphicsState_Blit2( client->gfx_state, rects, points1, points2, num );
           if (ret)
                return ret;
@@ -707,23 +990,28 @@ CoreGraphicsStateClient_StretchBlit( CoreGraphicsStateClient *client,
           }
      }
      else {
-          DFBResult ret;
+          DFBResult     ret;
+          DFBRectangle *payload;
 
           if (num == 1 && srects[0].w == drects[0].w && srects[0].h == drects[0].h) {
-               CoreGraphicsStateClient_Update( client, DFXL_BLIT, client->state );
-
                DFBPoint point = { drects[0].x, drects[0].y };
-               ret = CoreGraphicsState_Blit( client->gfx_state, srects, &point, 1 );
-               if (ret)
-                    return ret;
+
+               return CoreGraphicsStateClient_Blit( client, srects, &point, 1 );
           }
-          else {
-               CoreGraphicsStateClient_Update( client, DFXL_STRETCHBLIT, client->state );
 
-               ret = CoreGraphicsState_StretchBlit( client->gfx_state, srects, drects, num );
-               if (ret)
-                    return ret;
+          CoreGraphicsStateClient_Update( client, DFXL_STRETCHBLIT, client->state );
+
+          payload = CoreGraphicsStateClient_AddCommand( client, CGSC_STRETCHBLIT, num, 0,
+                                                        sizeof(DFBRectangle) * 2 * num );
+          if (payload) {
+               direct_memcpy( payload, srects, sizeof(DFBRectangle) * num );
+               direct_memcpy( payload + num, drects, sizeof(DFBRectangle) * num );
+               return DFB_OK;
           }
+
+          ret = CoreGraphicsState_StretchBlit( client->gfx_state, srects, drects, num );
+          if (ret)
+               return ret;
      }
 
      return DFB_OK;
@@ -751,10 +1039,20 @@ CoreGraphicsStateClient_TileBlit( CoreGraphicsStateClient *client,
                                      client->state );
      }
      else {
-          DFBResult ret;
+          DFBResult     ret;
+          DFBRectangle *payload;
 
           CoreGraphicsStateClient_Update( client, DFXL_BLIT, client->state );
 
+          payload = CoreGraphicsStateClient_AddCommand( client, CGSC_TILEBLIT, num, 0,
+                                                        (sizeof(DFBRectangle) + sizeof(DFBPoint) * 2) * num );
+          if (payload) {
+               direct_memcpy( payload, rects, sizeof(DFBRectangle) * num );
+               direct_memcpy( payload + num, points1, sizeof(DFBPoint) * num );
+               direct_memcpy( (DFBPoint*) (payload + num) + num, points2, sizeof(DFBPoint) * num );
+               return DFB_OK;
+          }
+
           ret = CoreGraphicsState_TileBlit( client->gfx_state, rects, points1, points2, num );
           if (ret)
                return ret;
@@ -778,10 +1076,18 @@ CoreGraphicsStateClient_TextureTriangles( CoreGraphicsStateClient *client,
           dfb_gfxcard_texture_triangles( (DFBVertex*) vertices, num, formation, client->state );
      }
      else {
-          DFBResult ret;
+          DFBResult  ret;
+          DFBVertex *payload;
 
           CoreGraphicsStateClient_Update( client, DFXL_TEXTRIANGLES, client->state );
 
+          payload = CoreGraphicsStateClient_AddCommand( client, CGSC_TEXTURETRIANGLES, num, formation,
+                                                        sizeof(DFBVertex) * num );
+          if (payload) {
+               direct_memcpy( payload, vertices, sizeof(DFBVertex) * num );
+               return DFB_OK;
+          }
+
           ret = CoreGraphicsState_TextureTriangles( client->gfx_state, vertices, num, formation );
           if (ret)
                return ret;
@@ -32,6 +32,10 @@ struct __DFB_CoreGraphicsStateClient {
      CardState         *state;     /* Local state structure. */
 
      CoreGraphicsState *gfx_state; /* Remote object for rendering, syncing values from local state as needed. */
+
+     u8                *commands;  /* Command buffer of a slave for the remote object, NULL if not used. */
+     unsigned int       length;    /* Length of the commands not yet executed. */
+     void              *tls;       /* Thread local data of the thread the pending commands belong to. */
 };
 
 /**********************************************************************************************************************/
@@ -43,6 +47,8 @@ void      CoreGraphicsStateClient_Deinit             ( CoreGraphicsStateClient *
 
 void      CoreGraphicsStateClient_Flush              ( CoreGraphicsStateClient *client );
 
+DFBResult CoreGraphicsStateClient_FlushCommands      ( CoreGraphicsStateClient *client );
+
 DFBResult CoreGraphicsStateClient_ReleaseSource      ( CoreGraphicsStateClient *client );
 
 DFBResult CoreGraphicsStateClient_SetColorAndIndex   ( CoreGraphicsStateClient *client,
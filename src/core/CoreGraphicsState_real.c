@@ -533,6 +533,200 @@ IGraphicsState_Real__SetSrcConvolution( CoreGraphicsState          *obj,
      return DFB_OK;
 }
 
+/*
+ * size of the fixed payload and of the array elements of each command type
+ */
+static const struct {
+     unsigned int fixed;
+     unsigned int element;
+} command_sizes[CGSC_NUM] = {
+     [CGSC_DRAWING_FLAGS]    = { 0, 0 },
+     [CGSC_BLITTING_FLAGS]   = { 0, 0 },
+     [CGSC_CLIP]             = { sizeof(DFBRegion), 0 },
+     [CGSC_COLOR]            = { sizeof(DFBColor), 0 },
+     [CGSC_SRC_BLEND]        = { 0, 0 },
+     [CGSC_DST_BLEND]        = { 0, 0 },
+     [CGSC_SRC_COLORKEY]     = { 0, 0 },
+     [CGSC_DST_COLORKEY]     = { 0, 0 },
+     [CGSC_SOURCE_MASK_VALS] = { sizeof(DFBPoint), 0 },
+     [CGSC_COLORKEY]         = { sizeof(DFBColorKey), 0 },
+     [CGSC_RENDER_OPTIONS]   = { 0, 0 },
+     [CGSC_MATRIX]           = { sizeof(s32) * 9, 0 },
+     [CGSC_FROM]             = { 0, 0 },
+     [CGSC_TO]               = { 0, 0 },
+     [CGSC_SRC_CONVOLUTION]  = { sizeof(DFBConvolutionFilter), 0 },
+     [CGSC_FILLRECTANGLES]   = { 0, sizeof(DFBRectangle) },
+     [CGSC_DRAWRECTANGLES]   = { 0, sizeof(DFBRectangle) },
+     [CGSC_DRAWLINES]        = { 0, sizeof(DFBRegion) },
+     [CGSC_FILLTRIANGLES]    = { 0, sizeof(DFBTriangle) },
+     [CGSC_FILLTRAPEZOIDS]   = { 0, sizeof(DFBTrapezoid) },
+     [CGSC_FILLQUADRANGLES]  = { 0, sizeof(DFBPoint) },
+     [CGSC_FILLSPANS]        = { 0, sizeof(DFBSpan) },
+     [CGSC_BLIT]             = { 0, sizeof(DFBRectangle) + sizeof(DFBPoint) },
+     [CGSC_BLIT2]            = { 0, sizeof(DFBRectangle) + sizeof(DFBPoint) * 2 },
+     [CGSC_STRETCHBLIT]      = { 0, sizeof(DFBRectangle) * 2 },
+     [CGSC_TILEBLIT]         = { 0, sizeof(DFBRectangle) + sizeof(DFBPoint) * 2 },
+     [CGSC_TEXTURETRIANGLES] = { 0, sizeof(DFBVertex) }
+};
+
+static DFBResult
+execute_command( CoreGraphicsState              *obj,
+                 const CoreGraphicsStateCommand *command )
+{
+     const void         *payload = command + 1;
+     const DFBRectangle *rects   = payload;
+     const DFBPoint     *points  = (const DFBPoint*) (rects + command->num);
+     u32                 num     = command->num;
+
+     switch (command->type) {
+          case CGSC_DRAWING_FLAGS:
+               return IGraphicsState_Real__SetDrawingFlags( obj, command->arg );
+
+          case CGSC_BLITTING_FLAGS:
+               return IGraphicsState_Real__SetBlittingFlags( obj, command->arg );
+
+          case CGSC_CLIP:
+               return IGraphicsState_Real__SetClip( obj, payload );
+
+          case CGSC_COLOR:
+               return IGraphicsState_Real__SetColor( obj, payload );
+
+          case CGSC_SRC_BLEND:
+               return IGraphicsState_Real__SetSrcBlend( obj, command->arg );
+
+          case CGSC_DST_BLEND:
+               return IGraphicsState_Real__SetDstBlend( obj, command->arg );
+
+          case CGSC_SRC_COLORKEY:
+               return IGraphicsState_Real__SetSrcColorKey( obj, command->arg );
+
+          case CGSC_DST_COLORKEY:
+               return IGraphicsState_Real__SetDstColorKey( obj, command->arg );
+
+          case CGSC_SOURCE_MASK_VALS:
+               return IGraphicsState_Real__SetSourceMaskVals( obj, payload, command->arg );
+
+          case CGSC_COLORKEY:
+               return IGraphicsState_Real__SetColorKey( obj, payload );
+
+          case CGSC_RENDER_OPTIONS:
+               return IGraphicsState_Real__SetRenderOptions( obj, command->arg );
+
+          case CGSC_MATRIX:
+               return IGraphicsState_Real__SetMatrix( obj, payload );
+
+          case CGSC_FROM:
+               if (command->arg != DSBR_FRONT && command->arg != DSBR_BACK && command->arg != DSBR_IDLE)
+                    return DFB_INVARG;
+
+               if (num != DSSE_LEFT && num != DSSE_RIGHT)
+                    return DFB_INVARG;
+
+               return IGraphicsState_Real__SetFrom( obj, command->arg, num );
+
+          case CGSC_TO:
+               if (command->arg != DSBR_FRONT && command->arg != DSBR_BACK && command->arg != DSBR_IDLE)
+                    return DFB_INVARG;
+
+               if (num != DSSE_LEFT && num != DSSE_RIGHT)
+                    return DFB_INVARG;
+
+               return IGraphicsState_Real__SetTo( obj, command->arg, num );
+
+          case CGSC_SRC_CONVOLUTION:
+               return IGraphicsState_Real__SetSrcConvolution( obj, payload );
+
+          case CGSC_FILLRECTANGLES:
+               return IGraphicsState_Real__FillRectangles( obj, payload, num );
+
+          case CGSC_DRAWRECTANGLES:
+               return IGraphicsState_Real__DrawRectangles( obj, payload, num );
+
+          case CGSC_DRAWLINES:
+               return IGraphicsState_Real__DrawLines( obj, payload, num );
+
+          case CGSC_FILLTRIANGLES:
+               return IGraphicsState_Real__FillTriangles( obj, payload, num );
+
+          case CGSC_FILLTRAPEZOIDS:
+               return IGraphicsState_Real__FillTrapezoids( obj, payload, num );
+
+          case CGSC_FILLQUADRANGLES:
+               return IGraphicsState_Real__FillQuadrangles( obj, payload, num );
+
+          case CGSC_FILLSPANS:
+               return IGraphicsState_Real__FillSpans( obj, command->arg, payload, num );
+
+          case CGSC_BLIT:
+               return IGraphicsState_Real__Blit( obj, rects, points, num );
+
+          case CGSC_BLIT2:
+               return IGraphicsState_Real__Blit2( obj, rects, points, points + num, num );
+
+          case CGSC_STRETCHBLIT:
+               return IGraphicsState_Real__StretchBlit( obj, rects, rects + num, num );
+
+          case CGSC_TILEBLIT:
+               return IGraphicsState_Real__TileBlit( obj, rects, points, points + num, num );
+
+          case CGSC_TEXTURETRIANGLES:
+               return IGraphicsState_Real__TextureTriangles( obj, payload, num, command->arg );
+
+          default:
+               break;
+     }
+
+     return DFB_INVARG;
+}
+
+DFBResult
+IGraphicsState_Real__Execute( CoreGraphicsState *obj,
+                              const u8          *commands,
+                              u32                length )
+{
+     DFBResult ret;
+     u32       offset = 0;
+
+     D_DEBUG_AT( DirectFB_CoreGraphicsState, "%s( %p, length %u )\n", __FUNCTION__, obj, length );
+
+     D_ASSERT( commands != NULL );
+
+     while (offset < length) {
+          const CoreGraphicsStateCommand *command = (const CoreGraphicsStateCommand*) (commands + offset);
+          u32                             size;
+
+          /* The buffer comes from a slave, validate each command before decoding it. */
+          if (length - offset < sizeof(CoreGraphicsStateCommand) || command->type >= CGSC_NUM ||
+              command->size < sizeof(CoreGraphicsStateCommand) || command->size > length - offset ||
+              command->size & 3)
+               return DFB_INVARG;
+
+          size = command->size - sizeof(CoreGraphicsStateCommand);
+
+          if (command_sizes[command->type].element) {
+               if (command->num > size / command_sizes[command->type].element)
+                    return DFB_INVARG;
+
+               if (size - command->num * command_sizes[command->type].element > 3)
+                    return DFB_INVARG;
+          }
+          else if (size < command_sizes[command->type].fixed || size - command_sizes[command->type].fixed > 3)
+               return DFB_INVARG;
+
+          D_DEBUG_AT( DirectFB_CoreGraphicsState, "  -> type %u, num %u, size %u\n",
+                      command->type, command->num, command->size );
+
+          /* Failing operations are skipped like when being called one by one. */
+          ret = execute_command( obj, command );
+          if (ret)
+               D_DEBUG_AT( DirectFB_CoreGraphicsState, "  -> %s\n", DirectFBErrorString( ret ) );
+
+          offset += command->size;
+     }
+
+     return DFB_OK;
+}
+
 DFBResult
 IGraphicsState_Real__GetAccelerationMask( CoreGraphicsState   *obj,
                                           DFBAccelerationMask *ret_accel )
@@ -17,6 +17,7 @@
 */
 
 #include <core/CoreDFB.h>
+#include <core/CoreGraphicsStateClient.h>
 #include <core/CoreSlave.h>
 #include <core/core.h>
 #include <core/core_parts.h>
@@ -1793,6 +1794,17 @@ dfb_core_leave_callback( FusionWorld *world,
      Core_Resource_DisposeIdentity( fusion_id );
 }
 
+static void
+dfb_core_flush_callback( FusionWorld *world,
+                         void        *ctx )
+{
+     CoreTLS *core_tls = direct_tls_get( &core_tls_key );
+
+     /* Execute the graphics commands buffered by the thread before any other request. */
+     if (core_tls && core_tls->pending)
+          CoreGraphicsStateClient_FlushCommands( core_tls->pending );
+}
+
 static int
 dfb_core_arena_initialize( void *ctx )
 {
@@ -1913,6 +1925,8 @@ dfb_core_arena_join( void *ctx )
           return DFB_UNSUPPORTED;
      }
 
+     fusion_world_set_flush_callback( core->world, dfb_core_flush_callback, NULL );
+
      /* Join. */
      ret = dfb_core_join( core );
      if (ret)
@@ -1949,6 +1963,9 @@ core_tls_destroy( void *arg )
 
      D_MAGIC_ASSERT( core_tls, CoreTLS );
 
+     if (core_tls->pending)
+          CoreGraphicsStateClient_FlushCommands( core_tls->pending );
+
      D_MAGIC_CLEAR( core_tls );
 
      D_FREE( core_tls );
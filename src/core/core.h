@@ -121,12 +121,14 @@ typedef struct {
 #define CORE_TLS_IDENTITY_STACK_MAX 8
 
 typedef struct {
-     int          magic;
+     int                      magic;
 
-     FusionID     identity[CORE_TLS_IDENTITY_STACK_MAX];
-     unsigned int identity_count;
+     FusionID                 identity[CORE_TLS_IDENTITY_STACK_MAX];
+     unsigned int             identity_count;
 
-     int          calling;
+     int                      calling;
+
+     CoreGraphicsStateClient *pending; /* State client of the thread with commands not yet executed. */
 } CoreTLS;
 
 /**********************************************************************************************************************/
@@ -31,7 +31,8 @@ typedef struct __DFB_CoreGraphicsState       CoreGraphicsState;
 typedef struct __DFB_CoreGraphicsStateClient CoreGraphicsStateClient;
 typedef struct __DFB_CoreFont                CoreFont;
 typedef struct __DFB_CoreFontCache           CoreFontCache;
-typedef struct __DFB_CoreFontCacheRow        CoreFontCacheRow;
+typedef struct __DFB_CoreFontCacheAtlas      CoreFontCacheAtlas;
+typedef struct __DFB_CoreFontCacheShelf      CoreFontCacheShelf;
 typedef struct __DFB_CoreFontManager         CoreFontManager;
 typedef struct __DFB_CoreGlyphData           CoreGlyphData;
 typedef struct __DFB_CoreInputDevice         CoreInputDevice;
@@ -16,23 +16,41 @@
    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
 */
 
+#include <config.h>
 #include <core/core.h>
 #include <core/fonts.h>
 #include <core/gfxcard.h>
 #include <core/surface.h>
+#include <core/surface_pool.h>
+#include <direct/atomic.h>
+#include <direct/filesystem.h>
 #include <direct/hash.h>
 #include <direct/map.h>
+#include <direct/system.h>
 #include <direct/utf8.h>
 #include <directfb_util.h>
 
 D_DEBUG_DOMAIN( Core_Font,         "Core/Font",          "DirectFB Core Font" );
 D_DEBUG_DOMAIN( Font_Cache,        "Core/Font/Cache",    "DirectFB Core Font Cache" );
-D_DEBUG_DOMAIN( Font_CacheRow,     "Core/Font/CacheRow", "DirectFB Core Font Cache Row" );
+D_DEBUG_DOMAIN( Font_CacheAtlas,   "Core/Font/Atlas",    "DirectFB Core Font Cache Atlas" );
 D_DEBUG_DOMAIN( Core_FontSurfaces, "Core/Font/Surf",     "DirectFB Core Font Surfaces" );
 D_DEBUG_DOMAIN( Font_Manager,      "Core/Font/Manager",  "DirectFB Core Font Manager" );
+D_DEBUG_DOMAIN( Font_CacheFile,    "Core/Font/File",     "DirectFB Core Font Cache File" );
+D_DEBUG_DOMAIN( Font_Measure,      "Core/Font/Measure",  "DirectFB Core Font Measurement Cache" );
+
+#ifdef USE_SSE
+#include <immintrin.h>
+
+static bool font_decode_sse2 = false;
+#endif
 
 /**********************************************************************************************************************/
 
+/*
+ * Maximum number of rows (of the cache height) stacked into one atlas surface.
+ */
+#define FONT_CACHE_ATLAS_ROWS 16
+
 struct __DFB_CoreFontCache {
      int                magic;
 
@@ -40,12 +58,17 @@ struct __DFB_CoreFontCache {
 
      CoreFontCacheType  type;
 
-     unsigned int       row_width;
+     unsigned int       atlas_width;
+     unsigned int       atlas_height;
+     unsigned int       atlas_rows;   /* maximum budget taken by one atlas, in rows of the cache height */
+     unsigned int       next_rows;    /* budget of the next atlas, doubled with each atlas created */
 
-     DirectLink        *rows;
+     unsigned int       align;        /* alignment mask for the x offset of glyphs */
+
+     DirectLink        *atlases;
 };
 
-struct __DFB_CoreFontCacheRow {
+struct __DFB_CoreFontCacheAtlas {
      DirectLink           link;
 
      int                  magic;
@@ -55,27 +78,104 @@ struct __DFB_CoreFontCacheRow {
      unsigned long long   stamp;
 
      CoreSurface         *surface;
-     unsigned int         next_x;
+     unsigned int         rows;       /* budget taken by the atlas */
+     bool                 readonly;   /* prewarmed from a glyph cache file, no glyphs are added */
+
+     DirectLink          *shelves;    /* sorted by y */
+};
+
+struct __DFB_CoreFontCacheShelf {
+     DirectLink           link;
+
+     int                  magic;
+
+     CoreFontCacheAtlas  *atlas;
 
-     DirectLink          *glyphs;
+     unsigned int         y;
+     unsigned int         height;
+
+     DirectLink          *glyphs;     /* sorted by x */
 };
 
+typedef struct {
+     DirectLink          link;
+
+     char               *path;
+     void               *map;
+     size_t              size;
+} FontCacheFileMap;
+
+typedef struct {
+     DirectLink          link;
+
+     int                 magic;
+
+     unsigned long       key;
+     DFBTextEncodingID   encoding;
+     int                 bytes;       /* text follows the entry */
+
+     CoreFontMeasure     measure;
+} CoreFontMeasureEntry;
+
+/*
+ * Longer strings are not kept in the measurement cache.
+ */
+#define FONT_MEASURE_MAX_BYTES 1024
+
+/* measurement cache statistics of all fonts, reported with the 'gfxcard-stats' option */
+static unsigned int font_measure_hits   = 0;
+static unsigned int font_measure_misses = 0;
+
+/*
+ * Maximum number of glyphs in the kerning table, it is built by querying all pairs.
+ */
+#define FONT_KERNING_MAX_GLYPHS 512
+
 struct __DFB_CoreFontManager {
      int                 magic;
 
      CoreDFB            *core;
 
      DirectMutex         lock;
+     unsigned int        lock_count;
+     unsigned long long  lock_stamp;  /* glyphs used since taking the lock are not evicted */
 
      DirectMap          *caches;
+     DirectLink         *cache_files; /* mapped glyph cache files */
 
      unsigned int        max_rows;
      unsigned int        num_rows;
-     unsigned long long  row_stamp;
+     unsigned long long  stamp;
 };
 
 /**********************************************************************************************************************/
 
+static __inline__ bool
+font_manager_pinned( const CoreFontManager *manager,
+                     unsigned long long     stamp )
+{
+     return manager->lock_count && stamp >= manager->lock_stamp;
+}
+
+static __inline__ void
+font_glyph_touch( CoreFontManager *manager,
+                  CoreGlyphData   *data )
+{
+     if (data->shelf)
+          data->stamp = data->shelf->atlas->stamp = manager->stamp++;
+}
+
+static __inline__ void
+font_glyph_publish( CoreFont      *font,
+                    CoreGlyphData *data )
+{
+     /* Make the completely set up glyph visible to lock-free lookups. */
+     if (data->index < font->direct_glyphs)
+          D_SYNC_STORE_RELEASE( &font->layers[data->layer].glyph_data[data->index], data );
+}
+
+/**********************************************************************************************************************/
+
 DFBResult
 dfb_font_manager_create( CoreDFB          *core,
                          CoreFontManager **ret_manager )
@@ -155,6 +255,10 @@ dfb_font_manager_init( CoreFontManager *manager,
      manager->core      = core;
      manager->max_rows  = dfb_config->max_font_rows;
 
+#ifdef USE_SSE
+     font_decode_sse2 = dfb_config->sse && __builtin_cpu_supports( "sse2" );
+#endif
+
      ret = direct_map_create( 11, font_cache_map_compare, font_cache_map_hash, NULL, &manager->caches );
      if (ret)
           return ret;
@@ -185,6 +289,8 @@ destroy_caches( DirectMap *map,
 DFBResult
 dfb_font_manager_deinit( CoreFontManager *manager )
 {
+     FontCacheFileMap *file, *next;
+
      D_DEBUG_AT( Font_Manager, "%s()\n", __FUNCTION__ );
 
      D_MAGIC_ASSERT( manager, CoreFontManager );
@@ -194,6 +300,14 @@ dfb_font_manager_deinit( CoreFontManager *manager )
      direct_map_iterate( manager->caches, destroy_caches, NULL );
      direct_map_destroy( manager->caches );
 
+     /* Prewarmed atlas surfaces are gone, unmap their memory. */
+     direct_list_foreach_safe (file, next, manager->cache_files) {
+          direct_file_unmap( file->map, file->size );
+
+          D_FREE( file->path );
+          D_FREE( file );
+     }
+
      direct_mutex_deinit( &manager->lock );
 
      D_MAGIC_CLEAR( manager );
@@ -212,6 +326,10 @@ dfb_font_manager_lock( CoreFontManager *manager )
 
      direct_mutex_lock( &manager->lock );
 
+     /* Glyphs used from now on may still be referenced by pending blits, keep them in the cache. */
+     if (!manager->lock_count++)
+          manager->lock_stamp = manager->stamp;
+
      return DFB_OK;
 }
 
@@ -224,6 +342,10 @@ dfb_font_manager_unlock( CoreFontManager *manager )
      D_ASSERT( manager->max_rows > 0 );
      D_ASSERT( manager->num_rows <= manager->max_rows );
 
+     D_ASSERT( manager->lock_count > 0 );
+
+     manager->lock_count--;
+
      direct_mutex_unlock( &manager->lock );
 
      return DFB_OK;
@@ -272,40 +394,66 @@ dfb_font_manager_get_cache( CoreFontManager          *manager,
 }
 
 typedef struct {
-     unsigned int      lru_stamp;
-     CoreFontCacheRow *lru_row;
-} FindLruRowContext;
+     CoreFontManager    *manager;
+     unsigned long long  lru_stamp;
+     CoreFontCacheAtlas *lru_atlas;
+} FindLruAtlasContext;
 
 static DirectEnumerationResult
-find_lru_row( DirectMap *map,
-              void      *object,
-              void      *ctx )
+find_lru_atlas( DirectMap *map,
+                void      *object,
+                void      *ctx )
 {
-     FindLruRowContext *context = ctx;
-     CoreFontCache     *cache   = object;
-     CoreFontCacheRow  *row;
+     FindLruAtlasContext *context = ctx;
+     CoreFontCache       *cache   = object;
+     CoreFontCacheAtlas  *atlas;
 
      D_DEBUG_AT( Font_Manager, "%s( %p )\n", __FUNCTION__, cache );
 
      D_MAGIC_ASSERT( cache, CoreFontCache );
 
-     direct_list_foreach (row, cache->rows) {
-          D_DEBUG_AT( Font_Manager, "  -> stamp %llu\n", row->stamp );
+     direct_list_foreach (atlas, cache->atlases) {
+          D_DEBUG_AT( Font_Manager, "  -> stamp %llu\n", atlas->stamp );
 
-          if (!context->lru_row || context->lru_stamp > row->stamp) {
-               context->lru_row   = row;
-               context->lru_stamp = row->stamp;
+          /* Skip atlases holding glyphs of the current operation. */
+          if (font_manager_pinned( context->manager, atlas->stamp ))
+               continue;
+
+          if (!context->lru_atlas || context->lru_stamp > atlas->stamp) {
+               context->lru_atlas = atlas;
+               context->lru_stamp = atlas->stamp;
           }
      }
 
      return DENUM_OK;
 }
 
+static void
+font_cache_remove_atlas( CoreFontCache      *cache,
+                         CoreFontCacheAtlas *atlas )
+{
+     CoreFontManager *manager;
+
+     D_MAGIC_ASSERT( cache, CoreFontCache );
+     D_MAGIC_ASSERT( atlas, CoreFontCacheAtlas );
+
+     manager = cache->manager;
+
+     D_MAGIC_ASSERT( manager, CoreFontManager );
+     D_ASSERT( manager->num_rows >= atlas->rows );
+
+     /* Decrease row counter. */
+     manager->num_rows -= atlas->rows;
+
+     direct_list_remove( &cache->atlases, &atlas->link );
+
+     dfb_font_cache_atlas_destroy( atlas );
+}
+
 DFBResult
-dfb_font_manager_remove_lru_row( CoreFontManager *manager )
+dfb_font_manager_evict_atlas( CoreFontManager *manager )
 {
-     FindLruRowContext  context;
-     CoreFontCache     *cache;
+     FindLruAtlasContext context;
 
      D_DEBUG_AT( Font_Manager, "%s()\n", __FUNCTION__ );
 
@@ -313,28 +461,20 @@ dfb_font_manager_remove_lru_row( CoreFontManager *manager )
      D_ASSERT( manager->max_rows > 0 );
      D_ASSERT( manager->num_rows <= manager->max_rows );
 
+     context.manager   = manager;
      context.lru_stamp = 0;
-     context.lru_row   = NULL;
+     context.lru_atlas = NULL;
 
-     direct_map_iterate( manager->caches, find_lru_row, &context );
+     direct_map_iterate( manager->caches, find_lru_atlas, &context );
 
-     if (!context.lru_row) {
-          D_ERROR( "Core/Font: Could not find any LRU row!\n" );
+     if (!context.lru_atlas) {
+          D_ERROR( "Core/Font: Could not find any LRU atlas!\n" );
           return DFB_ITEMNOTFOUND;
      }
 
-     D_DEBUG_AT( Font_Manager, "  -> row %p (stamp %llu)\n", context.lru_row, context.lru_row->stamp );
-
-     cache = context.lru_row->cache;
+     D_DEBUG_AT( Font_Manager, "  -> atlas %p (stamp %llu)\n", context.lru_atlas, context.lru_atlas->stamp );
 
-     D_MAGIC_ASSERT( cache, CoreFontCache );
-
-     direct_list_remove( &cache->rows, &context.lru_row->link );
-
-     dfb_font_cache_row_destroy( context.lru_row );
-
-     /* Decrease row counter. */
-     manager->num_rows--;
+     font_cache_remove_atlas( context.lru_atlas->cache, context.lru_atlas );
 
      return DFB_OK;
 }
@@ -396,16 +536,30 @@ dfb_font_cache_init( CoreFontCache           *cache,
      cache->manager = manager;
      cache->type    = *type;
 
-     cache->row_width = 2048 * type->height / 64;
+     cache->atlas_width = 2048 * type->height / 64;
+
+     if (cache->atlas_width > dfb_config->max_font_row_width)
+          cache->atlas_width = dfb_config->max_font_row_width;
+
+     if (cache->atlas_width < type->height)
+          cache->atlas_width = type->height;
+
+     cache->atlas_width = (cache->atlas_width + 7) & ~7;
 
-     if (cache->row_width > dfb_config->max_font_row_width)
-          cache->row_width = dfb_config->max_font_row_width;
+     /* Stack several rows into one surface, within the budget and not higher than wide. */
+     cache->atlas_rows = MIN( FONT_CACHE_ATLAS_ROWS, manager->max_rows );
+     cache->atlas_rows = MIN( cache->atlas_rows, cache->atlas_width / type->height );
 
-     if (cache->row_width < type->height)
-          cache->row_width = type->height;
+     cache->atlas_height = cache->atlas_rows * type->height;
 
-     cache->row_width = (cache->row_width + 7) & ~7;
+     /* Start with a single row, so that fonts using a few glyphs only do not take a large part of the budget. */
+     cache->next_rows = 1;
 
+     cache->align = (8 / (DFB_BYTES_PER_PIXEL( type->pixel_format ) ?: 1)) *
+                    (DFB_PIXELFORMAT_ALIGNMENT( type->pixel_format ) + 1) - 1;
+
+     D_DEBUG_AT( Font_Cache, "  -> atlas %ux%u (up to %u rows)\n",
+                 cache->atlas_width, cache->atlas_height, cache->atlas_rows );
 
      D_MAGIC_SET( cache, CoreFontCache );
 
@@ -415,34 +569,224 @@ dfb_font_cache_init( CoreFontCache           *cache,
 DFBResult
 dfb_font_cache_deinit( CoreFontCache *cache )
 {
-     CoreFontCacheRow *row, *next;
+     CoreFontCacheAtlas *atlas, *next;
 
      D_MAGIC_ASSERT( cache, CoreFontCache );
 
-     direct_list_foreach_safe (row, next, cache->rows) {
-          dfb_font_cache_row_destroy( row );
+     direct_list_foreach_safe (atlas, next, cache->atlases) {
+          font_cache_remove_atlas( cache, atlas );
      }
 
-     cache->rows = NULL;
+     cache->atlases = NULL;
 
      D_MAGIC_CLEAR( cache );
 
      return DFB_OK;
 }
 
+static void
+font_glyph_kick( CoreGlyphData *glyph )
+{
+     CoreFont *font = glyph->font;
+
+     D_MAGIC_ASSERT( glyph, CoreGlyphData );
+     D_ASSERT( glyph->layer < D_ARRAY_SIZE(font->layers) );
+
+     /* Glyphs in the direct index may be in use by lock-free lookups, only drop their bitmap. */
+     if (dfb_font_lookup_glyph( font, glyph->index, glyph->layer ) == glyph) {
+          glyph->shelf   = NULL;
+          glyph->surface = NULL;
+          glyph->evicted = true;
+          return;
+     }
+
+     direct_hash_remove( font->layers[glyph->layer].glyph_hash, glyph->index );
+
+     D_MAGIC_CLEAR( glyph );
+     D_FREE( glyph );
+}
+
+static bool
+font_shelf_find_space( CoreFontCacheShelf  *shelf,
+                       unsigned int         width,
+                       unsigned int        *ret_x,
+                       CoreGlyphData      **ret_next )
+{
+     CoreFontCache *cache = shelf->atlas->cache;
+     CoreGlyphData *glyph;
+     unsigned int   x     = 0;
+
+     /* Glyphs are sorted by their offset, look for the first gap wide enough. */
+     direct_list_foreach (glyph, shelf->glyphs) {
+          if (glyph->start >= x + width) {
+               *ret_x    = x;
+               *ret_next = glyph;
+
+               return true;
+          }
+
+          x = glyph->start + ((glyph->width + cache->align) & ~cache->align);
+     }
+
+     if (x + width > cache->atlas_width)
+          return false;
+
+     *ret_x    = x;
+     *ret_next = NULL;
+
+     return true;
+}
+
+static CoreFontCacheShelf *
+font_atlas_open_shelf( CoreFontCacheAtlas *atlas,
+                       unsigned int        height )
+{
+     CoreFontCacheShelf *shelf;
+     CoreFontCacheShelf *next;
+     unsigned int        y = 0;
+
+     /* Shelves are sorted by their offset, look for the first gap high enough. */
+     direct_list_foreach (next, atlas->shelves) {
+          if (next->y >= y + height)
+               break;
+
+          y = next->y + next->height;
+     }
+
+     if (!next && y + height > atlas->surface->config.size.h)
+          return NULL;
+
+     shelf = D_CALLOC( 1, sizeof(CoreFontCacheShelf) );
+     if (!shelf) {
+          D_OOM();
+          return NULL;
+     }
+
+     shelf->atlas  = atlas;
+     shelf->y      = y;
+     shelf->height = height;
+
+     D_MAGIC_SET( shelf, CoreFontCacheShelf );
+
+     direct_list_insert( &atlas->shelves, &shelf->link, next ? &next->link : NULL );
+
+     D_DEBUG_AT( Font_CacheAtlas, "  -> new shelf %p at %u, height %u\n", shelf, y, height );
+
+     return shelf;
+}
+
+static bool
+font_cache_place_glyph( CoreFontCache *cache,
+                        CoreGlyphData *data )
+{
+     CoreFontCacheAtlas *atlas;
+     CoreFontCacheShelf *shelf;
+     CoreFontCacheShelf *best_shelf = NULL;
+     CoreGlyphData      *best_next  = NULL;
+     unsigned int        best_x     = 0;
+     unsigned int        width      = data->width;
+     unsigned int        height     = data->height;
+     unsigned int        shelf_height;
+
+     /* Quantize the height of new shelves to share them between similar glyphs. */
+     shelf_height = MIN( (height + 3) & ~3, cache->type.height );
+
+     /* Find the lowest shelf with enough space left. */
+     direct_list_foreach (atlas, cache->atlases) {
+          D_MAGIC_ASSERT( atlas, CoreFontCacheAtlas );
+
+          if (atlas->readonly)
+               continue;
+
+          direct_list_foreach (shelf, atlas->shelves) {
+               unsigned int   x;
+               CoreGlyphData *next;
+
+               D_MAGIC_ASSERT( shelf, CoreFontCacheShelf );
+
+               if (shelf->height < height || (best_shelf && shelf->height >= best_shelf->height))
+                    continue;
+
+               if (font_shelf_find_space( shelf, width, &x, &next )) {
+                    best_shelf = shelf;
+                    best_next  = next;
+                    best_x     = x;
+               }
+          }
+     }
+
+     /* Rather open a new shelf than wasting too much space in a higher one. */
+     if (!best_shelf || best_shelf->height > shelf_height + shelf_height / 2) {
+          direct_list_foreach (atlas, cache->atlases) {
+               if (atlas->readonly)
+                    continue;
+
+               shelf = font_atlas_open_shelf( atlas, shelf_height );
+               if (shelf) {
+                    best_shelf = shelf;
+                    best_next  = NULL;
+                    best_x     = 0;
+                    break;
+               }
+          }
+     }
+
+     if (!best_shelf)
+          return false;
+
+     data->shelf   = best_shelf;
+     data->surface = best_shelf->atlas->surface;
+     data->start   = best_x;
+     data->y       = best_shelf->y;
+
+     direct_list_insert( &best_shelf->glyphs, &data->link, best_next ? &best_next->link : NULL );
+
+     return true;
+}
+
+static CoreGlyphData *
+font_cache_find_lru_glyph( CoreFontCache *cache )
+{
+     CoreFontCacheAtlas *atlas;
+     CoreFontCacheShelf *shelf;
+     CoreGlyphData      *glyph;
+     CoreGlyphData      *lru_glyph = NULL;
+
+     direct_list_foreach (atlas, cache->atlases) {
+          /* Evicting single glyphs does not free any space in prewarmed atlases. */
+          if (atlas->readonly)
+               continue;
+
+          direct_list_foreach (shelf, atlas->shelves) {
+               direct_list_foreach (glyph, shelf->glyphs) {
+                    /* Skip glyphs of the current operation. */
+                    if (font_manager_pinned( cache->manager, glyph->stamp ))
+                         continue;
+
+                    if (!lru_glyph || lru_glyph->stamp > glyph->stamp)
+                         lru_glyph = glyph;
+               }
+          }
+     }
+
+     return lru_glyph;
+}
+
 DFBResult
-dfb_font_cache_get_row( CoreFontCache     *cache,
-                        unsigned int       width,
-                        CoreFontCacheRow **ret_row )
+dfb_font_cache_insert_glyph( CoreFontCache *cache,
+                             CoreGlyphData *data )
 {
-     DFBResult         ret;
-     CoreFontManager  *manager;
-     CoreFontCacheRow *row;
-     CoreFontCacheRow *best_row = NULL;
-     unsigned int      best_val = 0;
+     DFBResult           ret;
+     CoreFontManager    *manager;
+     CoreFontCacheAtlas *atlas;
+     CoreGlyphData      *lru_glyph;
+     unsigned int        rows;
 
      D_MAGIC_ASSERT( cache, CoreFontCache );
-     D_ASSERT( ret_row != NULL );
+     D_MAGIC_ASSERT( data, CoreGlyphData );
+     D_ASSERT( data->shelf == NULL );
+     D_ASSERT( data->width > 0 && data->width <= cache->atlas_width );
+     D_ASSERT( data->height > 0 && data->height <= cache->type.height );
 
      manager = cache->manager;
 
@@ -450,96 +794,126 @@ dfb_font_cache_get_row( CoreFontCache     *cache,
      D_ASSERT( manager->max_rows > 0 );
      D_ASSERT( manager->num_rows <= manager->max_rows );
 
-     /* Try freshest row first. */
-     row = (CoreFontCacheRow*) cache->rows;
-     if (row && row->next_x + width <= cache->row_width) {
-          *ret_row = row;
+     while (!font_cache_place_glyph( cache, data )) {
+          /* Create another atlas if the budget allows, growing with each one up to the maximum size... */
+          rows = MIN( cache->next_rows, manager->max_rows - manager->num_rows );
+          if (rows) {
+               ret = dfb_font_cache_atlas_create( cache, rows, &atlas );
+               if (ret)
+                    return ret;
 
-          return DFB_OK;
-     }
+               /* Prepend to list (freshest is first). */
+               direct_list_prepend( &cache->atlases, &atlas->link );
 
-     /* Check for trailing space in each row. */
-     direct_list_foreach (row, cache->rows) {
-          D_MAGIC_ASSERT( row, CoreFontCacheRow );
+               /* Increase row counter in manager. */
+               manager->num_rows += rows;
 
-          /* If glyph fits... */
-          if (row->next_x + width <= cache->row_width) {
-               /* ...and no row yet or this row fits better... */
-               if (!best_row || best_val < row->next_x) {
-                    /* ...remember row. */
-                    best_row = row;
-                    best_val = row->next_x;
-               }
+               cache->next_rows = MIN( cache->next_rows * 2, cache->atlas_rows );
+
+               /* An empty atlas always has space, unless the shelf allocation failed. */
+               if (!font_cache_place_glyph( cache, data ))
+                    return DFB_NOSYSTEMMEMORY;
+
+               break;
           }
-     }
 
-     if (best_row) {
-          *ret_row = best_row;
+          /* ...otherwise evict the least recently used glyph of this cache... */
+          lru_glyph = font_cache_find_lru_glyph( cache );
+          if (lru_glyph) {
+               D_DEBUG_AT( Font_Cache, "  -> evicting glyph %u (stamp %llu)\n", lru_glyph->index, lru_glyph->stamp );
 
-          return DFB_OK;
-     }
+               dfb_font_cache_remove_glyph( lru_glyph );
+
+               font_glyph_kick( lru_glyph );
+               continue;
+          }
 
-     /* Maximum number of rows reached. */
-     if (manager->num_rows == manager->max_rows) {
-          /* Remove the least recently used row. */
-          ret = dfb_font_manager_remove_lru_row( manager );
+          /* ...or the least recently used atlas of another cache. */
+          ret = dfb_font_manager_evict_atlas( manager );
           if (ret)
                return ret;
      }
 
-     /* Create another row. */
-     ret = dfb_font_cache_row_create( cache, &row );
-     if (ret)
-          return ret;
+     font_glyph_touch( manager, data );
 
-     /* Prepend to list (freshest is first). */
-     direct_list_prepend( &cache->rows, &row->link );
+     return DFB_OK;
+}
 
-     /* Increase row counter in manager. */
-     manager->num_rows++;
+void
+dfb_font_cache_remove_glyph( CoreGlyphData *data )
+{
+     CoreFontCacheShelf *shelf;
+     CoreFontCacheAtlas *atlas;
 
-     *ret_row = row;
+     D_MAGIC_ASSERT( data, CoreGlyphData );
 
-     return DFB_OK;
+     shelf = data->shelf;
+     if (!shelf)
+          return;
+
+     D_MAGIC_ASSERT( shelf, CoreFontCacheShelf );
+
+     atlas = shelf->atlas;
+
+     D_MAGIC_ASSERT( atlas, CoreFontCacheAtlas );
+
+     direct_list_remove( &shelf->glyphs, &data->link );
+
+     data->shelf   = NULL;
+     data->surface = NULL;
+
+     /* If the shelf got empty, give its space back to the atlas. */
+     if (!shelf->glyphs) {
+          direct_list_remove( &atlas->shelves, &shelf->link );
+
+          D_MAGIC_CLEAR( shelf );
+          D_FREE( shelf );
+
+          /* If the atlas got empty, destroy it. */
+          if (!atlas->shelves)
+               font_cache_remove_atlas( atlas->cache, atlas );
+     }
 }
 
 DFBResult
-dfb_font_cache_row_create( CoreFontCache     *cache,
-                           CoreFontCacheRow **ret_row )
+dfb_font_cache_atlas_create( CoreFontCache       *cache,
+                             unsigned int         rows,
+                             CoreFontCacheAtlas **ret_atlas )
 {
-     DFBResult         ret;
-     CoreFontCacheRow *row;
+     DFBResult           ret;
+     CoreFontCacheAtlas *atlas;
 
-     row = D_CALLOC( 1, sizeof(CoreFontCacheRow) );
-     if (!row)
+     atlas = D_CALLOC( 1, sizeof(CoreFontCacheAtlas) );
+     if (!atlas)
           return D_OOM();
 
-     ret = dfb_font_cache_row_init( row, cache );
+     ret = dfb_font_cache_atlas_init( atlas, cache, rows );
      if (ret) {
-          D_FREE( row );
+          D_FREE( atlas );
           return ret;
      }
 
-     *ret_row = row;
+     *ret_atlas = atlas;
 
      return DFB_OK;
 }
 
 DFBResult
-dfb_font_cache_row_destroy( CoreFontCacheRow *row )
+dfb_font_cache_atlas_destroy( CoreFontCacheAtlas *atlas )
 {
-     D_MAGIC_ASSERT( row, CoreFontCacheRow );
+     D_MAGIC_ASSERT( atlas, CoreFontCacheAtlas );
 
-     dfb_font_cache_row_deinit( row );
+     dfb_font_cache_atlas_deinit( atlas );
 
-     D_FREE( row );
+     D_FREE( atlas );
 
      return DFB_OK;
 }
 
 DFBResult
-dfb_font_cache_row_init( CoreFontCacheRow *row,
-                         CoreFontCache    *cache )
+dfb_font_cache_atlas_init( CoreFontCacheAtlas *atlas,
+                           CoreFontCache      *cache,
+                           unsigned int        rows )
 {
      DFBResult        ret;
      CoreFontManager *manager;
@@ -551,202 +925,906 @@ dfb_font_cache_row_init( CoreFontCacheRow *row,
      D_MAGIC_ASSERT( manager, CoreFontManager );
      D_ASSERT( manager->max_rows > 0 );
      D_ASSERT( manager->num_rows <= manager->max_rows );
+     D_ASSERT( rows > 0 && rows <= cache->atlas_rows );
 
-     row->cache = cache;
+     atlas->cache = cache;
+     atlas->stamp = manager->stamp++;
+     atlas->rows  = rows;
 
      /* Create a new font surface. */
-     ret = dfb_surface_create_simple( manager->core, cache->row_width, cache->type.height, cache->type.pixel_format,
-                                      DFB_COLORSPACE_DEFAULT( cache->type.pixel_format ), cache->type.surface_caps,
-                                      CSTF_FONT, dfb_config->font_resource_id, NULL, &row->surface );
+     ret = dfb_surface_create_simple( manager->core, cache->atlas_width, rows * cache->type.height,
+                                      cache->type.pixel_format, DFB_COLORSPACE_DEFAULT( cache->type.pixel_format ),
+                                      cache->type.surface_caps,
+                                      CSTF_FONT, dfb_config->font_resource_id, NULL, &atlas->surface );
      if (ret) {
           D_DERROR( ret, "Core/Font: Could not create font surface!\n" );
           return ret;
      }
 
-     D_DEBUG_AT( Core_FontSurfaces, "  -> new row %u - %dx%d %s\n",
-                 manager->num_rows, row->surface->config.size.w, row->surface->config.size.h,
-                 dfb_pixelformat_name( row->surface->config.format ) );
+     D_DEBUG_AT( Core_FontSurfaces, "  -> new atlas (%u rows used) - %dx%d %s\n",
+                 manager->num_rows, atlas->surface->config.size.w, atlas->surface->config.size.h,
+                 dfb_pixelformat_name( atlas->surface->config.format ) );
 
-     D_MAGIC_SET( row, CoreFontCacheRow );
+     D_MAGIC_SET( atlas, CoreFontCacheAtlas );
 
      return DFB_OK;
 }
 
 DFBResult
-dfb_font_cache_row_deinit( CoreFontCacheRow *row )
+dfb_font_cache_atlas_deinit( CoreFontCacheAtlas *atlas )
 {
-     CoreGlyphData *glyph, *next;
+     CoreFontCacheShelf *shelf, *next_shelf;
+     CoreGlyphData      *glyph, *next;
 
-     D_MAGIC_ASSERT( row, CoreFontCacheRow );
+     D_MAGIC_ASSERT( atlas, CoreFontCacheAtlas );
 
      /* Kick out all glyphs. */
-     direct_list_foreach_safe (glyph, next, row->glyphs) {
-          CoreFont *font = glyph->font;
-
-          D_MAGIC_ASSERT( glyph, CoreGlyphData );
-          D_ASSERT( glyph->layer < D_ARRAY_SIZE(font->layers) );
-
-          direct_hash_remove( font->layers[glyph->layer].glyph_hash, glyph->index );
+     direct_list_foreach_safe (shelf, next_shelf, atlas->shelves) {
+          D_MAGIC_ASSERT( shelf, CoreFontCacheShelf );
 
-          if (glyph->index < 128)
-               font->layers[glyph->layer].glyph_data[glyph->index] = NULL;
+          direct_list_foreach_safe (glyph, next, shelf->glyphs) {
+               font_glyph_kick( glyph );
+          }
 
-          D_MAGIC_CLEAR( glyph );
-          D_FREE( glyph );
+          D_MAGIC_CLEAR( shelf );
+          D_FREE( shelf );
      }
 
-     dfb_surface_unref( row->surface );
+     dfb_surface_unref( atlas->surface );
 
-     D_MAGIC_CLEAR( row );
+     D_MAGIC_CLEAR( atlas );
 
      return DFB_OK;
 }
 
 /**********************************************************************************************************************/
 
-DFBResult
-dfb_font_create( CoreDFB                   *core,
-                 const DFBFontDescription  *description,
-                 const char                *url,
-                 CoreFont                 **ret_font )
-{
-     DFBResult  ret;
-     int        i;
-     CoreFont  *font;
+#define FONT_CACHE_FILE_MAGIC   "DFBGLYPH"
+#define FONT_CACHE_FILE_VERSION 1
 
-     D_DEBUG_AT( Core_Font, "%s()\n", __FUNCTION__ );
+typedef struct {
+     char               magic[8];
+     u32                version;
+     u32                header_size;     /* detects a different layout of the structures */
 
-     D_ASSERT( core != NULL );
-     D_ASSERT( ret_font != NULL );
+     u64                font_size;       /* identity of the font file */
+     u64                font_mtime;
 
-     font = D_CALLOC( 1, sizeof(CoreFont) );
-     if (!font)
-          return D_OOM();
+     DFBFontDescription description;     /* normalized description used to create the font */
+     u32                pixel_format;
+     u32                surface_caps;
 
-     for (i = 0; i < DFB_FONT_MAX_LAYERS; i++) {
-          ret = direct_hash_create( 163, &font->layers[i].glyph_hash );
-          if (ret) {
-               while (i--)
-                    direct_hash_destroy( font->layers[i].glyph_hash );
+     s32                height;
+     s32                ascender;
+     s32                descender;
+     s32                maxadvance;
 
-               D_FREE( font );
-               return ret;
-          }
-     }
+     u32                url_length;      /* including the terminating zero, padded to 8 bytes after the header */
 
-     font->description = *description;
-     font->url         = D_STRDUP( url );
+     u32                num_atlases;
+     u32                num_glyphs;
+} FontCacheFileHeader;
 
-     font->core    = core;
-     font->manager = dfb_core_font_manager( core );
+typedef struct {
+     u32                cache_height;    /* height of the cache type */
+     u32                width;
+     u32                height;
+     u32                pitch;
+     u64                offset;          /* page aligned offset of the bitmap in the file */
+} FontCacheFileAtlas;
 
-     font->pixel_format = dfb_config->font_format;
+typedef struct {
+     u32                index;
+     u32                layer;
+     s32                atlas;           /* -1 for glyphs without bitmap */
+     s32                start;
+     s32                y;
+     s32                shelf_height;
+     s32                width;
+     s32                height;
+     s32                left;
+     s32                top;
+     s32                xadvance;
+     s32                yadvance;
+} FontCacheFileGlyph;
+
+static DFBResult
+font_cache_file_header( const CoreFont      *font,
+                        FontCacheFileHeader *header )
+{
+     DFBResult                 ret;
+     DirectFile                fd;
+     DirectFileInfo            info;
+     const DFBFontDescription *desc = &font->description;
 
-     if ((font->pixel_format == DSPF_ARGB     ||
-          font->pixel_format == DSPF_ABGR     ||
-          font->pixel_format == DSPF_ARGB8565 ||
-          font->pixel_format == DSPF_ARGB4444 ||
-          font->pixel_format == DSPF_RGBA4444 ||
-          font->pixel_format == DSPF_ARGB1555 ||
-          font->pixel_format == DSPF_RGBA5551) && dfb_config->font_premult) {
-          font->surface_caps = DSCAPS_PREMULTIPLIED;
-     }
+     /* The font file itself is identified by its size and modification time. */
+     ret = direct_file_open( &fd, font->url, O_RDONLY, 0 );
+     if (ret)
+          return ret;
 
-     font->blittingflags = DSBLIT_BLEND_ALPHACHANNEL | DSBLIT_COLORIZE;
+     ret = direct_file_get_info( &fd, &info );
 
-     D_MAGIC_SET( font, CoreFont );
+     direct_file_close( &fd );
 
-     *ret_font = font;
+     if (ret)
+          return ret;
 
-     return DFB_OK;
-}
+     if (!(info.flags & DFIF_MTIME))
+          return DFB_UNSUPPORTED;
 
-void
-dfb_font_destroy( CoreFont *font )
-{
-     int i;
+     memset( header, 0, sizeof(FontCacheFileHeader) );
 
-     D_DEBUG_AT( Core_Font, "%s()\n", __FUNCTION__ );
+     memcpy( header->magic, FONT_CACHE_FILE_MAGIC, sizeof(header->magic) );
 
-     D_MAGIC_ASSERT( font, CoreFont );
-     D_ASSERT( font->encodings != NULL || !font->last_encoding );
+     header->version     = FONT_CACHE_FILE_VERSION;
+     header->header_size = sizeof(FontCacheFileHeader) + sizeof(FontCacheFileAtlas) + sizeof(FontCacheFileGlyph);
+     header->font_size   = info.size;
+     header->font_mtime  = info.mtime;
 
-     dfb_font_dispose( font );
+     /* Only keep the valid fields of the description. */
+     header->description.flags = desc->flags;
 
-     for (i = 0; i < DFB_FONT_MAX_LAYERS; i++)
-          direct_hash_destroy( font->layers[i].glyph_hash );
+     if (desc->flags & DFDESC_ATTRIBUTES)
+          header->description.attributes = desc->attributes;
 
-     for (i = DTEID_OTHER; i <= font->last_encoding; i++) {
-          CoreFontEncoding *encoding = font->encodings[i];
+     if (desc->flags & DFDESC_HEIGHT)
+          header->description.height = desc->height;
 
-          D_ASSERT( encoding != NULL );
-          D_ASSERT( encoding->name != NULL );
+     if (desc->flags & DFDESC_WIDTH)
+          header->description.width = desc->width;
 
-          D_MAGIC_CLEAR( encoding );
+     if (desc->flags & DFDESC_INDEX)
+          header->description.index = desc->index;
 
-          D_FREE( encoding->name );
-          D_FREE( encoding );
-     }
+     if (desc->flags & DFDESC_FIXEDADVANCE)
+          header->description.fixed_advance = desc->fixed_advance;
 
-     if (font->encodings)
-          D_FREE( font->encodings );
+     if (desc->flags & DFDESC_FRACT_HEIGHT)
+          header->description.fract_height = desc->fract_height;
 
-     D_FREE( font->url );
+     if (desc->flags & DFDESC_FRACT_WIDTH)
+          header->description.fract_width = desc->fract_width;
 
-     D_MAGIC_CLEAR( font );
+     if (desc->flags & DFDESC_OUTLINE_WIDTH)
+          header->description.outline_width = desc->outline_width;
 
-     D_FREE( font );
+     if (desc->flags & DFDESC_OUTLINE_OPACITY)
+          header->description.outline_opacity = desc->outline_opacity;
+
+     if (desc->flags & DFDESC_ROTATION)
+          header->description.rotation = desc->rotation;
+
+     header->pixel_format = font->pixel_format;
+     header->surface_caps = font->surface_caps;
+     header->height       = font->height;
+     header->ascender     = font->ascender;
+     header->descender    = font->descender;
+     header->maxadvance   = font->maxadvance;
+     header->url_length   = strlen( font->url ) + 1;
+
+     return DFB_OK;
 }
 
-static bool
-free_glyphs( DirectHash    *hash,
-             unsigned long  key,
-             void          *value,
-             void          *ctx )
+static void
+font_cache_file_path( const FontCacheFileHeader *header,
+                      const char                *url,
+                      char                      *buf,
+                      size_t                     size )
 {
-     CoreGlyphData    *data = value;
-     CoreFontCacheRow *row;
+     const u8 *p;
+     u32       hash = 0x811c9dc5;
 
-     D_DEBUG_AT( Core_Font, "%s( %lu )\n", __FUNCTION__, key );
+     /* FNV-1a over the url and everything affecting the glyph images. */
+     for (p = (const u8*) url; *p; p++)
+          hash = (hash ^ *p) * 0x01000193;
 
-     D_MAGIC_ASSERT( data, CoreGlyphData );
+     for (p = (const u8*) &header->description; p < (const u8*) &header->url_length; p++)
+          hash = (hash ^ *p) * 0x01000193;
 
-     CORE_GLYPH_DATA_DEBUG_AT( Core_Font, data );
+     snprintf( buf, size, "%s/%08x.dfbglyphs", dfb_config->font_cache_dir, hash );
+}
 
-     /* Remove glyph from font. */
-     direct_hash_remove( hash, key );
+static DFBResult
+font_cache_file_write( DirectFile *fd,
+                       const void *data,
+                       size_t      bytes )
+{
+     DFBResult ret;
+     size_t    written;
 
-     row = data->row;
-     if (row) {
-          D_MAGIC_ASSERT( row, CoreFontCacheRow );
+     while (bytes) {
+          ret = direct_file_write( fd, data, bytes, &written );
+          if (ret)
+               return ret;
 
-          /* Remove glyph from cache row. */
-          direct_list_remove( &row->glyphs, &data->link );
+          if (!written)
+               return DFB_IO;
 
-          /* If cache row got empty, destroy it. */
-          if (!row->glyphs) {
-               CoreFontManager *manager;
-               CoreFontCache   *cache = row->cache;
+          data   = (const u8*) data + written;
+          bytes -= written;
+     }
+
+     return DFB_OK;
+}
+
+static FontCacheFileMap *
+font_cache_file_map( CoreFontManager *manager,
+                     const char      *path )
+{
+     DFBResult         ret;
+     DirectFile        fd;
+     DirectFileInfo    info;
+     FontCacheFileMap *file;
+     void             *map;
+
+     /* Prewarmed surfaces may outlive their atlas, so mappings are kept until shutdown and reused. */
+     direct_list_foreach (file, manager->cache_files) {
+          if (!strcmp( file->path, path ))
+               return file;
+     }
+
+     ret = direct_file_open( &fd, path, O_RDONLY, 0 );
+     if (ret)
+          return NULL;
+
+     ret = direct_file_get_info( &fd, &info );
+     if (ret || info.size < sizeof(FontCacheFileHeader)) {
+          direct_file_close( &fd );
+          return NULL;
+     }
+
+     ret = direct_file_map( &fd, NULL, 0, info.size, DFP_READ, &map );
+
+     direct_file_close( &fd );
+
+     if (ret) {
+          D_DERROR( ret, "Core/Font: Failed during mmap() of '%s'!\n", path );
+          return NULL;
+     }
+
+     file = D_CALLOC( 1, sizeof(FontCacheFileMap) );
+     if (!file) {
+          D_OOM();
+          direct_file_unmap( map, info.size );
+          return NULL;
+     }
+
+     file->path = D_STRDUP( path );
+     file->map  = map;
+     file->size = info.size;
+
+     direct_list_append( &manager->cache_files, &file->link );
+
+     return file;
+}
+
+static CoreFontCacheAtlas *
+font_cache_file_atlas( CoreFont                 *font,
+                       const FontCacheFileAtlas *entry,
+                       void                     *pixels )
+{
+     DFBResult              ret;
+     CoreFontManager       *manager = font->manager;
+     CoreFontCache         *cache;
+     CoreFontCacheAtlas    *atlas;
+     CoreFontCacheType      type;
+     CoreSurface           *surface;
+     CoreSurfaceConfig      config;
+     DFBSurfaceDescription  desc;
+     unsigned int           rows;
+
+     type.height       = entry->cache_height;
+     type.pixel_format = font->pixel_format;
+     type.surface_caps = font->surface_caps;
+
+     ret = dfb_font_manager_get_cache( manager, &type, &cache );
+     if (ret || cache->type.height != entry->cache_height)
+          return NULL;
+
+     rows = (entry->height + cache->type.height - 1) / cache->type.height;
+
+     /* Prewarming never evicts anything. */
+     if (manager->num_rows + rows > manager->max_rows)
+          return NULL;
+
+     memset( &desc, 0, sizeof(desc) );
+
+     desc.flags                 = DSDESC_CAPS | DSDESC_PREALLOCATED;
+     desc.caps                  = font->surface_caps;
+     desc.preallocated[0].data  = pixels;
+     desc.preallocated[0].pitch = entry->pitch;
+
+     config.flags      = CSCONF_SIZE | CSCONF_FORMAT | CSCONF_COLORSPACE | CSCONF_CAPS | CSCONF_PREALLOCATED;
+     config.size.w     = entry->width;
+     config.size.h     = entry->height;
+     config.format     = font->pixel_format;
+     config.colorspace = DFB_COLORSPACE_DEFAULT( font->pixel_format );
+     config.caps       = font->surface_caps;
+
+     ret = dfb_surface_pools_prealloc( &desc, &config );
+     if (ret)
+          return NULL;
+
+     ret = dfb_surface_create( manager->core, &config, CSTF_FONT | CSTF_PREALLOCATED, dfb_config->font_resource_id, NULL,
+                               &surface );
+     if (ret) {
+          D_DERROR( ret, "Core/Font: Could not create prewarmed font surface!\n" );
+          return NULL;
+     }
+
+     atlas = D_CALLOC( 1, sizeof(CoreFontCacheAtlas) );
+     if (!atlas) {
+          D_OOM();
+          dfb_surface_unref( surface );
+          return NULL;
+     }
+
+     atlas->cache    = cache;
+     atlas->stamp    = manager->stamp++;
+     atlas->surface  = surface;
+     atlas->rows     = rows;
+     atlas->readonly = true;
+
+     D_MAGIC_SET( atlas, CoreFontCacheAtlas );
+
+     direct_list_append( &cache->atlases, &atlas->link );
+
+     /* Increase row counter in manager. */
+     manager->num_rows += rows;
+
+     D_DEBUG_AT( Core_FontSurfaces, "  -> prewarmed atlas (%u rows used) - %ux%u %s\n",
+                 manager->num_rows, entry->width, entry->height, dfb_pixelformat_name( font->pixel_format ) );
+
+     return atlas;
+}
+
+static bool
+font_cache_file_add_glyph( CoreFontCacheAtlas *atlas,
+                           CoreGlyphData      *data,
+                           unsigned int        shelf_height )
+{
+     CoreFontCacheShelf *shelf;
+     CoreFontCacheShelf *next_shelf;
+     CoreGlyphData      *next;
+
+     direct_list_foreach (next_shelf, atlas->shelves) {
+          if (next_shelf->y >= data->y)
+               break;
+     }
+
+     if (next_shelf && next_shelf->y == data->y) {
+          shelf = next_shelf;
+     }
+     else {
+          shelf = D_CALLOC( 1, sizeof(CoreFontCacheShelf) );
+          if (!shelf) {
+               D_OOM();
+               return false;
+          }
+
+          shelf->atlas  = atlas;
+          shelf->y      = data->y;
+          shelf->height = shelf_height;
+
+          D_MAGIC_SET( shelf, CoreFontCacheShelf );
+
+          direct_list_insert( &atlas->shelves, &shelf->link, next_shelf ? &next_shelf->link : NULL );
+     }
+
+     direct_list_foreach (next, shelf->glyphs) {
+          if (next->start > data->start)
+               break;
+     }
+
+     direct_list_insert( &shelf->glyphs, &data->link, next ? &next->link : NULL );
+
+     data->shelf   = shelf;
+     data->surface = atlas->surface;
+
+     return true;
+}
+
+static DFBResult
+font_cache_file_load( CoreFont *font )
+{
+     DFBResult                  ret;
+     CoreFontManager           *manager = font->manager;
+     FontCacheFileMap          *file;
+     FontCacheFileHeader        expected;
+     const FontCacheFileHeader *header;
+     const FontCacheFileAtlas  *atlases;
+     const FontCacheFileGlyph  *glyphs;
+     CoreFontCacheAtlas       **loaded;
+     size_t                     offset;
+     unsigned int               i;
+     unsigned int               num     = 0;
+     char                       path[PATH_MAX];
+
+     D_DEBUG_AT( Font_CacheFile, "%s( %p )\n", __FUNCTION__, font );
+
+     if (!dfb_config->font_cache_dir || !font->url)
+          return DFB_UNSUPPORTED;
+
+     /* Clearing new surfaces would write to the read-only mapping. */
+     if (dfb_config->surface_clear || DFB_PLANAR_PIXELFORMAT( font->pixel_format ))
+          return DFB_UNSUPPORTED;
+
+     ret = font_cache_file_header( font, &expected );
+     if (ret)
+          return ret;
+
+     font_cache_file_path( &expected, font->url, path, sizeof(path) );
+
+     file = font_cache_file_map( manager, path );
+     if (!file)
+          return DFB_FILENOTFOUND;
+
+     header = file->map;
+     offset = sizeof(FontCacheFileHeader) + ((header->url_length + 7) & ~7);
+
+     /* Everything up to the tables has to match. */
+     if (memcmp( header, &expected, (u8*) &expected.num_atlases - (u8*) &expected ) ||
+         offset > file->size || memcmp( (u8*) file->map + sizeof(FontCacheFileHeader), font->url, header->url_length )) {
+          D_DEBUG_AT( Font_CacheFile, "  -> '%s' does not match the font\n", path );
+          return DFB_UNSUPPORTED;
+     }
+
+     atlases = (const FontCacheFileAtlas*) ((u8*) file->map + offset);
+
+     if (header->num_atlases > (file->size - offset) / sizeof(FontCacheFileAtlas))
+          return DFB_UNSUPPORTED;
+
+     offset += header->num_atlases * sizeof(FontCacheFileAtlas);
+
+     glyphs = (const FontCacheFileGlyph*) ((u8*) file->map + offset);
+
+     if (header->num_glyphs > (file->size - offset) / sizeof(FontCacheFileGlyph))
+          return DFB_UNSUPPORTED;
+
+     loaded = D_CALLOC( header->num_atlases + 1, sizeof(CoreFontCacheAtlas*) );
+     if (!loaded)
+          return D_OOM();
+
+     /* Create the atlas surfaces directly on the mapped bitmaps. */
+     for (i = 0; i < header->num_atlases; i++) {
+          const FontCacheFileAtlas *entry = &atlases[i];
+
+          if (!entry->width || !entry->height || entry->width > 0x8000 || entry->height > 0x8000 ||
+              entry->pitch < DFB_BYTES_PER_LINE( font->pixel_format, entry->width ) ||
+              entry->offset % direct_pagesize() || entry->offset > file->size ||
+              (u64) entry->pitch * entry->height > file->size - entry->offset)
+               continue;
+
+          loaded[i] = font_cache_file_atlas( font, entry, (u8*) file->map + entry->offset );
+     }
+
+     for (i = 0; i < header->num_glyphs; i++) {
+          const FontCacheFileGlyph *entry = &glyphs[i];
+          const FontCacheFileAtlas *atlas = NULL;
+          CoreGlyphData            *data;
+
+          if (entry->layer >= DFB_FONT_MAX_LAYERS || entry->atlas < -1 || entry->atlas >= (s32) header->num_atlases)
+               continue;
+
+          if (entry->atlas >= 0) {
+               atlas = &atlases[entry->atlas];
+
+               if (!loaded[entry->atlas] || entry->width < 1 || entry->height < 1 || entry->start < 0 ||
+                   entry->y < 0 || entry->shelf_height < entry->height ||
+                   entry->start + entry->width > atlas->width || entry->y + entry->shelf_height > atlas->height)
+                    continue;
+          }
+
+          if (direct_hash_lookup( font->layers[entry->layer].glyph_hash, entry->index ))
+               continue;
+
+          data = D_CALLOC( 1, sizeof(CoreGlyphData) );
+          if (!data)
+               break;
+
+          D_MAGIC_SET( data, CoreGlyphData );
+
+          data->font     = font;
+          data->index    = entry->index;
+          data->layer    = entry->layer;
+          data->start    = entry->start;
+          data->y        = entry->y;
+          data->left     = entry->left;
+          data->top      = entry->top;
+          data->xadvance = entry->xadvance;
+          data->yadvance = entry->yadvance;
+
+          if (atlas) {
+               data->width  = entry->width;
+               data->height = entry->height;
+
+               if (!font_cache_file_add_glyph( loaded[entry->atlas], data, entry->shelf_height )) {
+                    D_MAGIC_CLEAR( data );
+                    D_FREE( data );
+                    break;
+               }
+
+               font_glyph_touch( manager, data );
+          }
+
+          direct_hash_insert( font->layers[data->layer].glyph_hash, data->index, data );
+
+          data->inserted = true;
+
+          font_glyph_publish( font, data );
+
+          num++;
+     }
+
+     /* Drop atlases without any glyphs. */
+     for (i = 0; i < header->num_atlases; i++) {
+          if (loaded[i] && !loaded[i]->shelves)
+               font_cache_remove_atlas( loaded[i]->cache, loaded[i] );
+     }
+
+     D_FREE( loaded );
+
+     D_DEBUG_AT( Font_CacheFile, "  -> prewarmed %u glyphs from '%s'\n", num, path );
+
+     return DFB_OK;
+}
+
+typedef struct {
+     CoreGlyphData **glyphs;
+     unsigned int    num;
+     unsigned int    size;
+} CollectGlyphsContext;
+
+static bool
+collect_glyphs( DirectHash    *hash,
+                unsigned long  key,
+                void          *value,
+                void          *ctx )
+{
+     CollectGlyphsContext *context = ctx;
+     CoreGlyphData        *data    = value;
+
+     D_MAGIC_ASSERT( data, CoreGlyphData );
+
+     /* Skip glyphs to be retried and glyphs not managed by the cache. */
+     if (data->retry || (data->width && !data->shelf))
+          return true;
+
+     if (context->num == context->size) {
+          CoreGlyphData **glyphs;
+
+          glyphs = D_REALLOC( context->glyphs, (context->size * 2 + 64) * sizeof(CoreGlyphData*) );
+          if (!glyphs)
+               return false;
+
+          context->glyphs = glyphs;
+          context->size   = context->size * 2 + 64;
+     }
+
+     context->glyphs[context->num++] = data;
+
+     return true;
+}
+
+static int
+compare_glyphs( const void *a,
+                const void *b )
+{
+     const CoreGlyphData *ga = *(CoreGlyphData* const*) a;
+     const CoreGlyphData *gb = *(CoreGlyphData* const*) b;
+     const CoreFontCache *ca = ga->shelf ? ga->shelf->atlas->cache : NULL;
+     const CoreFontCache *cb = gb->shelf ? gb->shelf->atlas->cache : NULL;
+
+     /* Group by cache, glyphs without bitmap last, then by decreasing height. */
+     if (ca != cb)
+          return !ca ? 1 : !cb ? -1 : ca->type.height < cb->type.height ? -1 : 1;
+
+     if (ga->height != gb->height)
+          return gb->height - ga->height;
+
+     return gb->width - ga->width;
+}
+
+static DFBResult
+font_cache_file_save( CoreFont *font )
+{
+     DFBResult             ret;
+     DirectFile            fd;
+     FontCacheFileHeader   header;
+     FontCacheFileAtlas   *atlases = NULL;
+     FontCacheFileGlyph   *glyphs  = NULL;
+     CollectGlyphsContext  context = { NULL, 0, 0 };
+     const CoreFontCache  *cache   = NULL;
+     unsigned int          i, l;
+     unsigned int          x       = 0;
+     unsigned int          shelf_y = 0;
+     unsigned int          shelf_h = 0;
+     u8                   *pixels  = NULL;
+     size_t                offset;
+     char                  path[PATH_MAX];
+     char                  tmp[PATH_MAX + 32];
+
+     D_DEBUG_AT( Font_CacheFile, "%s( %p )\n", __FUNCTION__, font );
+
+     if (!font->url || DFB_PLANAR_PIXELFORMAT( font->pixel_format ))
+          return DFB_UNSUPPORTED;
+
+     ret = font_cache_file_header( font, &header );
+     if (ret)
+          return ret;
+
+     for (l = 0; l < DFB_FONT_MAX_LAYERS; l++)
+          direct_hash_iterate( font->layers[l].glyph_hash, collect_glyphs, &context );
+
+     if (!context.num)
+          return DFB_OK;
+
+     qsort( context.glyphs, context.num, sizeof(CoreGlyphData*), compare_glyphs );
+
+     atlases = D_CALLOC( context.num, sizeof(FontCacheFileAtlas) );
+     glyphs  = D_CALLOC( context.num, sizeof(FontCacheFileGlyph) );
+     if (!atlases || !glyphs) {
+          ret = D_OOM();
+          goto out;
+     }
+
+     /* Pack the glyphs of each cache into new atlases, tallest first. */
+     for (i = 0; i < context.num; i++) {
+          CoreGlyphData      *data  = context.glyphs[i];
+          FontCacheFileGlyph *entry = &glyphs[i];
+
+          entry->index    = data->index;
+          entry->layer    = data->layer;
+          entry->atlas    = -1;
+          entry->left     = data->left;
+          entry->top      = data->top;
+          entry->xadvance = data->xadvance;
+          entry->yadvance = data->yadvance;
+
+          if (!data->width)
+               continue;
+
+          if (data->shelf->atlas->cache != cache) {
+               if (cache)
+                    atlases[header.num_atlases++].height = shelf_y + shelf_h;
+
+               cache   = data->shelf->atlas->cache;
+               x       = cache->atlas_width;
+               shelf_y = 0;
+               shelf_h = 0;
+
+               atlases[header.num_atlases].cache_height = cache->type.height;
+               atlases[header.num_atlases].width        = cache->atlas_width;
+          }
+
+          if (x + data->width > cache->atlas_width) {
+               shelf_y += shelf_h;
+               shelf_h  = MIN( (data->height + 3) & ~3, cache->type.height );
+               x        = 0;
+
+               if (shelf_y + shelf_h > cache->atlas_height) {
+                    atlases[header.num_atlases++].height = shelf_y;
+
+                    atlases[header.num_atlases].cache_height = cache->type.height;
+                    atlases[header.num_atlases].width        = cache->atlas_width;
+
+                    shelf_y = 0;
+               }
+          }
+
+          entry->atlas        = header.num_atlases;
+          entry->start        = x;
+          entry->y            = shelf_y;
+          entry->shelf_height = shelf_h;
+          entry->width        = data->width;
+          entry->height       = data->height;
+
+          x += (data->width + cache->align) & ~cache->align;
+     }
+
+     if (cache)
+          atlases[header.num_atlases++].height = shelf_y + shelf_h;
+
+     header.num_glyphs = context.num;
+
+     offset = direct_page_align( sizeof(FontCacheFileHeader) + ((header.url_length + 7) & ~7) +
+                                 header.num_atlases * sizeof(FontCacheFileAtlas) +
+                                 header.num_glyphs  * sizeof(FontCacheFileGlyph) );
+
+     for (i = 0; i < header.num_atlases; i++) {
+          atlases[i].pitch  = (DFB_BYTES_PER_LINE( font->pixel_format, atlases[i].width ) + 7) & ~7;
+          atlases[i].offset = offset;
+
+          offset = direct_page_align( offset + atlases[i].pitch * atlases[i].height );
+     }
+
+     /* Write to a temporary file of this writer first, running processes may have mapped the current one. */
+     font_cache_file_path( &header, font->url, path, sizeof(path) );
+
+     snprintf( tmp, sizeof(tmp), "%s.%d.%d.tmp", path, direct_getpid(), direct_gettid() );
+
+     ret = direct_file_open( &fd, tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+     if (ret) {
+          D_DERROR( ret, "Core/Font: Could not create glyph cache file '%s'!\n", tmp );
+          goto out;
+     }
+
+     ret = font_cache_file_write( &fd, &header, sizeof(header) );
+     if (!ret)
+          ret = font_cache_file_write( &fd, font->url, header.url_length );
+     if (!ret)
+          ret = direct_file_seek_to( &fd, sizeof(header) + ((header.url_length + 7) & ~7) );
+     if (!ret)
+          ret = font_cache_file_write( &fd, atlases, header.num_atlases * sizeof(FontCacheFileAtlas) );
+     if (!ret)
+          ret = font_cache_file_write( &fd, glyphs, header.num_glyphs * sizeof(FontCacheFileGlyph) );
+
+     for (i = 0; i < header.num_atlases && !ret; i++) {
+          size_t size = atlases[i].pitch * atlases[i].height;
+
+          pixels = D_CALLOC( 1, size );
+          if (!pixels) {
+               ret = D_OOM();
+               break;
+          }
+
+          /* Copy the glyph images from the atlas surfaces. */
+          for (l = 0; l < context.num; l++) {
+               CoreGlyphData *data = context.glyphs[l];
+               DFBRectangle   rect = { data->start, data->y, data->width, data->height };
+
+               if (glyphs[l].atlas != i)
+                    continue;
+
+               ret = dfb_surface_read_buffer( data->surface, DSBR_BACK,
+                                              pixels + glyphs[l].y * atlases[i].pitch +
+                                              DFB_BYTES_PER_LINE( font->pixel_format, glyphs[l].start ),
+                                              atlases[i].pitch, &rect );
+               if (ret)
+                    break;
+          }
+
+          if (!ret)
+               ret = direct_file_seek_to( &fd, atlases[i].offset );
+          if (!ret)
+               ret = font_cache_file_write( &fd, pixels, size );
+
+          D_FREE( pixels );
+     }
+
+     direct_file_close( &fd );
+
+     if (!ret)
+          ret = direct_rename( tmp, path );
+
+     if (ret) {
+          D_DERROR( ret, "Core/Font: Could not write glyph cache file '%s'!\n", path );
+          direct_unlink( tmp );
+     }
+     else
+          D_DEBUG_AT( Font_CacheFile, "  -> saved %u glyphs in %u atlases to '%s'\n",
+                      header.num_glyphs, header.num_atlases, path );
+
+out:
+     if (glyphs)
+          D_FREE( glyphs );
+
+     if (atlases)
+          D_FREE( atlases );
+
+     D_FREE( context.glyphs );
+
+     return ret;
+}
+
+/**********************************************************************************************************************/
+
+DFBResult
+dfb_font_create( CoreDFB                   *core,
+                 const DFBFontDescription  *description,
+                 const char                *url,
+                 CoreFont                 **ret_font )
+{
+     DFBResult  ret;
+     int        i;
+     CoreFont  *font;
+
+     D_DEBUG_AT( Core_Font, "%s()\n", __FUNCTION__ );
+
+     D_ASSERT( core != NULL );
+     D_ASSERT( ret_font != NULL );
+
+     font = D_CALLOC( 1, sizeof(CoreFont) );
+     if (!font)
+          return D_OOM();
+
+     font->direct_glyphs = dfb_config->font_direct_glyphs;
+
+     for (i = 0; i < DFB_FONT_MAX_LAYERS; i++) {
+          ret = direct_hash_create( 163, &font->layers[i].glyph_hash );
+          if (ret)
+               goto error;
+
+          font->layers[i].glyph_data = D_CALLOC( font->direct_glyphs ?: 1, sizeof(CoreGlyphData*) );
+          if (!font->layers[i].glyph_data) {
+               ret = D_OOM();
+               direct_hash_destroy( font->layers[i].glyph_hash );
+               goto error;
+          }
+     }
+
+     ret = direct_hash_create( 17, &font->measure.hash );
+     if (ret)
+          goto error;
+
+     direct_mutex_init( &font->measure.lock );
+
+     font->description = *description;
+     font->url         = D_STRDUP( url );
+
+     font->core    = core;
+     font->manager = dfb_core_font_manager( core );
+
+     font->pixel_format = dfb_config->font_format;
+
+     if ((font->pixel_format == DSPF_ARGB     ||
+          font->pixel_format == DSPF_ABGR     ||
+          font->pixel_format == DSPF_ARGB8565 ||
+          font->pixel_format == DSPF_ARGB4444 ||
+          font->pixel_format == DSPF_RGBA4444 ||
+          font->pixel_format == DSPF_ARGB1555 ||
+          font->pixel_format == DSPF_RGBA5551) && dfb_config->font_premult) {
+          font->surface_caps = DSCAPS_PREMULTIPLIED;
+     }
+
+     font->blittingflags = DSBLIT_BLEND_ALPHACHANNEL | DSBLIT_COLORIZE;
+
+     D_MAGIC_SET( font, CoreFont );
+
+     *ret_font = font;
+
+     return DFB_OK;
+
+error:
+     while (i--) {
+          direct_hash_destroy( font->layers[i].glyph_hash );
+          D_FREE( font->layers[i].glyph_data );
+     }
+
+     D_FREE( font );
 
-               D_MAGIC_ASSERT( cache, CoreFontCache );
+     return ret;
+}
+
+static bool
+free_glyphs( DirectHash    *hash,
+             unsigned long  key,
+             void          *value,
+             void          *ctx )
+{
+     CoreGlyphData *data = value;
+     CoreFont      *font = ctx;
 
-               manager = cache->manager;
+     D_DEBUG_AT( Core_Font, "%s( %lu )\n", __FUNCTION__, key );
 
-               D_MAGIC_ASSERT( manager, CoreFontManager );
-               D_ASSERT( manager->max_rows > 0 );
-               D_ASSERT( manager->num_rows <= manager->max_rows );
+     D_MAGIC_ASSERT( data, CoreGlyphData );
 
-               /* Remove row from cache. */
-               direct_list_remove( &cache->rows, &row->link );
+     CORE_GLYPH_DATA_DEBUG_AT( Core_Font, data );
 
-               /* Destroy row. */
-               dfb_font_cache_row_destroy( row );
+     /* Remove glyph from cache. */
+     if (data->shelf) {
+          dfb_font_cache_remove_glyph( data );
 
-               /* Decrease row counter in manager. */
-               manager->num_rows--;
-          }
+          data->evicted = true;
      }
 
+     /* Unless the font is destroyed, keep glyphs of the direct index for lock-free lookups. */
+     if (font && dfb_font_lookup_glyph( font, data->index, data->layer ) == data)
+          return true;
+
+     /* Remove glyph from font. */
+     direct_hash_remove( hash, key );
+
      D_MAGIC_CLEAR( data );
 
      D_FREE( data );
@@ -754,40 +1832,152 @@ free_glyphs( DirectHash    *hash,
      return true;
 }
 
-DFBResult
-dfb_font_dispose( CoreFont *font )
+void
+dfb_font_destroy( CoreFont *font )
 {
-     int i;
+     int                   i;
+     CoreFontMeasureEntry *entry, *next;
 
      D_DEBUG_AT( Core_Font, "%s()\n", __FUNCTION__ );
 
      D_MAGIC_ASSERT( font, CoreFont );
+     D_ASSERT( font->encodings != NULL || !font->last_encoding );
+
+     /* Keep the glyphs rendered by this font for the next process. */
+     if (font->cache_file_dirty && dfb_config->font_cache_dir) {
+          dfb_font_manager_lock( font->manager );
 
+          font_cache_file_save( font );
+
+          dfb_font_manager_unlock( font->manager );
+     }
+
+     dfb_font_dispose( font );
+
+     /* Free the glyphs kept for the direct index, too. */
      dfb_font_manager_lock( font->manager );
 
-     for (i = 0; i < DFB_FONT_MAX_LAYERS; i++) {
+     for (i = 0; i < DFB_FONT_MAX_LAYERS; i++)
           direct_hash_iterate( font->layers[i].glyph_hash, free_glyphs, NULL );
 
-          memset( font->layers[i].glyph_data, 0, sizeof(font->layers[i].glyph_data) );
+     dfb_font_manager_unlock( font->manager );
+
+     for (i = 0; i < DFB_FONT_MAX_LAYERS; i++) {
+          direct_hash_destroy( font->layers[i].glyph_hash );
+
+          D_FREE( font->layers[i].glyph_data );
+     }
+
+     D_DEBUG_AT( Font_Measure, "  -> %u entries\n", font->measure.count );
+
+     direct_list_foreach_safe (entry, next, font->measure.entries) {
+          D_MAGIC_CLEAR( entry );
+          D_FREE( entry );
+     }
+
+     direct_hash_destroy( font->measure.hash );
+
+     direct_mutex_deinit( &font->measure.lock );
+
+     if (font->kerning.first)
+          D_FREE( font->kerning.first );
+
+     if (font->kerning.pairs)
+          D_FREE( font->kerning.pairs );
+
+     for (i = DTEID_OTHER; i <= font->last_encoding; i++) {
+          CoreFontEncoding *encoding = font->encodings[i];
+
+          D_ASSERT( encoding != NULL );
+          D_ASSERT( encoding->name != NULL );
+
+          D_MAGIC_CLEAR( encoding );
+
+          D_FREE( encoding->name );
+          D_FREE( encoding );
      }
 
+     if (font->encodings)
+          D_FREE( font->encodings );
+
+     D_FREE( font->url );
+
+     D_MAGIC_CLEAR( font );
+
+     D_FREE( font );
+}
+
+DFBResult
+dfb_font_dispose( CoreFont *font )
+{
+     int i;
+
+     D_DEBUG_AT( Core_Font, "%s()\n", __FUNCTION__ );
+
+     D_MAGIC_ASSERT( font, CoreFont );
+
+     dfb_font_manager_lock( font->manager );
+
+     for (i = 0; i < DFB_FONT_MAX_LAYERS; i++)
+          direct_hash_iterate( font->layers[i].glyph_hash, free_glyphs, font );
+
      dfb_font_manager_unlock( font->manager );
 
      return DFB_OK;
 }
 
+static void
+font_glyph_restore( CoreFont      *font,
+                    CoreGlyphData *data )
+{
+     DFBResult         ret;
+     CoreFontCache    *cache;
+     CoreFontCacheType type;
+
+     D_DEBUG_AT( Core_Font, "%s( index %u, layer %u )\n", __FUNCTION__, data->index, data->layer );
+
+     D_ASSERT( data->shelf == NULL );
+     D_ASSERT( data->width > 0 && data->height > 0 );
+
+     if (!font->RenderGlyph)
+          return;
+
+     type.height       = MAX( MAX( data->height, data->width ), font->height );
+     type.pixel_format = font->pixel_format;
+     type.surface_caps = font->surface_caps;
+
+     ret = dfb_font_manager_get_cache( font->manager, &type, &cache );
+     if (ret)
+          return;
+
+     ret = dfb_font_cache_insert_glyph( cache, data );
+     if (ret) {
+          D_DEBUG_AT( Core_Font, "  -> could not insert glyph into cache!\n" );
+          return;
+     }
+
+     ret = font->RenderGlyph( font, data->index, data );
+     if (ret) {
+          D_DEBUG_AT( Core_Font, "  -> rendering glyph failed!\n" );
+          dfb_font_cache_remove_glyph( data );
+          return;
+     }
+
+     dfb_gfxcard_flush_texture_cache();
+
+     data->evicted = false;
+}
+
 DFBResult
 dfb_font_get_glyph_data( CoreFont       *font,
                          unsigned int    index,
                          unsigned int    layer,
                          CoreGlyphData **ret_data )
 {
-     DFBResult         ret;
-     CoreGlyphData    *data;
-     int               align;
-     CoreFontManager  *manager;
-     CoreFontCache    *cache;
-     CoreFontCacheRow *row = NULL;
+     DFBResult        ret;
+     CoreGlyphData   *data;
+     CoreFontManager *manager;
+     CoreFontCache   *cache;
 
      D_DEBUG_AT( Core_Font, "%s( index %u, layer %u )\n", __FUNCTION__, index, layer );
 
@@ -801,13 +1991,18 @@ dfb_font_get_glyph_data( CoreFont       *font,
      D_ASSERT( (manager)->max_rows > 0 );
      D_ASSERT( (manager)->num_rows <= (manager)->max_rows );
 
-     /* Quick Lookup in array. */
-     if (index < 128 && font->layers[layer].glyph_data[index]) {
-          data = font->layers[layer].glyph_data[index];
-          if (data->retry)
-               goto retry;
+     /* Quick lookup in direct index. */
+     data = dfb_font_lookup_glyph( font, index, layer );
+     if (data) {
+          D_MAGIC_ASSERT( data, CoreGlyphData );
+
+          /* Bring back the bitmap, the metrics are kept. */
+          if (data->evicted)
+               font_glyph_restore( font, data );
+          else
+               font_glyph_touch( manager, data );
 
-          *ret_data = font->layers[layer].glyph_data[index];
+          *ret_data = data;
           return DFB_OK;
      }
 
@@ -818,12 +2013,7 @@ dfb_font_get_glyph_data( CoreFont       *font,
 
           D_DEBUG_AT( Core_Font, "  -> already in cache (%p)\n", data );
 
-          row = data->row;
-          if (row) {
-               D_MAGIC_ASSERT( row, CoreFontCacheRow );
-
-               row->stamp = manager->row_stamp++;
-          }
+          font_glyph_touch( manager, data );
 
           if (data->retry)
                goto retry;
@@ -832,6 +2022,14 @@ dfb_font_get_glyph_data( CoreFont       *font,
           return DFB_OK;
      }
 
+     /* Prewarm the cache from the glyph cache file on the first miss. */
+     if (!font->cache_file_checked) {
+          font->cache_file_checked = true;
+
+          if (font_cache_file_load( font ) == DFB_OK)
+               return dfb_font_get_glyph_data( font, index, layer, ret_data );
+     }
+
      /* No glyph data available in cache, load new glyph. */
 
      if (!font->GetGlyphData)
@@ -849,6 +2047,8 @@ dfb_font_get_glyph_data( CoreFont       *font,
      data->layer = layer;
 
 retry:
+     D_ASSERT( data->shelf == NULL );
+
      data->retry = false;
 
      /* Get glyph data from font implementation. */
@@ -872,6 +2072,7 @@ retry:
      if (data->width < 1 || data->height < 1) {
           D_DEBUG_AT( Core_Font, "  -> zero size glyph bitmap!\n" );
           data->start = data->width = data->height = 0;
+          font->cache_file_dirty = true;
           goto out;
      }
 
@@ -892,34 +2093,27 @@ retry:
           goto error;
      }
 
-     /* Check for a cache row (surface) to use. */
-     ret = dfb_font_cache_get_row( cache, data->width, &row );
+     /* Find a place for the glyph in one of the cache atlases. */
+     ret = dfb_font_cache_insert_glyph( cache, data );
      if (ret) {
-          D_DEBUG_AT( Core_Font, "  -> could not get row from cache!\n" );
-          goto error;
-     }
-
-     /* Add the glyph to the cache row. */
-
-     D_DEBUG_AT( Core_FontSurfaces, "  -> render %u - %2dx%2d at %03u\n",
-                 index, data->width, data->height, row->next_x );
-
-     data->row     = row;
-     data->start   = row->next_x;
-     data->surface = row->surface;
+          D_DEBUG_AT( Core_Font, "  -> could not insert glyph into cache!\n" );
+          data->start = data->y = data->width = data->height = 0;
 
-     align = (8 / (DFB_BYTES_PER_PIXEL( font->pixel_format ) ?: 1)) *
-             (DFB_PIXELFORMAT_ALIGNMENT( font->pixel_format ) + 1) - 1;
+          /* Try again next time, the cache may have space then. */
+          data->retry = true;
 
-     row->next_x  += (data->width + align) & ~align;
+          goto out;
+     }
 
-     row->stamp = manager->row_stamp++;
+     D_DEBUG_AT( Core_FontSurfaces, "  -> render %u - %2dx%2d at %03d,%03d\n",
+                 index, data->width, data->height, data->start, data->y );
 
      /* Render the glyph data into the surface. */
      ret = font->RenderGlyph( font, index, data );
      if (ret) {
           D_DEBUG_AT( Core_Font, "  -> rendering glyph failed!\n" );
-          data->start = data->width = data->height = 0;
+          dfb_font_cache_remove_glyph( data );
+          data->start = data->y = data->width = data->height = 0;
 
           /* If the font module returned BUFFEREMPTY we will retry loading next time. */
           if (ret == DFB_BUFFEREMPTY)
@@ -930,21 +2124,21 @@ retry:
 
      dfb_gfxcard_flush_texture_cache();
 
+     font->cache_file_dirty = true;
+
      CORE_GLYPH_DATA_DEBUG_AT( Core_Font, data );
 
 out:
      if (!data->inserted) {
-          if (row)
-               direct_list_append( &row->glyphs, &data->link );
-
           direct_hash_insert( font->layers[layer].glyph_hash, index, data );
 
-          if (index < 128)
-               font->layers[layer].glyph_data[index] = data;
-
           data->inserted = true;
      }
 
+     /* Glyphs to be retried may still change, keep them out of the direct index. */
+     if (!data->retry)
+          font_glyph_publish( font, data );
+
      *ret_data = data;
 
      return DFB_OK;
@@ -958,6 +2152,280 @@ error:
 
 /**********************************************************************************************************************/
 
+static unsigned long
+font_measure_key( DFBTextEncodingID  encoding,
+                  const void        *text,
+                  int                bytes )
+{
+     const u8 *p;
+     u32       hash = 0x811c9dc5;
+
+     /* FNV-1a over the text, mixed with encoding and length. */
+     for (p = text; p < (const u8*) text + bytes; p++)
+          hash = (hash ^ *p) * 0x01000193;
+
+     return hash ^ (encoding << 24) ^ bytes;
+}
+
+static CoreFontMeasureEntry *
+font_measure_find( CoreFont          *font,
+                   unsigned long      key,
+                   DFBTextEncodingID  encoding,
+                   const void        *text,
+                   int                bytes )
+{
+     CoreFontMeasureEntry *entry;
+
+     entry = direct_hash_lookup( font->measure.hash, key );
+     if (!entry)
+          return NULL;
+
+     D_MAGIC_ASSERT( entry, CoreFontMeasureEntry );
+
+     /* Different strings may end up with the same key. */
+     if (entry->encoding != encoding || entry->bytes != bytes || memcmp( entry + 1, text, bytes ))
+          return NULL;
+
+     return entry;
+}
+
+static void
+font_measure_remove( CoreFont             *font,
+                     CoreFontMeasureEntry *entry )
+{
+     D_MAGIC_ASSERT( entry, CoreFontMeasureEntry );
+     D_ASSERT( font->measure.count > 0 );
+
+     direct_hash_remove( font->measure.hash, entry->key );
+     direct_list_remove( &font->measure.entries, &entry->link );
+
+     font->measure.count--;
+
+     D_MAGIC_CLEAR( entry );
+     D_FREE( entry );
+}
+
+bool
+dfb_font_measure_lookup( CoreFont             *font,
+                         DFBTextEncodingID     encoding,
+                         const void           *text,
+                         int                   bytes,
+                         CoreFontMeasureFlags  flags,
+                         int                   max_width,
+                         CoreFontMeasure      *ret_measure )
+{
+     CoreFontMeasureEntry *entry;
+
+     D_MAGIC_ASSERT( font, CoreFont );
+     D_ASSERT( text != NULL );
+     D_ASSERT( ret_measure != NULL );
+
+     if (!dfb_config->font_measure_cache || bytes > FONT_MEASURE_MAX_BYTES)
+          return false;
+
+     direct_mutex_lock( &font->measure.lock );
+
+     entry = font_measure_find( font, font_measure_key( encoding, text, bytes ), encoding, text, bytes );
+     if (!entry || (entry->measure.flags & flags) != flags ||
+         ((flags & CFMF_BREAK) && entry->measure.max_width != max_width)) {
+          D_SYNC_ADD_AND_FETCH( &font_measure_misses, 1 );
+
+          direct_mutex_unlock( &font->measure.lock );
+
+          return false;
+     }
+
+     D_SYNC_ADD_AND_FETCH( &font_measure_hits, 1 );
+
+     direct_list_move_to_front( &font->measure.entries, &entry->link );
+
+     *ret_measure = entry->measure;
+
+     direct_mutex_unlock( &font->measure.lock );
+
+     D_DEBUG_AT( Font_Measure, "%s( %d bytes, flags 0x%x ) -> hit\n", __FUNCTION__, bytes, flags );
+
+     return true;
+}
+
+void
+dfb_font_measure_store( CoreFont              *font,
+                        DFBTextEncodingID      encoding,
+                        const void            *text,
+                        int                    bytes,
+                        const CoreFontMeasure *measure )
+{
+     CoreFontMeasureEntry *entry;
+     CoreFontMeasureEntry *old;
+     unsigned long         key;
+
+     D_MAGIC_ASSERT( font, CoreFont );
+     D_ASSERT( text != NULL );
+     D_ASSERT( measure != NULL );
+
+     D_DEBUG_AT( Font_Measure, "%s( %d bytes, flags 0x%x )\n", __FUNCTION__, bytes, measure->flags );
+
+     if (!dfb_config->font_measure_cache || bytes > FONT_MEASURE_MAX_BYTES)
+          return;
+
+     key = font_measure_key( encoding, text, bytes );
+
+     direct_mutex_lock( &font->measure.lock );
+
+     entry = font_measure_find( font, key, encoding, text, bytes );
+     if (!entry) {
+          /* Replace an entry with the same key, otherwise the least recently used one if the cache is full. */
+          old = direct_hash_lookup( font->measure.hash, key );
+          if (old)
+               font_measure_remove( font, old );
+          else if (font->measure.count >= dfb_config->font_measure_cache)
+               font_measure_remove( font, (CoreFontMeasureEntry*) direct_list_get_last( font->measure.entries ) );
+
+          entry = D_CALLOC( 1, sizeof(CoreFontMeasureEntry) + bytes );
+          if (!entry) {
+               D_OOM();
+               direct_mutex_unlock( &font->measure.lock );
+               return;
+          }
+
+          entry->key      = key;
+          entry->encoding = encoding;
+          entry->bytes    = bytes;
+
+          memcpy( entry + 1, text, bytes );
+
+          D_MAGIC_SET( entry, CoreFontMeasureEntry );
+
+          direct_hash_insert( font->measure.hash, key, entry );
+
+          font->measure.count++;
+     }
+     else
+          direct_list_remove( &font->measure.entries, &entry->link );
+
+     direct_list_prepend( &font->measure.entries, &entry->link );
+
+     /* Merge the new results. */
+     if (measure->flags & CFMF_WIDTH)
+          entry->measure.width = measure->width;
+
+     if (measure->flags & CFMF_EXTENTS) {
+          entry->measure.logical_rect = measure->logical_rect;
+          entry->measure.ink_rect     = measure->ink_rect;
+     }
+
+     if (measure->flags & CFMF_BREAK) {
+          entry->measure.max_width    = measure->max_width;
+          entry->measure.break_width  = measure->break_width;
+          entry->measure.break_length = measure->break_length;
+          entry->measure.break_next   = measure->break_next;
+     }
+
+     entry->measure.flags |= measure->flags;
+
+     direct_mutex_unlock( &font->measure.lock );
+}
+
+void
+dfb_font_measure_get_stats( unsigned int *ret_hits,
+                            unsigned int *ret_misses )
+{
+     if (ret_hits)
+          *ret_hits = font_measure_hits;
+
+     if (ret_misses)
+          *ret_misses = font_measure_misses;
+}
+
+DFBResult
+dfb_font_build_kerning_table( CoreFont *font )
+{
+     DFBResult            ret     = DFB_OK;
+     unsigned int         num;
+     unsigned int         prev, current;
+     unsigned int         count   = 0;
+     unsigned int         size    = 0;
+     u32                 *first;
+     CoreFontKerningPair *pairs   = NULL;
+
+     D_DEBUG_AT( Core_Font, "%s( %p )\n", __FUNCTION__, font );
+
+     D_MAGIC_ASSERT( font, CoreFont );
+     D_ASSERT( font->kerning.first == NULL );
+
+     num = MIN( font->direct_glyphs, FONT_KERNING_MAX_GLYPHS );
+
+     if (!dfb_config->font_kerning_table || !font->GetKerning || num < 2)
+          return DFB_OK;
+
+     first = D_CALLOC( num + 1, sizeof(u32) );
+     if (!first)
+          return D_OOM();
+
+     dfb_font_lock( font );
+
+     /* Index 0 is never kerned, it is used for the start of a string. */
+     for (prev = 1; prev < num; prev++) {
+          first[prev] = count;
+
+          for (current = 1; current < num; current++) {
+               int x = 0;
+               int y = 0;
+
+               if (font->GetKerning( font, prev, current, &x, &y ) || (!x && !y))
+                    continue;
+
+               if (x != (s16) x || y != (s16) y) {
+                    ret = DFB_LIMITEXCEEDED;
+                    goto out;
+               }
+
+               if (count == size) {
+                    CoreFontKerningPair *new_pairs;
+
+                    new_pairs = D_REALLOC( pairs, (size * 2 + 256) * sizeof(CoreFontKerningPair) );
+                    if (!new_pairs) {
+                         ret = D_OOM();
+                         goto out;
+                    }
+
+                    pairs = new_pairs;
+                    size  = size * 2 + 256;
+               }
+
+               pairs[count].second = current;
+               pairs[count].x      = x;
+               pairs[count].y      = y;
+
+               count++;
+          }
+     }
+
+     first[num] = count;
+
+     font->kerning.first      = first;
+     font->kerning.pairs      = pairs;
+     font->kerning.num_glyphs = num;
+
+     D_DEBUG_AT( Core_Font, "  -> %u kerning pairs of %u glyphs\n", count, num );
+
+out:
+     dfb_font_unlock( font );
+
+     if (ret) {
+          D_DEBUG_AT( Core_Font, "  -> no kerning table (%s)\n", DirectFBErrorString( ret ) );
+
+          if (pairs)
+               D_FREE( pairs );
+
+          D_FREE( first );
+     }
+
+     return ret;
+}
+
+/**********************************************************************************************************************/
+
 DFBResult
 dfb_font_register_encoding( CoreFont                    *font,
                             const char                  *name,
@@ -1022,6 +2490,41 @@ dfb_font_register_encoding( CoreFont                    *font,
      return DFB_OK;
 }
 
+#ifdef USE_SSE
+/*
+ * Widen ASCII characters to indices, 16 at a time. Returns the number of characters decoded, stopping at the first
+ * block of 16 bytes containing a multi-byte sequence.
+ */
+static __attribute__((target("sse2"))) int
+font_decode_ascii_SSE2( const u8     *bytes,
+                        int           length,
+                        unsigned int *ret_indices )
+{
+     int     pos  = 0;
+     __m128i zero = _mm_setzero_si128();
+
+     while (pos + 16 <= length) {
+          __m128i chars = _mm_loadu_si128( (const __m128i*) (bytes + pos) );
+          __m128i lo, hi;
+
+          if (_mm_movemask_epi8( chars ))
+               break;
+
+          lo = _mm_unpacklo_epi8( chars, zero );
+          hi = _mm_unpackhi_epi8( chars, zero );
+
+          _mm_storeu_si128( (__m128i*) (ret_indices + pos),      _mm_unpacklo_epi16( lo, zero ) );
+          _mm_storeu_si128( (__m128i*) (ret_indices + pos + 4),  _mm_unpackhi_epi16( lo, zero ) );
+          _mm_storeu_si128( (__m128i*) (ret_indices + pos + 8),  _mm_unpacklo_epi16( hi, zero ) );
+          _mm_storeu_si128( (__m128i*) (ret_indices + pos + 12), _mm_unpackhi_epi16( hi, zero ) );
+
+          pos += 16;
+     }
+
+     return pos;
+}
+#endif
+
 DFBResult
 dfb_font_decode_text( CoreFont          *font,
                       DFBTextEncodingID  encoding,
@@ -1078,7 +2581,23 @@ dfb_font_decode_text( CoreFont          *font,
           }
      }
      else {
+#ifdef USE_SSE
+          int scalar_end = 0;
+#endif
+
           while (pos < length) {
+#ifdef USE_SSE
+               /* Decode ASCII runs in blocks, the block after a run is decoded by the scalar code. */
+               if (font_decode_sse2 && pos >= scalar_end && length - pos >= 16) {
+                    int n = font_decode_ascii_SSE2( &bytes[pos], length - pos, &ret_indices[num] );
+
+                    pos       += n;
+                    num       += n;
+                    scalar_end = pos + 16;
+                    continue;
+               }
+#endif
+
                if (bytes[pos] < 128)
                     ret_indices[num++] = bytes[pos++];
                else {
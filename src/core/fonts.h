@@ -20,7 +20,9 @@
 #define __CORE__FONTS_H__
 
 #include <core/coretypes.h>
+#include <direct/atomic.h>
 #include <direct/list.h>
+#include <direct/mutex.h>
 
 /**********************************************************************************************************************/
 
@@ -56,6 +58,39 @@ typedef enum {
      CFF_ALL              = 0x00000001,
 } CoreFontFlags;
 
+typedef struct {
+     u16                           second;          /* second glyph of the pair */
+     s16                           x;
+     s16                           y;
+} CoreFontKerningPair;
+
+typedef enum {
+     CFMF_NONE            = 0x00000000,
+
+     CFMF_WIDTH           = 0x00000001,  /* width is valid */
+     CFMF_EXTENTS         = 0x00000002,  /* logical_rect and ink_rect are valid */
+     CFMF_BREAK           = 0x00000004,  /* break results for max_width are valid */
+
+     CFMF_ALL             = 0x00000007,
+} CoreFontMeasureFlags;
+
+/*
+ * Results of measuring a string, as returned by the font interface.
+ */
+typedef struct {
+     CoreFontMeasureFlags          flags;
+
+     int                           width;
+
+     DFBRectangle                  logical_rect;
+     DFBRectangle                  ink_rect;
+
+     int                           max_width;
+     int                           break_width;
+     int                           break_length;
+     int                           break_next;      /* offset of the next line, -1 for none */
+} CoreFontMeasure;
+
 struct __DFB_CoreFont {
      CoreDFB                      *core;
 
@@ -72,9 +107,11 @@ struct __DFB_CoreFont {
 
      struct {
           DirectHash              *glyph_hash;
-          CoreGlyphData           *glyph_data[128];
+          CoreGlyphData          **glyph_data;      /* direct index of loaded glyphs below direct_glyphs */
      } layers[DFB_FONT_MAX_LAYERS];
 
+     unsigned int                  direct_glyphs;   /* size of the direct index */
+
      int                           height;          /* font height */
 
      int                           ascender;        /* a positive value, the distance from the baseline to the top */
@@ -102,6 +139,22 @@ struct __DFB_CoreFont {
      int                           underline_thickness;
 
      CoreFontFlags                 flags;
+
+     bool                          cache_file_checked; /* persistent glyph cache has been looked up */
+     bool                          cache_file_dirty;   /* glyphs have been loaded from the font since */
+
+     struct {
+          DirectMutex              lock;
+          DirectHash              *hash;
+          DirectLink              *entries;         /* most recently used first */
+          unsigned int             count;
+     } measure;                                     /* cache of string measurements */
+
+     struct {
+          unsigned int             num_glyphs;      /* pairs of glyphs below are in the table */
+          u32                     *first;           /* start of the pairs of each first glyph, sorted by second */
+          CoreFontKerningPair     *pairs;
+     } kerning;                                     /* kerning table built by dfb_font_build_kerning_table() */
 };
 
 #define CORE_FONT_DEBUG_AT(Domain,font)                                   \
@@ -119,30 +172,34 @@ struct __DFB_CoreGlyphData {
      unsigned int      index;
      unsigned int      layer;
 
-     CoreSurface      *surface;  /* contains bitmap of glyph */
-     int               start;    /* x offset of glyph in surface */
-     int               width;    /* width of the glyphs bitmap */
-     int               height;   /* height of the glyphs bitmap */
-     int               left;     /* x offset of the glyph */
-     int               top;      /* y offset of the glyph */
-     int               xadvance; /* x placement of next glyph */
-     int               yadvance; /* y placement of next glyph */
+     CoreSurface        *surface;  /* contains bitmap of glyph */
+     int                 start;    /* x offset of glyph in surface */
+     int                 y;        /* y offset of glyph in surface */
+     int                 width;    /* width of the glyphs bitmap */
+     int                 height;   /* height of the glyphs bitmap */
+     int                 left;     /* x offset of the glyph */
+     int                 top;      /* y offset of the glyph */
+     int                 xadvance; /* x placement of next glyph */
+     int                 yadvance; /* y placement of next glyph */
 
-     int               magic;
+     int                 magic;
 
-     CoreFontCacheRow *row;
+     CoreFontCacheShelf *shelf;    /* shelf of the cache atlas holding the glyph */
+     unsigned long long  stamp;    /* last use, for eviction */
 
-     bool              inserted;
-     bool              retry;
+     bool                inserted;
+     bool                retry;
+     bool                evicted;  /* bitmap has been dropped from the cache, metrics are kept */
 };
 
 #define CORE_GLYPH_DATA_DEBUG_AT(Domain,data)                           \
      do {                                                               \
           D_DEBUG_AT( Domain, "  -> index    %u\n", (data)->index );    \
           D_DEBUG_AT( Domain, "  -> layer    %u\n", (data)->layer );    \
-          D_DEBUG_AT( Domain, "  -> row      %p\n", (data)->row );      \
+          D_DEBUG_AT( Domain, "  -> shelf    %p\n", (data)->shelf );    \
           D_DEBUG_AT( Domain, "  -> surface  %p\n", (data)->surface );  \
           D_DEBUG_AT( Domain, "  -> start    %d\n", (data)->start );    \
+          D_DEBUG_AT( Domain, "  -> y        %d\n", (data)->y );        \
           D_DEBUG_AT( Domain, "  -> width    %d\n", (data)->width );    \
           D_DEBUG_AT( Domain, "  -> height   %d\n", (data)->height );   \
           D_DEBUG_AT( Domain, "  -> left     %d\n", (data)->left );     \
@@ -179,7 +236,10 @@ DFBResult dfb_font_manager_get_cache     ( CoreFontManager              *manager
                                            const CoreFontCacheType      *type,
                                            CoreFontCache               **ret_cache );
 
-DFBResult dfb_font_manager_remove_lru_row( CoreFontManager              *manager );
+/*
+ * Remove the least recently used atlas not holding glyphs in use since the manager was locked.
+ */
+DFBResult dfb_font_manager_evict_atlas   ( CoreFontManager              *manager );
 
 /**********************************************************************************************************************/
 
@@ -195,19 +255,30 @@ DFBResult dfb_font_cache_init            ( CoreFontCache                *cache,
 
 DFBResult dfb_font_cache_deinit          ( CoreFontCache                *cache );
 
-DFBResult dfb_font_cache_get_row         ( CoreFontCache                *cache,
-                                           unsigned int                  width,
-                                           CoreFontCacheRow            **ret_row );
+/*
+ * Place a glyph of the given size in one of the cache atlases, evicting least recently used glyphs if needed.
+ *
+ * On success, the surface, start and y of the glyph data are set up for RenderGlyph().
+ */
+DFBResult dfb_font_cache_insert_glyph    ( CoreFontCache                *cache,
+                                           CoreGlyphData                *data );
+
+/*
+ * Give the atlas space of a glyph back to its cache.
+ */
+void      dfb_font_cache_remove_glyph    ( CoreGlyphData                *data );
 
-DFBResult dfb_font_cache_row_create      ( CoreFontCache                *cache,
-                                           CoreFontCacheRow            **ret_row );
+DFBResult dfb_font_cache_atlas_create    ( CoreFontCache                *cache,
+                                           unsigned int                  rows,
+                                           CoreFontCacheAtlas          **ret_atlas );
 
-DFBResult dfb_font_cache_row_destroy     ( CoreFontCacheRow             *row );
+DFBResult dfb_font_cache_atlas_destroy   ( CoreFontCacheAtlas           *atlas );
 
-DFBResult dfb_font_cache_row_init        ( CoreFontCacheRow             *row,
-                                           CoreFontCache                *cache );
+DFBResult dfb_font_cache_atlas_init      ( CoreFontCacheAtlas           *atlas,
+                                           CoreFontCache                *cache,
+                                           unsigned int                  rows );
 
-DFBResult dfb_font_cache_row_deinit      ( CoreFontCacheRow             *row );
+DFBResult dfb_font_cache_atlas_deinit    ( CoreFontCacheAtlas           *atlas );
 
 /**********************************************************************************************************************/
 
@@ -237,6 +308,41 @@ DFBResult dfb_font_get_glyph_data        ( CoreFont                     *font,
                                            unsigned int                  layer,
                                            CoreGlyphData               **glyph_data );
 
+/*
+ * Precompute the kerning of all pairs of glyphs in the direct index.
+ *
+ * Called after the font implementation has been set up. Kerning of pairs in the table no longer calls GetKerning().
+ */
+DFBResult dfb_font_build_kerning_table   ( CoreFont                     *font );
+
+/*
+ * Lookup cached measurements of a string.
+ *
+ * Returns true if all results in 'flags' are cached, for CFMF_BREAK with the same max_width.
+ */
+bool      dfb_font_measure_lookup        ( CoreFont                     *font,
+                                           DFBTextEncodingID             encoding,
+                                           const void                   *text,
+                                           int                           bytes,
+                                           CoreFontMeasureFlags          flags,
+                                           int                           max_width,
+                                           CoreFontMeasure              *ret_measure );
+
+/*
+ * Add measurements of a string to the cache, merging them with results already cached.
+ */
+void      dfb_font_measure_store         ( CoreFont                     *font,
+                                           DFBTextEncodingID             encoding,
+                                           const void                   *text,
+                                           int                           bytes,
+                                           const CoreFontMeasure        *measure );
+
+/*
+ * Get the number of lookups in the measurement caches of all fonts that were hits or misses.
+ */
+void      dfb_font_measure_get_stats     ( unsigned int                 *ret_hits,
+                                           unsigned int                 *ret_misses );
+
 /*
  * Register encoding implementations.
  *
@@ -298,4 +404,113 @@ dfb_font_unlock( CoreFont *font )
      dfb_font_manager_unlock( font->manager );
 }
 
+/*
+ * Lookup loaded glyph data without locking the font.
+ *
+ * Only glyphs in the direct index are found, otherwise NULL is returned and dfb_font_get_glyph_data() has to be used
+ * with the font being locked. The metrics of the returned glyph are valid until the font is destroyed, but its surface
+ * must not be used.
+ */
+static __inline__ CoreGlyphData *
+dfb_font_lookup_glyph( CoreFont     *font,
+                       unsigned int  index,
+                       unsigned int  layer )
+{
+     D_MAGIC_ASSERT( font, CoreFont );
+     D_ASSERT( layer < D_ARRAY_SIZE(font->layers) );
+
+     if (index >= font->direct_glyphs)
+          return NULL;
+
+     return D_SYNC_LOAD_ACQUIRE( &font->layers[layer].glyph_data[index] );
+}
+
+/*
+ * Get glyph data for its metrics, locking the font only when the glyph is not found in the direct index.
+ *
+ * The caller has to unlock the font if 'locked' has been set.
+ */
+static __inline__ DFBResult
+dfb_font_get_glyph_metrics( CoreFont       *font,
+                            unsigned int    index,
+                            unsigned int    layer,
+                            bool           *locked,
+                            CoreGlyphData **ret_data )
+{
+     D_ASSERT( locked != NULL );
+     D_ASSERT( ret_data != NULL );
+
+     *ret_data = dfb_font_lookup_glyph( font, index, layer );
+     if (*ret_data)
+          return DFB_OK;
+
+     if (!*locked) {
+          dfb_font_lock( font );
+
+          *locked = true;
+     }
+
+     return dfb_font_get_glyph_data( font, index, layer, ret_data );
+}
+
+/*
+ * Get the kerning of a pair of glyphs, from the kerning table or from the font implementation.
+ *
+ * Pass 'locked' to have the font locked on demand, otherwise it must be locked already.
+ * The caller has to unlock the font if 'locked' has been set.
+ */
+static __inline__ DFBResult
+dfb_font_get_kerning( CoreFont     *font,
+                      unsigned int  prev,
+                      unsigned int  current,
+                      bool         *locked,
+                      int          *ret_x,
+                      int          *ret_y )
+{
+     D_MAGIC_ASSERT( font, CoreFont );
+
+     if (!font->GetKerning)
+          return DFB_UNSUPPORTED;
+
+     if (prev < font->kerning.num_glyphs && current < font->kerning.num_glyphs) {
+          unsigned int lower = font->kerning.first[prev];
+          unsigned int upper = font->kerning.first[prev+1];
+          int          x     = 0;
+          int          y     = 0;
+
+          /* Binary search of the second glyph, pairs without kerning are not stored. */
+          while (lower < upper) {
+               unsigned int               mid  = (lower + upper) / 2;
+               const CoreFontKerningPair *pair = &font->kerning.pairs[mid];
+
+               if (pair->second == current) {
+                    x = pair->x;
+                    y = pair->y;
+                    break;
+               }
+
+               if (pair->second < current)
+                    lower = mid + 1;
+               else
+                    upper = mid;
+          }
+
+          if (ret_x)
+               *ret_x = x;
+
+          if (ret_y)
+               *ret_y = y;
+
+          return DFB_OK;
+     }
+
+     if (locked && !*locked) {
+          dfb_font_lock( font );
+
+          *locked = true;
+     }
+
+     return font->GetKerning( font, prev, current, ret_x, ret_y );
+}
+
 #endif
@@ -23,14 +23,17 @@
 #include <core/gfxcard.h>
 #include <core/surface_allocation.h>
 #include <core/system.h>
+#include <direct/memcpy.h>
 #include <fusion/conf.h>
 #include <fusion/shmalloc.h>
 #include <core/state.h>
 #include <gfx/clip.h>
 #include <gfx/generic/generic.h>
+#include <gfx/generic/generic_affine_blit.h>
 #include <gfx/generic/generic_blit.h>
 #include <gfx/generic/generic_draw_line.h>
 #include <gfx/generic/generic_fill_rectangle.h>
+#include <gfx/generic/generic_glyphs.h>
 #include <gfx/generic/generic_stretch_blit.h>
 #include <gfx/generic/generic_texture_triangles.h>
 #include <gfx/util.h>
@@ -43,6 +46,8 @@ DEFINE_MODULE_DIRECTORY( dfb_graphics_drivers, "gfxdrivers", DFB_GRAPHICS_DRIVER
 
 /**********************************************************************************************************************/
 
+#define GRAPHICS_OP_STATS_SIZE 256                /* slots for the operation counters, a power of two */
+
 typedef struct {
      int                      magic;
 
@@ -66,6 +71,11 @@ typedef struct {
      long long                ts_start;
      long long                ts_busy;
      long long                ts_busy_sum;
+
+     bool                     op_stats_enabled;   /* Operations are counted by all processes of the session. */
+     FusionSkirmish           op_stats_lock;
+     unsigned int             op_stats_num;       /* Number of used slots. */
+     DFBGraphicsOperationStats op_stats[GRAPHICS_OP_STATS_SIZE];
 } DFBGraphicsCoreShared;
 
 typedef struct {
@@ -271,6 +281,13 @@ dfb_graphics_core_initialize( CoreDFB               *core,
 
      fusion_skirmish_init2( &shared->lock, "GfxCard", dfb_core_world( core ), fusion_config->secure_fusion );
 
+     if (dfb_config->gfxcard_stats) {
+          fusion_skirmish_init2( &shared->op_stats_lock, "GfxCard Stats", dfb_core_world( core ),
+                                 fusion_config->secure_fusion );
+
+          shared->op_stats_enabled = true;
+     }
+
      D_MAGIC_SET( data, DFBGraphicsCore );
      D_MAGIC_SET( shared, DFBGraphicsCoreShared );
 
@@ -397,6 +414,8 @@ dfb_graphics_core_shutdown( DFBGraphicsCore *data,
 
      dfb_gfxcard_lock( GDLF_SYNC );
 
+     gShutdown();
+
      if (data->driver_funcs) {
           const GraphicsDriverFuncs *funcs = data->driver_funcs;
 
@@ -411,6 +430,9 @@ dfb_graphics_core_shutdown( DFBGraphicsCore *data,
 
      fusion_skirmish_destroy( &shared->lock );
 
+     if (shared->op_stats_enabled)
+          fusion_skirmish_destroy( &shared->op_stats_lock );
+
      if (shared->module_name)
           SHFREE( pool, shared->module_name );
 
@@ -431,6 +453,8 @@ dfb_graphics_core_leave( DFBGraphicsCore *data,
      D_MAGIC_ASSERT( data, DFBGraphicsCore );
      D_MAGIC_ASSERT( data->shared, DFBGraphicsCoreShared );
 
+     gShutdown();
+
      if (data->driver_funcs) {
           data->driver_funcs->CloseDriver( data->driver_data );
 
@@ -478,6 +502,28 @@ static void dfb_gfxcard_update_stats( long long now );
 static void dfb_gfxcard_switch_busy ( void );
 static void dfb_gfxcard_switch_idle ( void );
 
+static long long          dfb_gfxcard_stats_begin( CardState                 *state );
+static void               dfb_gfxcard_stats_end  ( CardState                 *state,
+                                                   DFBAccelerationMask        accel,
+                                                   unsigned long long         pixels,
+                                                   long long                  start );
+
+static unsigned long long count_rectangles       ( const DFBRectangle        *rects,
+                                                   int                        num );
+static unsigned long long count_lines            ( const DFBRegion           *lines,
+                                                   int                        num );
+static unsigned long long count_triangles        ( const DFBTriangle         *tris,
+                                                   int                        num );
+static unsigned long long count_trapezoids       ( const DFBTrapezoid        *traps,
+                                                   int                        num );
+static unsigned long long count_quadrangles      ( const DFBPoint            *points,
+                                                   int                        num );
+static unsigned long long count_spans            ( const DFBSpan             *spans,
+                                                   int                        num );
+static unsigned long long count_vertices         ( const DFBVertex           *vertices,
+                                                   int                        num,
+                                                   DFBTriangleFormation       formation );
+
 DFBResult
 dfb_gfxcard_lock( GraphicsDeviceLockFlags flags )
 {
@@ -1447,10 +1493,21 @@ dfb_gfxcard_state_release( CardState *state )
      shared = card->shared;
 
      if (!dfb_config->software_only) {
-          /* Store the serial of the operation. */
-          if (card->funcs.GetSerial)
+          /* Store the serial of the operation, also for the sources not to be written before being read. */
+          if (card->funcs.GetSerial) {
                card->funcs.GetSerial( card->driver_data, card->device_data, &state->dst.allocation->gfx_serial );
 
+               if (state->flags & CSF_SOURCE_LOCKED)
+                    card->funcs.GetSerial( card->driver_data, card->device_data, &state->src.allocation->gfx_serial );
+
+               if (state->flags & CSF_SOURCE_MASK_LOCKED)
+                    card->funcs.GetSerial( card->driver_data, card->device_data,
+                                           &state->src_mask.allocation->gfx_serial );
+
+               if (state->flags & CSF_SOURCE2_LOCKED)
+                    card->funcs.GetSerial( card->driver_data, card->device_data, &state->src2.allocation->gfx_serial );
+          }
+
           if (dfb_config->gfx_emit_early && card->funcs.EmitCommands) {
                dfb_gfxcard_switch_busy();
 
@@ -1516,6 +1573,9 @@ dfb_gfxcard_state_destroy ( CardState *state )
           if (gfxs->ABstart)
                D_FREE( gfxs->ABstart );
 
+          if (gfxs->convolution.rows_start)
+               D_FREE( gfxs->convolution.rows_start );
+
           D_FREE( gfxs );
      }
 
@@ -1657,11 +1717,119 @@ fill_tri( DFBTriangle *tri,
      }
 }
 
+static int
+compare_rows( const void *a,
+              const void *b )
+{
+     const DFBRectangle *ra = a;
+     const DFBRectangle *rb = b;
+
+     if (ra->y != rb->y)
+          return ra->y < rb->y ? -1 : 1;
+
+     if (ra->h != rb->h)
+          return ra->h < rb->h ? -1 : 1;
+
+     if (ra->x != rb->x)
+          return ra->x < rb->x ? -1 : 1;
+
+     return 0;
+}
+
+static int
+compare_columns( const void *a,
+                 const void *b )
+{
+     const DFBRectangle *ra = a;
+     const DFBRectangle *rb = b;
+
+     if (ra->x != rb->x)
+          return ra->x < rb->x ? -1 : 1;
+
+     if (ra->w != rb->w)
+          return ra->w < rb->w ? -1 : 1;
+
+     if (ra->y != rb->y)
+          return ra->y < rb->y ? -1 : 1;
+
+     return 0;
+}
+
+/*
+ * Merges the rectangles of a fill into fewer, larger ones and returns their number. If the fill does not depend on the
+ * order or on the number of times a pixel is written, the rectangles are sorted and overlapping ones are merged, too.
+ * Otherwise only consecutive rectangles being exactly adjacent are merged.
+ */
+static int
+coalesce_fills( DFBRectangle *rects,
+                int           num,
+                bool          opaque )
+{
+     int i, n;
+
+     /* Drop empty rectangles and merge rectangles within the same rows. */
+     if (opaque)
+          qsort( rects, num, sizeof(DFBRectangle), compare_rows );
+
+     for (i = 0, n = -1; i < num; i++) {
+          DFBRectangle *rect = &rects[i];
+
+          if (rect->w <= 0 || rect->h <= 0)
+               continue;
+
+          if (n >= 0) {
+               DFBRectangle *last = &rects[n];
+
+               if (rect->y == last->y && rect->h == last->h &&
+                   (opaque ? rect->x <= last->x + last->w : rect->x == last->x + last->w)) {
+                    int x2 = MAX( last->x + last->w, rect->x + rect->w );
+
+                    if (x2 - last->x <= card->limits.dst_max.w) {
+                         last->w = x2 - last->x;
+                         continue;
+                    }
+               }
+          }
+
+          rects[++n] = *rect;
+     }
+
+     num = n + 1;
+     if (!num)
+          return 0;
+
+     /* Merge rows of the same columns. */
+     if (opaque)
+          qsort( rects, num, sizeof(DFBRectangle), compare_columns );
+
+     for (i = 1, n = 0; i < num; i++) {
+          DFBRectangle *last = &rects[n];
+          DFBRectangle *rect = &rects[i];
+
+          if (rect->x == last->x && rect->w == last->w &&
+              (opaque ? rect->y <= last->y + last->h : rect->y == last->y + last->h)) {
+               int y2 = MAX( last->y + last->h, rect->y + rect->h );
+
+               if (y2 - last->y <= card->limits.dst_max.h) {
+                    last->h = y2 - last->y;
+                    continue;
+               }
+          }
+
+          rects[++n] = *rect;
+     }
+
+     return n + 1;
+}
+
 void
 dfb_gfxcard_fillrectangles( DFBRectangle *rects,
                             int           num,
                             CardState    *state )
 {
+     DFBRectangle *allocated = NULL;
+     long long     start;
+
      D_ASSERT( card != NULL );
      D_ASSERT( card->shared != NULL );
 
@@ -1677,6 +1845,8 @@ dfb_gfxcard_fillrectangles( DFBRectangle *rects,
      /* Signal beginning of sequence of operations if not already done. */
      dfb_state_start_drawing( state );
 
+     start = dfb_gfxcard_stats_begin( state );
+
      if (!(state->render_options & DSRO_MATRIX)) {
           while (num > 0) {
                if (dfb_rectangle_region_intersects( rects, &state->clip ))
@@ -1685,6 +1855,31 @@ dfb_gfxcard_fillrectangles( DFBRectangle *rects,
                rects++;
                num--;
           }
+
+          /* Coalesce adjacent rectangles, e.g. of tiles, into fewer, larger ones. */
+          if (num > 1) {
+               DFBRectangle *coalesced;
+               bool          opaque = !(state->drawingflags & ~(DSDRAW_DST_COLORKEY | DSDRAW_SRC_PREMULTIPLY));
+
+               if (num > 256) {
+                    coalesced = allocated = D_MALLOC( sizeof(DFBRectangle) * num );
+                    if (!coalesced)
+                         D_OOM();
+               }
+               else
+                    coalesced = alloca( sizeof(DFBRectangle) * num );
+
+               if (coalesced) {
+                    direct_memcpy( coalesced, rects, sizeof(DFBRectangle) * num );
+
+                    D_DEBUG_AT( Core_GraphicsOps, "  -> coalescing %d rectangles\n", num );
+
+                    rects = coalesced;
+                    num   = coalesce_fills( coalesced, num, opaque );
+
+                    D_DEBUG_AT( Core_GraphicsOps, "  -> into %d rectangles\n", num );
+               }
+          }
      }
 
      if (num > 0) {
@@ -1819,7 +2014,13 @@ dfb_gfxcard_fillrectangles( DFBRectangle *rects,
      }
 
      /* Unlock after execution. */
+     if (start)
+          dfb_gfxcard_stats_end( state, DFXL_FILLRECTANGLE, count_rectangles( rects, num ), start );
+
      dfb_state_unlock( state );
+
+     if (allocated)
+          D_FREE( allocated );
 }
 
 void
@@ -1829,6 +2030,7 @@ dfb_gfxcard_drawrectangle( DFBRectangle *rect,
      DFBRectangle rects[4];
      bool         hw = false;
      int          i = 0, num = 0;
+     long long    start;
 
      D_ASSERT( card != NULL );
      D_ASSERT( card->shared != NULL );
@@ -1844,6 +2046,8 @@ dfb_gfxcard_drawrectangle( DFBRectangle *rect,
      /* Signal beginning of sequence of operations if not already done. */
      dfb_state_start_drawing( state );
 
+     start = dfb_gfxcard_stats_begin( state );
+
      if (!(state->render_options & DSRO_MATRIX) &&
          !dfb_rectangle_region_intersects( rect, &state->clip )) {
           dfb_state_unlock( state );
@@ -1925,6 +2129,9 @@ dfb_gfxcard_drawrectangle( DFBRectangle *rect,
           }
      }
 
+     if (start)
+          dfb_gfxcard_stats_end( state, DFXL_DRAWRECTANGLE, (unsigned long long) (rect->w + rect->h) * 2, start );
+
      dfb_state_unlock( state );
 }
 
@@ -1933,7 +2140,8 @@ dfb_gfxcard_drawlines( DFBRegion *lines,
                        int        num,
                        CardState *state )
 {
-     int i = 0;
+     int       i = 0;
+     long long start;
 
      D_ASSERT( card != NULL );
      D_ASSERT( card->shared != NULL );
@@ -1950,6 +2158,8 @@ dfb_gfxcard_drawlines( DFBRegion *lines,
      /* Signal beginning of sequence of operations if not already done. */
      dfb_state_start_drawing( state );
 
+     start = dfb_gfxcard_stats_begin( state );
+
      if (dfb_gfxcard_state_check_acquire( state, DFXL_DRAWLINE )) {
           for (; i < num; i++) {
                if (!D_FLAGS_IS_SET( card->caps.flags, CCF_CLIPPING ) &&
@@ -1980,6 +2190,9 @@ dfb_gfxcard_drawlines( DFBRegion *lines,
           }
      }
 
+     if (start)
+          dfb_gfxcard_stats_end( state, DFXL_DRAWLINE, count_lines( lines, num ), start );
+
      dfb_state_unlock( state );
 }
 
@@ -1988,8 +2201,9 @@ dfb_gfxcard_filltriangles( DFBTriangle *tris,
                            int          num,
                            CardState   *state )
 {
-     bool hw = false;
-     int  i  = 0;
+     bool      hw = false;
+     int       i  = 0;
+     long long start;
 
      D_ASSERT( card != NULL );
      D_ASSERT( card->shared != NULL );
@@ -2006,6 +2220,8 @@ dfb_gfxcard_filltriangles( DFBTriangle *tris,
      /* Signal beginning of sequence of operations if not already done. */
      dfb_state_start_drawing( state );
 
+     start = dfb_gfxcard_stats_begin( state );
+
      if (dfb_gfxcard_state_check_acquire( state, DFXL_FILLTRIANGLE )) {
           if (!D_FLAGS_IS_SET( card->caps.flags, CCF_CLIPPING ) &&
               !D_FLAGS_IS_SET( card->caps.clip, DFXL_FILLTRIANGLE )) {
@@ -2092,6 +2308,9 @@ dfb_gfxcard_filltriangles( DFBTriangle *tris,
           }
      }
 
+     if (start)
+          dfb_gfxcard_stats_end( state, DFXL_FILLTRIANGLE, count_triangles( tris, num ), start );
+
      dfb_state_unlock( state );
 }
 
@@ -2155,8 +2374,9 @@ dfb_gfxcard_filltrapezoids( DFBTrapezoid *traps,
                             int           num,
                             CardState    *state )
 {
-     bool hw = false;
-     int  i  = 0;
+     bool      hw = false;
+     int       i  = 0;
+     long long start;
 
      D_ASSERT( card != NULL );
      D_ASSERT( card->shared != NULL );
@@ -2173,6 +2393,8 @@ dfb_gfxcard_filltrapezoids( DFBTrapezoid *traps,
      /* Signal beginning of sequence of operations if not already done. */
      dfb_state_start_drawing( state );
 
+     start = dfb_gfxcard_stats_begin( state );
+
      if (dfb_gfxcard_state_check_acquire( state, DFXL_FILLTRAPEZOID )) {
           if (D_FLAGS_IS_SET( card->caps.flags, CCF_CLIPPING )      ||
               D_FLAGS_IS_SET( card->caps.clip, DFXL_FILLTRAPEZOID ) ||
@@ -2299,6 +2521,9 @@ dfb_gfxcard_filltrapezoids( DFBTrapezoid *traps,
           }
      }
 
+     if (start)
+          dfb_gfxcard_stats_end( state, DFXL_FILLTRAPEZOID, count_trapezoids( traps, num ), start );
+
      dfb_state_unlock( state );
 }
 
@@ -2307,7 +2532,8 @@ dfb_gfxcard_fillquadrangles( DFBPoint  *points,
                              int        num,
                              CardState *state )
 {
-     bool hw = false;
+     bool      hw = false;
+     long long start;
 
      D_ASSERT( card != NULL );
      D_ASSERT( card->shared != NULL );
@@ -2323,6 +2549,8 @@ dfb_gfxcard_fillquadrangles( DFBPoint  *points,
      /* Signal beginning of sequence of operations if not already done. */
      dfb_state_start_drawing( state );
 
+     start = dfb_gfxcard_stats_begin( state );
+
      if (dfb_gfxcard_state_check_acquire( state, DFXL_FILLQUADRANGLE )) {
           if (!D_FLAGS_IS_SET( card->caps.flags, CCF_CLIPPING ) &&
               !D_FLAGS_IS_SET( card->caps.clip, DFXL_FILLQUADRANGLE ))
@@ -2369,6 +2597,9 @@ dfb_gfxcard_fillquadrangles( DFBPoint  *points,
           }
      }
 
+     if (start)
+          dfb_gfxcard_stats_end( state, DFXL_FILLQUADRANGLE, count_quadrangles( points, num ), start );
+
      dfb_state_unlock( state );
 }
 
@@ -2378,7 +2609,8 @@ dfb_gfxcard_fillspans( int        y,
                        int        num,
                        CardState *state )
 {
-     int i = 0;
+     int       i = 0;
+     long long start;
 
      D_ASSERT( card != NULL );
      D_ASSERT( card->shared != NULL );
@@ -2395,6 +2627,8 @@ dfb_gfxcard_fillspans( int        y,
      /* Signal beginning of sequence of operations if not already done. */
      dfb_state_start_drawing( state );
 
+     start = dfb_gfxcard_stats_begin( state );
+
      if (dfb_gfxcard_state_check_acquire( state, DFXL_FILLRECTANGLE )) {
           if (card->funcs.BatchFill) {
                unsigned int done = 0;
@@ -2538,6 +2772,9 @@ dfb_gfxcard_fillspans( int        y,
           }
      }
 
+     if (start)
+          dfb_gfxcard_stats_end( state, DFXL_FILLRECTANGLE, count_spans( spans, num ), start );
+
      dfb_state_unlock( state );
 }
 
@@ -2620,6 +2857,47 @@ GenefxVertexAffine_Transform( GenefxVertexAffine *v,
      }
 }
 
+/*
+ * Software fallback for blits with a matrix that rotates, skews, mirrors or projects.
+ * The pipeline must have been acquired for DFXL_TEXTRIANGLES.
+ */
+static void
+genefx_matrix_blit( CardState    *state,
+                    DFBRectangle *srect,
+                    DFBRectangle *drect )
+{
+     GenefxVertexAffine v[4];
+
+     if (state->affine_matrix) {
+          gAffineBlit( state, srect, drect );
+          return;
+     }
+
+     v[0].x = drect->x;
+     v[0].y = drect->y;
+     v[0].s = srect->x * 0x10000;
+     v[0].t = srect->y * 0x10000;
+
+     v[1].x = drect->x + drect->w - 1;
+     v[1].y = drect->y;
+     v[1].s = (srect->x + srect->w - 1) * 0x10000;
+     v[1].t = v[0].t;
+
+     v[2].x = drect->x + drect->w - 1;
+     v[2].y = drect->y + drect->h - 1;
+     v[2].s = v[1].s;
+     v[2].t = (srect->y + srect->h - 1) * 0x10000;
+
+     v[3].x = drect->x;
+     v[3].y = drect->y + drect->h - 1;
+     v[3].s = v[0].s;
+     v[3].t = v[2].t;
+
+     GenefxVertexAffine_Transform( v, 4, state->matrix, state->affine_matrix );
+
+     Genefx_TextureTrianglesAffine( state, v, 4, DTTF_FAN, &state->clip );
+}
+
 static void
 dfb_gfxcard_blit_locked( DFBRectangle *rect,
                          int           dx,
@@ -2698,31 +2976,9 @@ dfb_gfxcard_blit_locked( DFBRectangle *rect,
                    state->matrix[3] != 0 || state->matrix[4] < 0  ||
                    state->matrix[6] != 0 || state->matrix[7] != 0) {
                     if (gAcquire( state, DFXL_TEXTRIANGLES )) {
-                         GenefxVertexAffine v[4];
-
-                         v[0].x = dx;
-                         v[0].y = dy;
-                         v[0].s = rect->x * 0x10000;
-                         v[0].t = rect->y * 0x10000;
-
-                         v[1].x = dx + rect->w - 1;
-                         v[1].y = dy;
-                         v[1].s = (rect->x + rect->w - 1) * 0x10000;
-                         v[1].t = v[0].t;
-
-                         v[2].x = dx + rect->w - 1;
-                         v[2].y = dy + rect->h - 1;
-                         v[2].s = v[1].s;
-                         v[2].t = (rect->y + rect->h - 1) * 0x10000;
-
-                         v[3].x = dx;
-                         v[3].y = dy + rect->h - 1;
-                         v[3].s = v[0].s;
-                         v[3].t = v[2].t;
-
-                         GenefxVertexAffine_Transform( v, 4, state->matrix, state->affine_matrix );
+                         DFBRectangle drect = { dx, dy, rect->w, rect->h };
 
-                         Genefx_TextureTrianglesAffine( state, v, 4, DTTF_FAN, &state->clip );
+                         genefx_matrix_blit( state, rect, &drect );
 
                          gRelease( state );
                     }
@@ -2752,12 +3008,74 @@ dfb_gfxcard_blit( DFBRectangle *rect,
                   int           dy,
                   CardState    *state )
 {
+     long long start;
+
      /* The state is locked during graphics operations. */
      dfb_state_lock( state );
+
+     start = dfb_gfxcard_stats_begin( state );
+
      dfb_gfxcard_blit_locked( rect, dx, dy, state );
+
+     if (start)
+          dfb_gfxcard_stats_end( state, DFXL_BLIT, (unsigned long long) rect->w * rect->h, start );
+
      dfb_state_unlock( state );
 }
 
+/*
+ * Merges consecutive blits being exactly adjacent in both source and destination, i.e. having matching offsets, and
+ * returns their number. The order of the blits is kept, as overlapping ones would not yield the same result otherwise.
+ */
+static int
+coalesce_blits( DFBRectangle *rects,
+                DFBPoint     *points,
+                int           num )
+{
+     int i, n;
+
+     /* Drop empty blits and merge blits within the same rows. */
+     for (i = 0, n = -1; i < num; i++) {
+          if (rects[i].w <= 0 || rects[i].h <= 0)
+               continue;
+
+          if (n >= 0 && rects[i].y == rects[n].y && rects[i].h == rects[n].h &&
+              rects[i].x == rects[n].x + rects[n].w &&
+              points[i].x == points[n].x + rects[n].w && points[i].y == points[n].y &&
+              rects[n].w + rects[i].w <= card->limits.dst_max.w) {
+               rects[n].w += rects[i].w;
+               continue;
+          }
+
+          n++;
+
+          rects[n]  = rects[i];
+          points[n] = points[i];
+     }
+
+     num = n + 1;
+     if (!num)
+          return 0;
+
+     /* Merge rows of the same columns. */
+     for (i = 1, n = 0; i < num; i++) {
+          if (rects[i].x == rects[n].x && rects[i].w == rects[n].w &&
+              rects[i].y == rects[n].y + rects[n].h &&
+              points[i].y == points[n].y + rects[n].h && points[i].x == points[n].x &&
+              rects[n].h + rects[i].h <= card->limits.dst_max.h) {
+               rects[n].h += rects[i].h;
+               continue;
+          }
+
+          n++;
+
+          rects[n]  = rects[i];
+          points[n] = points[i];
+     }
+
+     return n + 1;
+}
+
 static void
 clip_blits( const DFBRegion         *clip,
             const DFBRectangle      *rects,
@@ -2809,6 +3127,8 @@ dfb_gfxcard_batchblit( DFBRectangle *rects,
      unsigned int i = 0;
 
      DFBSurfaceBlittingFlags blittingflags;
+     void                   *allocated = NULL;
+     long long               start;
 
      D_ASSERT( card != NULL );
      D_ASSERT( card->shared != NULL );
@@ -2823,12 +3143,53 @@ dfb_gfxcard_batchblit( DFBRectangle *rects,
      blittingflags = state->blittingflags;
      dfb_simplify_blittingflags( &blittingflags );
 
+     /* Coalesce adjacent blits, e.g. of tiles, into fewer, larger ones, unless the result depends on their extents. */
+     if (num > 1 && !(state->render_options & DSRO_MATRIX) && state->source != state->destination &&
+         !(blittingflags & (DSBLIT_ROTATE90 | DSBLIT_ROTATE180 | DSBLIT_ROTATE270 |
+                            DSBLIT_FLIP_HORIZONTAL | DSBLIT_FLIP_VERTICAL | DSBLIT_DEINTERLACE |
+                            DSBLIT_SRC_MASK_ALPHA | DSBLIT_SRC_MASK_COLOR | DSBLIT_SRC_CONVOLUTION))) {
+          DFBRectangle *coalesced_rects;
+          DFBPoint     *coalesced_points;
+
+          if (num > 256) {
+               coalesced_rects = allocated = D_MALLOC( (sizeof(DFBRectangle) + sizeof(DFBPoint)) * num );
+               if (!coalesced_rects)
+                    D_OOM();
+          }
+          else
+               coalesced_rects = alloca( (sizeof(DFBRectangle) + sizeof(DFBPoint)) * num );
+
+          if (coalesced_rects) {
+               coalesced_points = (DFBPoint*) (coalesced_rects + num);
+
+               direct_memcpy( coalesced_rects, rects, sizeof(DFBRectangle) * num );
+               direct_memcpy( coalesced_points, points, sizeof(DFBPoint) * num );
+
+               D_DEBUG_AT( Core_GraphicsOps, "  -> coalescing %d blits\n", num );
+
+               rects  = coalesced_rects;
+               points = coalesced_points;
+               num    = coalesce_blits( coalesced_rects, coalesced_points, num );
+
+               D_DEBUG_AT( Core_GraphicsOps, "  -> into %d blits\n", num );
+
+               if (!num) {
+                    if (allocated)
+                         D_FREE( allocated );
+
+                    return;
+               }
+          }
+     }
+
      /* The state is locked during graphics operations. */
      dfb_state_lock( state );
 
      /* Signal beginning of sequence of operations if not already done. */
      dfb_state_start_drawing( state );
 
+     start = dfb_gfxcard_stats_begin( state );
+
      if (dfb_gfxcard_state_check_acquire( state, DFXL_BLIT )) {
           if (card->funcs.BatchBlit) {
                unsigned int done = 0;
@@ -2920,31 +3281,9 @@ dfb_gfxcard_batchblit( DFBRectangle *rects,
                    state->matrix[6] != 0 || state->matrix[7] != 0) {
                     if (gAcquire( state, DFXL_TEXTRIANGLES )) {
                          for (; i < num; i++) {
-                              GenefxVertexAffine v[4];
+                              DFBRectangle drect = { points[i].x, points[i].y, rects[i].w, rects[i].h };
 
-                              v[0].x = points[i].x;
-                              v[0].y = points[i].y;
-                              v[0].s = rects[i].x * 0x10000;
-                              v[0].t = rects[i].y * 0x10000;
-
-                              v[1].x = points[i].x + rects[i].w - 1;
-                              v[1].y = points[i].y;
-                              v[1].s = (rects[i].x + rects[i].w - 1) * 0x10000;
-                              v[1].t = v[0].t;
-
-                              v[2].x = points[i].x + rects[i].w - 1;
-                              v[2].y = points[i].y + rects[i].h - 1;
-                              v[2].s = v[1].s;
-                              v[2].t = (rects[i].y + rects[i].h - 1) * 0x10000;
-
-                              v[3].x = points[i].x;
-                              v[3].y = points[i].y + rects[i].h - 1;
-                              v[3].s = v[0].s;
-                              v[3].t = v[2].t;
-
-                              GenefxVertexAffine_Transform( v, 4, state->matrix, state->affine_matrix );
-
-                              Genefx_TextureTrianglesAffine( state, v, 4, DTTF_FAN, &state->clip );
+                              genefx_matrix_blit( state, &rects[i], &drect );
                          }
 
                          gRelease( state );
@@ -2970,17 +3309,23 @@ dfb_gfxcard_batchblit( DFBRectangle *rects,
           }
           else {
                if (gAcquire( state, DFXL_BLIT )) {
-                    for (; i < num; i++) {
-                         DFBRectangle drect = { points[i].x, points[i].y, rects[i].w, rects[i].h };
+                    /* Glyphs of a string are composited in one pass. */
+                    if (gBlitGlyphRunCheck( state )) {
+                         gBlitGlyphRun( state, rects + i, points + i, num - i );
+                    }
+                    else {
+                         for (; i < num; i++) {
+                              DFBRectangle drect = { points[i].x, points[i].y, rects[i].w, rects[i].h };
 
-                         if (blittingflags & DSBLIT_ROTATE90)
-                              D_UTIL_SWAP( drect.w, drect.h );
+                              if (blittingflags & DSBLIT_ROTATE90)
+                                   D_UTIL_SWAP( drect.w, drect.h );
 
-                         if (dfb_clip_blit_precheck( &state->clip, drect.w, drect.h, drect.x, drect.y )) {
-                              DFBRectangle srect = rects[i];
+                              if (dfb_clip_blit_precheck( &state->clip, drect.w, drect.h, drect.x, drect.y )) {
+                                   DFBRectangle srect = rects[i];
 
-                              dfb_clip_blit_flipped_rotated( &state->clip, &srect, &drect, blittingflags );
-                              gBlit( state, &srect, drect.x, drect.y );
+                                   dfb_clip_blit_flipped_rotated( &state->clip, &srect, &drect, blittingflags );
+                                   gBlit( state, &srect, drect.x, drect.y );
+                              }
                          }
                     }
 
@@ -2989,7 +3334,13 @@ dfb_gfxcard_batchblit( DFBRectangle *rects,
           }
      }
 
+     if (start)
+          dfb_gfxcard_stats_end( state, DFXL_BLIT, count_rectangles( rects, num ), start );
+
      dfb_state_unlock( state );
+
+     if (allocated)
+          D_FREE( allocated );
 }
 
 void
@@ -2999,7 +3350,8 @@ dfb_gfxcard_batchblit2( DFBRectangle *rects,
                         int           num,
                         CardState    *state )
 {
-     int i = 0;
+     int       i = 0;
+     long long start;
 
      D_ASSERT( card != NULL );
      D_ASSERT( card->shared != NULL );
@@ -3018,6 +3370,8 @@ dfb_gfxcard_batchblit2( DFBRectangle *rects,
      /* Signal beginning of sequence of operations if not already done. */
      dfb_state_start_drawing( state );
 
+     start = dfb_gfxcard_stats_begin( state );
+
      if (dfb_gfxcard_state_check_acquire( state, DFXL_BLIT2 )) {
           for (; i < num; i++) {
                if ((state->render_options & DSRO_MATRIX) ||
@@ -3069,6 +3423,9 @@ dfb_gfxcard_batchblit2( DFBRectangle *rects,
           }
      }
 
+     if (start)
+          dfb_gfxcard_stats_end( state, DFXL_BLIT2, count_rectangles( rects, num ), start );
+
      dfb_state_unlock( state );
 }
 
@@ -3078,8 +3435,9 @@ dfb_gfxcard_batchstretchblit( DFBRectangle *srects,
                               unsigned int  num,
                               CardState    *state )
 {
-     int  i;
-     bool need_clip, acquired = false;
+     int       i;
+     bool      need_clip, acquired = false;
+     long long start;
 
      DFBSurfaceBlittingFlags blittingflags;
 
@@ -3106,6 +3464,8 @@ dfb_gfxcard_batchstretchblit( DFBRectangle *srects,
      /* Signal beginning of sequence of operations if not already done. */
      dfb_state_start_drawing( state );
 
+     start = dfb_gfxcard_stats_begin( state );
+
      need_clip = (!D_FLAGS_IS_SET( card->caps.flags, CCF_CLIPPING ) &&
                   !D_FLAGS_IS_SET( card->caps.clip, DFXL_STRETCHBLIT ));
 
@@ -3148,36 +3508,8 @@ dfb_gfxcard_batchstretchblit( DFBRectangle *srects,
                state->matrix[3] != 0 || state->matrix[4] < 0  ||
                state->matrix[6] != 0 || state->matrix[7] != 0)) {
                if (gAcquire( state, DFXL_TEXTRIANGLES )) {
-                    for (; i < num; ++i) {
-                         DFBRectangle *srect = &srects[i];
-                         DFBRectangle *drect = &drects[i];
-
-                         GenefxVertexAffine v[4];
-
-                         v[0].x = drect->x;
-                         v[0].y = drect->y;
-                         v[0].s = srect->x * 0x10000;
-                         v[0].t = srect->y * 0x10000;
-
-                         v[1].x = drect->x + drect->w - 1;
-                         v[1].y = drect->y;
-                         v[1].s = (srect->x + srect->w - 1) * 0x10000;
-                         v[1].t = v[0].t;
-
-                         v[2].x = drect->x + drect->w - 1;
-                         v[2].y = drect->y + drect->h - 1;
-                         v[2].s = v[1].s;
-                         v[2].t = (srect->y + srect->h - 1) * 0x10000;
-
-                         v[3].x = drect->x;
-                         v[3].y = drect->y + drect->h - 1;
-                         v[3].s = v[0].s;
-                         v[3].t = v[2].t;
-
-                         GenefxVertexAffine_Transform( v, 4, state->matrix, state->affine_matrix );
-
-                         Genefx_TextureTrianglesAffine( state, v, 4, DTTF_FAN, &state->clip );
-                    }
+                    for (; i < num; ++i)
+                         genefx_matrix_blit( state, &srects[i], &drects[i] );
 
                     gRelease( state );
                }
@@ -3208,6 +3540,9 @@ dfb_gfxcard_batchstretchblit( DFBRectangle *srects,
           }
      }
 
+     if (start)
+          dfb_gfxcard_stats_end( state, DFXL_STRETCHBLIT, count_rectangles( drects, num ), start );
+
      dfb_state_unlock( state );
 }
 
@@ -3231,6 +3566,7 @@ dfb_gfxcard_tileblit( DFBRectangle *rect,
      int           odx;
      DFBRectangle  srect;
      DFBRegion    *clip;
+     long long     start;
 
      D_ASSERT( card != NULL );
      D_ASSERT( card->shared != NULL );
@@ -3248,6 +3584,8 @@ dfb_gfxcard_tileblit( DFBRectangle *rect,
      /* Signal beginning of sequence of operations if not already done. */
      dfb_state_start_drawing( state );
 
+     start = dfb_gfxcard_stats_begin( state );
+
      clip = &state->clip;
 
      /* Check if anything is drawn at all. */
@@ -3324,31 +3662,9 @@ dfb_gfxcard_tileblit( DFBRectangle *rect,
                          /* Build mesh. */
                          for (; dy1 < dy2; dy1 += rect->h) {
                               for (; dx1 < dx2; dx1 += rect->w) {
-                                   GenefxVertexAffine v[4];
-
-                                   v[0].x = dx1;
-                                   v[0].y = dy1;
-                                   v[0].s = rect->x * 0x10000;
-                                   v[0].t = rect->y * 0x10000;
-
-                                   v[1].x = dx1 + rect->w - 1;
-                                   v[1].y = dy1;
-                                   v[1].s = (rect->x + rect->w - 1) * 0x10000;
-                                   v[1].t = v[0].t;
-
-                                   v[2].x = dx1 + rect->w - 1;
-                                   v[2].y = dy1 + rect->h - 1;
-                                   v[2].s = v[1].s;
-                                   v[2].t = (rect->y + rect->h - 1) * 0x10000;
+                                   DFBRectangle drect = { dx1, dy1, rect->w, rect->h };
 
-                                   v[3].x = dx1;
-                                   v[3].y = dy1 + rect->h - 1;
-                                   v[3].s = v[0].s;
-                                   v[3].t = v[2].t;
-
-                                   GenefxVertexAffine_Transform( v, 4, state->matrix, state->affine_matrix );
-
-                                   Genefx_TextureTrianglesAffine( state, v, 4, DTTF_FAN, &state->clip );
+                                   genefx_matrix_blit( state, rect, &drect );
                               }
 
                               dx1 = odx;
@@ -3403,6 +3719,9 @@ dfb_gfxcard_tileblit( DFBRectangle *rect,
           }
      }
 
+     if (start)
+          dfb_gfxcard_stats_end( state, DFXL_BLIT, (unsigned long long) (dx2 - dx1 + 1) * (dy2 - dy1 + 1), start );
+
      dfb_state_unlock( state );
 }
 
@@ -3412,7 +3731,8 @@ dfb_gfxcard_texture_triangles( DFBVertex            *vertices,
                                DFBTriangleFormation  formation,
                                CardState            *state )
 {
-     bool hw = false;
+     bool      hw = false;
+     long long start;
 
      D_ASSERT( card != NULL );
      D_ASSERT( card->shared != NULL );
@@ -3432,6 +3752,8 @@ dfb_gfxcard_texture_triangles( DFBVertex            *vertices,
      /* Signal beginning of sequence of operations if not already done. */
      dfb_state_start_drawing( state );
 
+     start = dfb_gfxcard_stats_begin( state );
+
      if ((D_FLAGS_IS_SET( card->caps.flags, CCF_CLIPPING ) ||
           D_FLAGS_IS_SET( card->caps.clip, DFXL_TEXTRIANGLES )) &&
          dfb_gfxcard_state_check_acquire( state, DFXL_TEXTRIANGLES )) {
@@ -3443,22 +3765,26 @@ dfb_gfxcard_texture_triangles( DFBVertex            *vertices,
      if (!hw) {
           if (gAcquire( state, DFXL_TEXTRIANGLES )) {
                int i;
-               GenefxVertexAffine v[num];
+               GenefxVertex v[num];
 
                /* Convert vertices. */
                for (i = 0; i < num; i++) {
                     v[i].x = vertices[i].x;
                     v[i].y = vertices[i].y;
-                    v[i].s = vertices[i].s * state->source->config.size.w * 0x10000;
-                    v[i].t = vertices[i].t * state->source->config.size.h * 0x10000;
+                    v[i].w = vertices[i].w;
+                    v[i].s = vertices[i].s * state->source->config.size.w;
+                    v[i].t = vertices[i].t * state->source->config.size.h;
                }
 
-               Genefx_TextureTrianglesAffine( state, v, num, formation, &state->clip );
+               Genefx_TextureTriangles( state, v, num, formation, &state->clip );
 
                gRelease( state );
           }
      }
 
+     if (start)
+          dfb_gfxcard_stats_end( state, DFXL_TEXTRIANGLES, count_vertices( vertices, num, formation ), start );
+
      dfb_state_unlock( state );
 }
 
@@ -3528,6 +3854,24 @@ font_state_restore( CardState *state,
      }
 }
 
+static bool
+drawstring_clipped( const CoreFont  *font,
+                    const CardState *state,
+                    int              x,
+                    int              y )
+{
+     /* Simple prechecks. */
+     if (!(font->description.flags & DFDESC_ROTATION) || !font->description.rotation) {
+          if (!(state->render_options & DSRO_MATRIX) &&
+              (x > state->clip.x2 || y > state->clip.y2 ||
+               y + font->height <= state->clip.y1)) {
+               return true;
+          }
+     }
+
+     return false;
+}
+
 void
 dfb_gfxcard_drawstring( const u8                *text,
                         int                      bytes,
@@ -3540,9 +3884,45 @@ dfb_gfxcard_drawstring( const u8                *text,
                         DFBSurfaceTextFlags      flags )
 {
      DFBResult     ret;
-     unsigned int  prev = 0;
      unsigned int  indices[bytes];
-     int           i, l, num;
+     int           num;
+
+     D_MAGIC_ASSERT( client, CoreGraphicsStateClient );
+     D_MAGIC_ASSERT( client->state, CardState );
+     D_ASSERT( text != NULL );
+     D_ASSERT( bytes > 0 );
+     D_ASSERT( font != NULL );
+
+     if (encoding == DTEID_UTF8)
+          D_DEBUG_AT( Core_GraphicsOps, "%s( '%s' [%d], %d,%d, %p, %p )\n", __FUNCTION__,
+                      text, bytes, x, y, font, client );
+     else
+          D_DEBUG_AT( Core_GraphicsOps, "%s( %p [%d], %u, %d,%d, %p, %p )\n", __FUNCTION__,
+                      text, bytes, encoding, x, y, font, client );
+
+     if (drawstring_clipped( font, client->state, x, y ))
+          return;
+
+     /* Decode string to character indices. */
+     ret = dfb_font_decode_text( font, encoding, text, bytes, indices, &num );
+     if (ret)
+          return;
+
+     dfb_gfxcard_drawstring_indices( indices, num, x, y, font, layers, client, flags );
+}
+
+void
+dfb_gfxcard_drawstring_indices( const unsigned int      *indices,
+                                int                      num,
+                                int                      x,
+                                int                      y,
+                                CoreFont                *font,
+                                unsigned int             layers,
+                                CoreGraphicsStateClient *client,
+                                DFBSurfaceTextFlags      flags )
+{
+     unsigned int  prev = 0;
+     int           i, l;
      int           kern_x;
      int           kern_y;
      CoreSurface  *surface;
@@ -3563,31 +3943,14 @@ dfb_gfxcard_drawstring( const u8                *text,
 
      D_MAGIC_ASSERT( state, CardState );
      D_MAGIC_ASSERT( state->destination, CoreSurface );
-     D_ASSERT( text != NULL );
-     D_ASSERT( bytes > 0 );
+     D_ASSERT( indices != NULL );
      D_ASSERT( font != NULL );
 
-     if (encoding == DTEID_UTF8)
-          D_DEBUG_AT( Core_GraphicsOps, "%s( '%s' [%d], %d,%d, %p, %p )\n", __FUNCTION__,
-                      text, bytes, x, y, font, client );
-     else
-          D_DEBUG_AT( Core_GraphicsOps, "%s( %p [%d], %u, %d,%d, %p, %p )\n", __FUNCTION__,
-                      text, bytes, encoding, x, y, font, client );
+     D_DEBUG_AT( Core_GraphicsOps, "%s( %p [%d], %d,%d, %p, %p )\n", __FUNCTION__, indices, num, x, y, font, client );
 
      surface = state->destination;
 
-     /* Simple prechecks. */
-     if (!(font->description.flags & DFDESC_ROTATION) || !font->description.rotation) {
-          if (!(state->render_options & DSRO_MATRIX) &&
-              (x > state->clip.x2 || y > state->clip.y2 ||
-               y + font->height <= state->clip.y1)) {
-               return;
-          }
-     }
-
-     /* Decode string to character indices. */
-     ret = dfb_font_decode_text( font, encoding, text, bytes, indices, &num );
-     if (ret)
+     if (num < 1 || drawstring_clipped( font, state, x, y ))
           return;
 
      font_state_prepare( state, &state_backup, font, surface, !(flags & DSTF_BLEND_FUNCS) );
@@ -3614,12 +3977,12 @@ dfb_gfxcard_drawstring( const u8                *text,
                     continue;
                }
 
-               if (prev && font->GetKerning && font->GetKerning( font, prev, current, &kern_x, &kern_y) == DFB_OK) {
+               if (prev && dfb_font_get_kerning( font, prev, current, NULL, &kern_x, &kern_y ) == DFB_OK) {
                     x += kern_x << 8;
                     y += kern_y << 8;
                }
 
-               if (glyph->width) {
+               if (glyph->width && glyph->surface) {
                     if (glyph->surface != state->source || num_blits == D_ARRAY_SIZE(rects)) {
                          if (num_blits) {
                               CoreGraphicsStateClient_Blit( client, rects, points, num_blits );
@@ -3631,7 +3994,7 @@ dfb_gfxcard_drawstring( const u8                *text,
                     }
 
                     points[num_blits] = (DFBPoint) { (x >> 8) + glyph->left, (y >> 8) + glyph->top };
-                    rects[num_blits]  = (DFBRectangle) { glyph->start, 0, glyph->width, glyph->height };
+                    rects[num_blits]  = (DFBRectangle) { glyph->start, glyph->y, glyph->width, glyph->height };
 
                     num_blits++;
                }
@@ -3688,8 +4051,8 @@ dfb_gfxcard_drawglyph( CoreGlyphData           **glyph,
                dfb_state_set_color( state, &state->colors[l] );
 
           /* Blit glyph. */
-          if (glyph[l]->width) {
-               DFBRectangle rect  = { glyph[l]->start, 0, glyph[l]->width, glyph[l]->height };
+          if (glyph[l]->width && glyph[l]->surface) {
+               DFBRectangle rect  = { glyph[l]->start, glyph[l]->y, glyph[l]->width, glyph[l]->height };
                DFBPoint     point = { x + glyph[l]->left, y + glyph[l]->top };
 
                dfb_state_set_source( state, glyph[l]->surface );
@@ -3888,6 +4251,46 @@ dfb_gfxcard_get_driver_info( GraphicsDriverInfo *ret_info )
      *ret_info = shared->driver_info;
 }
 
+DFBResult
+dfb_gfxcard_get_stats( DFBGraphicsOperationStats *ret_stats,
+                       unsigned int               max,
+                       unsigned int              *ret_num,
+                       unsigned int              *ret_total )
+{
+     DFBResult              ret;
+     DFBGraphicsCoreShared *shared;
+     unsigned int           i;
+     unsigned int           n = 0;
+
+     D_ASSERT( card != NULL );
+     D_ASSERT( card->shared != NULL );
+
+     D_ASSERT( ret_stats != NULL || max == 0 );
+     D_ASSERT( ret_num != NULL );
+     D_ASSERT( ret_total != NULL );
+
+     shared = card->shared;
+
+     if (!shared->op_stats_enabled)
+          return DFB_UNSUPPORTED;
+
+     ret = fusion_skirmish_prevail( &shared->op_stats_lock );
+     if (ret)
+          return ret;
+
+     for (i = 0; i < GRAPHICS_OP_STATS_SIZE && n < max; i++) {
+          if (shared->op_stats[i].accel != DFXL_NONE)
+               ret_stats[n++] = shared->op_stats[i];
+     }
+
+     *ret_num   = n;
+     *ret_total = shared->op_stats_num;
+
+     fusion_skirmish_dismiss( &shared->op_stats_lock );
+
+     return DFB_OK;
+}
+
 int
 dfb_gfxcard_reserve_memory( unsigned int size )
 {
@@ -4051,6 +4454,8 @@ dfb_gfxcard_update_stats( long long now )
      if (dfb_config->gfxcard_stats) {
           DFBGraphicsCoreShared *shared;
           long long              total;
+          unsigned int           hits;
+          unsigned int           misses;
 
           D_ASSERT( card != NULL );
           D_ASSERT( card->shared != NULL );
@@ -4062,6 +4467,16 @@ dfb_gfxcard_update_stats( long long now )
                D_INFO( "DirectFB/Graphics: Stats: busy %lld / %lld -> %3lld.%lld%%\n", shared->ts_busy_sum, total,
                        (1000 * shared->ts_busy_sum / total) / 10LL, (1000 * shared->ts_busy_sum / total) % 10LL );
 
+               gGetPipelineCacheStats( &hits, &misses );
+
+               D_INFO( "DirectFB/Graphics: Stats: software pipeline cache %u hits / %u misses\n", hits, misses );
+
+               if (dfb_config->font_measure_cache) {
+                    dfb_font_measure_get_stats( &hits, &misses );
+
+                    D_INFO( "DirectFB/Graphics: Stats: font measurement cache %u hits / %u misses\n", hits, misses );
+               }
+
                shared->ts_start    = now;
                shared->ts_busy_sum = 0;
           }
@@ -4113,3 +4528,235 @@ dfb_gfxcard_switch_idle()
           dfb_gfxcard_update_stats( now );
      }
 }
+
+/**********************************************************************************************************************/
+
+/*
+ * Starts counting a graphics operation, returns zero if the operations are not counted.
+ * The state must be locked.
+ */
+static long long
+dfb_gfxcard_stats_begin( CardState *state )
+{
+     D_ASSERT( card != NULL );
+     D_ASSERT( card->shared != NULL );
+
+     if (!card->shared->op_stats_enabled)
+          return 0;
+
+     state->flags &= ~CSF_SOFTWARE;
+
+     return direct_clock_get_time( DIRECT_CLOCK_MONOTONIC );
+}
+
+/*
+ * Adds a graphics operation to the counters of its function, pixel formats and flags.
+ */
+static void
+dfb_gfxcard_stats_end( CardState           *state,
+                       DFBAccelerationMask  accel,
+                       unsigned long long   pixels,
+                       long long            start )
+{
+     DFBGraphicsCoreShared     *shared;
+     DFBGraphicsOperationStats  key;
+     unsigned int               hash;
+     unsigned int               i;
+
+     D_ASSERT( card != NULL );
+     D_ASSERT( card->shared != NULL );
+
+     D_MAGIC_ASSERT( state, CardState );
+
+     shared = card->shared;
+
+     memset( &key, 0, sizeof(key) );
+
+     key.accel              = accel;
+     key.source_format      = DSPF_UNKNOWN;
+     key.destination_format = state->destination ? state->destination->config.format : DSPF_UNKNOWN;
+
+     if (DFB_BLITTING_FUNCTION( accel )) {
+          key.source_format  = state->source ? state->source->config.format : DSPF_UNKNOWN;
+          key.blitting_flags = state->blittingflags;
+     }
+     else
+          key.drawing_flags  = state->drawingflags;
+
+     hash = accel * 31 + key.source_format;
+     hash = hash  * 31 + key.destination_format;
+     hash = hash  * 31 + key.drawing_flags + key.blitting_flags;
+     hash = hash ^ (hash >> 16);
+
+     if (fusion_skirmish_prevail( &shared->op_stats_lock ))
+          return;
+
+     /* Look up the slot of the combination using linear probing, claiming a free one if not found. */
+     for (i = 0; i < GRAPHICS_OP_STATS_SIZE; i++) {
+          DFBGraphicsOperationStats *stats = &shared->op_stats[(hash + i) & (GRAPHICS_OP_STATS_SIZE - 1)];
+
+          if (stats->accel == DFXL_NONE) {
+               *stats = key;
+
+               shared->op_stats_num++;
+          }
+          else if (stats->accel              != key.accel              ||
+                   stats->source_format      != key.source_format      ||
+                   stats->destination_format != key.destination_format ||
+                   stats->drawing_flags      != key.drawing_flags      ||
+                   stats->blitting_flags     != key.blitting_flags)
+               continue;
+
+          stats->calls++;
+          stats->pixels += pixels;
+          stats->time   += direct_clock_get_time( DIRECT_CLOCK_MONOTONIC ) - start;
+
+          if (state->flags & CSF_SOFTWARE)
+               stats->software++;
+
+          break;
+     }
+
+     if (i == GRAPHICS_OP_STATS_SIZE)
+          D_ONCE( "too many combinations of graphics operations to count" );
+
+     fusion_skirmish_dismiss( &shared->op_stats_lock );
+}
+
+static unsigned long long
+count_rectangles( const DFBRectangle *rects,
+                  int                 num )
+{
+     unsigned long long pixels = 0;
+     int                i;
+
+     for (i = 0; i < num; i++) {
+          if (rects[i].w > 0 && rects[i].h > 0)
+               pixels += (unsigned long long) rects[i].w * rects[i].h;
+     }
+
+     return pixels;
+}
+
+static unsigned long long
+count_lines( const DFBRegion *lines,
+             int              num )
+{
+     unsigned long long pixels = 0;
+     int                i;
+
+     for (i = 0; i < num; i++)
+          pixels += MAX( ABS( lines[i].x2 - lines[i].x1 ), ABS( lines[i].y2 - lines[i].y1 ) ) + 1;
+
+     return pixels;
+}
+
+static unsigned long long
+count_triangle( long long x1,
+                long long y1,
+                long long x2,
+                long long y2,
+                long long x3,
+                long long y3 )
+{
+     long long area2 = (x2 - x1) * (y3 - y1) - (x3 - x1) * (y2 - y1);
+
+     return ABS( area2 ) / 2;
+}
+
+static unsigned long long
+count_triangles( const DFBTriangle *tris,
+                 int                num )
+{
+     unsigned long long pixels = 0;
+     int                i;
+
+     for (i = 0; i < num; i++)
+          pixels += count_triangle( tris[i].x1, tris[i].y1, tris[i].x2, tris[i].y2, tris[i].x3, tris[i].y3 );
+
+     return pixels;
+}
+
+static unsigned long long
+count_trapezoids( const DFBTrapezoid *traps,
+                  int                 num )
+{
+     unsigned long long pixels = 0;
+     int                i;
+
+     for (i = 0; i < num; i++)
+          pixels += (unsigned long long) (ABS( traps[i].w1 ) + ABS( traps[i].w2 )) *
+                    (ABS( traps[i].y2 - traps[i].y1 ) + 1) / 2;
+
+     return pixels;
+}
+
+static unsigned long long
+count_quadrangles( const DFBPoint *points,
+                   int             num )
+{
+     unsigned long long pixels = 0;
+     int                i;
+
+     for (i = 0; i < num; i++, points += 4) {
+          pixels += count_triangle( points[0].x, points[0].y, points[1].x, points[1].y, points[2].x, points[2].y );
+          pixels += count_triangle( points[0].x, points[0].y, points[2].x, points[2].y, points[3].x, points[3].y );
+     }
+
+     return pixels;
+}
+
+static unsigned long long
+count_spans( const DFBSpan *spans,
+             int            num )
+{
+     unsigned long long pixels = 0;
+     int                i;
+
+     for (i = 0; i < num; i++) {
+          if (spans[i].w > 0)
+               pixels += spans[i].w;
+     }
+
+     return pixels;
+}
+
+static unsigned long long
+count_vertices( const DFBVertex      *vertices,
+                int                   num,
+                DFBTriangleFormation  formation )
+{
+     unsigned long long pixels = 0;
+     int                i;
+
+     for (i = 2; i < num; i++) {
+          const DFBVertex *v1, *v2, *v3;
+
+          switch (formation) {
+               case DTTF_LIST:
+                    if (i % 3 != 2)
+                         continue;
+
+                    v1 = &vertices[i-2];
+                    break;
+
+               case DTTF_STRIP:
+                    v1 = &vertices[i-2];
+                    break;
+
+               case DTTF_FAN:
+                    v1 = &vertices[0];
+                    break;
+
+               default:
+                    return pixels;
+          }
+
+          v2 = &vertices[i-1];
+          v3 = &vertices[i];
+
+          pixels += count_triangle( v1->x, v1->y, v2->x, v2->y, v3->x, v3->y );
+     }
+
+     return pixels;
+}
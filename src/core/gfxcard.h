@@ -440,6 +440,18 @@ void           dfb_gfxcard_drawstring            ( const u8
                                                    CoreGraphicsStateClient       *client,
                                                    DFBSurfaceTextFlags            flags );
 
+/*
+ * Draw a string already decoded by dfb_font_decode_text().
+ */
+void           dfb_gfxcard_drawstring_indices    ( const unsigned int            *indices,
+                                                   int                            num,
+                                                   int                            x,
+                                                   int                            y,
+                                                   CoreFont                      *font,
+                                                   unsigned int                   layers,
+                                                   CoreGraphicsStateClient       *client,
+                                                   DFBSurfaceTextFlags            flags );
+
 void           dfb_gfxcard_drawglyph             ( CoreGlyphData                **glyph,
                                                    int                            x,
                                                    int                            y,
@@ -472,6 +484,11 @@ void           dfb_gfxcard_get_device_info       ( GraphicsDeviceInfo
 
 void           dfb_gfxcard_get_driver_info       ( GraphicsDriverInfo            *ret_info );
 
+DFBResult      dfb_gfxcard_get_stats             ( DFBGraphicsOperationStats     *ret_stats,
+                                                   unsigned int                   max,
+                                                   unsigned int                  *ret_num,
+                                                   unsigned int                  *ret_total );
+
 int            dfb_gfxcard_reserve_memory        ( unsigned int                   size );
 
 unsigned int   dfb_gfxcard_memory_length         ( void );
@@ -44,6 +44,54 @@ typedef struct {
 
 /**********************************************************************************************************************/
 
+#define CORE_GRAPHICS_STATE_COMMANDS_SIZE 8192     /* size of the command buffer of a slave */
+
+/*
+ * State changes and drawing operations encoded by slaves into a command buffer being executed by the master with a
+ * single CoreGraphicsState_Execute() call.
+ */
+typedef enum {
+     CGSC_DRAWING_FLAGS,                        /* 'arg' is the DFBSurfaceDrawingFlags */
+     CGSC_BLITTING_FLAGS,                       /* 'arg' is the DFBSurfaceBlittingFlags */
+     CGSC_CLIP,                                 /* DFBRegion */
+     CGSC_COLOR,                                /* DFBColor */
+     CGSC_SRC_BLEND,                            /* 'arg' is the DFBSurfaceBlendFunction */
+     CGSC_DST_BLEND,                            /* 'arg' is the DFBSurfaceBlendFunction */
+     CGSC_SRC_COLORKEY,                         /* 'arg' is the key */
+     CGSC_DST_COLORKEY,                         /* 'arg' is the key */
+     CGSC_SOURCE_MASK_VALS,                     /* DFBPoint, 'arg' is the DFBSurfaceMaskFlags */
+     CGSC_COLORKEY,                             /* DFBColorKey */
+     CGSC_RENDER_OPTIONS,                       /* 'arg' is the DFBSurfaceRenderOptions */
+     CGSC_MATRIX,                               /* s32[9] */
+     CGSC_FROM,                                 /* 'arg' is the DFBSurfaceBufferRole, 'num' the DFBSurfaceStereoEye */
+     CGSC_TO,                                   /* 'arg' is the DFBSurfaceBufferRole, 'num' the DFBSurfaceStereoEye */
+     CGSC_SRC_CONVOLUTION,                      /* DFBConvolutionFilter */
+
+     CGSC_FILLRECTANGLES,                       /* DFBRectangle[num] */
+     CGSC_DRAWRECTANGLES,                       /* DFBRectangle[num] */
+     CGSC_DRAWLINES,                            /* DFBRegion[num] */
+     CGSC_FILLTRIANGLES,                        /* DFBTriangle[num] */
+     CGSC_FILLTRAPEZOIDS,                       /* DFBTrapezoid[num] */
+     CGSC_FILLQUADRANGLES,                      /* DFBPoint[num] */
+     CGSC_FILLSPANS,                            /* DFBSpan[num], 'arg' is the y coordinate */
+     CGSC_BLIT,                                 /* DFBRectangle[num], DFBPoint[num] */
+     CGSC_BLIT2,                                /* DFBRectangle[num], DFBPoint[num], DFBPoint[num] */
+     CGSC_STRETCHBLIT,                          /* DFBRectangle[num], DFBRectangle[num] */
+     CGSC_TILEBLIT,                             /* DFBRectangle[num], DFBPoint[num], DFBPoint[num] */
+     CGSC_TEXTURETRIANGLES,                     /* DFBVertex[num], 'arg' is the DFBTriangleFormation */
+
+     CGSC_NUM
+} CoreGraphicsStateCommandType;
+
+typedef struct {
+     u32                          type;         /* CoreGraphicsStateCommandType */
+     u32                          size;         /* size including this header, a multiple of 4 */
+     u32                          num;          /* number of elements of each array following */
+     s32                          arg;
+} CoreGraphicsStateCommand;
+
+/**********************************************************************************************************************/
+
 /*
  * Creates a pool of graphics state objects.
  */
@@ -46,8 +46,10 @@ typedef enum {
 
      CSF_DRAWING            = 0x00010000, /* something has been rendered with this state, this is cleared by flushing
                                              the state, e.g. upon flip */
+     CSF_SOFTWARE           = 0x00020000, /* the software fallback has been acquired, cleared at the beginning of each
+                                             graphics operation being counted */
 
-     CSF_ALL                = 0x0001033B  /* all of these */
+     CSF_ALL                = 0x0003033B  /* all of these */
 } CardStateFlags;
 
 typedef enum {
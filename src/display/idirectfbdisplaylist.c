@@ -0,0 +1,558 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <core/CoreGraphicsStateClient.h>
+#include <core/state.h>
+#include <core/surface.h>
+#include <directfb_util.h>
+#include <display/idirectfbdisplaylist.h>
+#include <display/idirectfbsurface.h>
+
+D_DEBUG_DOMAIN( DisplayList, "IDirectFBDisplayList", "IDirectFBDisplayList Interface" );
+
+/**********************************************************************************************************************/
+
+#define REPLAY_BATCH 200                                    /* rectangles per call, as done by IDirectFBSurface */
+
+typedef enum {
+     DLCT_FILLRECTANGLES,
+     DLCT_DRAWRECTANGLES,
+     DLCT_BLIT,
+     DLCT_STRETCHBLIT
+} DisplayListCommandType;
+
+/*
+ * recorded part of the state, fields not used by a command are zero, so that states can be compared with memcmp()
+ */
+typedef struct {
+     DFBSurfaceDrawingFlags   drawingflags;
+     DFBSurfaceBlittingFlags  blittingflags;
+     DFBColor                 color;
+     u32                      color_index;
+     DFBSurfaceBlendFunction  src_blend;
+     DFBSurfaceBlendFunction  dst_blend;
+     u32                      src_colorkey;
+     u32                      dst_colorkey;
+     DFBSurfaceRenderOptions  render_options;
+     s32                      matrix[9];
+
+     CoreSurface             *source;                       /* referenced source of blits */
+     DFBSurfaceBufferRole     from;
+     DFBSurfaceStereoEye      from_eye;
+} DisplayListState;
+
+typedef struct {
+     DisplayListCommandType   type;
+     DisplayListState         state;
+
+     unsigned int             first;                        /* index of the first entry */
+     unsigned int             num;                          /* number of entries */
+} DisplayListCommand;
+
+typedef struct {
+     DFBRectangle             rect;                         /* rectangle to fill or draw, source rectangle of blits */
+     DFBRectangle             drect;                        /* destination rectangle of blits */
+} DisplayListEntry;
+
+/*
+ * private data struct of IDirectFBDisplayList
+ */
+typedef struct {
+     int                      ref;                          /* reference counter */
+
+     DisplayListCommand      *commands;                     /* batches of operations using the same state */
+     unsigned int             num_commands;
+     unsigned int             max_commands;
+
+     DisplayListEntry        *entries;                      /* rectangles of all commands */
+     unsigned int             num_entries;
+     unsigned int             max_entries;
+} IDirectFBDisplayList_data;
+
+/**********************************************************************************************************************/
+
+static void
+save_state( const CardState  *state,
+            DisplayListState *ret_state )
+{
+     memset( ret_state, 0, sizeof(DisplayListState) );
+
+     ret_state->drawingflags   = state->drawingflags;
+     ret_state->blittingflags  = state->blittingflags;
+     ret_state->color          = state->color;
+     ret_state->color_index    = state->color_index;
+     ret_state->src_blend      = state->src_blend;
+     ret_state->dst_blend      = state->dst_blend;
+     ret_state->src_colorkey   = state->src_colorkey;
+     ret_state->dst_colorkey   = state->dst_colorkey;
+     ret_state->render_options = state->render_options;
+     ret_state->source         = state->source;
+     ret_state->from           = state->from;
+     ret_state->from_eye       = state->from_eye;
+
+     memcpy( ret_state->matrix, state->matrix, sizeof(ret_state->matrix) );
+}
+
+static void
+snapshot_state( const CardState        *state,
+                DisplayListCommandType  type,
+                DisplayListState       *ret_state )
+{
+     save_state( state, ret_state );
+
+     /* Clear what does not affect the command to merge as many commands as possible. */
+     if (type == DLCT_FILLRECTANGLES || type == DLCT_DRAWRECTANGLES) {
+          ret_state->blittingflags = DSBLIT_NOFX;
+          ret_state->src_colorkey  = 0;
+          ret_state->source        = NULL;
+          ret_state->from          = DSBR_FRONT;
+          ret_state->from_eye      = DSSE_LEFT;
+
+          if (!(ret_state->drawingflags & DSDRAW_BLEND)) {
+               ret_state->src_blend = 0;
+               ret_state->dst_blend = 0;
+          }
+
+          if (!(ret_state->drawingflags & DSDRAW_DST_COLORKEY))
+               ret_state->dst_colorkey = 0;
+     }
+     else {
+          ret_state->drawingflags = DSDRAW_NOFX;
+
+          if (!(ret_state->blittingflags & (DSBLIT_BLEND_ALPHACHANNEL | DSBLIT_BLEND_COLORALPHA))) {
+               ret_state->src_blend = 0;
+               ret_state->dst_blend = 0;
+          }
+
+          if (!(ret_state->blittingflags & DSBLIT_SRC_COLORKEY))
+               ret_state->src_colorkey = 0;
+
+          if (!(ret_state->blittingflags & DSBLIT_DST_COLORKEY))
+               ret_state->dst_colorkey = 0;
+     }
+
+     if (!(ret_state->render_options & DSRO_MATRIX))
+          memset( ret_state->matrix, 0, sizeof(ret_state->matrix) );
+}
+
+static void
+apply_state( CardState              *state,
+             const DisplayListState *snapshot )
+{
+     dfb_state_set_drawing_flags( state, snapshot->drawingflags );
+     dfb_state_set_blitting_flags( state, snapshot->blittingflags );
+     dfb_state_set_color( state, &snapshot->color );
+     dfb_state_set_color_index( state, snapshot->color_index );
+     dfb_state_set_src_colorkey( state, snapshot->src_colorkey );
+     dfb_state_set_dst_colorkey( state, snapshot->dst_colorkey );
+     dfb_state_set_render_options( state, snapshot->render_options );
+
+     if (snapshot->src_blend)
+          dfb_state_set_src_blend( state, snapshot->src_blend );
+
+     if (snapshot->dst_blend)
+          dfb_state_set_dst_blend( state, snapshot->dst_blend );
+
+     if (snapshot->render_options & DSRO_MATRIX)
+          dfb_state_set_matrix( state, snapshot->matrix );
+
+     state->colors[0]        = state->color;
+     state->color_indices[0] = state->color_index;
+
+     if (snapshot->source) {
+          dfb_state_set_source( state, snapshot->source );
+          dfb_state_set_from( state, snapshot->from, snapshot->from_eye );
+     }
+}
+
+static DFBResult
+record( IDirectFBDisplayList   *thiz,
+        DisplayListCommandType  type,
+        CardState              *state,
+        int                     dx,
+        int                     dy,
+        const DFBRectangle     *rects,
+        const DFBPoint         *points,
+        const DFBRectangle     *drects,
+        unsigned int            num )
+{
+     DisplayListState    snapshot;
+     DisplayListCommand *command = NULL;
+     unsigned int        i;
+
+     DIRECT_INTERFACE_GET_DATA( IDirectFBDisplayList )
+
+     D_DEBUG_AT( DisplayList, "%s( %p, type %u, num %u )\n", __FUNCTION__, thiz, type, num );
+
+     D_ASSERT( rects != NULL );
+
+     if (type == DLCT_BLIT || type == DLCT_STRETCHBLIT) {
+          if (!state->source)
+               return DFB_INVARG;
+     }
+
+     snapshot_state( state, type, &snapshot );
+
+     /* Merge with the previous command if it uses the same state. */
+     if (data->num_commands) {
+          command = &data->commands[data->num_commands - 1];
+
+          if (command->type != type || memcmp( &command->state, &snapshot, sizeof(DisplayListState) ))
+               command = NULL;
+     }
+
+     if (data->num_entries + num > data->max_entries) {
+          unsigned int      max     = MAX( MAX( 64, data->max_entries * 2 ), data->num_entries + num );
+          DisplayListEntry *entries = D_REALLOC( data->entries, sizeof(DisplayListEntry) * max );
+
+          if (!entries)
+               return D_OOM();
+
+          data->entries     = entries;
+          data->max_entries = max;
+     }
+
+     if (!command) {
+          if (data->num_commands == data->max_commands) {
+               unsigned int        max      = MAX( 16, data->max_commands * 2 );
+               DisplayListCommand *commands = D_REALLOC( data->commands, sizeof(DisplayListCommand) * max );
+
+               if (!commands)
+                    return D_OOM();
+
+               data->commands     = commands;
+               data->max_commands = max;
+          }
+
+          if (snapshot.source && dfb_surface_ref( snapshot.source ))
+               return DFB_DEAD;
+
+          command = &data->commands[data->num_commands++];
+
+          command->type  = type;
+          command->state = snapshot;
+          command->first = data->num_entries;
+          command->num   = 0;
+
+          D_DEBUG_AT( DisplayList, "  -> new command %u\n", data->num_commands - 1 );
+     }
+
+     for (i = 0; i < num; i++) {
+          DisplayListEntry *entry = &data->entries[data->num_entries];
+
+          /* Rectangles emptied by clipping to the source area are dropped. */
+          if (rects[i].w < 1 || rects[i].h < 1)
+               continue;
+
+          entry->rect = rects[i];
+
+          switch (type) {
+               case DLCT_FILLRECTANGLES:
+               case DLCT_DRAWRECTANGLES:
+                    entry->rect.x += dx;
+                    entry->rect.y += dy;
+                    entry->drect   = entry->rect;
+                    break;
+
+               case DLCT_BLIT:
+                    entry->drect = (DFBRectangle) { points[i].x + dx, points[i].y + dy, rects[i].w, rects[i].h };
+                    break;
+
+               case DLCT_STRETCHBLIT:
+                    if (drects[i].w < 1 || drects[i].h < 1)
+                         continue;
+
+                    entry->drect = (DFBRectangle) { drects[i].x + dx, drects[i].y + dy, drects[i].w, drects[i].h };
+                    break;
+          }
+
+          data->num_entries++;
+          command->num++;
+     }
+
+     D_DEBUG_AT( DisplayList, "  -> %u entries in command %u\n", command->num, data->num_commands - 1 );
+
+     return DFB_OK;
+}
+
+/**********************************************************************************************************************/
+
+static void
+IDirectFBDisplayList_Destruct( IDirectFBDisplayList *thiz )
+{
+     IDirectFBDisplayList_data *data = thiz->priv;
+     unsigned int               i;
+
+     D_DEBUG_AT( DisplayList, "%s( %p )\n", __FUNCTION__, thiz );
+
+     for (i = 0; i < data->num_commands; i++) {
+          if (data->commands[i].state.source)
+               dfb_surface_unref( data->commands[i].state.source );
+     }
+
+     if (data->commands)
+          D_FREE( data->commands );
+
+     if (data->entries)
+          D_FREE( data->entries );
+
+     DIRECT_DEALLOCATE_INTERFACE( thiz );
+}
+
+static DirectResult
+IDirectFBDisplayList_AddRef( IDirectFBDisplayList *thiz )
+{
+     DIRECT_INTERFACE_GET_DATA( IDirectFBDisplayList )
+
+     D_DEBUG_AT( DisplayList, "%s( %p )\n", __FUNCTION__, thiz );
+
+     data->ref++;
+
+     return DFB_OK;
+}
+
+static DirectResult
+IDirectFBDisplayList_Release( IDirectFBDisplayList *thiz )
+{
+     DIRECT_INTERFACE_GET_DATA( IDirectFBDisplayList )
+
+     D_DEBUG_AT( DisplayList, "%s( %p )\n", __FUNCTION__, thiz );
+
+     if (--data->ref == 0)
+          IDirectFBDisplayList_Destruct( thiz );
+
+     return DFB_OK;
+}
+
+static DFBResult
+IDirectFBDisplayList_GetSize( IDirectFBDisplayList *thiz,
+                              unsigned int         *ret_batches,
+                              unsigned int         *ret_rects )
+{
+     DIRECT_INTERFACE_GET_DATA( IDirectFBDisplayList )
+
+     D_DEBUG_AT( DisplayList, "%s( %p )\n", __FUNCTION__, thiz );
+
+     if (!ret_batches && !ret_rects)
+          return DFB_INVARG;
+
+     if (ret_batches)
+          *ret_batches = data->num_commands;
+
+     if (ret_rects)
+          *ret_rects = data->num_entries;
+
+     return DFB_OK;
+}
+
+static DFBResult
+IDirectFBDisplayList_Replay( IDirectFBDisplayList *thiz,
+                             IDirectFBSurface     *destination,
+                             int                   dx,
+                             int                   dy,
+                             const DFBRegion      *clip )
+{
+     DFBResult              ret = DFB_OK;
+     IDirectFBSurface_data *dst_data;
+     CardState             *state;
+     DisplayListState       saved;
+     DFBRegion              saved_clip;
+     DFBRegion              replay_clip;
+     DFBRectangle           rects[REPLAY_BATCH];
+     DFBRectangle           drects[REPLAY_BATCH];
+     DFBPoint               points[REPLAY_BATCH];
+     unsigned int           i, j, n, num;
+
+     DIRECT_INTERFACE_GET_DATA( IDirectFBDisplayList )
+
+     D_DEBUG_AT( DisplayList, "%s( %p, %p, %d,%d )\n", __FUNCTION__, thiz, destination, dx, dy );
+
+     if (!destination)
+          return DFB_INVARG;
+
+     dst_data = destination->priv;
+     if (!dst_data)
+          return DFB_DEAD;
+
+     if (!dst_data->surface)
+          return DFB_DESTROYED;
+
+     if (!dst_data->area.current.w || !dst_data->area.current.h)
+          return DFB_INVAREA;
+
+     if (dst_data->locked)
+          return DFB_LOCKED;
+
+     if (dst_data->display_list)
+          return DFB_BUSY;
+
+     state = &dst_data->state;
+
+     saved_clip  = state->clip;
+     replay_clip = state->clip;
+
+     if (clip) {
+          DFBRegion region = DFB_REGION_INIT_TRANSLATED( clip, dst_data->area.wanted.x, dst_data->area.wanted.y );
+
+          if (!dfb_region_region_intersect( &replay_clip, &region ))
+               return DFB_OK;
+     }
+
+     dx += dst_data->area.wanted.x;
+     dy += dst_data->area.wanted.y;
+
+     save_state( state, &saved );
+
+     /* Keep the source of the destination alive while replaying blits from other sources. */
+     if (saved.source && dfb_surface_ref( saved.source ))
+          return DFB_DEAD;
+
+     dfb_state_set_clip( state, &replay_clip );
+
+     for (i = 0; i < data->num_commands && !ret; i++) {
+          const DisplayListCommand *command = &data->commands[i];
+          const DisplayListEntry   *entries = &data->entries[command->first];
+
+          D_DEBUG_AT( DisplayList, "  -> [%u] type %u, %u entries\n", i, command->type, command->num );
+
+          apply_state( state, &command->state );
+
+          for (n = 0; n < command->num && !ret; n += num) {
+               num = MIN( REPLAY_BATCH, command->num - n );
+
+               for (j = 0; j < num; j++) {
+                    const DisplayListEntry *entry = &entries[n + j];
+
+                    switch (command->type) {
+                         case DLCT_FILLRECTANGLES:
+                         case DLCT_DRAWRECTANGLES:
+                              rects[j] = (DFBRectangle) { entry->rect.x + dx, entry->rect.y + dy,
+                                                          entry->rect.w,      entry->rect.h };
+                              break;
+
+                         case DLCT_BLIT:
+                              rects[j]  = entry->rect;
+                              points[j] = (DFBPoint) { entry->drect.x + dx, entry->drect.y + dy };
+                              break;
+
+                         case DLCT_STRETCHBLIT:
+                              rects[j]  = entry->rect;
+                              drects[j] = (DFBRectangle) { entry->drect.x + dx, entry->drect.y + dy,
+                                                           entry->drect.w,      entry->drect.h };
+                              break;
+                    }
+               }
+
+               switch (command->type) {
+                    case DLCT_FILLRECTANGLES:
+                         ret = CoreGraphicsStateClient_FillRectangles( &dst_data->state_client, rects, num );
+                         break;
+
+                    case DLCT_DRAWRECTANGLES:
+                         ret = CoreGraphicsStateClient_DrawRectangles( &dst_data->state_client, rects, num );
+                         break;
+
+                    case DLCT_BLIT:
+                         ret = CoreGraphicsStateClient_Blit( &dst_data->state_client, rects, points, num );
+                         break;
+
+                    case DLCT_STRETCHBLIT:
+                         ret = CoreGraphicsStateClient_StretchBlit( &dst_data->state_client, rects, drects, num );
+                         break;
+               }
+          }
+     }
+
+     /* Restore the state of the destination. */
+     apply_state( state, &saved );
+
+     dfb_state_set_source( state, saved.source );
+     dfb_state_set_from( state, saved.from, saved.from_eye );
+     dfb_state_set_matrix( state, saved.matrix );
+     dfb_state_set_clip( state, &saved_clip );
+
+     if (saved.source)
+          dfb_surface_unref( saved.source );
+
+     return ret;
+}
+
+/**********************************************************************************************************************/
+
+DFBResult
+IDirectFBDisplayList_Construct( IDirectFBDisplayList *thiz )
+{
+     DIRECT_ALLOCATE_INTERFACE_DATA( thiz, IDirectFBDisplayList )
+
+     D_DEBUG_AT( DisplayList, "%s( %p )\n", __FUNCTION__, thiz );
+
+     data->ref = 1;
+
+     thiz->AddRef  = IDirectFBDisplayList_AddRef;
+     thiz->Release = IDirectFBDisplayList_Release;
+     thiz->GetSize = IDirectFBDisplayList_GetSize;
+     thiz->Replay  = IDirectFBDisplayList_Replay;
+
+     return DFB_OK;
+}
+
+DFBResult
+IDirectFBDisplayList_RecordFill( IDirectFBDisplayList *thiz,
+                                 CardState            *state,
+                                 int                   dx,
+                                 int                   dy,
+                                 const DFBRectangle   *rects,
+                                 unsigned int          num )
+{
+     return record( thiz, DLCT_FILLRECTANGLES, state, dx, dy, rects, NULL, NULL, num );
+}
+
+DFBResult
+IDirectFBDisplayList_RecordDraw( IDirectFBDisplayList *thiz,
+                                 CardState            *state,
+                                 int                   dx,
+                                 int                   dy,
+                                 const DFBRectangle   *rects,
+                                 unsigned int          num )
+{
+     return record( thiz, DLCT_DRAWRECTANGLES, state, dx, dy, rects, NULL, NULL, num );
+}
+
+DFBResult
+IDirectFBDisplayList_RecordBlit( IDirectFBDisplayList *thiz,
+                                 CardState            *state,
+                                 int                   dx,
+                                 int                   dy,
+                                 const DFBRectangle   *rects,
+                                 const DFBPoint       *points,
+                                 unsigned int          num )
+{
+     return record( thiz, DLCT_BLIT, state, dx, dy, rects, points, NULL, num );
+}
+
+DFBResult
+IDirectFBDisplayList_RecordStretchBlit( IDirectFBDisplayList *thiz,
+                                        CardState            *state,
+                                        int                   dx,
+                                        int                   dy,
+                                        const DFBRectangle   *srects,
+                                        const DFBRectangle   *drects,
+                                        unsigned int          num )
+{
+     return record( thiz, DLCT_STRETCHBLIT, state, dx, dy, srects, NULL, drects, num );
+}
@@ -0,0 +1,72 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#ifndef __DISPLAY__IDIRECTFBDISPLAYLIST_H__
+#define __DISPLAY__IDIRECTFBDISPLAYLIST_H__
+
+#include <core/coretypes.h>
+
+/*
+ * initializes interface struct and private data
+ */
+DFBResult IDirectFBDisplayList_Construct        ( IDirectFBDisplayList *thiz );
+
+/*
+ * records rectangle fills, 'dx' and 'dy' translate the rectangles to surface coordinates
+ */
+DFBResult IDirectFBDisplayList_RecordFill       ( IDirectFBDisplayList *thiz,
+                                                  CardState            *state,
+                                                  int                   dx,
+                                                  int                   dy,
+                                                  const DFBRectangle   *rects,
+                                                  unsigned int          num );
+
+/*
+ * records rectangle outlines, 'dx' and 'dy' translate the rectangles to surface coordinates
+ */
+DFBResult IDirectFBDisplayList_RecordDraw       ( IDirectFBDisplayList *thiz,
+                                                  CardState            *state,
+                                                  int                   dx,
+                                                  int                   dy,
+                                                  const DFBRectangle   *rects,
+                                                  unsigned int          num );
+
+/*
+ * records blits from the source of the state, 'dx' and 'dy' translate the points to surface coordinates
+ */
+DFBResult IDirectFBDisplayList_RecordBlit       ( IDirectFBDisplayList *thiz,
+                                                  CardState            *state,
+                                                  int                   dx,
+                                                  int                   dy,
+                                                  const DFBRectangle   *rects,
+                                                  const DFBPoint       *points,
+                                                  unsigned int          num );
+
+/*
+ * records stretch blits from the source of the state, 'dx' and 'dy' translate the destination rectangles to surface
+ * coordinates
+ */
+DFBResult IDirectFBDisplayList_RecordStretchBlit( IDirectFBDisplayList *thiz,
+                                                  CardState            *state,
+                                                  int                   dx,
+                                                  int                   dy,
+                                                  const DFBRectangle   *srects,
+                                                  const DFBRectangle   *drects,
+                                                  unsigned int          num );
+
+#endif
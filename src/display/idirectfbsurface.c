@@ -27,6 +27,7 @@
 #include <core/surface_pool.h>
 #include <direct/memcpy.h>
 #include <direct/thread.h>
+#include <display/idirectfbdisplaylist.h>
 #include <display/idirectfbpalette.h>
 #include <display/idirectfbsurface.h>
 #include <display/idirectfbsurfaceallocation.h>
@@ -119,17 +120,21 @@ IDirectFBSurface_Destruct( IDirectFBSurface *thiz )
 
      direct_mutex_unlock( &data->children_lock );
 
+     /* Execute pending commands of the thread first, which may still read from preallocated memory. */
+     CoreGraphicsStateClient_Flush( &data->state_client );
+
      if (data->memory_permissions_count) {
           CoreDFB_WaitIdle( data->core );
 
           unregister_prealloc( data );
      }
-     else
-          CoreGraphicsStateClient_Flush( &data->state_client );
 
      if (data->surface_client)
           dfb_surface_client_unref( data->surface_client );
 
+     if (data->display_list)
+          data->display_list->Release( data->display_list );
+
      parent = data->parent;
      if (parent) {
           IDirectFBSurface_data *parent_data;
@@ -904,6 +909,9 @@ IDirectFBSurface_Clear( IDirectFBSurface *thiz,
      if (data->locked)
           return DFB_LOCKED;
 
+     if (data->display_list)
+          return DFB_UNSUPPORTED;
+
      /* Save current color and drawing flags. */
      old_color   = data->state.color;
      old_index   = data->state.color_index;
@@ -1337,6 +1345,7 @@ IDirectFBSurface_Blit( IDirectFBSurface   *thiz,
                        int                 x,
                        int                 y )
 {
+     DFBResult              ret = DFB_OK;
      DFBRectangle           srect;
      DFBPoint               p;
      IDirectFBSurface_data *src_data;
@@ -1411,12 +1420,16 @@ IDirectFBSurface_Blit( IDirectFBSurface   *thiz,
      p.x = data->area.wanted.x + dx;
      p.y = data->area.wanted.y + dy;
 
-     CoreGraphicsStateClient_Blit( &data->state_client, &srect, &p, 1 );
+     if (data->display_list)
+          ret = IDirectFBDisplayList_RecordBlit( data->display_list, &data->state,
+                                                 -data->area.wanted.x, -data->area.wanted.y, &srect, &p, 1 );
+     else
+          CoreGraphicsStateClient_Blit( &data->state_client, &srect, &p, 1 );
 
      if (src_data->surface_client)
           direct_mutex_unlock( &data->surface_client_lock );
 
-     return DFB_OK;
+     return ret;
 }
 
 static DFBResult
@@ -1446,6 +1459,9 @@ IDirectFBSurface_TileBlit( IDirectFBSurface   *thiz,
      if (data->locked)
           return DFB_LOCKED;
 
+     if (data->display_list)
+          return DFB_UNSUPPORTED;
+
      if (!source)
           return DFB_INVARG;
 
@@ -1585,6 +1601,9 @@ IDirectFBSurface_BatchBlit( IDirectFBSurface   *thiz,
      if (data->state.blittingflags & DSBLIT_SRC_COLORKEY)
           dfb_state_set_src_colorkey( &data->state, src_data->src_key.value );
 
+     if (data->display_list)
+          return IDirectFBDisplayList_RecordBlit( data->display_list, &data->state, -dx, -dy, rects, points, num );
+
      CoreGraphicsStateClient_Blit( &data->state_client, rects, points, num );
 
      return DFB_OK;
@@ -1664,6 +1683,9 @@ IDirectFBSurface_TextureTriangles( IDirectFBSurface     *thiz,
      if (data->locked)
           return DFB_LOCKED;
 
+     if (data->display_list)
+          return DFB_UNSUPPORTED;
+
      if (!texture || !vertices || num < 3)
           return DFB_INVARG;
 
@@ -1784,6 +1806,9 @@ IDirectFBSurface_FillRectangle( IDirectFBSurface *thiz,
      if (w <= 0 || h <= 0)
           return DFB_INVARG;
 
+     if (data->display_list)
+          return IDirectFBDisplayList_RecordFill( data->display_list, &data->state, 0, 0, &rect, 1 );
+
      rect.x += data->area.wanted.x;
      rect.y += data->area.wanted.y;
 
@@ -1818,6 +1843,9 @@ IDirectFBSurface_DrawRectangle( IDirectFBSurface *thiz,
      if (w <= 0 || h <= 0)
           return DFB_INVARG;
 
+     if (data->display_list)
+          return IDirectFBDisplayList_RecordDraw( data->display_list, &data->state, 0, 0, &rect, 1 );
+
      rect.x += data->area.wanted.x;
      rect.y += data->area.wanted.y;
 
@@ -1847,6 +1875,9 @@ IDirectFBSurface_DrawLine( IDirectFBSurface *thiz,
      if (data->locked)
           return DFB_LOCKED;
 
+     if (data->display_list)
+          return DFB_UNSUPPORTED;
+
      if ((x1 == x2 || y1 == y2) && !(data->state.render_options & DSRO_MATRIX)) {
           DFBRectangle rect;
 
@@ -1907,6 +1938,9 @@ IDirectFBSurface_DrawLines( IDirectFBSurface *thiz,
      if (data->locked)
           return DFB_LOCKED;
 
+     if (data->display_list)
+          return DFB_UNSUPPORTED;
+
      if (!lines || !num_lines)
           return DFB_INVARG;
 
@@ -1986,6 +2020,9 @@ IDirectFBSurface_FillTriangle( IDirectFBSurface *thiz,
      if (data->locked)
           return DFB_LOCKED;
 
+     if (data->display_list)
+          return DFB_UNSUPPORTED;
+
      tri.x1 += data->area.wanted.x;
      tri.y1 += data->area.wanted.y;
      tri.x2 += data->area.wanted.x;
@@ -2023,6 +2060,9 @@ IDirectFBSurface_FillRectangles( IDirectFBSurface   *thiz,
      if (!rects || !num_rects)
           return DFB_INVARG;
 
+     if (data->display_list)
+          return IDirectFBDisplayList_RecordFill( data->display_list, &data->state, 0, 0, rects, num_rects );
+
      if (data->area.wanted.x || data->area.wanted.y) {
           DFBRectangle *local_rects;
           bool          malloced = (num_rects > 256);
@@ -2078,6 +2118,9 @@ IDirectFBSurface_FillSpans( IDirectFBSurface *thiz,
      if (data->locked)
           return DFB_LOCKED;
 
+     if (data->display_list)
+          return DFB_UNSUPPORTED;
+
      if (!spans || !num_spans)
           return DFB_INVARG;
 
@@ -2116,6 +2159,9 @@ IDirectFBSurface_FillTriangles( IDirectFBSurface  *thiz,
      if (data->locked)
           return DFB_LOCKED;
 
+     if (data->display_list)
+          return DFB_UNSUPPORTED;
+
      if (!tris || !num_tris)
           return DFB_INVARG;
 
@@ -2219,8 +2265,10 @@ IDirectFBSurface_DrawString( IDirectFBSurface    *thiz,
                              int                  y,
                              DFBSurfaceTextFlags  flags )
 {
+     DFBResult           ret;
      IDirectFBFont_data *font_data;
      unsigned int        layers = 1;
+     int                 num;
 
      DIRECT_INTERFACE_GET_DATA( IDirectFBSurface )
 
@@ -2235,6 +2283,9 @@ IDirectFBSurface_DrawString( IDirectFBSurface    *thiz,
      if (data->locked)
           return DFB_LOCKED;
 
+     if (data->display_list)
+          return DFB_UNSUPPORTED;
+
      if (!data->font)
           return DFB_MISSINGFONT;
 
@@ -2274,34 +2325,30 @@ IDirectFBSurface_DrawString( IDirectFBSurface    *thiz,
           }
      }
 
+     unsigned int indices[bytes];
+
+     /* Decode string to character indices, once for justification and drawing. */
+     ret = dfb_font_decode_text( font_data->font, data->encoding, text, bytes, indices, &num );
+     if (ret)
+          return ret;
+
      if (flags & (DSTF_RIGHT | DSTF_CENTER)) {
-          DFBResult    ret;
-          int          i, num, kx, ky;
+          int          i, kx, ky;
           int          xsize = 0;
           int          ysize = 0;
-          unsigned int prev  = 0;
-          unsigned int indices[bytes];
-
-          dfb_font_lock( font_data->font );
-
-          /* Decode string to character indices. */
-          ret = dfb_font_decode_text( font_data->font, data->encoding, text, bytes, indices, &num );
-          if (ret) {
-               dfb_font_unlock( font_data->font );
-               return ret;
-          }
+          unsigned int prev   = 0;
+          bool         locked = false;
 
           /* Calculate string width. */
           for (i = 0; i < num; i++) {
                unsigned int   current = indices[i];
                CoreGlyphData *glyph;
 
-               if (dfb_font_get_glyph_data( font_data->font, current, 0, &glyph ) == DFB_OK) {
+               if (dfb_font_get_glyph_metrics( font_data->font, current, 0, &locked, &glyph ) == DFB_OK) {
                     xsize += glyph->xadvance;
                     ysize += glyph->yadvance;
 
-                    if (prev && font_data->font->GetKerning &&
-                        font_data->font->GetKerning( font_data->font, prev, current, &kx, &ky ) == DFB_OK) {
+                    if (prev && dfb_font_get_kerning( font_data->font, prev, current, &locked, &kx, &ky ) == DFB_OK) {
                          xsize += kx << 8;
                          ysize += ky << 8;
                     }
@@ -2310,7 +2357,8 @@ IDirectFBSurface_DrawString( IDirectFBSurface    *thiz,
                prev = current;
           }
 
-          dfb_font_unlock( font_data->font );
+          if (locked)
+               dfb_font_unlock( font_data->font );
 
           /* Justify. */
           if (flags & DSTF_RIGHT) {
@@ -2323,9 +2371,8 @@ IDirectFBSurface_DrawString( IDirectFBSurface    *thiz,
           }
      }
 
-     dfb_gfxcard_drawstring( (const unsigned char*) text, bytes, data->encoding,
-                             data->area.wanted.x + x, data->area.wanted.y + y,
-                             font_data->font, layers, &data->state_client, flags );
+     dfb_gfxcard_drawstring_indices( indices, num, data->area.wanted.x + x, data->area.wanted.y + y,
+                                     font_data->font, layers, &data->state_client, flags );
 
      return DFB_OK;
 }
@@ -2357,6 +2404,9 @@ IDirectFBSurface_DrawGlyph( IDirectFBSurface    *thiz,
      if (data->locked)
           return DFB_LOCKED;
 
+     if (data->display_list)
+          return DFB_UNSUPPORTED;
+
      if (!data->font)
           return DFB_MISSINGFONT;
 
@@ -2805,6 +2855,8 @@ IDirectFBSurface_Write( IDirectFBSurface   *thiz,
 
      D_DEBUG_AT( Surface, "  -> %4d,%4d-%4dx%4d\n", DFB_RECTANGLE_VALS( rect ) );
 
+     CoreGraphicsStateClient_Flush( &data->state_client );
+
      return dfb_surface_write_buffer( data->surface, DSBR_BACK, ptr, pitch, rect );
 }
 
@@ -2832,6 +2884,8 @@ IDirectFBSurface_Read( IDirectFBSurface   *thiz,
 
      D_DEBUG_AT( Surface, "  -> %4d,%4d-%4dx%4d\n", DFB_RECTANGLE_VALS( rect ) );
 
+     CoreGraphicsStateClient_Flush( &data->state_client );
+
      return dfb_surface_read_buffer( data->surface, DSBR_FRONT, ptr, pitch, rect );
 }
 
@@ -2900,6 +2954,9 @@ IDirectFBSurface_BatchBlit2( IDirectFBSurface   *thiz,
      if (data->locked)
           return DFB_LOCKED;
 
+     if (data->display_list)
+          return DFB_UNSUPPORTED;
+
      if (!source || !source2 || !source_rects || !dest_points || !source2_points || num < 1)
           return DFB_INVARG;
 
@@ -3028,6 +3085,9 @@ IDirectFBSurface_FillTrapezoids( IDirectFBSurface   *thiz,
      if (data->locked)
           return DFB_LOCKED;
 
+     if (data->display_list)
+          return DFB_UNSUPPORTED;
+
      if (!traps || !num_traps)
           return DFB_INVARG;
 
@@ -3079,6 +3139,9 @@ IDirectFBSurface_FillQuadrangles( IDirectFBSurface *thiz,
      if (data->locked)
           return DFB_LOCKED;
 
+     if (data->display_list)
+          return DFB_UNSUPPORTED;
+
      if (!points || !num_points)
           return DFB_INVARG;
 
@@ -3148,6 +3211,9 @@ IDirectFBSurface_DrawMonoGlyphs( IDirectFBSurface             *thiz,
      if (data->locked)
           return DFB_LOCKED;
 
+     if (data->display_list)
+          return DFB_UNSUPPORTED;
+
      if (!glyphs || !attributes || !dest_points || num < 1)
           return DFB_INVARG;
 
@@ -3380,6 +3446,10 @@ IDirectFBSurface_BatchStretchBlit( IDirectFBSurface   *thiz,
      if (data->state.blittingflags & DSBLIT_SRC_COLORKEY)
           dfb_state_set_src_colorkey( &data->state, src_data->src_key.value );
 
+     if (data->display_list)
+          return IDirectFBDisplayList_RecordStretchBlit( data->display_list, &data->state, -dx, -dy,
+                                                         srects, drects, num );
+
      CoreGraphicsStateClient_StretchBlit( &data->state_client, srects, drects, num );
 
      return DFB_OK;
@@ -3699,6 +3769,56 @@ IDirectFBSurface_Flush( IDirectFBSurface     *thiz )
      return DFB_OK;
 }
 
+static DFBResult
+IDirectFBSurface_BeginDisplayList( IDirectFBSurface *thiz )
+{
+     DFBResult             ret;
+     IDirectFBDisplayList *iface;
+
+     DIRECT_INTERFACE_GET_DATA( IDirectFBSurface )
+
+     D_DEBUG_AT( Surface, "%s( %p )\n", __FUNCTION__, thiz );
+
+     if (!data->surface)
+          return DFB_DESTROYED;
+
+     if (data->display_list)
+          return DFB_BUSY;
+
+     DIRECT_ALLOCATE_INTERFACE( iface, IDirectFBDisplayList );
+     if (!iface)
+          return DFB_NOSYSTEMMEMORY;
+
+     ret = IDirectFBDisplayList_Construct( iface );
+     if (ret)
+          return ret;
+
+     data->display_list = iface;
+
+     return DFB_OK;
+}
+
+static DFBResult
+IDirectFBSurface_EndDisplayList( IDirectFBSurface      *thiz,
+                                 IDirectFBDisplayList **ret_interface )
+{
+     DIRECT_INTERFACE_GET_DATA( IDirectFBSurface )
+
+     D_DEBUG_AT( Surface, "%s( %p )\n", __FUNCTION__, thiz );
+
+     if (!ret_interface)
+          return DFB_INVARG;
+
+     if (!data->display_list)
+          return DFB_NOCONTEXT;
+
+     *ret_interface = data->display_list;
+
+     data->display_list = NULL;
+
+     return DFB_OK;
+}
+
 static ReactionResult
 IDirectFBSurface_React( const void *msg_data,
                         void       *ctx )
@@ -3989,6 +4109,8 @@ IDirectFBSurface_Construct( IDirectFBSurface       *thiz,
      thiz->GetAllocation          = IDirectFBSurface_GetAllocation;
      thiz->GetAllocations         = IDirectFBSurface_GetAllocations;
      thiz->Flush                  = IDirectFBSurface_Flush;
+     thiz->BeginDisplayList       = IDirectFBSurface_BeginDisplayList;
+     thiz->EndDisplayList         = IDirectFBSurface_EndDisplayList;
 
      return DFB_OK;
 }
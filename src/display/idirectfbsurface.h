@@ -123,6 +123,8 @@ typedef struct {
      unsigned int             local_buffer_count;
 
      CoreSurfaceAllocation   *allocations[MAX_SURFACE_BUFFERS];
+
+     IDirectFBDisplayList    *display_list;                     /* display list being recorded */
 } IDirectFBSurface_data;
 
 /*
@@ -20,10 +20,15 @@
 #include <core/core.h>
 #include <core/state.h>
 #include <core/palette.h>
+#include <direct/atomic.h>
 #include <direct/memcpy.h>
 #include <gfx/convert.h>
 #include <gfx/generic/duffs_device.h>
 #include <gfx/generic/generic.h>
+#include <gfx/generic/generic_bands.h>
+#include <gfx/generic/generic_convolution.h>
+#include <gfx/generic/generic_glyphs.h>
+#include <gfx/generic/generic_util.h>
 #include <gfx/util.h>
 
 /**********************************************************************************************************************/
@@ -32,13 +37,8 @@
 static const u8 lookup3to8[] = { 0x00, 0x24, 0x49, 0x6d, 0x92, 0xb6, 0xdb, 0xff };
 static const u8 lookup2to8[] = { 0x00, 0x55, 0xaa, 0xff };
 
-#define EXPAND_1to8(v) ((v) ? 0xff : 0x00)
 #define EXPAND_2to8(v) lookup2to8[v]
 #define EXPAND_3to8(v) lookup3to8[v]
-#define EXPAND_4to8(v) (((v) << 4) |  (v)      )
-#define EXPAND_5to8(v) (((v) << 3) | ((v) >> 2))
-#define EXPAND_6to8(v) (((v) << 2) | ((v) >> 4))
-#define EXPAND_7to8(v) (((v) << 1) | ((v) >> 6))
 
 /**********************************************************************************************************************/
 
@@ -2599,6 +2599,211 @@ static GenefxFunc Sop_PFI_TEX_Kto_Dacc[DFB_NUM_PIXELFORMATS] = {
      [DFB_PIXELFORMAT_INDEX(DSPF_NV61)]       = NULL,
 };
 
+/**********************************************************************************************************************
+ ********************************* Sop_PFI_TEX_filter_to_Dacc *********************************************************
+ **********************************************************************************************************************/
+
+/*
+ * Bilinear texture lookup, sampling at the texel centers and clamping to the edges of the texture.
+ * The weights have 8 bits, the 32 bit formats interpolate two channels at once.
+ */
+#define TEX_FILTER_SETUP()                                               \
+     int u  = s - 0x8000;                                                \
+     int v  = t - 0x8000;                                                \
+     int fx = (u >> 8) & 0xff;                                           \
+     int fy = (v >> 8) & 0xff;                                           \
+     int x0 = CLAMP( u >> 16, 0, sw - 1 );                               \
+     int x1 = CLAMP( (u >> 16) + 1, 0, sw - 1 );                         \
+     int y0 = CLAMP( v >> 16, 0, sh - 1 );                               \
+     int y1 = CLAMP( (v >> 16) + 1, 0, sh - 1 )
+
+static __inline__ u32
+tex_lerp_argb( u32 a,
+               u32 b,
+               int f )
+{
+     u32 rb = (((a & 0x00ff00ff) * (256 - f) + (b & 0x00ff00ff) * f) >> 8) & 0x00ff00ff;
+     u32 ag = (((a >> 8) & 0x00ff00ff) * (256 - f) + ((b >> 8) & 0x00ff00ff) * f) & 0xff00ff00;
+
+     return ag | rb;
+}
+
+static __inline__ u32
+tex_filter_argb( const u32 *S,
+                 int        sp4,
+                 int        s,
+                 int        t,
+                 int        sw,
+                 int        sh )
+{
+     TEX_FILTER_SETUP();
+
+     return tex_lerp_argb( tex_lerp_argb( S[y0*sp4+x0], S[y0*sp4+x1], fx ),
+                           tex_lerp_argb( S[y1*sp4+x0], S[y1*sp4+x1], fx ), fy );
+}
+
+static void
+Sop_argb_TEX_filter_to_Dacc( GenefxState *gfxs )
+{
+     int                s     = gfxs->s;
+     int                t     = gfxs->t;
+     int                w     = gfxs->length + 1;
+     u32               *S     = gfxs->Sop[0];
+     GenefxAccumulator *D     = gfxs->Dacc;
+     int                sp4   = gfxs->src_pitch / 4;
+     int                sw    = gfxs->src_width;
+     int                sh    = gfxs->src_height;
+     int                SperD = gfxs->SperD;
+     int                TperD = gfxs->TperD;
+
+     while (--w) {
+          u32 p = tex_filter_argb( S, sp4, s, t, sw, sh );
+
+          D->RGB.a = p >> 24;
+          D->RGB.r = (p >> 16) & 0xff;
+          D->RGB.g = (p >> 8) & 0xff;
+          D->RGB.b = p & 0xff;
+
+          ++D;
+          s += SperD;
+          t += TperD;
+     }
+}
+
+static void
+Sop_rgb32_TEX_filter_to_Dacc( GenefxState *gfxs )
+{
+     int                s     = gfxs->s;
+     int                t     = gfxs->t;
+     int                w     = gfxs->length + 1;
+     u32               *S     = gfxs->Sop[0];
+     GenefxAccumulator *D     = gfxs->Dacc;
+     int                sp4   = gfxs->src_pitch / 4;
+     int                sw    = gfxs->src_width;
+     int                sh    = gfxs->src_height;
+     int                SperD = gfxs->SperD;
+     int                TperD = gfxs->TperD;
+
+     while (--w) {
+          u32 p = tex_filter_argb( S, sp4, s, t, sw, sh );
+
+          D->RGB.a = 0xff;
+          D->RGB.r = (p >> 16) & 0xff;
+          D->RGB.g = (p >> 8) & 0xff;
+          D->RGB.b = p & 0xff;
+
+          ++D;
+          s += SperD;
+          t += TperD;
+     }
+}
+
+static void
+Sop_rgb16_TEX_filter_to_Dacc( GenefxState *gfxs )
+{
+     int                s     = gfxs->s;
+     int                t     = gfxs->t;
+     int                w     = gfxs->length + 1;
+     u16               *S     = gfxs->Sop[0];
+     GenefxAccumulator *D     = gfxs->Dacc;
+     int                sp2   = gfxs->src_pitch / 2;
+     int                sw    = gfxs->src_width;
+     int                sh    = gfxs->src_height;
+     int                SperD = gfxs->SperD;
+     int                TperD = gfxs->TperD;
+
+     while (--w) {
+          TEX_FILTER_SETUP();
+
+          u32 p = tex_lerp_argb( tex_lerp_argb( RGB16_TO_ARGB( S[y0*sp2+x0] ), RGB16_TO_ARGB( S[y0*sp2+x1] ), fx ),
+                                 tex_lerp_argb( RGB16_TO_ARGB( S[y1*sp2+x0] ), RGB16_TO_ARGB( S[y1*sp2+x1] ), fx ), fy );
+
+          D->RGB.a = 0xff;
+          D->RGB.r = (p >> 16) & 0xff;
+          D->RGB.g = (p >> 8) & 0xff;
+          D->RGB.b = p & 0xff;
+
+          ++D;
+          s += SperD;
+          t += TperD;
+     }
+}
+
+static void
+Sop_a8_TEX_filter_to_Dacc( GenefxState *gfxs )
+{
+     int                s     = gfxs->s;
+     int                t     = gfxs->t;
+     int                w     = gfxs->length + 1;
+     u8                *S     = gfxs->Sop[0];
+     GenefxAccumulator *D     = gfxs->Dacc;
+     int                sp    = gfxs->src_pitch;
+     int                sw    = gfxs->src_width;
+     int                sh    = gfxs->src_height;
+     int                SperD = gfxs->SperD;
+     int                TperD = gfxs->TperD;
+
+     while (--w) {
+          TEX_FILTER_SETUP();
+
+          int a0 = (S[y0*sp+x0] * (256 - fx) + S[y0*sp+x1] * fx) >> 8;
+          int a1 = (S[y1*sp+x0] * (256 - fx) + S[y1*sp+x1] * fx) >> 8;
+
+          D->RGB.a = (a0 * (256 - fy) + a1 * fy) >> 8;
+          D->RGB.r = 0xff;
+          D->RGB.g = 0xff;
+          D->RGB.b = 0xff;
+
+          ++D;
+          s += SperD;
+          t += TperD;
+     }
+}
+
+static GenefxFunc Sop_PFI_TEX_filter_to_Dacc[DFB_NUM_PIXELFORMATS] = {
+     [DFB_PIXELFORMAT_INDEX(DSPF_ARGB1555)]   = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGB16)]      = Sop_rgb16_TEX_filter_to_Dacc,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGB24)]      = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGB32)]      = Sop_rgb32_TEX_filter_to_Dacc,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ARGB)]       = Sop_argb_TEX_filter_to_Dacc,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ABGR)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_A8)]         = Sop_a8_TEX_filter_to_Dacc,
+     [DFB_PIXELFORMAT_INDEX(DSPF_YUY2)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGB332)]     = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_UYVY)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_I420)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_YV12)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_LUT8)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ALUT44)]     = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_AiRGB)]      = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_A1)]         = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_NV12)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_NV16)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ARGB2554)]   = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ARGB4444)]   = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGBA4444)]   = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_NV21)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_AYUV)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_A4)]         = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ARGB1666)]   = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ARGB6666)]   = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGB18)]      = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_LUT1)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_LUT2)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGB444)]     = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGB555)]     = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_BGR555)]     = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGBA5551)]   = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_YUV444P)]    = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ARGB8565)]   = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGBAF88871)] = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_AVYU)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_VYU)]        = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_A1_LSB)]     = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_YV16)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_NV61)]       = NULL,
+};
+
 /**********************************************************************************************************************
  ********************************* Sacc_to_Aop_PFI ********************************************************************
  **********************************************************************************************************************/
@@ -5891,6 +6096,102 @@ static GenefxFunc Bop_PFI_TEX_to_Aop_PFI[DFB_NUM_PIXELFORMATS] = {
      [DFB_PIXELFORMAT_INDEX(DSPF_NV61)]       = NULL,
 };
 
+/**********************************************************************************************************************
+ ********************************* Bop_argb_blend_alphachannel_*_Aop_PFI (fused) **************************************
+ **********************************************************************************************************************/
+
+/* ARGB */
+#define DST_TYPE u32
+#define DST_LOAD(d,a,r,g,b)  \
+do {                         \
+     a =  (d) >> 24;         \
+     r = ((d) >> 16) & 0xff; \
+     g = ((d) >>  8) & 0xff; \
+     b =  (d)        & 0xff; \
+} while (0)
+#define DST_STORE(a,r,g,b) PIXEL_ARGB( a, r, g, b )
+#define DST_KEEP(d)
+
+#define FUSED_FUNC Bop_argb_blend_alphachannel_src_invsrc_Aop_argb
+#define FUSED_SRCALPHA
+#include "template_blend_argb.h"
+
+#define FUSED_FUNC Bop_argb_blend_alphachannel_colorize_src_invsrc_Aop_argb
+#define FUSED_COLORIZE
+#define FUSED_SRCALPHA
+#include "template_blend_argb.h"
+
+#define FUSED_FUNC Bop_argb_blend_alphachannel_colorize_one_invsrc_premultiply_Aop_argb
+#define FUSED_COLORIZE
+#define FUSED_PREMULTIPLY
+#include "template_blend_argb.h"
+
+#undef DST_TYPE
+#undef DST_LOAD
+#undef DST_STORE
+#undef DST_KEEP
+
+/* RGB32 */
+#define DST_TYPE u32
+#define DST_LOAD(d,a,r,g,b)  \
+do {                         \
+     a = 0xff;               \
+     r = ((d) >> 16) & 0xff; \
+     g = ((d) >>  8) & 0xff; \
+     b =  (d)        & 0xff; \
+} while (0)
+#define DST_STORE(a,r,g,b) PIXEL_RGB32( r, g, b )
+#define DST_KEEP(d) (d) |= 0xff000000
+
+#define FUSED_FUNC Bop_argb_blend_alphachannel_colorize_src_invsrc_Aop_rgb32
+#define FUSED_COLORIZE
+#define FUSED_SRCALPHA
+#include "template_blend_argb.h"
+
+#define FUSED_FUNC Bop_argb_blend_alphachannel_colorize_one_invsrc_premultiply_Aop_rgb32
+#define FUSED_COLORIZE
+#define FUSED_PREMULTIPLY
+#include "template_blend_argb.h"
+
+#undef DST_TYPE
+#undef DST_LOAD
+#undef DST_STORE
+#undef DST_KEEP
+
+/* RGB16 */
+#define DST_TYPE u16
+#define DST_LOAD(d,a,r,g,b)                  \
+do {                                         \
+     a = 0xff;                               \
+     r = EXPAND_5to8(  (d) >> 11         );  \
+     g = EXPAND_6to8( ((d) >>  5) & 0x3f );  \
+     b = EXPAND_5to8(  (d)        & 0x1f );  \
+} while (0)
+#define DST_STORE(a,r,g,b) PIXEL_RGB16( r, g, b )
+#define DST_KEEP(d)
+
+#define FUSED_FUNC Bop_argb_blend_alphachannel_one_invsrc_Aop_rgb16
+#include "template_blend_argb.h"
+
+#define FUSED_FUNC Bop_argb_blend_alphachannel_one_invsrc_premultiply_Aop_rgb16
+#define FUSED_PREMULTIPLY
+#include "template_blend_argb.h"
+
+#define FUSED_FUNC Bop_argb_blend_alphachannel_colorize_src_invsrc_Aop_rgb16
+#define FUSED_COLORIZE
+#define FUSED_SRCALPHA
+#include "template_blend_argb.h"
+
+#define FUSED_FUNC Bop_argb_blend_alphachannel_colorize_one_invsrc_premultiply_Aop_rgb16
+#define FUSED_COLORIZE
+#define FUSED_PREMULTIPLY
+#include "template_blend_argb.h"
+
+#undef DST_TYPE
+#undef DST_LOAD
+#undef DST_STORE
+#undef DST_KEEP
+
 /**********************************************************************************************************************
  ********************************* Bop_argb_blend_alphachannel_src_invsrc_Aop_PFI *************************************
  **********************************************************************************************************************/
@@ -6000,7 +6301,7 @@ static GenefxFunc Bop_argb_blend_alphachannel_src_invsrc_Aop_PFI[DFB_NUM_PIXELFO
      [DFB_PIXELFORMAT_INDEX(DSPF_RGB16)]      = Bop_argb_blend_alphachannel_src_invsrc_Aop_rgb16,
      [DFB_PIXELFORMAT_INDEX(DSPF_RGB24)]      = NULL,
      [DFB_PIXELFORMAT_INDEX(DSPF_RGB32)]      = Bop_argb_blend_alphachannel_src_invsrc_Aop_rgb32,
-     [DFB_PIXELFORMAT_INDEX(DSPF_ARGB)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ARGB)]       = Bop_argb_blend_alphachannel_src_invsrc_Aop_argb,
      [DFB_PIXELFORMAT_INDEX(DSPF_ABGR)]       = NULL,
      [DFB_PIXELFORMAT_INDEX(DSPF_A8)]         = NULL,
      [DFB_PIXELFORMAT_INDEX(DSPF_YUY2)]       = NULL,
@@ -6079,7 +6380,7 @@ Bop_argb_blend_alphachannel_one_invsrc_Aop_argb( GenefxState *gfxs )
 
 static GenefxFunc Bop_argb_blend_alphachannel_one_invsrc_Aop_PFI[DFB_NUM_PIXELFORMATS] = {
      [DFB_PIXELFORMAT_INDEX(DSPF_ARGB1555)]   = NULL,
-     [DFB_PIXELFORMAT_INDEX(DSPF_RGB16)]      = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGB16)]      = Bop_argb_blend_alphachannel_one_invsrc_Aop_rgb16,
      [DFB_PIXELFORMAT_INDEX(DSPF_RGB24)]      = NULL,
      [DFB_PIXELFORMAT_INDEX(DSPF_RGB32)]      = Bop_argb_blend_alphachannel_one_invsrc_Aop_argb,
      [DFB_PIXELFORMAT_INDEX(DSPF_ARGB)]       = Bop_argb_blend_alphachannel_one_invsrc_Aop_argb,
@@ -6165,7 +6466,7 @@ Bop_argb_blend_alphachannel_one_invsrc_premultiply_Aop_argb( GenefxState *gfxs )
 
 static GenefxFunc Bop_argb_blend_alphachannel_one_invsrc_premultiply_Aop_PFI[DFB_NUM_PIXELFORMATS] = {
      [DFB_PIXELFORMAT_INDEX(DSPF_ARGB1555)]   = NULL,
-     [DFB_PIXELFORMAT_INDEX(DSPF_RGB16)]      = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGB16)]      = Bop_argb_blend_alphachannel_one_invsrc_premultiply_Aop_rgb16,
      [DFB_PIXELFORMAT_INDEX(DSPF_RGB24)]      = NULL,
      [DFB_PIXELFORMAT_INDEX(DSPF_RGB32)]      = Bop_argb_blend_alphachannel_one_invsrc_premultiply_Aop_argb,
      [DFB_PIXELFORMAT_INDEX(DSPF_ARGB)]       = Bop_argb_blend_alphachannel_one_invsrc_premultiply_Aop_argb,
@@ -6207,6 +6508,177 @@ static GenefxFunc Bop_argb_blend_alphachannel_one_invsrc_premultiply_Aop_PFI[DFB
      [DFB_PIXELFORMAT_INDEX(DSPF_NV61)]       = NULL,
 };
 
+static GenefxFunc Bop_argb_blend_alphachannel_colorize_src_invsrc_Aop_PFI[DFB_NUM_PIXELFORMATS] = {
+     [DFB_PIXELFORMAT_INDEX(DSPF_ARGB1555)]   = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGB16)]      = Bop_argb_blend_alphachannel_colorize_src_invsrc_Aop_rgb16,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGB24)]      = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGB32)]      = Bop_argb_blend_alphachannel_colorize_src_invsrc_Aop_rgb32,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ARGB)]       = Bop_argb_blend_alphachannel_colorize_src_invsrc_Aop_argb,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ABGR)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_A8)]         = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_YUY2)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGB332)]     = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_UYVY)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_I420)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_YV12)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_LUT8)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ALUT44)]     = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_AiRGB)]      = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_A1)]         = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_NV12)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_NV16)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ARGB2554)]   = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ARGB4444)]   = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGBA4444)]   = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_NV21)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_AYUV)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_A4)]         = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ARGB1666)]   = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ARGB6666)]   = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGB18)]      = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_LUT1)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_LUT2)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGB444)]     = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGB555)]     = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_BGR555)]     = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGBA5551)]   = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_YUV444P)]    = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ARGB8565)]   = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGBAF88871)] = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_AVYU)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_VYU)]        = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_A1_LSB)]     = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_YV16)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_NV61)]       = NULL,
+};
+
+static GenefxFunc Bop_argb_blend_alphachannel_colorize_one_invsrc_premultiply_Aop_PFI[DFB_NUM_PIXELFORMATS] = {
+     [DFB_PIXELFORMAT_INDEX(DSPF_ARGB1555)]   = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGB16)]      = Bop_argb_blend_alphachannel_colorize_one_invsrc_premultiply_Aop_rgb16,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGB24)]      = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGB32)]      = Bop_argb_blend_alphachannel_colorize_one_invsrc_premultiply_Aop_rgb32,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ARGB)]       = Bop_argb_blend_alphachannel_colorize_one_invsrc_premultiply_Aop_argb,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ABGR)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_A8)]         = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_YUY2)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGB332)]     = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_UYVY)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_I420)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_YV12)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_LUT8)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ALUT44)]     = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_AiRGB)]      = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_A1)]         = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_NV12)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_NV16)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ARGB2554)]   = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ARGB4444)]   = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGBA4444)]   = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_NV21)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_AYUV)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_A4)]         = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ARGB1666)]   = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ARGB6666)]   = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGB18)]      = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_LUT1)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_LUT2)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGB444)]     = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGB555)]     = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_BGR555)]     = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGBA5551)]   = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_YUV444P)]    = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ARGB8565)]   = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGBAF88871)] = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_AVYU)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_VYU)]        = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_A1_LSB)]     = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_YV16)]       = NULL,
+     [DFB_PIXELFORMAT_INDEX(DSPF_NV61)]       = NULL,
+};
+
+/**********************************************************************************************************************
+ ********************************* Bop_argb_runs_to_Aop ***************************************************************
+ **********************************************************************************************************************/
+
+/* shorter runs of transparent or opaque pixels are blended along with their neighbours */
+#define ALPHA_RUN_MIN 8
+
+static __inline__ void
+run_span( GenefxState *gfxs,
+          GenefxFunc  *funcs,
+          int          offset,
+          int          length )
+{
+     u8  *Aop = gfxs->Aop[0];
+     u8  *Bop = gfxs->Bop[0];
+     int  w   = gfxs->length;
+
+     gfxs->Aop[0] = Aop + offset * gfxs->dst_bpp;
+     gfxs->Bop[0] = Bop + offset * 4;
+     gfxs->length = length;
+
+     for (; *funcs; funcs++)
+          (*funcs)( gfxs );
+
+     gfxs->Aop[0] = Aop;
+     gfxs->Bop[0] = Bop;
+     gfxs->length = w;
+}
+
+/*
+ * Split the span of an alpha blended ARGB source into runs: transparent runs leave the destination unchanged and are
+ * skipped, opaque runs are copied or converted, only the remaining pixels are blended.
+ */
+static void
+Bop_argb_runs_to_Aop( GenefxState *gfxs )
+{
+     int        w     = gfxs->length;
+     const u32 *S     = gfxs->Bop[0];
+     u32        mask  = gfxs->run_zero ? 0xffffffff : 0xff000000;
+     int        start = 0;
+     int        i     = 0;
+
+     if (gfxs->Astep != 1) {
+          run_span( gfxs, gfxs->run_funcs, 0, w );
+          return;
+     }
+
+     while (i < w) {
+          u32 s = S[i];
+          int n = i + 1;
+
+          if (!(s & mask)) {
+               while (n < w && !(S[n] & mask))
+                    n++;
+
+               if (n - i >= ALPHA_RUN_MIN) {
+                    if (start < i)
+                         run_span( gfxs, gfxs->run_funcs, start, i - start );
+
+                    start = n;
+               }
+          }
+          else if (s >= 0xff000000) {
+               while (n < w && S[n] >= 0xff000000)
+                    n++;
+
+               if (n - i >= ALPHA_RUN_MIN) {
+                    if (start < i)
+                         run_span( gfxs, gfxs->run_funcs, start, i - start );
+
+                    run_span( gfxs, gfxs->run_opaque, i, n - i );
+
+                    start = n;
+               }
+          }
+
+          i = n;
+     }
+
+     if (start < w)
+          run_span( gfxs, gfxs->run_funcs, start, w - start );
+}
+
 /**********************************************************************************************************************
  ********************************* Bop_a8_set_alphapixel_Aop_PFI ******************************************************
  **********************************************************************************************************************/
@@ -8465,6 +8937,40 @@ static GenefxFunc Dacc_demultiply = Dacc_demultiply_C;
 
 /**********************************************************************************************************************/
 
+static __inline__ u16
+colormatrix_clamp( s64 value )
+{
+     value >>= 16;
+
+     return (value < 0) ? 0 : (value > 0xff) ? 0xff : value;
+}
+
+static void
+Dacc_colormatrix_C( GenefxState *gfxs )
+{
+     int                w = gfxs->length + 1;
+     GenefxAccumulator *D = gfxs->Dacc;
+     const s32         *m = gfxs->colormatrix;
+
+     while (--w) {
+          if (!(D->RGB.a & 0xf000)) {
+               s64 r = D->RGB.r;
+               s64 g = D->RGB.g;
+               s64 b = D->RGB.b;
+
+               D->RGB.r = colormatrix_clamp( r * m[0] + g * m[1] + b * m[2]  + m[3]  + 0x8000 );
+               D->RGB.g = colormatrix_clamp( r * m[4] + g * m[5] + b * m[6]  + m[7]  + 0x8000 );
+               D->RGB.b = colormatrix_clamp( r * m[8] + g * m[9] + b * m[10] + m[11] + 0x8000 );
+          }
+
+          ++D;
+     }
+}
+
+static GenefxFunc Dacc_colormatrix = Dacc_colormatrix_C;
+
+/**********************************************************************************************************************/
+
 static void
 Dacc_xor_C( GenefxState *gfxs )
 {
@@ -8835,6 +9341,82 @@ gInit_MMX()
 
 #endif
 
+static int use_sse = 0;
+
+#ifdef USE_SSE
+
+#include "generic_sse.h"
+
+/*
+ * patches function pointers to SSE2 functions
+ */
+static void
+gInit_SSE2()
+{
+     use_sse = 2;
+
+/********************************* Sop_PFI_to_Dacc ****************************/
+     Sop_PFI_to_Dacc[DFB_PIXELFORMAT_INDEX(DSPF_ARGB)]  = Sop_argb_to_Dacc_SSE2;
+     Sop_PFI_to_Dacc[DFB_PIXELFORMAT_INDEX(DSPF_RGB32)] = Sop_rgb32_to_Dacc_SSE2;
+/********************************* Sop_PFI_TEX_filter_to_Dacc *****************/
+     Sop_PFI_TEX_filter_to_Dacc[DFB_PIXELFORMAT_INDEX(DSPF_ARGB)]  = Sop_argb_TEX_filter_to_Dacc_SSE2;
+     Sop_PFI_TEX_filter_to_Dacc[DFB_PIXELFORMAT_INDEX(DSPF_RGB32)] = Sop_rgb32_TEX_filter_to_Dacc_SSE2;
+/********************************* Sacc_to_Aop_PFI ****************************/
+     Sacc_to_Aop_PFI[DFB_PIXELFORMAT_INDEX(DSPF_ARGB)]  = Sacc_to_Aop_argb_SSE2;
+     Sacc_to_Aop_PFI[DFB_PIXELFORMAT_INDEX(DSPF_RGB32)] = Sacc_to_Aop_rgb32_SSE2;
+/********************************* Xacc_blend *********************************/
+     Xacc_blend[DSBF_SRCALPHA-1]    = Xacc_blend_srcalpha_SSE2;
+     Xacc_blend[DSBF_INVSRCALPHA-1] = Xacc_blend_invsrcalpha_SSE2;
+/********************************* Dacc_modulation ****************************/
+     Dacc_modulation[DSBLIT_BLEND_ALPHACHANNEL | DSBLIT_BLEND_COLORALPHA]                   = Dacc_modulate_alpha_SSE2;
+     Dacc_modulation[DSBLIT_COLORIZE]                                                       = Dacc_modulate_rgb_SSE2;
+     Dacc_modulation[DSBLIT_COLORIZE | DSBLIT_BLEND_ALPHACHANNEL]                           = Dacc_modulate_rgb_SSE2;
+     Dacc_modulation[DSBLIT_COLORIZE | DSBLIT_BLEND_ALPHACHANNEL | DSBLIT_BLEND_COLORALPHA] = Dacc_modulate_argb_SSE2;
+/********************************* Misc accumulator operations ****************/
+     Dacc_premultiply  = Dacc_premultiply_SSE2;
+     Dacc_colormatrix  = Dacc_colormatrix_SSE2;
+     SCacc_add_to_Dacc = SCacc_add_to_Dacc_SSE2;
+     Sacc_add_to_Dacc  = Sacc_add_to_Dacc_SSE2;
+/********************************* Glyph runs *********************************/
+     Genefx_Glyphs_init_SSE2();
+}
+
+/*
+ * patches function pointers to AVX2 functions
+ */
+static void
+gInit_AVX2()
+{
+     use_sse = 3;
+
+/********************************* Sop_PFI_to_Dacc ****************************/
+     Sop_PFI_to_Dacc[DFB_PIXELFORMAT_INDEX(DSPF_ARGB)]  = Sop_argb_to_Dacc_AVX2;
+     Sop_PFI_to_Dacc[DFB_PIXELFORMAT_INDEX(DSPF_RGB32)] = Sop_rgb32_to_Dacc_AVX2;
+/********************************* Sop_PFI_TEX_filter_to_Dacc *****************/
+     Sop_PFI_TEX_filter_to_Dacc[DFB_PIXELFORMAT_INDEX(DSPF_ARGB)]  = Sop_argb_TEX_filter_to_Dacc_SSE2;
+     Sop_PFI_TEX_filter_to_Dacc[DFB_PIXELFORMAT_INDEX(DSPF_RGB32)] = Sop_rgb32_TEX_filter_to_Dacc_SSE2;
+/********************************* Sacc_to_Aop_PFI ****************************/
+     Sacc_to_Aop_PFI[DFB_PIXELFORMAT_INDEX(DSPF_ARGB)]  = Sacc_to_Aop_argb_AVX2;
+     Sacc_to_Aop_PFI[DFB_PIXELFORMAT_INDEX(DSPF_RGB32)] = Sacc_to_Aop_rgb32_AVX2;
+/********************************* Xacc_blend *********************************/
+     Xacc_blend[DSBF_SRCALPHA-1]    = Xacc_blend_srcalpha_AVX2;
+     Xacc_blend[DSBF_INVSRCALPHA-1] = Xacc_blend_invsrcalpha_AVX2;
+/********************************* Dacc_modulation ****************************/
+     Dacc_modulation[DSBLIT_BLEND_ALPHACHANNEL | DSBLIT_BLEND_COLORALPHA]                   = Dacc_modulate_alpha_AVX2;
+     Dacc_modulation[DSBLIT_COLORIZE]                                                       = Dacc_modulate_rgb_AVX2;
+     Dacc_modulation[DSBLIT_COLORIZE | DSBLIT_BLEND_ALPHACHANNEL]                           = Dacc_modulate_rgb_AVX2;
+     Dacc_modulation[DSBLIT_COLORIZE | DSBLIT_BLEND_ALPHACHANNEL | DSBLIT_BLEND_COLORALPHA] = Dacc_modulate_argb_AVX2;
+/********************************* Misc accumulator operations ****************/
+     Dacc_premultiply  = Dacc_premultiply_AVX2;
+     Dacc_colormatrix  = Dacc_colormatrix_SSE2;
+     SCacc_add_to_Dacc = SCacc_add_to_Dacc_AVX2;
+     Sacc_add_to_Dacc  = Sacc_add_to_Dacc_AVX2;
+/********************************* Glyph runs *********************************/
+     Genefx_Glyphs_init_SSE2();
+}
+
+#endif
+
 #if SIZEOF_LONG == 8
 
 #include "generic_64.h"
@@ -8932,6 +9514,26 @@ gGetDriverInfo( GraphicsDriverInfo *info )
      }
 #endif
 
+#ifdef USE_SSE
+     if (!dfb_config->sse) {
+          D_INFO( "DirectFB/Genefx: SSE disabled by option 'no-sse'\n" );
+     }
+     else if (__builtin_cpu_supports( "avx2" )) {
+          gInit_AVX2();
+
+          snprintf( info->name, DFB_GRAPHICS_DRIVER_INFO_NAME_LENGTH, "AVX2 Software Driver" );
+
+          D_INFO( "DirectFB/Genefx: AVX2 enabled\n" );
+     }
+     else if (__builtin_cpu_supports( "sse2" )) {
+          gInit_SSE2();
+
+          snprintf( info->name, DFB_GRAPHICS_DRIVER_INFO_NAME_LENGTH, "SSE2 Software Driver" );
+
+          D_INFO( "DirectFB/Genefx: SSE2 enabled\n" );
+     }
+#endif
+
      snprintf( info->vendor, DFB_GRAPHICS_DRIVER_INFO_VENDOR_LENGTH, "DirectFB" );
 
      info->version.major = 0;
@@ -8943,7 +9545,8 @@ gGetDeviceInfo( GraphicsDeviceInfo *info )
 {
      snprintf( info->name, DFB_GRAPHICS_DEVICE_INFO_NAME_LENGTH, "Software Rasterizer" );
 
-     snprintf( info->vendor, DFB_GRAPHICS_DEVICE_INFO_VENDOR_LENGTH, use_mmx ? "MMX" : "Generic" );
+     snprintf( info->vendor, DFB_GRAPHICS_DEVICE_INFO_VENDOR_LENGTH,
+               use_sse == 3 ? "AVX2" : use_sse == 2 ? "SSE2" : use_mmx ? "MMX" : "Generic" );
 
      info->caps.flags    = 0;
      info->caps.accel    = DFXL_NONE;
@@ -9107,6 +9710,184 @@ gAcquireUnlockBuffers( CardState *state )
      return DFB_OK;
 }
 
+static unsigned int pipeline_cache_hits   = 0;
+static unsigned int pipeline_cache_misses = 0;
+
+static bool
+gPipelineKey( CardState           *state,
+              DFBAccelerationMask  accel,
+              GenefxPipelineKey   *key,
+              unsigned int        *ret_hash )
+{
+     const u8     *bytes = (const u8*) key;
+     unsigned int  hash  = 2166136261u;
+     unsigned int  i;
+
+     memset( key, 0, sizeof(GenefxPipelineKey) );
+
+     key->accel      = accel;
+     key->src_blend  = state->src_blend;
+     key->dst_blend  = state->dst_blend;
+     key->color      = state->color;
+     key->dst_format = state->destination->config.format;
+
+     /* Palettes and index translation tables are not part of the key. */
+     if (DFB_PIXELFORMAT_IS_INDEXED( key->dst_format ))
+          return false;
+
+     if (DFB_BLITTING_FUNCTION( accel )) {
+          key->blittingflags = state->blittingflags;
+          key->src_colorkey  = state->src_colorkey;
+          key->src_format    = state->source->config.format;
+
+          if (DFB_PIXELFORMAT_IS_INDEXED( key->src_format ))
+               return false;
+
+          /* The convolution filter is kept outside of the pipeline. */
+          if (state->blittingflags & DSBLIT_SRC_CONVOLUTION)
+               return false;
+
+          if (state->blittingflags & (DSBLIT_SRC_MASK_ALPHA | DSBLIT_SRC_MASK_COLOR))
+               key->mask_format = state->source_mask->config.format;
+
+          /* Texture lookups are filtered with smooth scaling. */
+          if (accel == DFXL_TEXTRIANGLES)
+               key->render_options = state->render_options & (DSRO_SMOOTH_UPSCALE | DSRO_SMOOTH_DOWNSCALE);
+     }
+     else
+          key->drawingflags = state->drawingflags;
+
+     key->dst_colorkey = state->dst_colorkey;
+
+     /* FNV-1a */
+     for (i = 0; i < sizeof(GenefxPipelineKey); i++)
+          hash = (hash ^ bytes[i]) * 16777619u;
+
+     *ret_hash = hash ?: 1;
+
+     return true;
+}
+
+static bool
+gPipelineLookup( GenefxState             *gfxs,
+                 const GenefxPipelineKey *key,
+                 unsigned int             hash )
+{
+     int i;
+
+     for (i = 0; i < GENEFX_PIPELINE_CACHE_SIZE; i++) {
+          GenefxPipeline *pipeline = &gfxs->pipelines[i];
+
+          if (pipeline->hash == hash && !memcmp( &pipeline->key, key, sizeof(GenefxPipelineKey) )) {
+               direct_memcpy( gfxs->funcs, pipeline->funcs, sizeof(gfxs->funcs) );
+
+               gfxs->Cop              = pipeline->Cop;
+               gfxs->Dkey             = pipeline->Dkey;
+               gfxs->Skey             = pipeline->Skey;
+               gfxs->Cacc             = pipeline->Cacc;
+               gfxs->SCacc            = pipeline->SCacc;
+               gfxs->need_accumulator = pipeline->need_accumulator;
+
+               if (pipeline->funcs[0] == Bop_argb_runs_to_Aop) {
+                    direct_memcpy( gfxs->run_funcs, pipeline->run_funcs, sizeof(gfxs->run_funcs) );
+                    direct_memcpy( gfxs->run_opaque, pipeline->run_opaque, sizeof(gfxs->run_opaque) );
+
+                    gfxs->run_zero = pipeline->run_zero;
+               }
+
+               if (pipeline->Sop_is_Bop)
+                    gfxs->Sop = gfxs->Bop;
+
+               D_SYNC_ADD_AND_FETCH( &pipeline_cache_hits, 1 );
+
+               return true;
+          }
+     }
+
+     D_SYNC_ADD_AND_FETCH( &pipeline_cache_misses, 1 );
+
+     return false;
+}
+
+static void
+gPipelineStore( GenefxState             *gfxs,
+                const GenefxPipelineKey *key,
+                unsigned int             hash )
+{
+     GenefxPipeline *pipeline = &gfxs->pipelines[gfxs->next_pipeline];
+
+     gfxs->next_pipeline = (gfxs->next_pipeline + 1) % GENEFX_PIPELINE_CACHE_SIZE;
+
+     pipeline->hash = hash;
+     pipeline->key  = *key;
+
+     direct_memcpy( pipeline->funcs, gfxs->funcs, sizeof(gfxs->funcs) );
+
+     pipeline->Cop              = gfxs->Cop;
+     pipeline->Dkey             = gfxs->Dkey;
+     pipeline->Skey             = gfxs->Skey;
+     pipeline->Cacc             = gfxs->Cacc;
+     pipeline->SCacc            = gfxs->SCacc;
+     pipeline->need_accumulator = gfxs->need_accumulator;
+     pipeline->Sop_is_Bop       = gfxs->Sop == gfxs->Bop;
+
+     if (gfxs->funcs[0] == Bop_argb_runs_to_Aop) {
+          direct_memcpy( pipeline->run_funcs, gfxs->run_funcs, sizeof(gfxs->run_funcs) );
+          direct_memcpy( pipeline->run_opaque, gfxs->run_opaque, sizeof(gfxs->run_opaque) );
+
+          pipeline->run_zero = gfxs->run_zero;
+     }
+}
+
+/*
+ * Wrap the blending pipeline of an ARGB source into Bop_argb_runs_to_Aop if transparent pixels leave the destination
+ * unchanged and opaque pixels are written as they are.
+ */
+static void
+gSetupAlphaRuns( GenefxState             *gfxs,
+                 CardState               *state,
+                 DFBSurfaceBlittingFlags  blittingflags )
+{
+     GenefxFunc *funcs   = gfxs->run_opaque;
+     int         dst_pfi = DFB_PIXELFORMAT_INDEX( gfxs->dst_format );
+
+     if (gfxs->src_format != DSPF_ARGB || state->dst_blend != DSBF_INVSRCALPHA)
+          return;
+
+     if (blittingflags == DSBLIT_BLEND_ALPHACHANNEL && state->src_blend == DSBF_SRCALPHA)
+          gfxs->run_zero = false;
+     else if (blittingflags == DSBLIT_BLEND_ALPHACHANNEL && state->src_blend == DSBF_ONE)
+          gfxs->run_zero = true;
+     else if (blittingflags == (DSBLIT_BLEND_ALPHACHANNEL | DSBLIT_SRC_PREMULTIPLY) && state->src_blend == DSBF_ONE)
+          gfxs->run_zero = false;
+     else
+          return;
+
+     if (is_ycbcr[dst_pfi] || DFB_PIXELFORMAT_IS_INDEXED( gfxs->dst_format ) || !gfxs->dst_bpp ||
+         DFB_PLANAR_PIXELFORMAT( gfxs->dst_format ) || !Sacc_to_Aop_PFI[dst_pfi])
+          return;
+
+     if (gfxs->dst_format == DSPF_ARGB || gfxs->dst_format == DSPF_RGB32) {
+          *funcs++ = Bop_PFI_to_Aop_PFI[dst_pfi];
+     }
+     else {
+          *funcs++ = Sop_is_Bop;
+          *funcs++ = Dacc_is_Bacc;
+          *funcs++ = Sop_PFI_to_Dacc[DFB_PIXELFORMAT_INDEX(DSPF_ARGB)];
+          *funcs++ = Sacc_is_Bacc;
+          *funcs++ = Sacc_to_Aop_PFI[dst_pfi];
+
+          gfxs->need_accumulator = true;
+     }
+
+     *funcs = NULL;
+
+     direct_memcpy( gfxs->run_funcs, gfxs->funcs, sizeof(gfxs->run_funcs) );
+
+     gfxs->funcs[0] = Bop_argb_runs_to_Aop;
+     gfxs->funcs[1] = NULL;
+}
+
 static bool
 gAcquireSetup( CardState           *state,
                DFBAccelerationMask  accel )
@@ -9123,6 +9904,9 @@ gAcquireSetup( CardState           *state,
      bool                     dst_ycbcr            = false;
      DFBSurfaceBlittingFlags  simpld_blittingflags = state->blittingflags;
      u16                      ca;
+     GenefxPipelineKey        key;
+     unsigned int             hash                 = 0;
+     bool                     cacheable;
 
      dfb_simplify_blittingflags( &simpld_blittingflags );
 
@@ -9187,6 +9971,7 @@ gAcquireSetup( CardState           *state,
           CoreSurface *source_mask = state->source_mask;
 
           gfxs->src_caps         = source->config.caps;
+          gfxs->src_width        = source->config.size.w;
           gfxs->src_height       = source->config.size.h;
           gfxs->src_format       = source->config.format;
           gfxs->src_bpp          = DFB_BYTES_PER_PIXEL( gfxs->src_format );
@@ -9275,6 +10060,10 @@ gAcquireSetup( CardState           *state,
 
      gfxs->color = color;
 
+     /* The matrix is read by the pipeline, it is not part of the cached setup. */
+     if (DFB_BLITTING_FUNCTION( accel ) && (simpld_blittingflags & DSBLIT_SRC_COLORMATRIX))
+          direct_memcpy( gfxs->colormatrix, state->src_colormatrix, sizeof(gfxs->colormatrix) );
+
      switch (gfxs->dst_format) {
           case DSPF_ARGB1555:
                gfxs->Cop = PIXEL_ARGB1555( color.a, color.r, color.g, color.b );
@@ -9482,10 +10271,19 @@ gAcquireSetup( CardState           *state,
 
      src_ycbcr = is_ycbcr[DFB_PIXELFORMAT_INDEX(gfxs->src_format)];
 
-     gfxs->need_accumulator = true;
-
      gfxs->Astep = gfxs->Bstep = gfxs->Ostep = 1;
 
+     /* Reuse the pipeline if the state matches a previous setup. */
+     cacheable = gPipelineKey( state, accel, &key, &hash );
+
+     if (cacheable && gPipelineLookup( gfxs, &key, hash )) {
+          dfb_state_update( state, state->flags & CSF_SOURCE_LOCKED );
+
+          return true;
+     }
+
+     gfxs->need_accumulator = true;
+
      switch (accel) {
           case DFXL_FILLRECTANGLE:
           case DFXL_DRAWRECTANGLE:
@@ -9719,6 +10517,30 @@ gAcquireSetup( CardState           *state,
                          break;
                     }
                }
+               if (simpld_blittingflags == (DSBLIT_COLORIZE | DSBLIT_BLEND_ALPHACHANNEL) &&
+                   state->src_blend == DSBF_SRCALPHA &&
+                   state->dst_blend == DSBF_INVSRCALPHA) {
+                    if (gfxs->src_format == DSPF_ARGB &&
+                        Bop_argb_blend_alphachannel_colorize_src_invsrc_Aop_PFI[dst_pfi]) {
+                         gfxs->Cacc.RGB.r = color.r + 1;
+                         gfxs->Cacc.RGB.g = color.g + 1;
+                         gfxs->Cacc.RGB.b = color.b + 1;
+                         *funcs++ = Bop_argb_blend_alphachannel_colorize_src_invsrc_Aop_PFI[dst_pfi];
+                         break;
+                    }
+               }
+               if (simpld_blittingflags == (DSBLIT_COLORIZE | DSBLIT_BLEND_ALPHACHANNEL | DSBLIT_SRC_PREMULTIPLY) &&
+                   state->src_blend == DSBF_ONE &&
+                   state->dst_blend == DSBF_INVSRCALPHA) {
+                    if (gfxs->src_format == DSPF_ARGB &&
+                        Bop_argb_blend_alphachannel_colorize_one_invsrc_premultiply_Aop_PFI[dst_pfi]) {
+                         gfxs->Cacc.RGB.r = color.r + 1;
+                         gfxs->Cacc.RGB.g = color.g + 1;
+                         gfxs->Cacc.RGB.b = color.b + 1;
+                         *funcs++ = Bop_argb_blend_alphachannel_colorize_one_invsrc_premultiply_Aop_PFI[dst_pfi];
+                         break;
+                    }
+               }
                if (((simpld_blittingflags == (DSBLIT_COLORIZE | DSBLIT_BLEND_ALPHACHANNEL | DSBLIT_SRC_PREMULTIPLY) &&
                      state->src_blend == DSBF_ONE) ||
                     (simpld_blittingflags == (DSBLIT_COLORIZE | DSBLIT_BLEND_ALPHACHANNEL) &&
@@ -9754,9 +10576,16 @@ gAcquireSetup( CardState           *state,
                /* fall through */
           case DFXL_TEXTRIANGLES:
           case DFXL_STRETCHBLIT: {
-               int modulation = simpld_blittingflags & MODULATION_FLAGS;
+               int  modulation  = simpld_blittingflags & MODULATION_FLAGS;
+               bool convolution = accel == DFXL_BLIT && (simpld_blittingflags & DSBLIT_SRC_CONVOLUTION);
+               bool filter      = accel == DFXL_TEXTRIANGLES && !(simpld_blittingflags & DSBLIT_SRC_COLORKEY) &&
+                                  (state->render_options & (DSRO_SMOOTH_UPSCALE | DSRO_SMOOTH_DOWNSCALE)) &&
+                                  Sop_PFI_TEX_filter_to_Dacc[src_pfi];
 
                if (modulation                                                                   ||
+                   convolution                                                                  ||
+                   filter                                                                       ||
+                   (simpld_blittingflags & DSBLIT_SRC_COLORMATRIX)                              ||
                    (accel == DFXL_TEXTRIANGLES && (src_pfi != dst_pfi || simpld_blittingflags)) ||
                    (simpld_blittingflags & (DSBLIT_SRC_MASK_ALPHA | DSBLIT_SRC_MASK_COLOR))     ||
                    ((simpld_blittingflags & DSBLIT_ROTATE90) && accel == DFXL_STRETCHBLIT)) {
@@ -9815,10 +10644,18 @@ gAcquireSetup( CardState           *state,
 
                               *funcs++ = Sop_PFI_TEX_Kto_Dacc[src_pfi];
                          }
+                         else if (filter) {
+                              *funcs++ = Sop_PFI_TEX_filter_to_Dacc[src_pfi];
+                         }
                          else {
                               *funcs++ = Sop_PFI_TEX_to_Dacc[src_pfi];
                          }
                     }
+                    else if (convolution &&
+                             Genefx_Convolution_setup( gfxs, &state->src_convolution, Sop_PFI_to_Dacc[src_pfi],
+                                                       source->config.size.w, simpld_blittingflags )) {
+                         *funcs++ = Genefx_Bop_convolve_to_Dacc;
+                    }
                     else {
                          if (simpld_blittingflags & DSBLIT_SRC_COLORKEY) {
                               gfxs->Skey = state->src_colorkey;
@@ -9838,6 +10675,10 @@ gAcquireSetup( CardState           *state,
                     if (src_ycbcr)
                          *funcs++ = Dacc_YCbCr_to_RGB;
 
+                    /* Transform the source colors. */
+                    if (simpld_blittingflags & DSBLIT_SRC_COLORMATRIX)
+                         *funcs++ = Dacc_colormatrix;
+
                     /* Premultiply color alpha. */
                     if (simpld_blittingflags & DSBLIT_SRC_PREMULTCOLOR) {
                          gfxs->Cacc.RGB.a = color.a + 1;
@@ -10107,6 +10948,12 @@ gAcquireSetup( CardState           *state,
 
      *funcs = NULL;
 
+     if (accel == DFXL_BLIT)
+          gSetupAlphaRuns( gfxs, state, simpld_blittingflags );
+
+     if (cacheable)
+          gPipelineStore( gfxs, &key, hash );
+
      dfb_state_update( state, state->flags & CSF_SOURCE_LOCKED );
 
      return true;
@@ -10136,6 +10983,23 @@ gAcquire( CardState           *state,
           return false;
      }
 
+     state->flags |= CSF_SOFTWARE;
+
+     return true;
+}
+
+bool
+gAcquireLocked( CardState           *state,
+                DFBAccelerationMask  accel )
+{
+     if (!gAcquireCheck( state, accel ))
+          return false;
+
+     if (!gAcquireSetup( state, accel ))
+          return false;
+
+     state->flags |= CSF_SOFTWARE;
+
      return true;
 }
 
@@ -10146,3 +11010,20 @@ gRelease( CardState *state )
 
      Core_PopIdentity();
 }
+
+void
+gShutdown()
+{
+     Genefx_Bands_shutdown();
+}
+
+void
+gGetPipelineCacheStats( unsigned int *ret_hits,
+                        unsigned int *ret_misses )
+{
+     if (ret_hits)
+          *ret_hits = pipeline_cache_hits;
+
+     if (ret_misses)
+          *ret_misses = pipeline_cache_misses;
+}
@@ -40,6 +40,62 @@ typedef union {
      } YUV;
 } GenefxAccumulator;
 
+#define GENEFX_PIPELINE_CACHE_SIZE 4
+
+typedef struct {
+     DFBAccelerationMask      accel;
+     DFBSurfaceDrawingFlags   drawingflags;
+     DFBSurfaceBlittingFlags  blittingflags;
+     DFBSurfaceBlendFunction  src_blend;
+     DFBSurfaceBlendFunction  dst_blend;
+     DFBColor                 color;
+     u32                      src_colorkey;
+     u32                      dst_colorkey;
+     DFBSurfacePixelFormat    dst_format;
+     DFBSurfacePixelFormat    src_format;
+     DFBSurfacePixelFormat    mask_format;
+     DFBSurfaceRenderOptions  render_options;
+} GenefxPipelineKey;
+
+typedef struct {
+     unsigned int             hash;              /* zero if unused */
+     GenefxPipelineKey        key;
+
+     GenefxFunc               funcs[32];
+
+     u32                      Cop;
+     u32                      Dkey;
+     u32                      Skey;
+     GenefxAccumulator        Cacc;
+     GenefxAccumulator        SCacc;
+     bool                     need_accumulator;
+     bool                     Sop_is_Bop;
+
+     GenefxFunc               run_funcs[32];
+     GenefxFunc               run_opaque[8];
+     bool                     run_zero;
+} GenefxPipeline;
+
+typedef struct {
+     GenefxFunc               load;              /* source span to accumulator conversion */
+     int                      width;             /* source width for clamping at the edges */
+
+     s32                      kernel[9];         /* 16.16 */
+     s32                      scale;             /* 16.16 */
+     s32                      bias;              /* 16.16 */
+
+     bool                     separable;         /* kernel is the product of h and v */
+     s32                      h[3];              /* horizontal factors (16.16) */
+     s32                      v[3];              /* vertical factors (16.16) */
+
+     void                    *rows_start;        /* converted source rows */
+     int                      rows_size;
+     const void              *rows_key[3];       /* source address of each row, NULL if unused */
+     int                      rows_length[3];
+     unsigned int             rows_stamp[3];
+     unsigned int             stamp;             /* incremented per span */
+} GenefxConvolution;
+
 struct __DFB_GenefxState {
      GenefxFunc               funcs[32];
 
@@ -71,11 +127,14 @@ struct __DFB_GenefxState {
      int                      src_height;
      int                      mask_height;
 
+     int                      src_width;         /* for clamping filtered texture lookups */
+
      int                      dst_field_offset;
      int                      src_field_offset;
      int                      mask_field_offset;
 
      DFBColor                 color;
+     s32                      colormatrix[12];   /* source color matrix (16.16) */
 
      /*
       * operands
@@ -145,19 +204,49 @@ struct __DFB_GenefxState {
 
      bool                     need_accumulator;
 
+     /*
+      * alpha runs
+      */
+     GenefxFunc               run_funcs[32];     /* pipeline for spans with translucent pixels */
+     GenefxFunc               run_opaque[8];     /* pipeline for runs of opaque pixels */
+     bool                     run_zero;          /* transparent pixels must be zero, not only their alpha */
+
      int                     *trans;
      int                      num_trans;
+
+     /*
+      * source convolution
+      */
+     GenefxConvolution        convolution;
+
+     /*
+      * pipelines resolved by previous setups
+      */
+     GenefxPipeline           pipelines[GENEFX_PIPELINE_CACHE_SIZE];
+     unsigned int             next_pipeline;
 };
 
 /**********************************************************************************************************************/
 
-void gGetDriverInfo( GraphicsDriverInfo  *info );
+void gGetDriverInfo        ( GraphicsDriverInfo  *info );
 
-void gGetDeviceInfo( GraphicsDeviceInfo  *info );
+void gGetDeviceInfo        ( GraphicsDeviceInfo  *info );
+
+bool gAcquire              ( CardState           *state,
+                             DFBAccelerationMask  accel );
+
+void gRelease              ( CardState           *state );
+
+/*
+ * Set up the state for the function 'accel' with the buffers already locked by the caller, i.e. the state's 'dst',
+ * 'src' and 'src_mask' locks are used as is and nothing needs to be released afterwards.
+ */
+bool gAcquireLocked        ( CardState           *state,
+                             DFBAccelerationMask  accel );
 
-bool gAcquire      ( CardState           *state,
-                     DFBAccelerationMask  accel );
+void gShutdown             ( void );
 
-void gRelease      ( CardState           *state );
+void gGetPipelineCacheStats( unsigned int        *ret_hits,
+                             unsigned int        *ret_misses );
 
 #endif
@@ -0,0 +1,286 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <core/state.h>
+#include <gfx/generic/generic.h>
+#include <gfx/generic/generic_affine_blit.h>
+#include <gfx/generic/generic_bands.h>
+#include <gfx/generic/generic_util.h>
+
+D_DEBUG_DOMAIN( Genefx_AffineBlit, "Genefx/AffineBlit", "Genefx Affine Blit" );
+
+/**********************************************************************************************************************/
+
+/*
+ * The source position of a destination pixel center (X + 0.5, Y + 0.5) is s0 + X' * sx + Y' * sy,
+ * with X' and Y' being the coordinates of the pixel center.
+ */
+typedef struct {
+     DFBRegion clip;                             /* destination lines and columns to render */
+
+     double    s0, sx, sy;                       /* source position in pixels */
+     double    t0, tx, ty;
+
+     double    s_min, s_max;                     /* source rectangle in pixels, exclusive maximum */
+     double    t_min, t_max;
+
+     int       SperD;                            /* source steps per destination pixel (16.16) */
+     int       TperD;
+
+     int       s_first, s_last;                  /* first and last valid source position (16.16) */
+     int       t_first, t_last;
+} AffineBlit;
+
+static __inline__ int
+iceil( double f )
+{
+     int i = (int) f;
+
+     return (f > i) ? i + 1 : i;
+}
+
+/*
+ * Narrow the range [x1,x2) of pixel centers to where v0 + x * dv is within [min,max).
+ */
+static __inline__ void
+affine_interval( double  v0,
+                 double  dv,
+                 double  min,
+                 double  max,
+                 double *x1,
+                 double *x2 )
+{
+     double lo, hi;
+
+     if (dv == 0.0) {
+          if (v0 < min || v0 >= max)
+               *x2 = *x1;
+
+          return;
+     }
+
+     lo = (min - v0) / dv;
+     hi = (max - v0) / dv;
+
+     if (dv < 0.0) {
+          double tmp = lo;
+
+          lo = hi;
+          hi = tmp;
+     }
+
+     if (*x1 < lo)
+          *x1 = lo;
+
+     if (*x2 > hi)
+          *x2 = hi;
+}
+
+static __inline__ bool
+affine_inside( const AffineBlit *affine,
+               long long         s,
+               long long         t )
+{
+     return s >= affine->s_first && s <= affine->s_last && t >= affine->t_first && t <= affine->t_last;
+}
+
+static void
+affine_band( GenefxState *gfxs,
+             void        *ctx,
+             int          y,
+             int          height )
+{
+     const AffineBlit *affine = ctx;
+     int               y2     = y + height - 1;
+
+     for (; y <= y2; y++) {
+          double yc = y + 0.5;
+          double s  = affine->s0 + yc * affine->sy;
+          double t  = affine->t0 + yc * affine->ty;
+          double x1 = affine->clip.x1 + 0.5;
+          double x2 = affine->clip.x2 + 1.5;
+          int    X1, X2, len;
+          int    ss, st;
+
+          /* Clip the span analytically to the source rectangle. */
+          affine_interval( s, affine->sx, affine->s_min, affine->s_max, &x1, &x2 );
+          affine_interval( t, affine->tx, affine->t_min, affine->t_max, &x1, &x2 );
+
+          if (x1 >= x2)
+               continue;
+
+          X1  = iceil( x1 - 0.5 );
+          X2  = iceil( x2 - 0.5 ) - 1;
+          len = X2 - X1 + 1;
+
+          /* Make sure the stepping in fixed point stays within the source at both ends. */
+          while (len > 0) {
+               ss = (s + (X1 + 0.5) * affine->sx) * 65536.0;
+               st = (t + (X1 + 0.5) * affine->tx) * 65536.0;
+
+               if (affine_inside( affine, ss, st ))
+                    break;
+
+               X1++;
+               len--;
+          }
+
+          while (len > 0 && !affine_inside( affine, ss + (long long) (len - 1) * affine->SperD,
+                                                    st + (long long) (len - 1) * affine->TperD ))
+               len--;
+
+          if (len <= 0)
+               continue;
+
+          gfxs->Dlen   = len;
+          gfxs->length = len;
+          gfxs->s      = ss;
+          gfxs->t      = st;
+          gfxs->SperD  = affine->SperD;
+          gfxs->TperD  = affine->TperD;
+
+          Genefx_Aop_xy( gfxs, X1, y );
+
+          RUN_PIPELINE();
+     }
+}
+
+/**********************************************************************************************************************/
+
+void
+gAffineBlit( CardState    *state,
+             DFBRectangle *srect,
+             DFBRectangle *drect )
+{
+     GenefxState *gfxs;
+     AffineBlit   affine;
+     const s32   *m = state->matrix;
+     double       a, b, c, d, e, f, det;
+     double       kx, ky;
+     double       xs[4], ys[4];
+     double       min_x, max_x, min_y, max_y;
+     int          i;
+
+     D_ASSERT( state != NULL );
+     D_ASSERT( state->gfxs != NULL );
+     D_ASSERT( state->affine_matrix );
+     DFB_RECTANGLE_ASSERT( srect );
+     DFB_RECTANGLE_ASSERT( drect );
+
+     gfxs = state->gfxs;
+
+     if (dfb_config->software_warn) {
+          D_WARN( "AffineBlit (%4d,%4d-%4dx%4d) %6s, flags 0x%08x, color 0x%02x%02x%02x%02x <- (%4d,%4d-%4dx%4d) %6s",
+                  DFB_RECTANGLE_VALS( drect ), dfb_pixelformat_name( gfxs->dst_format ),
+                  state->blittingflags, state->color.a, state->color.r, state->color.g, state->color.b,
+                  DFB_RECTANGLE_VALS( srect ), dfb_pixelformat_name( gfxs->src_format ) );
+     }
+
+     CHECK_PIPELINE();
+
+     if (srect->w < 1 || srect->h < 1 || drect->w < 1 || drect->h < 1)
+          return;
+
+     a = m[0] / 65536.0;
+     b = m[1] / 65536.0;
+     c = m[2] / 65536.0;
+     d = m[3] / 65536.0;
+     e = m[4] / 65536.0;
+     f = m[5] / 65536.0;
+
+     det = a * e - b * d;
+     if (det == 0.0)
+          return;
+
+     /* Destination bounds of the transformed rectangle. */
+     for (i = 0; i < 4; i++) {
+          double x = drect->x + ((i & 1) ? drect->w : 0);
+          double y = drect->y + ((i & 2) ? drect->h : 0);
+
+          xs[i] = a * x + b * y + c;
+          ys[i] = d * x + e * y + f;
+     }
+
+     min_x = max_x = xs[0];
+     min_y = max_y = ys[0];
+
+     for (i = 1; i < 4; i++) {
+          min_x = MIN( min_x, xs[i] );
+          max_x = MAX( max_x, xs[i] );
+          min_y = MIN( min_y, ys[i] );
+          max_y = MAX( max_y, ys[i] );
+     }
+
+     affine.clip.x1 = MAX( state->clip.x1, min_x > state->clip.x2 ? state->clip.x2 + 1 : iceil( min_x - 0.5 ) );
+     affine.clip.y1 = MAX( state->clip.y1, min_y > state->clip.y2 ? state->clip.y2 + 1 : iceil( min_y - 0.5 ) );
+     affine.clip.x2 = MIN( state->clip.x2, max_x < state->clip.x1 ? state->clip.x1 - 1 : iceil( max_x - 0.5 ) - 1 );
+     affine.clip.y2 = MIN( state->clip.y2, max_y < state->clip.y1 ? state->clip.y1 - 1 : iceil( max_y - 0.5 ) - 1 );
+
+     if (affine.clip.x1 > affine.clip.x2 || affine.clip.y1 > affine.clip.y2)
+          return;
+
+     /*
+      * Inverse mapping of a destination position (X,Y) to the logical destination (x,y):
+      *   x = ( e * (X - c) - b * (Y - f)) / det
+      *   y = (-d * (X - c) + a * (Y - f)) / det
+      * and on to the source, scaling from the destination to the source rectangle.
+      */
+     kx = (double) srect->w / drect->w;
+     ky = (double) srect->h / drect->h;
+
+     affine.sx = kx *  e / det;
+     affine.sy = kx * -b / det;
+     affine.s0 = srect->x + kx * ((-e * c + b * f) / det - drect->x);
+
+     affine.tx = ky * -d / det;
+     affine.ty = ky *  a / det;
+     affine.t0 = srect->y + ky * (( d * c - a * f) / det - drect->y);
+
+     affine.s_min = srect->x;
+     affine.s_max = srect->x + srect->w;
+     affine.t_min = srect->y;
+     affine.t_max = srect->y + srect->h;
+
+     affine.SperD = affine.sx * 65536.0 + (affine.sx < 0 ? -0.5 : 0.5);
+     affine.TperD = affine.tx * 65536.0 + (affine.tx < 0 ? -0.5 : 0.5);
+
+     affine.s_first = srect->x << 16;
+     affine.s_last  = ((srect->x + srect->w) << 16) - 1;
+     affine.t_first = srect->y << 16;
+     affine.t_last  = ((srect->y + srect->h) << 16) - 1;
+
+     D_DEBUG_AT( Genefx_AffineBlit, "%s( %4d,%4d-%4dx%4d -> %4d,%4d-%4dx%4d ) <- lines %d-%d, steps %d,%d\n",
+                 __FUNCTION__, DFB_RECTANGLE_VALS( srect ), DFB_RECTANGLE_VALS( drect ),
+                 affine.clip.y1, affine.clip.y2, affine.SperD, affine.TperD );
+
+     if (!Genefx_ABacc_prepare( gfxs, affine.clip.x2 - affine.clip.x1 + 1 ))
+          return;
+
+     /* Reset Bop to 0,0 as texture lookup accesses the source arbitrarily. */
+     Genefx_Bop_xy( gfxs, 0, 0 );
+
+     if (gfxs->src_org[0] == gfxs->dst_org[0])
+          affine_band( gfxs, &affine, affine.clip.y1, affine.clip.y2 - affine.clip.y1 + 1 );
+     else
+          Genefx_Bands_run( gfxs, affine.clip.x2 - affine.clip.x1 + 1, affine.clip.y1,
+                            affine.clip.y2 - affine.clip.y1 + 1,
+                            (affine.clip.x2 - affine.clip.x1 + 1) * (affine.clip.y2 - affine.clip.y1 + 1),
+                            affine_band, &affine );
+
+     Genefx_ABacc_flush( gfxs );
+}
@@ -0,0 +1,34 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#ifndef __GENERIC_AFFINE_BLIT_H__
+#define __GENERIC_AFFINE_BLIT_H__
+
+#include <core/coretypes.h>
+
+/**********************************************************************************************************************/
+
+/*
+ * Blit the source rectangle to the destination rectangle transformed by the affine matrix of the state,
+ * using the pipeline set up for DFXL_TEXTRIANGLES.
+ */
+void gAffineBlit( CardState    *state,
+                  DFBRectangle *srect,
+                  DFBRectangle *drect );
+
+#endif
@@ -0,0 +1,457 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <direct/mem.h>
+#include <direct/memcpy.h>
+#include <direct/thread.h>
+#include <direct/util.h>
+#include <gfx/generic/generic.h>
+#include <gfx/generic/generic_bands.h>
+
+D_DEBUG_DOMAIN( Genefx_Bands, "Genefx/Bands", "Genefx Banded Rendering" );
+
+/**********************************************************************************************************************/
+
+#define GENEFX_BANDS_MAX_WORKERS   16
+
+#define GENEFX_BANDS_MIN_LINES     16
+#define GENEFX_BANDS_MIN_PIXELS    0x4000
+
+typedef struct {
+     DirectThread            *thread;
+     int                      index;
+     unsigned int             generation;
+
+     GenefxState              gfxs;
+} GenefxBandWorker;
+
+static struct {
+     DirectMutex              lock;
+     DirectWaitQueue          work;
+     DirectWaitQueue          done;
+
+     bool                     started;
+     bool                     quit;
+
+     GenefxBandWorker        *workers;
+     int                      num_workers;
+
+     unsigned int             generation;
+     int                      num_bands;
+     int                      pending;
+     unsigned int             failed;
+
+     const GenefxState       *master;
+     GenefxState              snapshot;
+     int                      width;
+     int                      y;
+     int                      height;
+     GenefxBandFunc           func;              /* NULL for the lines */
+     void                    *ctx;
+     GenefxLines              lines;
+} bands = {
+     .lock = DIRECT_MUTEX_INITIALIZER()
+};
+
+/* Serializes the jobs, a thread finding the pool busy renders on its own. */
+static DirectMutex bands_job_lock = DIRECT_MUTEX_INITIALIZER();
+
+/**********************************************************************************************************************/
+
+static inline void
+lines_advance( GenefxState       *gfxs,
+               const GenefxLines *lines,
+               int               *phase )
+{
+     lines->Aop_advance( gfxs );
+
+     if (lines->Bop_step) {
+          *phase += lines->Bop_step;
+
+          while (*phase > 0xffff) {
+               *phase -= 0x10000;
+               lines->Bop_advance( gfxs );
+          }
+     }
+     else if (lines->Bop_advance)
+          lines->Bop_advance( gfxs );
+
+     if (lines->Mop_advance)
+          lines->Mop_advance( gfxs );
+}
+
+static void
+lines_render( GenefxState       *gfxs,
+              const GenefxLines *lines,
+              int                skip,
+              int                count )
+{
+     int phase = lines->Bop_phase;
+
+     while (skip--)
+          lines_advance( gfxs, lines, &phase );
+
+     while (count--) {
+          RUN_PIPELINE();
+
+          lines_advance( gfxs, lines, &phase );
+     }
+}
+
+static inline int
+band_start( int band )
+{
+     return bands.height * band / bands.num_bands;
+}
+
+static void
+band_run( GenefxState *gfxs,
+          int          band )
+{
+     int start = band_start( band );
+     int count = band_start( band + 1 ) - start;
+
+     if (bands.func)
+          bands.func( gfxs, bands.ctx, bands.y + start, count );
+     else
+          lines_render( gfxs, &bands.lines, start, count );
+}
+
+static GenefxAccumulator *
+remap_accumulator( const GenefxState *from,
+                   const GenefxState *to,
+                   GenefxAccumulator *acc )
+{
+     if (acc == from->Aacc)
+          return to->Aacc;
+
+     if (acc == from->Bacc)
+          return to->Bacc;
+
+     if (acc == from->Tacc)
+          return to->Tacc;
+
+     return acc;
+}
+
+/*
+ * Load the snapshot of the master state into the given state, keeping its own accumulators,
+ * and render the band.
+ */
+static bool
+band_render( GenefxState *gfxs,
+             int          band )
+{
+     const GenefxState *snapshot  = &bands.snapshot;
+     void              *ABstart   = gfxs->ABstart;
+     int                ABsize    = gfxs->ABsize;
+     GenefxAccumulator *Aacc      = gfxs->Aacc;
+     GenefxAccumulator *Bacc      = gfxs->Bacc;
+     GenefxAccumulator *Tacc      = gfxs->Tacc;
+     void              *rows      = gfxs->convolution.rows_start;
+     int                rows_size = gfxs->convolution.rows_size;
+
+     direct_memcpy( gfxs, snapshot, sizeof(GenefxState) );
+
+     gfxs->ABstart = ABstart;
+     gfxs->ABsize  = ABsize;
+     gfxs->Aacc    = Aacc;
+     gfxs->Bacc    = Bacc;
+     gfxs->Tacc    = Tacc;
+
+     /* Keep the own source rows of the convolution, the cached ones belong to the master. */
+     gfxs->convolution.rows_start  = rows;
+     gfxs->convolution.rows_size   = rows_size;
+     gfxs->convolution.rows_key[0] = gfxs->convolution.rows_key[1] = gfxs->convolution.rows_key[2] = NULL;
+
+     if (!Genefx_ABacc_prepare( gfxs, bands.width ))
+          return false;
+
+     gfxs->Xacc = remap_accumulator( snapshot, gfxs, snapshot->Xacc );
+     gfxs->Yacc = remap_accumulator( snapshot, gfxs, snapshot->Yacc );
+
+     /* The source operand may point to the operand array of the master state. */
+     if (snapshot->Sop == bands.master->Aop)
+          gfxs->Sop = gfxs->Aop;
+     else if (snapshot->Sop == bands.master->Bop)
+          gfxs->Sop = gfxs->Bop;
+
+     band_run( gfxs, band );
+
+     return true;
+}
+
+static void *
+band_worker_loop( DirectThread *thread,
+                  void         *arg )
+{
+     GenefxBandWorker *worker = arg;
+     int               band   = worker->index + 1;
+     bool              rendered;
+
+     D_DEBUG_AT( Genefx_Bands, "%s() running...\n", __FUNCTION__ );
+
+     direct_mutex_lock( &bands.lock );
+
+     while (!bands.quit) {
+          if (worker->generation == bands.generation) {
+               direct_waitqueue_wait( &bands.work, &bands.lock );
+               continue;
+          }
+
+          worker->generation = bands.generation;
+
+          if (band >= bands.num_bands)
+               continue;
+
+          direct_mutex_unlock( &bands.lock );
+
+          rendered = band_render( &worker->gfxs, band );
+          if (rendered)
+               Genefx_ABacc_flush( &worker->gfxs );
+
+          direct_mutex_lock( &bands.lock );
+
+          if (!rendered)
+               bands.failed |= 1 << band;
+
+          if (!--bands.pending)
+               direct_waitqueue_broadcast( &bands.done );
+     }
+
+     direct_mutex_unlock( &bands.lock );
+
+     return NULL;
+}
+
+static void
+bands_start( void )
+{
+     int i;
+     int num = MIN( dfb_config->software_threads, GENEFX_BANDS_MAX_WORKERS );
+
+     D_DEBUG_AT( Genefx_Bands, "%s() <- %d workers\n", __FUNCTION__, num );
+
+     bands.started = true;
+
+     bands.workers = D_CALLOC( num, sizeof(GenefxBandWorker) );
+     if (!bands.workers) {
+          D_OOM();
+          return;
+     }
+
+     direct_waitqueue_init( &bands.work );
+     direct_waitqueue_init( &bands.done );
+
+     for (i = 0; i < num; i++) {
+          GenefxBandWorker *worker = &bands.workers[i];
+          char              name[16];
+
+          snprintf( name, sizeof(name), "Genefx Band %d", i + 1 );
+
+          worker->index  = i;
+          worker->thread = direct_thread_create( DTT_DEFAULT, band_worker_loop, worker, name );
+          if (!worker->thread)
+               break;
+     }
+
+     bands.num_workers = i;
+
+     D_INFO( "Genefx/Bands: Using %d worker threads for software rendering\n", bands.num_workers );
+}
+
+/**********************************************************************************************************************/
+
+/*
+ * Returns the number of bands to render, with the job lock being held if it's more than one.
+ */
+static int
+bands_acquire( int height,
+               int pixels )
+{
+     int num;
+
+     if (!dfb_config->software_threads || height < GENEFX_BANDS_MIN_LINES * 2 || pixels < GENEFX_BANDS_MIN_PIXELS ||
+         direct_mutex_trylock( &bands_job_lock ))
+          return 1;
+
+     if (!bands.started)
+          bands_start();
+
+     num = MIN( bands.num_workers + 1, height / GENEFX_BANDS_MIN_LINES );
+     if (num < 2) {
+          direct_mutex_unlock( &bands_job_lock );
+          return 1;
+     }
+
+     return num;
+}
+
+static void
+bands_render( GenefxState *gfxs,
+              int          num )
+{
+     int          i;
+     unsigned int failed;
+
+     direct_mutex_lock( &bands.lock );
+
+     direct_memcpy( &bands.snapshot, gfxs, sizeof(GenefxState) );
+
+     bands.master    = gfxs;
+     bands.num_bands = num;
+     bands.pending   = num - 1;
+     bands.failed    = 0;
+
+     bands.generation++;
+
+     direct_waitqueue_broadcast( &bands.work );
+
+     direct_mutex_unlock( &bands.lock );
+
+     /* The first band is rendered using the state positioned by the caller. */
+     band_run( gfxs, 0 );
+
+     direct_mutex_lock( &bands.lock );
+
+     while (bands.pending)
+          direct_waitqueue_wait( &bands.done, &bands.lock );
+
+     failed = bands.failed;
+
+     direct_mutex_unlock( &bands.lock );
+
+     /* Render bands of workers that could not allocate their accumulators. */
+     for (i = 1; i < num; i++) {
+          if (failed & (1 << i))
+               band_render( gfxs, i );
+     }
+
+     direct_mutex_unlock( &bands_job_lock );
+}
+
+void
+Genefx_Lines_run( GenefxState       *gfxs,
+                  const GenefxLines *lines )
+{
+     int num;
+
+     D_ASSERT( gfxs != NULL );
+     D_ASSERT( lines != NULL );
+     D_ASSERT( lines->Aop_advance != NULL );
+     D_ASSERT( !lines->Bop_step || lines->Bop_advance != NULL );
+
+     if (lines->serial)
+          num = 1;
+     else
+          num = bands_acquire( lines->height, lines->width * lines->height );
+
+     if (num < 2) {
+          lines_render( gfxs, lines, 0, lines->height );
+          return;
+     }
+
+     D_DEBUG_AT( Genefx_Bands, "%s( %dx%d ) <- %d bands\n", __FUNCTION__, lines->width, lines->height, num );
+
+     /* The job parameters are only read by the workers after the generation has been incremented. */
+     bands.width  = lines->width;
+     bands.y      = 0;
+     bands.height = lines->height;
+     bands.func   = NULL;
+     bands.ctx    = NULL;
+     bands.lines  = *lines;
+
+     bands_render( gfxs, num );
+}
+
+void
+Genefx_Bands_run( GenefxState    *gfxs,
+                  int             width,
+                  int             y,
+                  int             height,
+                  int             pixels,
+                  GenefxBandFunc  func,
+                  void           *ctx )
+{
+     int num;
+
+     D_ASSERT( gfxs != NULL );
+     D_ASSERT( func != NULL );
+
+     num = bands_acquire( height, pixels );
+     if (num < 2) {
+          func( gfxs, ctx, y, height );
+          return;
+     }
+
+     D_DEBUG_AT( Genefx_Bands, "%s( %d, %d lines ) <- %d bands\n", __FUNCTION__, y, height, num );
+
+     bands.width  = width;
+     bands.y      = y;
+     bands.height = height;
+     bands.func   = func;
+     bands.ctx    = ctx;
+
+     bands_render( gfxs, num );
+}
+
+void
+Genefx_Bands_shutdown( void )
+{
+     int i;
+
+     direct_mutex_lock( &bands_job_lock );
+
+     if (bands.workers) {
+          D_DEBUG_AT( Genefx_Bands, "%s()\n", __FUNCTION__ );
+
+          direct_mutex_lock( &bands.lock );
+
+          bands.quit = true;
+
+          direct_waitqueue_broadcast( &bands.work );
+
+          direct_mutex_unlock( &bands.lock );
+
+          for (i = 0; i < bands.num_workers; i++) {
+               GenefxBandWorker *worker = &bands.workers[i];
+
+               direct_thread_join( worker->thread );
+               direct_thread_destroy( worker->thread );
+
+               if (worker->gfxs.ABstart)
+                    D_FREE( worker->gfxs.ABstart );
+
+               if (worker->gfxs.convolution.rows_start)
+                    D_FREE( worker->gfxs.convolution.rows_start );
+          }
+
+          D_FREE( bands.workers );
+
+          direct_waitqueue_deinit( &bands.work );
+          direct_waitqueue_deinit( &bands.done );
+
+          bands.workers     = NULL;
+          bands.num_workers = 0;
+          bands.quit        = false;
+     }
+
+     bands.started = false;
+
+     direct_mutex_unlock( &bands_job_lock );
+}
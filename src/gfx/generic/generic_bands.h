@@ -0,0 +1,72 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#ifndef __GENERIC_BANDS_H__
+#define __GENERIC_BANDS_H__
+
+#include <gfx/generic/generic_util.h>
+
+/**********************************************************************************************************************/
+
+typedef struct {
+     int                      width;             /* accumulator width */
+     int                      height;            /* number of lines */
+
+     XopAdvanceFunc           Aop_advance;
+     XopAdvanceFunc           Bop_advance;       /* optional */
+     XopAdvanceFunc           Mop_advance;       /* optional */
+
+     int                      Bop_phase;         /* fractional source line position (16.16) */
+     int                      Bop_step;          /* source lines per line (16.16), zero advances by one line */
+
+     bool                     serial;            /* lines depend on previously written lines */
+} GenefxLines;
+
+/*
+ * Render the lines y..y+height-1 of a band, positioning the operands on its own.
+ */
+typedef void (*GenefxBandFunc)( GenefxState *gfxs,
+                                void        *ctx,
+                                int          y,
+                                int          height );
+
+/**********************************************************************************************************************/
+
+/*
+ * Run the pipeline for each line, advancing the operands in between.
+ * The operands must have been positioned at the first line and the accumulators prepared.
+ * Large operations are split into horizontal bands rendered in parallel by the worker threads.
+ */
+void Genefx_Lines_run      ( GenefxState       *gfxs,
+                             const GenefxLines *lines );
+
+/*
+ * Call the function for horizontal bands of the given lines, rendered in parallel by the worker threads
+ * if the operation covers enough pixels. Each band gets a copy of the state with accumulators of 'width'.
+ */
+void Genefx_Bands_run      ( GenefxState       *gfxs,
+                             int                width,
+                             int                y,
+                             int                height,
+                             int                pixels,
+                             GenefxBandFunc     func,
+                             void              *ctx );
+
+void Genefx_Bands_shutdown ( void );
+
+#endif
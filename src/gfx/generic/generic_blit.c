@@ -18,14 +18,13 @@
 
 #include <core/state.h>
 #include <gfx/generic/generic.h>
+#include <gfx/generic/generic_bands.h>
 #include <gfx/generic/generic_blit.h>
 #include <gfx/generic/generic_util.h>
 #include <gfx/util.h>
 
 /**********************************************************************************************************************/
 
-typedef void (*XopAdvanceFunc)( GenefxState *gfxs );
-
 void
 gBlit( CardState    *state,
        DFBRectangle *rect,
@@ -340,15 +339,19 @@ gBlit( CardState    *state,
           }
      }
      else {
-          for (h = rect->h; h; h--) {
-               RUN_PIPELINE();
-
-               Aop_advance( gfxs );
-               Bop_advance( gfxs );
-
-               if (state->blittingflags & (DSBLIT_SRC_MASK_ALPHA | DSBLIT_SRC_MASK_COLOR))
-                    Mop_advance( gfxs );
-          }
+          GenefxLines lines;
+
+          lines.width       = rect->w;
+          lines.height      = rect->h;
+          lines.Aop_advance = Aop_advance;
+          lines.Bop_advance = Bop_advance;
+          lines.Mop_advance = (state->blittingflags & (DSBLIT_SRC_MASK_ALPHA | DSBLIT_SRC_MASK_COLOR)) ?
+                              Mop_advance : NULL;
+          lines.Bop_phase   = 0;
+          lines.Bop_step    = 0;
+          lines.serial      = gfxs->src_org[0] == gfxs->dst_org[0];
+
+          Genefx_Lines_run( gfxs, &lines );
      }
 
      Genefx_ABacc_flush( gfxs );
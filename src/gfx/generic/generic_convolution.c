@@ -0,0 +1,302 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <direct/mem.h>
+#include <direct/util.h>
+#include <directfb_util.h>
+#include <gfx/generic/generic_convolution.h>
+#include <misc/conf.h>
+
+D_DEBUG_DOMAIN( Genefx_Convolution, "Genefx/Convolution", "Genefx Source Convolution" );
+
+/**********************************************************************************************************************/
+
+/*
+ * Each cached source row holds the converted span including one pixel on either side,
+ * followed by the horizontally filtered span (one plane per channel) for separable kernels.
+ */
+#define ROW_BYTES(size) (((size) + 2) * sizeof(GenefxAccumulator) + 4 * (size) * sizeof(s32))
+
+static __inline__ GenefxAccumulator *
+row_acc( const GenefxConvolution *conv,
+         int                      slot )
+{
+     return (GenefxAccumulator*) ((u8*) conv->rows_start + slot * ROW_BYTES( conv->rows_size ));
+}
+
+static __inline__ s32 *
+row_sum( const GenefxConvolution *conv,
+         int                      slot,
+         int                      channel )
+{
+     return (s32*) (row_acc( conv, slot ) + conv->rows_size + 2) + channel * conv->rows_size;
+}
+
+static __inline__ u16
+clamp_channel( s64 value )
+{
+     value >>= 32;
+
+     return (value < 0) ? 0 : (value > 0xff) ? 0xff : value;
+}
+
+static bool
+rows_prepare( GenefxConvolution *conv,
+              int                length )
+{
+     int   size;
+     void *rows_start;
+
+     if (conv->rows_size >= length)
+          return true;
+
+     size = (length + 31) & ~31;
+
+     rows_start = D_MALLOC( 3 * ROW_BYTES( size ) );
+     if (!rows_start) {
+          D_WARN( "out of memory" );
+          return false;
+     }
+
+     if (conv->rows_start)
+          D_FREE( conv->rows_start );
+
+     conv->rows_start  = rows_start;
+     conv->rows_size   = size;
+     conv->rows_key[0] = conv->rows_key[1] = conv->rows_key[2] = NULL;
+
+     return true;
+}
+
+/*
+ * Return the slot holding the source row 'y' for the current span starting at 'x', converting it if not cached.
+ */
+static int
+rows_fetch( GenefxState *gfxs,
+            int          y,
+            int          x )
+{
+     GenefxConvolution  *conv   = &gfxs->convolution;
+     int                 length = gfxs->length;
+     u8                 *row    = (u8*) gfxs->src_org[0] + y * gfxs->src_pitch;
+     const void         *key    = row + x * gfxs->src_bpp;
+     GenefxAccumulator  *acc;
+     GenefxAccumulator  *Dacc   = gfxs->Dacc;
+     void              **Sop    = gfxs->Sop;
+     int                 Ostep  = gfxs->Ostep;
+     void               *S[3];
+     int                 lo, hi;
+     int                 i;
+     int                 slot   = 0;
+
+     for (i = 0; i < 3; i++) {
+          if (conv->rows_key[i] == key && conv->rows_length[i] == length) {
+               conv->rows_stamp[i] = conv->stamp;
+               return i;
+          }
+     }
+
+     /* Replace the least recently used row, which is never one used by the current span. */
+     for (i = 1; i < 3; i++) {
+          if ((int) (conv->rows_stamp[i] - conv->rows_stamp[slot]) < 0)
+               slot = i;
+     }
+
+     conv->rows_key[slot]    = key;
+     conv->rows_length[slot] = length;
+     conv->rows_stamp[slot]  = conv->stamp;
+
+     acc = row_acc( conv, slot );
+
+     /* Convert the span with one extra pixel on either side, clamped to the source. */
+     lo = MAX( x - 1, 0 );
+     hi = MIN( x + length, conv->width - 1 );
+
+     S[0] = row + lo * gfxs->src_bpp;
+
+     gfxs->Sop    = S;
+     gfxs->length = hi - lo + 1;
+     gfxs->Dacc   = acc + lo - (x - 1);
+     gfxs->Ostep  = 1;
+
+     conv->load( gfxs );
+
+     gfxs->Sop    = Sop;
+     gfxs->length = length;
+     gfxs->Dacc   = Dacc;
+     gfxs->Ostep  = Ostep;
+
+     if (x == 0)
+          acc[0] = acc[1];
+
+     if (x + length >= conv->width)
+          acc[length+1] = acc[length];
+
+     /* Filter the row horizontally once, it is used by up to three spans. */
+     if (conv->separable) {
+          s64 h0 = conv->h[0];
+          s64 h1 = conv->h[1];
+          s64 h2 = conv->h[2];
+          int c;
+
+          for (c = 0; c < 4; c++) {
+               s32       *sum = row_sum( conv, slot, c );
+               const u16 *p   = (const u16*) acc + c;
+
+               for (i = 0; i < length; i++, p += 4)
+                    sum[i] = (h0 * p[0] + h1 * p[4] + h2 * p[8]) >> 8;
+          }
+     }
+
+     return slot;
+}
+
+/**********************************************************************************************************************/
+
+bool
+Genefx_Convolution_setup( GenefxState                *gfxs,
+                          const DFBConvolutionFilter *filter,
+                          GenefxFunc                  load,
+                          int                         width,
+                          DFBSurfaceBlittingFlags     flags )
+{
+     GenefxConvolution *conv  = &gfxs->convolution;
+     const s32         *k     = filter->kernel;
+     int                pivot = 0;
+     int                i, j;
+
+     if (!load || !gfxs->src_bpp || (flags & (DSBLIT_SRC_COLORKEY | DSBLIT_DEINTERLACE)) ||
+         DFB_PLANAR_PIXELFORMAT( gfxs->src_format ) || DFB_PIXELFORMAT_ALIGNMENT( gfxs->src_format ) ||
+         (gfxs->src_caps & DSCAPS_SEPARATED)) {
+          D_ONCE( "source convolution from %s not supported", dfb_pixelformat_name( gfxs->src_format ) );
+          return false;
+     }
+
+     conv->load  = load;
+     conv->width = width;
+     conv->scale = filter->scale;
+     conv->bias  = filter->bias;
+
+     for (i = 0; i < 9; i++) {
+          conv->kernel[i] = k[i];
+
+          if (ABS( k[i] ) > ABS( k[pivot] ))
+               pivot = i;
+     }
+
+     /* The kernel is separable if all rows are multiples of the row containing the largest element. */
+     conv->separable = true;
+
+     for (i = 0; i < 3; i++) {
+          for (j = 0; j < 3; j++) {
+               if ((s64) k[i*3+j] * k[pivot] != (s64) k[i*3+pivot%3] * k[pivot/3*3+j])
+                    conv->separable = false;
+          }
+     }
+
+     if (conv->separable) {
+          for (i = 0; i < 3; i++) {
+               conv->h[i] = k[pivot/3*3+i];
+               conv->v[i] = k[pivot] ? ((s64) k[i*3+pivot%3] << 16) / k[pivot] : (i == 1) << 16;
+          }
+     }
+
+     D_DEBUG_AT( Genefx_Convolution, "%s() <- %s kernel, scale 0x%x, bias 0x%x\n", __FUNCTION__,
+                 conv->separable ? "separable" : "full", conv->scale, conv->bias );
+
+     conv->rows_key[0] = conv->rows_key[1] = conv->rows_key[2] = NULL;
+
+     return true;
+}
+
+void
+Genefx_Convolution_flush( GenefxState *gfxs )
+{
+     GenefxConvolution *conv = &gfxs->convolution;
+
+     conv->rows_key[0] = conv->rows_key[1] = conv->rows_key[2] = NULL;
+
+     if (dfb_config->keep_accumulators >= 0 && conv->rows_size > dfb_config->keep_accumulators) {
+          D_FREE( conv->rows_start );
+
+          conv->rows_start = NULL;
+          conv->rows_size  = 0;
+     }
+}
+
+void
+Genefx_Bop_convolve_to_Dacc( GenefxState *gfxs )
+{
+     GenefxConvolution *conv   = &gfxs->convolution;
+     int                length = gfxs->length;
+     GenefxAccumulator *D      = gfxs->Dacc;
+     int                y      = gfxs->BopY;
+     s64                scale  = conv->scale;
+     s64                bias   = ((s64) conv->bias << 16) + 0x80000000LL;
+     int                rows[3];
+     int                x;
+     int                i, c;
+
+     /* Fall back to the unfiltered source if the rows cannot be allocated. */
+     if (!rows_prepare( conv, length )) {
+          conv->load( gfxs );
+          return;
+     }
+
+     x = ((u8*) gfxs->Bop[0] - (u8*) gfxs->src_org[0] - y * gfxs->src_pitch) / gfxs->src_bpp;
+
+     conv->stamp++;
+
+     rows[0] = rows_fetch( gfxs, MAX( y - 1, 0 ), x );
+     rows[1] = rows_fetch( gfxs, y, x );
+     rows[2] = rows_fetch( gfxs, MIN( y + 1, gfxs->src_height - 1 ), x );
+
+     if (conv->separable) {
+          s64 v0 = conv->v[0];
+          s64 v1 = conv->v[1];
+          s64 v2 = conv->v[2];
+
+          for (c = 0; c < 4; c++) {
+               const s32 *s0 = row_sum( conv, rows[0], c );
+               const s32 *s1 = row_sum( conv, rows[1], c );
+               const s32 *s2 = row_sum( conv, rows[2], c );
+               u16       *d  = (u16*) D + c;
+
+               for (i = 0; i < length; i++, d += 4)
+                    *d = clamp_channel( ((v0 * s0[i] + v1 * s1[i] + v2 * s2[i]) >> 8) * scale + bias );
+          }
+     }
+     else {
+          const s32 *k = conv->kernel;
+
+          for (c = 0; c < 4; c++) {
+               const u16 *p0 = (const u16*) row_acc( conv, rows[0] ) + c;
+               const u16 *p1 = (const u16*) row_acc( conv, rows[1] ) + c;
+               const u16 *p2 = (const u16*) row_acc( conv, rows[2] ) + c;
+               u16       *d  = (u16*) D + c;
+
+               for (i = 0; i < length; i++, p0 += 4, p1 += 4, p2 += 4, d += 4) {
+                    s64 sum = (s64) k[0] * p0[0] + (s64) k[1] * p0[4] + (s64) k[2] * p0[8] +
+                              (s64) k[3] * p1[0] + (s64) k[4] * p1[4] + (s64) k[5] * p1[8] +
+                              (s64) k[6] * p2[0] + (s64) k[7] * p2[4] + (s64) k[8] * p2[8];
+
+                    *d = clamp_channel( sum * scale + bias );
+               }
+          }
+     }
+}
@@ -0,0 +1,46 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#ifndef __GENERIC_CONVOLUTION_H__
+#define __GENERIC_CONVOLUTION_H__
+
+#include <gfx/generic/generic.h>
+
+/**********************************************************************************************************************/
+
+/*
+ * Prepare the convolution of the source, loading source spans with the given conversion function.
+ * Returns false if the source cannot be convolved.
+ */
+bool Genefx_Convolution_setup    ( GenefxState                *gfxs,
+                                   const DFBConvolutionFilter *filter,
+                                   GenefxFunc                  load,
+                                   int                         width,
+                                   DFBSurfaceBlittingFlags     flags );
+
+/*
+ * Forget the cached source rows, releasing them if they exceed the accumulators to keep.
+ */
+void Genefx_Convolution_flush    ( GenefxState                *gfxs );
+
+/*
+ * Pipeline stage reading the convolved source span at Bop into Dacc.
+ */
+void Genefx_Bop_convolve_to_Dacc ( GenefxState                *gfxs );
+
+#endif
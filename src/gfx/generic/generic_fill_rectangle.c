@@ -18,6 +18,7 @@
 
 #include <core/state.h>
 #include <gfx/generic/generic.h>
+#include <gfx/generic/generic_bands.h>
 #include <gfx/generic/generic_fill_rectangle.h>
 #include <gfx/generic/generic_util.h>
 
@@ -28,7 +29,7 @@ gFillRectangle( CardState    *state,
                 DFBRectangle *rect )
 {
      GenefxState *gfxs;
-     int          h;
+     GenefxLines  lines;
 
      D_ASSERT( state != NULL );
      D_ASSERT( state->gfxs != NULL );
@@ -54,12 +55,16 @@ gFillRectangle( CardState    *state,
 
      Genefx_Aop_xy( gfxs, rect->x, rect->y );
 
-     h = rect->h;
-     while (h--) {
-          RUN_PIPELINE();
+     lines.width       = rect->w;
+     lines.height      = rect->h;
+     lines.Aop_advance = Genefx_Aop_next;
+     lines.Bop_advance = NULL;
+     lines.Mop_advance = NULL;
+     lines.Bop_phase   = 0;
+     lines.Bop_step    = 0;
+     lines.serial      = false;
 
-          Genefx_Aop_next( gfxs );
-     }
+     Genefx_Lines_run( gfxs, &lines );
 
      Genefx_ABacc_flush( gfxs );
 }
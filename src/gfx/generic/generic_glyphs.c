@@ -0,0 +1,456 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <config.h>
+#include <core/state.h>
+#include <gfx/clip.h>
+#include <gfx/convert.h>
+#include <gfx/generic/generic.h>
+#include <gfx/generic/generic_glyphs.h>
+#include <gfx/generic/generic_util.h>
+#include <gfx/util.h>
+
+D_DEBUG_DOMAIN( Genefx_Glyphs, "Genefx/Glyphs", "Genefx Glyph Runs" );
+
+/**********************************************************************************************************************/
+
+/* maximum number of glyphs composited in one pass */
+#define GLYPH_RUN_MAX 64
+
+/*
+ * The pipeline for DSBLIT_COLORIZE | DSBLIT_BLEND_ALPHACHANNEL with SRC_OVER computes per pixel, with 'a' being the
+ * coverage (modulated by the color alpha for DSBLIT_BLEND_COLORALPHA):
+ *
+ *   D = ((S * (a + 1)) >> 8) + ((D * (0x100 - a)) >> 8)
+ *
+ * with S being the color and, for the alpha channel, 'a' for DSBF_SRCALPHA or 0xff for DSBLIT_SRC_PREMULTIPLY with
+ * DSBF_ONE. No channel exceeds 0xff, so there is no need to saturate.
+ */
+typedef struct {
+     u32                      r;
+     u32                      g;
+     u32                      b;
+     u32                      ca;                /* color alpha + 1, 0x100 if the coverage is not modulated */
+     bool                     premultiplied;     /* DSBLIT_SRC_PREMULTIPLY with DSBF_ONE */
+     u32                      opaque;            /* destination pixel for full coverage */
+} GlyphColor;
+
+typedef void (*GlyphSpanFunc)( const u8         *S,
+                               void             *D,
+                               int               w,
+                               const GlyphColor *color );
+
+typedef struct {
+     const u8                *src;               /* coverage of the first line */
+     u8                      *dst;               /* destination of the first line */
+     int                      y;
+     int                      w;
+     int                      h;
+} Glyph;
+
+/**********************************************************************************************************************/
+
+static __inline__ u32
+blend8( u32 s,
+        u32 d,
+        u32 a )
+{
+     return ((s * (a + 1)) >> 8) + ((d * (0x100 - a)) >> 8);
+}
+
+static void
+glyph_span_rgb16( const u8         *S,
+                  void             *D,
+                  int               w,
+                  const GlyphColor *color )
+{
+     u16 *d = D;
+
+     while (w--) {
+          u32 a = (*S++ * color->ca) >> 8;
+
+          if (a == 0xff) {
+               *d = color->opaque;
+          }
+          else if (a) {
+               u16 p = *d;
+
+               *d = PIXEL_RGB16( blend8( color->r, EXPAND_5to8( p >> 11 ), a ),
+                                 blend8( color->g, EXPAND_6to8( (p >> 5) & 0x3f ), a ),
+                                 blend8( color->b, EXPAND_5to8( p & 0x1f ), a ) );
+          }
+
+          d++;
+     }
+}
+
+static void
+glyph_span_rgb32( const u8         *S,
+                  void             *D,
+                  int               w,
+                  const GlyphColor *color )
+{
+     u32 *d = D;
+
+     while (w--) {
+          u32 a = (*S++ * color->ca) >> 8;
+
+          if (a == 0xff) {
+               *d = color->opaque;
+          }
+          else if (a) {
+               u32 p = *d;
+
+               *d = PIXEL_RGB32( blend8( color->r, (p >> 16) & 0xff, a ),
+                                 blend8( color->g, (p >>  8) & 0xff, a ),
+                                 blend8( color->b,  p        & 0xff, a ) );
+          }
+
+          d++;
+     }
+}
+
+static void
+glyph_span_argb( const u8         *S,
+                 void             *D,
+                 int               w,
+                 const GlyphColor *color )
+{
+     u32 *d = D;
+
+     while (w--) {
+          u32 a = (*S++ * color->ca) >> 8;
+
+          if (a == 0xff) {
+               *d = color->opaque;
+          }
+          else if (a) {
+               u32 p = *d;
+
+               *d = PIXEL_ARGB( blend8( color->premultiplied ? 0xff : a, p >> 24, a ),
+                                blend8( color->r, (p >> 16) & 0xff, a ),
+                                blend8( color->g, (p >>  8) & 0xff, a ),
+                                blend8( color->b,  p        & 0xff, a ) );
+          }
+
+          d++;
+     }
+}
+
+/**********************************************************************************************************************/
+
+#ifdef USE_SSE
+
+/* ((s * (a + 1)) >> 8) + ((d * (0x100 - a)) >> 8) for 8 channels */
+static inline SSE2_FUNC __m128i
+blend8_SSE2( __m128i s,
+             __m128i d,
+             __m128i a )
+{
+     return _mm_add_epi16( _mm_srli_epi16( _mm_mullo_epi16( s, _mm_add_epi16( a, _mm_set1_epi16( 1 ) ) ), 8 ),
+                           _mm_srli_epi16( _mm_mullo_epi16( d, _mm_sub_epi16( _mm_set1_epi16( 0x100 ), a ) ), 8 ) );
+}
+
+/* coverage of 8 pixels to 16 bit alpha, modulated by the color alpha */
+static inline SSE2_FUNC __m128i
+coverage_SSE2( __m128i cov,
+               __m128i ca )
+{
+     return _mm_srli_epi16( _mm_mullo_epi16( _mm_unpacklo_epi8( cov, _mm_setzero_si128() ), ca ), 8 );
+}
+
+static SSE2_FUNC void
+glyph_span_rgb16_SSE2( const u8         *S,
+                       void             *D,
+                       int               w,
+                       const GlyphColor *color )
+{
+     u16     *d      = D;
+     __m128i  ca     = _mm_set1_epi16( color->ca );
+     __m128i  r      = _mm_set1_epi16( color->r );
+     __m128i  g      = _mm_set1_epi16( color->g );
+     __m128i  b      = _mm_set1_epi16( color->b );
+     __m128i  opaque = _mm_set1_epi16( color->opaque );
+
+     for (; w >= 8; w -= 8, S += 8, d += 8) {
+          __m128i cov = _mm_loadl_epi64( (const __m128i*) S );
+          __m128i a, p, dr, dg, db;
+
+          if (_mm_movemask_epi8( _mm_cmpeq_epi8( cov, _mm_setzero_si128() ) ) == 0xffff)
+               continue;
+
+          if (color->ca == 0x100 &&
+              (_mm_movemask_epi8( _mm_cmpeq_epi8( cov, _mm_set1_epi8( -1 ) ) ) & 0xff) == 0xff) {
+               _mm_storeu_si128( (__m128i*) d, opaque );
+               continue;
+          }
+
+          a = coverage_SSE2( cov, ca );
+          p = _mm_loadu_si128( (const __m128i*) d );
+
+          dr = _mm_srli_epi16( p, 11 );
+          dg = _mm_and_si128( _mm_srli_epi16( p, 5 ), _mm_set1_epi16( 0x3f ) );
+          db = _mm_and_si128( p, _mm_set1_epi16( 0x1f ) );
+
+          dr = blend8_SSE2( r, _mm_or_si128( _mm_slli_epi16( dr, 3 ), _mm_srli_epi16( dr, 2 ) ), a );
+          dg = blend8_SSE2( g, _mm_or_si128( _mm_slli_epi16( dg, 2 ), _mm_srli_epi16( dg, 4 ) ), a );
+          db = blend8_SSE2( b, _mm_or_si128( _mm_slli_epi16( db, 3 ), _mm_srli_epi16( db, 2 ) ), a );
+
+          p = _mm_or_si128( _mm_slli_epi16( _mm_and_si128( dr, _mm_set1_epi16( 0xf8 ) ), 8 ),
+                            _mm_or_si128( _mm_slli_epi16( _mm_and_si128( dg, _mm_set1_epi16( 0xfc ) ), 3 ),
+                                          _mm_srli_epi16( db, 3 ) ) );
+
+          _mm_storeu_si128( (__m128i*) d, p );
+     }
+
+     glyph_span_rgb16( S, d, w, color );
+}
+
+/*
+ * 4 pixels per iteration, each pixel being 4 x u16 (b, g, r, a) after unpacking, 'alpha' being the source alpha
+ * channel for all pixels (0xff) or zero to use the coverage, 'fill' being or'ed into the result.
+ */
+static inline SSE2_FUNC void
+glyph_span_32_SSE2( const u8         **S,
+                    u32              **D,
+                    int               *w,
+                    const GlyphColor  *color,
+                    u16                alpha,
+                    u32                fill )
+{
+     const u8 *s      = *S;
+     u32      *d      = *D;
+     int       n      = *w;
+     __m128i   ca     = _mm_set1_epi16( color->ca );
+     __m128i   src    = _mm_set_epi16( alpha, color->r, color->g, color->b, alpha, color->r, color->g, color->b );
+     __m128i   amask  = alpha ? _mm_setzero_si128() : _mm_set_epi16( -1, 0, 0, 0, -1, 0, 0, 0 );
+     __m128i   opaque = _mm_set1_epi32( color->opaque );
+
+     for (; n >= 4; n -= 4, s += 4, d += 4) {
+          u32     cov;
+          __m128i a, a_lo, a_hi, p, p_lo, p_hi;
+
+          /* coverage bytes are not aligned */
+          memcpy( &cov, s, 4 );
+
+          if (!cov)
+               continue;
+
+          if (cov == 0xffffffff && color->ca == 0x100) {
+               _mm_storeu_si128( (__m128i*) d, opaque );
+               continue;
+          }
+
+          /* a0 a0 a1 a1 a2 a2 a3 a3, then each alpha for all channels of its pixel */
+          a    = coverage_SSE2( _mm_cvtsi32_si128( cov ), ca );
+          a    = _mm_unpacklo_epi16( a, a );
+          a_lo = _mm_unpacklo_epi32( a, a );
+          a_hi = _mm_unpackhi_epi32( a, a );
+
+          p    = _mm_loadu_si128( (const __m128i*) d );
+          p_lo = _mm_unpacklo_epi8( p, _mm_setzero_si128() );
+          p_hi = _mm_unpackhi_epi8( p, _mm_setzero_si128() );
+
+          p_lo = blend8_SSE2( _mm_or_si128( src, _mm_and_si128( amask, a_lo ) ), p_lo, a_lo );
+          p_hi = blend8_SSE2( _mm_or_si128( src, _mm_and_si128( amask, a_hi ) ), p_hi, a_hi );
+
+          _mm_storeu_si128( (__m128i*) d, _mm_or_si128( _mm_packus_epi16( p_lo, p_hi ), _mm_set1_epi32( fill ) ) );
+     }
+
+     *S = s;
+     *D = d;
+     *w = n;
+}
+
+static SSE2_FUNC void
+glyph_span_rgb32_SSE2( const u8         *S,
+                       void             *D,
+                       int               w,
+                       const GlyphColor *color )
+{
+     u32 *d = D;
+
+     glyph_span_32_SSE2( &S, &d, &w, color, 0xff, 0xff000000 );
+
+     glyph_span_rgb32( S, d, w, color );
+}
+
+static SSE2_FUNC void
+glyph_span_argb_SSE2( const u8         *S,
+                      void             *D,
+                      int               w,
+                      const GlyphColor *color )
+{
+     u32 *d = D;
+
+     glyph_span_32_SSE2( &S, &d, &w, color, color->premultiplied ? 0xff : 0, 0 );
+
+     glyph_span_argb( S, d, w, color );
+}
+
+#endif
+
+/**********************************************************************************************************************/
+
+static GlyphSpanFunc Glyph_span_PFI[DFB_NUM_PIXELFORMATS] = {
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGB16)] = glyph_span_rgb16,
+     [DFB_PIXELFORMAT_INDEX(DSPF_RGB32)] = glyph_span_rgb32,
+     [DFB_PIXELFORMAT_INDEX(DSPF_ARGB)]  = glyph_span_argb,
+};
+
+#ifdef USE_SSE
+void
+Genefx_Glyphs_init_SSE2()
+{
+     Glyph_span_PFI[DFB_PIXELFORMAT_INDEX(DSPF_RGB16)] = glyph_span_rgb16_SSE2;
+     Glyph_span_PFI[DFB_PIXELFORMAT_INDEX(DSPF_RGB32)] = glyph_span_rgb32_SSE2;
+     Glyph_span_PFI[DFB_PIXELFORMAT_INDEX(DSPF_ARGB)]  = glyph_span_argb_SSE2;
+}
+#endif
+
+/**********************************************************************************************************************/
+
+bool
+gBlitGlyphRunCheck( CardState *state )
+{
+     GenefxState             *gfxs;
+     DFBSurfaceBlittingFlags  flags;
+
+     D_ASSERT( state != NULL );
+
+     gfxs = state->gfxs;
+     if (!gfxs || !gfxs->funcs[0])
+          return false;
+
+     if (gfxs->src_format != DSPF_A8 || !Glyph_span_PFI[DFB_PIXELFORMAT_INDEX(gfxs->dst_format)])
+          return false;
+
+     if ((gfxs->src_caps | gfxs->dst_caps) & DSCAPS_SEPARATED)
+          return false;
+
+     if (state->render_options & DSRO_MATRIX)
+          return false;
+
+     flags = state->blittingflags;
+
+     dfb_simplify_blittingflags( &flags );
+
+     if ((flags & ~(DSBLIT_BLEND_COLORALPHA | DSBLIT_SRC_PREMULTIPLY)) != (DSBLIT_COLORIZE | DSBLIT_BLEND_ALPHACHANNEL))
+          return false;
+
+     if (state->dst_blend != DSBF_INVSRCALPHA)
+          return false;
+
+     return state->src_blend == ((flags & DSBLIT_SRC_PREMULTIPLY) ? DSBF_ONE : DSBF_SRCALPHA);
+}
+
+void
+gBlitGlyphRun( CardState          *state,
+               const DFBRectangle *rects,
+               const DFBPoint     *points,
+               int                 num )
+{
+     GenefxState   *gfxs;
+     GlyphSpanFunc  span;
+     GlyphColor     color;
+
+     D_ASSERT( state != NULL );
+     D_ASSERT( state->gfxs != NULL );
+     D_ASSERT( rects != NULL );
+     D_ASSERT( points != NULL );
+
+     gfxs = state->gfxs;
+     span = Glyph_span_PFI[DFB_PIXELFORMAT_INDEX(gfxs->dst_format)];
+
+     D_ASSERT( span != NULL );
+
+     D_DEBUG_AT( Genefx_Glyphs, "%s( %d ) -> %s\n", __FUNCTION__, num, dfb_pixelformat_name( gfxs->dst_format ) );
+
+     if (dfb_config->software_warn) {
+          D_WARN( "GlyphRun (%4d) %6s, flags 0x%08x, funcs %u/%u, color 0x%02x%02x%02x%02x",
+                  num, dfb_pixelformat_name( gfxs->dst_format ), state->blittingflags,
+                  state->src_blend, state->dst_blend, state->color.a, state->color.r, state->color.g, state->color.b );
+     }
+
+     color.r             = gfxs->color.r;
+     color.g             = gfxs->color.g;
+     color.b             = gfxs->color.b;
+     color.ca            = (state->blittingflags & DSBLIT_BLEND_COLORALPHA) ? gfxs->color.a + 1 : 0x100;
+     color.premultiplied = state->src_blend == DSBF_ONE;
+
+     switch (gfxs->dst_format) {
+          case DSPF_RGB16:
+               color.opaque = PIXEL_RGB16( color.r, color.g, color.b );
+               break;
+          case DSPF_RGB32:
+               color.opaque = PIXEL_RGB32( color.r, color.g, color.b );
+               break;
+          default:
+               color.opaque = PIXEL_ARGB( 0xff, color.r, color.g, color.b );
+               break;
+     }
+
+     while (num > 0) {
+          Glyph glyphs[GLYPH_RUN_MAX];
+          int   count = 0;
+          int   n     = MIN( num, GLYPH_RUN_MAX );
+          int   y1    = state->clip.y2 + 1;
+          int   y2    = state->clip.y1 - 1;
+          int   i, y;
+
+          for (i = 0; i < n; i++) {
+               DFBRectangle  srect = rects[i];
+               int           dx    = points[i].x;
+               int           dy    = points[i].y;
+               Glyph        *glyph = &glyphs[count];
+
+               if (!dfb_clip_blit_precheck( &state->clip, srect.w, srect.h, dx, dy ))
+                    continue;
+
+               dfb_clip_blit( &state->clip, &srect, &dx, &dy );
+
+               glyph->src = (const u8*) gfxs->src_org[0] + srect.y * gfxs->src_pitch + srect.x;
+               glyph->dst = (u8*) gfxs->dst_org[0] + dy * gfxs->dst_pitch + dx * gfxs->dst_bpp;
+               glyph->y   = dy;
+               glyph->w   = srect.w;
+               glyph->h   = srect.h;
+
+               y1 = MIN( y1, dy );
+               y2 = MAX( y2, dy + srect.h - 1 );
+
+               count++;
+          }
+
+          /* Composite each destination line once, overlapping glyphs in the order of the run. */
+          for (y = y1; y <= y2; y++) {
+               for (i = 0; i < count; i++) {
+                    const Glyph *glyph = &glyphs[i];
+                    int          line  = y - glyph->y;
+
+                    if (line < 0 || line >= glyph->h)
+                         continue;
+
+                    span( glyph->src + line * gfxs->src_pitch, glyph->dst + line * gfxs->dst_pitch, glyph->w, &color );
+               }
+          }
+
+          rects  += n;
+          points += n;
+          num    -= n;
+     }
+}
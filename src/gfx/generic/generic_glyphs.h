@@ -0,0 +1,46 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#ifndef __GENERIC_GLYPHS_H__
+#define __GENERIC_GLYPHS_H__
+
+#include <core/coretypes.h>
+
+/**********************************************************************************************************************/
+
+/*
+ * Check if the blits of the acquired state are colorized A8 glyphs composited with SRC_OVER into a destination
+ * supported by gBlitGlyphRun().
+ */
+bool gBlitGlyphRunCheck       ( CardState          *state );
+
+/*
+ * Composite a run of glyph blits scanline by scanline in one pass, the rectangles are clipped to the state.
+ * The state must have been acquired for DFXL_BLIT and passed gBlitGlyphRunCheck().
+ */
+void gBlitGlyphRun            ( CardState          *state,
+                                const DFBRectangle *rects,
+                                const DFBPoint     *points,
+                                int                 num );
+
+/*
+ * Use the SSE2 span kernels (called by gGetDriverInfo()).
+ */
+void Genefx_Glyphs_init_SSE2  ( void );
+
+#endif
@@ -0,0 +1,615 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <config.h>
+#include <core/state.h>
+#include <direct/mem.h>
+#include <direct/util.h>
+#include <directfb_util.h>
+#include <gfx/convert.h>
+#include <gfx/generic/generic.h>
+#include <gfx/generic/generic_scale.h>
+#include <gfx/generic/generic_util.h>
+#include <misc/conf.h>
+
+D_DEBUG_DOMAIN( Genefx_SmoothScale, "Genefx/Scale", "Genefx Smooth Scaler" );
+
+/**********************************************************************************************************************/
+
+/*
+ * Weights are 1.14 fixed point. Each source row is filtered horizontally into 16 bit intermediates with 6 fractional
+ * bits, which are filtered vertically into 8 bit channels.
+ */
+#define SCALE_WEIGHT_BITS 14
+#define SCALE_ROW_SHIFT   8
+#define SCALE_COL_SHIFT   (2 * SCALE_WEIGHT_BITS - SCALE_ROW_SHIFT)
+
+typedef struct {
+     int          taps;                          /* number of taps for each destination pixel */
+     int          count;                         /* number of destination pixels */
+     int         *start;                         /* first source pixel of each destination pixel */
+     s16         *weights;                       /* taps of each destination pixel */
+} ScaleAxis;
+
+typedef struct {
+     int          channels;                      /* interleaved 8 bit channels */
+     bool         rgb16;                         /* pixels are expanded to 4 channels */
+
+     const u8    *src;
+     int          src_pitch;
+     DFBRectangle srect;
+
+     u8          *dst;
+     int          dst_pitch;
+     DFBRectangle drect;
+     DFBRegion    clip;                          /* relative to drect */
+} ScalePlane;
+
+/* Lanczos3 kernel at x = i / 64 */
+static const s16 lanczos3_table[193] = {
+     16384, 16377, 16355, 16318, 16267, 16202, 16122, 16028, 15921, 15799, 15664, 15515,
+     15354, 15179, 14993, 14794, 14583, 14361, 14128, 13884, 13630, 13366, 13093, 12811,
+     12521, 12223, 11917, 11605, 11287, 10962, 10633, 10299,  9960,  9618,  9273,  8926,
+      8576,  8226,  7874,  7522,  7170,  6819,  6470,  6122,  5776,  5434,  5094,  4758,
+      4427,  4100,  3778,  3462,  3151,  2847,  2549,  2258,  1975,  1699,  1431,  1171,
+       919,   676,   442,   216,     0,  -207,  -405,  -593,  -772,  -941, -1101, -1251,
+     -1391, -1522, -1643, -1755, -1858, -1951, -2035, -2111, -2177, -2235, -2284, -2325,
+     -2358, -2383, -2400, -2410, -2413, -2409, -2398, -2381, -2359, -2330, -2296, -2257,
+     -2213, -2165, -2113, -2056, -1996, -1933, -1867, -1799, -1728, -1654, -1580, -1504,
+     -1426, -1348, -1269, -1190, -1111, -1032,  -953,  -875,  -798,  -721,  -646,  -573,
+      -501,  -431,  -362,  -296,  -232,  -170,  -111,   -54,     0,    52,   100,   147,
+       190,   230,   268,   303,   335,   364,   390,   414,   435,   453,   468,   481,
+       492,   500,   506,   509,   511,   510,   507,   503,   497,   489,   479,   469,
+       457,   444,   429,   414,   398,   382,   365,   347,   329,   311,   292,   274,
+       256,   237,   219,   202,   184,   167,   151,   136,   121,   106,    93,    80,
+        68,    57,    47,    38,    30,    23,    17,    12,     7,     4,     2,     0,
+         0,
+};
+
+/**********************************************************************************************************************/
+
+static __inline__ s64
+lanczos3( s64 x )
+{
+     int idx  = x >> 10;
+     int frac = (x << 6) & 0xffff;
+
+     if (idx >= 192)
+          return 0;
+
+     return lanczos3_table[idx] + (((lanczos3_table[idx+1] - lanczos3_table[idx]) * frac) >> 16);
+}
+
+static int
+scale_taps( int                   src_size,
+            int                   dst_size,
+            DFBConfigSmoothScaler quality )
+{
+     int taps;
+
+     if (src_size <= dst_size)
+          taps = 2;
+     else if (quality == DCSS_BEST)
+          taps = (6 * src_size + dst_size - 1) / dst_size + 1;
+     else
+          taps = (src_size + dst_size - 1) / dst_size + 1;
+
+     return taps;
+}
+
+/*
+ * Compute the taps of 'count' destination pixels starting at 'first'.
+ * Taps outside of the source are folded onto the edge pixels.
+ */
+static void
+scale_axis_init( ScaleAxis             *axis,
+                 int                    src_size,
+                 int                    dst_size,
+                 int                    first,
+                 DFBConfigSmoothScaler  quality,
+                 s64                   *raw )
+{
+     int taps  = axis->taps;
+     s64 ratio = ((s64) src_size << 16) / dst_size;
+     int i, j, k;
+
+     for (i = 0; i < axis->count; i++) {
+          int  n   = first + i;
+          s64  c   = (((s64) (2 * n + 1) * src_size) << 16) / (2 * dst_size) - 0x8000;
+          s16 *w   = axis->weights + i * taps;
+          s64  sum = 0;
+          int  jlo, jhi;
+          int  start, max;
+
+          if (src_size <= dst_size) {
+               jlo    = c >> 16;
+               jhi    = jlo + 1;
+               raw[0] = 0x10000 - (c & 0xffff);
+               raw[1] = c & 0xffff;
+          }
+          else if (quality == DCSS_BEST) {
+               jlo = ((c - 3 * ratio) >> 16) + 1;
+               jhi = (c + 3 * ratio - 1) >> 16;
+
+               for (j = jlo; j <= jhi; j++)
+                    raw[j-jlo] = lanczos3( (ABS( (s64) j * 0x10000 - c ) << 16) / ratio );
+          }
+          else {
+               s64 a = ((s64) n * src_size << 16) / dst_size;
+               s64 b = ((s64) (n + 1) * src_size << 16) / dst_size;
+
+               jlo = a >> 16;
+               jhi = (b - 1) >> 16;
+
+               for (j = jlo; j <= jhi; j++)
+                    raw[j-jlo] = MIN( b, (s64) (j + 1) << 16 ) - MAX( a, (s64) j << 16 );
+          }
+
+          start = MIN( MAX( jlo, 0 ), src_size - taps );
+
+          axis->start[i] = start;
+
+          for (k = 0; k < taps; k++)
+               w[k] = 0;
+
+          for (j = jlo; j <= jhi; j++)
+               sum += raw[j-jlo];
+
+          /* Normalize the weights, giving the rounding error to the largest one. */
+          for (j = jlo, max = 0; j <= jhi; j++) {
+               k = CLAMP( j, 0, src_size - 1 ) - start;
+
+               D_ASSERT( k >= 0 && k < taps );
+
+               w[k] += raw[j-jlo] * (1 << SCALE_WEIGHT_BITS) / sum;
+          }
+
+          for (k = 0, sum = 0; k < taps; k++) {
+               sum += w[k];
+
+               if (w[k] > w[max])
+                    max = k;
+          }
+
+          w[max] += (1 << SCALE_WEIGHT_BITS) - sum;
+     }
+}
+
+/**********************************************************************************************************************/
+
+static void
+scale_row_C( const ScaleAxis *axis,
+             const u8        *src,
+             s16             *dst,
+             int              channels )
+{
+     int x, c, k;
+     int taps = axis->taps;
+
+     for (x = 0; x < axis->count; x++) {
+          const u8  *S = src + axis->start[x] * channels;
+          const s16 *w = axis->weights + x * taps;
+
+          for (c = 0; c < channels; c++) {
+               int sum = 1 << (SCALE_ROW_SHIFT - 1);
+
+               for (k = 0; k < taps; k++)
+                    sum += w[k] * S[k*channels+c];
+
+               *dst++ = sum >> SCALE_ROW_SHIFT;
+          }
+     }
+}
+
+static void
+scale_column_C( s16 * const *rows,
+                const s16   *w,
+                int          taps,
+                u8          *dst,
+                int          from,
+                int          to )
+{
+     int i, k;
+
+     for (i = from; i < to; i++) {
+          int sum = 1 << (SCALE_COL_SHIFT - 1);
+
+          for (k = 0; k < taps; k++)
+               sum += w[k] * rows[k][i];
+
+          sum >>= SCALE_COL_SHIFT;
+
+          dst[i] = (sum < 0) ? 0 : (sum > 0xff) ? 0xff : sum;
+     }
+}
+
+/**********************************************************************************************************************/
+
+#ifdef USE_SSE
+
+/* four channels, two taps per iteration */
+static SSE2_FUNC void
+scale_row_4_SSE2( const ScaleAxis *axis,
+                  const u8        *src,
+                  s16             *dst )
+{
+     int     x, k;
+     int     taps = axis->taps;
+     __m128i zero = _mm_setzero_si128();
+
+     for (x = 0; x < axis->count; x++) {
+          const u8  *S   = src + axis->start[x] * 4;
+          const s16 *w   = axis->weights + x * taps;
+          __m128i    sum = _mm_set1_epi32( 1 << (SCALE_ROW_SHIFT - 1) );
+
+          for (k = 0; k + 1 < taps; k += 2) {
+               __m128i p = _mm_unpacklo_epi8( _mm_loadl_epi64( (const __m128i*) (S + k * 4) ), zero );
+
+               p   = _mm_unpacklo_epi16( p, _mm_srli_si128( p, 8 ) );
+               sum = _mm_add_epi32( sum, _mm_madd_epi16( p, _mm_set1_epi32( (u16) w[k] | ((u32) (u16) w[k+1] << 16) ) ) );
+          }
+
+          if (k < taps) {
+               __m128i p = _mm_unpacklo_epi8( _mm_cvtsi32_si128( *(const u32*) (S + k * 4) ), zero );
+
+               p   = _mm_unpacklo_epi16( p, zero );
+               sum = _mm_add_epi32( sum, _mm_madd_epi16( p, _mm_set1_epi32( (u16) w[k] ) ) );
+          }
+
+          sum = _mm_srai_epi32( sum, SCALE_ROW_SHIFT );
+
+          _mm_storel_epi64( (__m128i*) dst, _mm_packs_epi32( sum, sum ) );
+
+          dst += 4;
+     }
+}
+
+/* one channel, eight taps per iteration */
+static SSE2_FUNC void
+scale_row_1_SSE2( const ScaleAxis *axis,
+                  const u8        *src,
+                  s16             *dst )
+{
+     int     x, k;
+     int     taps = axis->taps;
+     __m128i zero = _mm_setzero_si128();
+
+     for (x = 0; x < axis->count; x++) {
+          const u8  *S   = src + axis->start[x];
+          const s16 *w   = axis->weights + x * taps;
+          __m128i    acc = zero;
+          int        sum;
+
+          for (k = 0; k + 8 <= taps; k += 8) {
+               __m128i p = _mm_unpacklo_epi8( _mm_loadl_epi64( (const __m128i*) (S + k) ), zero );
+
+               acc = _mm_add_epi32( acc, _mm_madd_epi16( p, _mm_loadu_si128( (const __m128i*) (w + k) ) ) );
+          }
+
+          acc = _mm_add_epi32( acc, _mm_srli_si128( acc, 8 ) );
+          acc = _mm_add_epi32( acc, _mm_srli_si128( acc, 4 ) );
+          sum = _mm_cvtsi128_si32( acc ) + (1 << (SCALE_ROW_SHIFT - 1));
+
+          for (; k < taps; k++)
+               sum += w[k] * S[k];
+
+          *dst++ = sum >> SCALE_ROW_SHIFT;
+     }
+}
+
+/* eight intermediates of two rows per iteration */
+static SSE2_FUNC void
+scale_column_SSE2( s16 * const *rows,
+                   const s16   *w,
+                   int          taps,
+                   u8          *dst,
+                   int          length )
+{
+     int     i, k;
+     __m128i zero = _mm_setzero_si128();
+
+     for (i = 0; i + 8 <= length; i += 8) {
+          __m128i lo = _mm_set1_epi32( 1 << (SCALE_COL_SHIFT - 1) );
+          __m128i hi = lo;
+
+          for (k = 0; k < taps; k += 2) {
+               __m128i a = _mm_loadu_si128( (const __m128i*) (rows[k] + i) );
+               __m128i b = zero;
+               u32     f = (u16) w[k];
+
+               if (k + 1 < taps) {
+                    b  = _mm_loadu_si128( (const __m128i*) (rows[k+1] + i) );
+                    f |= (u32) (u16) w[k+1] << 16;
+               }
+
+               lo = _mm_add_epi32( lo, _mm_madd_epi16( _mm_unpacklo_epi16( a, b ), _mm_set1_epi32( f ) ) );
+               hi = _mm_add_epi32( hi, _mm_madd_epi16( _mm_unpackhi_epi16( a, b ), _mm_set1_epi32( f ) ) );
+          }
+
+          lo = _mm_packs_epi32( _mm_srai_epi32( lo, SCALE_COL_SHIFT ), _mm_srai_epi32( hi, SCALE_COL_SHIFT ) );
+
+          _mm_storel_epi64( (__m128i*) (dst + i), _mm_packus_epi16( lo, lo ) );
+     }
+
+     scale_column_C( rows, w, taps, dst, i, length );
+}
+
+#endif
+
+/**********************************************************************************************************************/
+
+static bool
+scale_plane( const ScalePlane      *plane,
+             DFBConfigSmoothScaler  quality,
+             bool                   sse )
+{
+     ScaleAxis   h, v;
+     int         channels = plane->rgb16 ? 4 : plane->channels;
+     int         width    = plane->clip.x2 - plane->clip.x1 + 1;
+     int         length   = width * channels;
+     int         bpp      = plane->rgb16 ? 2 : plane->channels;
+     int         x, y, k;
+     int         span;
+     size_t      size;
+     void       *mem;
+     s64        *raw;
+     s16        *ring;
+     s16       **rows;
+     int        *ring_y;
+     u8         *expand = NULL;
+     u8         *line   = NULL;
+
+     /* Before folding, a destination pixel covers up to the unclamped number of taps plus one. */
+     h.taps  = scale_taps( plane->srect.w, plane->drect.w, quality );
+     v.taps  = scale_taps( plane->srect.h, plane->drect.h, quality );
+     span    = MAX( h.taps, v.taps ) + 2;
+
+     h.taps  = MIN( h.taps, plane->srect.w );
+     h.count = width;
+     v.taps  = MIN( v.taps, plane->srect.h );
+     v.count = plane->clip.y2 - plane->clip.y1 + 1;
+
+     size = v.taps * sizeof(s16*) +
+            (h.count + v.count + v.taps) * sizeof(int) +
+            (h.count * h.taps + v.count * v.taps) * sizeof(s16) +
+            span * sizeof(s64) +
+            v.taps * length * sizeof(s16) +
+            (plane->rgb16 ? (plane->srect.w + width) * 4 : 0) + 64;
+
+     mem = D_MALLOC( size );
+     if (!mem) {
+          D_WARN( "out of memory" );
+          return false;
+     }
+
+     rows      = mem;
+     raw       = (s64*) (rows + v.taps);
+     h.start   = (int*) (raw + span);
+     v.start   = h.start + h.count;
+     ring_y    = v.start + v.count;
+     h.weights = (s16*) (ring_y + v.taps);
+     v.weights = h.weights + h.count * h.taps;
+     ring      = v.weights + v.count * v.taps;
+
+     if (plane->rgb16) {
+          expand = (u8*) (((unsigned long) (ring + v.taps * length) + 3) & ~3UL);
+          line   = expand + plane->srect.w * 4;
+     }
+
+     scale_axis_init( &h, plane->srect.w, plane->drect.w, plane->clip.x1, quality, raw );
+     scale_axis_init( &v, plane->srect.h, plane->drect.h, plane->clip.y1, quality, raw );
+
+     for (k = 0; k < v.taps; k++)
+          ring_y[k] = -1;
+
+     for (y = 0; y < v.count; y++) {
+          u8 *dst = plane->dst + (plane->drect.y + plane->clip.y1 + y) * plane->dst_pitch +
+                    (plane->drect.x + plane->clip.x1) * bpp;
+
+          /* Filter the source rows of this destination row horizontally, unless done for the previous rows. */
+          for (k = 0; k < v.taps; k++) {
+               int  sy   = v.start[y] + k;
+               int  slot = sy % v.taps;
+               s16 *row  = ring + slot * length;
+
+               if (ring_y[slot] != sy) {
+                    const u8 *src = plane->src + (plane->srect.y + sy) * plane->src_pitch + plane->srect.x * bpp;
+
+                    if (plane->rgb16) {
+                         const u16 *S = (const u16*) src;
+                         u32       *E = (u32*) expand;
+
+                         for (x = 0; x < plane->srect.w; x++)
+                              E[x] = RGB16_TO_ARGB( S[x] );
+
+                         src = expand;
+                    }
+
+#ifdef USE_SSE
+                    if (sse && channels == 4)
+                         scale_row_4_SSE2( &h, src, row );
+                    else if (sse && channels == 1 && h.taps >= 8)
+                         scale_row_1_SSE2( &h, src, row );
+                    else
+#endif
+                         scale_row_C( &h, src, row, channels );
+
+                    ring_y[slot] = sy;
+               }
+
+               rows[k] = row;
+          }
+
+#ifdef USE_SSE
+          if (sse)
+               scale_column_SSE2( rows, v.weights + y * v.taps, v.taps, line ?: dst, length );
+          else
+#endif
+               scale_column_C( rows, v.weights + y * v.taps, v.taps, line ?: dst, 0, length );
+
+          if (plane->rgb16) {
+               const u32 *L = (const u32*) line;
+               u16       *D = (u16*) dst;
+
+               for (x = 0; x < width; x++)
+                    D[x] = ARGB_TO_RGB16( L[x] );
+          }
+     }
+
+     D_FREE( mem );
+
+     return true;
+}
+
+/**********************************************************************************************************************/
+
+bool
+Genefx_Scale( CardState    *state,
+              DFBRectangle *srect,
+              DFBRectangle *drect )
+{
+     GenefxState           *gfxs    = state->gfxs;
+     DFBConfigSmoothScaler  quality = dfb_config->smooth_scaler;
+     bool                   sse     = false;
+     ScalePlane             planes[3];
+     int                    num     = 1;
+     int                    i;
+     DFBRegion              clip;
+
+     D_ASSERT( state != NULL );
+     D_ASSERT( gfxs != NULL );
+     DFB_RECTANGLE_ASSERT( srect );
+     DFB_RECTANGLE_ASSERT( drect );
+
+     if (quality == DCSS_LEGACY)
+          return false;
+
+     if (srect->w > drect->w && srect->h > drect->h) {
+          if (!(state->render_options & DSRO_SMOOTH_DOWNSCALE))
+               return false;
+     }
+     else {
+          if (!(state->render_options & DSRO_SMOOTH_UPSCALE))
+               return false;
+     }
+
+     if (state->blittingflags != DSBLIT_NOFX || gfxs->src_format != gfxs->dst_format)
+          return false;
+
+     if (gfxs->src_org[0] == gfxs->dst_org[0] || ((gfxs->src_caps | gfxs->dst_caps) & DSCAPS_SEPARATED))
+          return false;
+
+     clip = state->clip;
+
+     if (!dfb_region_rectangle_intersect( &clip, drect ))
+          return false;
+
+     dfb_region_translate( &clip, - drect->x, - drect->y );
+
+     planes[0].channels  = DFB_BYTES_PER_PIXEL( gfxs->dst_format );
+     planes[0].rgb16     = false;
+     planes[0].src       = gfxs->src_org[0];
+     planes[0].src_pitch = gfxs->src_pitch;
+     planes[0].srect     = *srect;
+     planes[0].dst       = gfxs->dst_org[0];
+     planes[0].dst_pitch = gfxs->dst_pitch;
+     planes[0].drect     = *drect;
+     planes[0].clip      = clip;
+
+     switch (gfxs->dst_format) {
+          case DSPF_ARGB:
+          case DSPF_ABGR:
+          case DSPF_RGB32:
+               break;
+
+          case DSPF_RGB16:
+               planes[0].rgb16 = true;
+               break;
+
+          case DSPF_I420:
+          case DSPF_YV12:
+          case DSPF_YV16:
+          case DSPF_YUV444P:
+          case DSPF_NV12:
+          case DSPF_NV21:
+          case DSPF_NV16:
+          case DSPF_NV61:
+               planes[1] = planes[0];
+
+               if (gfxs->dst_format != DSPF_YUV444P) {
+                    planes[1].srect.x /= 2;
+                    planes[1].srect.w  = MAX( srect->w / 2, 1 );
+                    planes[1].drect.x /= 2;
+                    planes[1].drect.w  = MAX( drect->w / 2, 1 );
+                    planes[1].clip.x1 /= 2;
+                    planes[1].clip.x2  = MIN( clip.x2 / 2, planes[1].drect.w - 1 );
+               }
+
+               if (gfxs->dst_format == DSPF_I420 || gfxs->dst_format == DSPF_YV12 ||
+                   gfxs->dst_format == DSPF_NV12 || gfxs->dst_format == DSPF_NV21) {
+                    planes[1].srect.y /= 2;
+                    planes[1].srect.h  = MAX( srect->h / 2, 1 );
+                    planes[1].drect.y /= 2;
+                    planes[1].drect.h  = MAX( drect->h / 2, 1 );
+                    planes[1].clip.y1 /= 2;
+                    planes[1].clip.y2  = MIN( clip.y2 / 2, planes[1].drect.h - 1 );
+               }
+
+               planes[1].src = gfxs->src_org[1];
+               planes[1].dst = gfxs->dst_org[1];
+
+               if (gfxs->dst_format != DSPF_NV12 && gfxs->dst_format != DSPF_NV21 &&
+                   gfxs->dst_format != DSPF_NV16 && gfxs->dst_format != DSPF_NV61) {
+                    if (gfxs->dst_format != DSPF_YUV444P) {
+                         planes[1].src_pitch /= 2;
+                         planes[1].dst_pitch /= 2;
+                    }
+
+                    planes[2]     = planes[1];
+                    planes[2].src = gfxs->src_org[2];
+                    planes[2].dst = gfxs->dst_org[2];
+
+                    num = 3;
+               }
+               else {
+                    planes[1].channels = 2;
+
+                    num = 2;
+               }
+               break;
+
+          default:
+               return false;
+     }
+
+#ifdef USE_SSE
+     sse = dfb_config->sse && __builtin_cpu_supports( "sse2" );
+#endif
+
+     D_DEBUG_AT( Genefx_SmoothScale, "%s( %4d,%4d-%4dx%4d -> %4d,%4d-%4dx%4d ) <- %s, quality %d\n", __FUNCTION__,
+                 DFB_RECTANGLE_VALS( srect ), DFB_RECTANGLE_VALS( drect ),
+                 dfb_pixelformat_name( gfxs->dst_format ), quality );
+
+     /* Only the first plane may fall back, as the others need less memory. */
+     for (i = 0; i < num; i++) {
+          if (!scale_plane( &planes[i], quality, sse ) && i == 0)
+               return false;
+     }
+
+     return true;
+}
@@ -0,0 +1,770 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+#include <gfx/generic/generic_util.h>
+
+/*
+ * The kernels are compiled with per function target attributes (SSE2_FUNC and AVX2_FUNC), the instruction set actually
+ * used is selected at runtime (see gInit_SSE2() and gInit_AVX2()).
+ *
+ * A GenefxAccumulator is 4 x u16 (b, g, r, a), so a 128 bit register holds 2 accumulators and a 256 bit register 4.
+ * Accumulators having a flag in the upper nibble of the alpha channel (0xf000) are left untouched, like in C code.
+ */
+
+/**********************************************************************************************************************
+ ********************************* SSE2 helpers ***********************************************************************
+ **********************************************************************************************************************/
+
+/* (x * f) >> 8 computed with 32 bit intermediates, truncated to 16 bit */
+static inline SSE2_FUNC __m128i
+mul8_SSE2( __m128i x, __m128i f )
+{
+     return _mm_or_si128( _mm_srli_epi16( _mm_mullo_epi16( x, f ), 8 ),
+                          _mm_slli_epi16( _mm_mulhi_epu16( x, f ), 8 ) );
+}
+
+/* all ones for accumulators without flag, zero otherwise */
+static inline SSE2_FUNC __m128i
+keep_SSE2( __m128i x )
+{
+     __m128i flag = _mm_cmpeq_epi16( _mm_and_si128( x, _mm_set1_epi64x( 0xf000000000000000ll ) ),
+                                     _mm_setzero_si128() );
+
+     return _mm_shufflehi_epi16( _mm_shufflelo_epi16( flag, _MM_SHUFFLE(3,3,3,3) ), _MM_SHUFFLE(3,3,3,3) );
+}
+
+static inline SSE2_FUNC __m128i
+select_SSE2( __m128i mask, __m128i a, __m128i b )
+{
+     return _mm_or_si128( _mm_and_si128( mask, a ), _mm_andnot_si128( mask, b ) );
+}
+
+static inline SSE2_FUNC __m128i
+alpha_SSE2( __m128i x )
+{
+     return _mm_shufflehi_epi16( _mm_shufflelo_epi16( x, _MM_SHUFFLE(3,3,3,3) ), _MM_SHUFFLE(3,3,3,3) );
+}
+
+/* channels having bits in the upper byte are saturated to 0xff */
+static inline SSE2_FUNC __m128i
+clamp_SSE2( __m128i x )
+{
+     __m128i ok = _mm_cmpeq_epi16( _mm_and_si128( x, _mm_set1_epi16( 0xff00 ) ), _mm_setzero_si128() );
+
+     return select_SSE2( ok, x, _mm_set1_epi16( 0x00ff ) );
+}
+
+/**********************************************************************************************************************
+ ********************************* AVX2 helpers ***********************************************************************
+ **********************************************************************************************************************/
+
+static inline AVX2_FUNC __m256i
+mul8_AVX2( __m256i x, __m256i f )
+{
+     return _mm256_or_si256( _mm256_srli_epi16( _mm256_mullo_epi16( x, f ), 8 ),
+                             _mm256_slli_epi16( _mm256_mulhi_epu16( x, f ), 8 ) );
+}
+
+static inline AVX2_FUNC __m256i
+keep_AVX2( __m256i x )
+{
+     __m256i flag = _mm256_cmpeq_epi16( _mm256_and_si256( x, _mm256_set1_epi64x( 0xf000000000000000ll ) ),
+                                        _mm256_setzero_si256() );
+
+     return _mm256_shufflehi_epi16( _mm256_shufflelo_epi16( flag, _MM_SHUFFLE(3,3,3,3) ), _MM_SHUFFLE(3,3,3,3) );
+}
+
+static inline AVX2_FUNC __m256i
+select_AVX2( __m256i mask, __m256i a, __m256i b )
+{
+     return _mm256_or_si256( _mm256_and_si256( mask, a ), _mm256_andnot_si256( mask, b ) );
+}
+
+static inline AVX2_FUNC __m256i
+alpha_AVX2( __m256i x )
+{
+     return _mm256_shufflehi_epi16( _mm256_shufflelo_epi16( x, _MM_SHUFFLE(3,3,3,3) ), _MM_SHUFFLE(3,3,3,3) );
+}
+
+static inline AVX2_FUNC __m256i
+clamp_AVX2( __m256i x )
+{
+     __m256i ok = _mm256_cmpeq_epi16( _mm256_and_si256( x, _mm256_set1_epi16( 0xff00 ) ), _mm256_setzero_si256() );
+
+     return select_AVX2( ok, x, _mm256_set1_epi16( 0x00ff ) );
+}
+
+/**********************************************************************************************************************
+ ********************************* Sop_PFI_to_Dacc ********************************************************************
+ **********************************************************************************************************************/
+
+static inline SSE2_FUNC void
+argb_to_acc_SSE2( const u32 *S, GenefxAccumulator *D, int w, __m128i or )
+{
+     __m128i zero = _mm_setzero_si128();
+
+     for (; w >= 4; w -= 4) {
+          __m128i s = _mm_loadu_si128( (const __m128i*) S );
+
+          _mm_storeu_si128( (__m128i*) D,     _mm_or_si128( _mm_unpacklo_epi8( s, zero ), or ) );
+          _mm_storeu_si128( (__m128i*) D + 1, _mm_or_si128( _mm_unpackhi_epi8( s, zero ), or ) );
+
+          S += 4;
+          D += 4;
+     }
+
+     for (; w; w--) {
+          __m128i s = _mm_cvtsi32_si128( *S++ );
+
+          _mm_storel_epi64( (__m128i*) D++, _mm_or_si128( _mm_unpacklo_epi8( s, zero ), or ) );
+     }
+}
+
+static inline AVX2_FUNC void
+argb_to_acc_AVX2( const u32 *S, GenefxAccumulator *D, int w, __m128i or )
+{
+     __m256i or2 = _mm256_broadcastsi128_si256( or );
+
+     for (; w >= 8; w -= 8) {
+          __m256i d0 = _mm256_cvtepu8_epi16( _mm_loadu_si128( (const __m128i*) S ) );
+          __m256i d1 = _mm256_cvtepu8_epi16( _mm_loadu_si128( (const __m128i*) S + 1 ) );
+
+          _mm256_storeu_si256( (__m256i*) D,     _mm256_or_si256( d0, or2 ) );
+          _mm256_storeu_si256( (__m256i*) D + 1, _mm256_or_si256( d1, or2 ) );
+
+          S += 8;
+          D += 8;
+     }
+
+     argb_to_acc_SSE2( S, D, w, or );
+}
+
+static SSE2_FUNC void
+Sop_argb_to_Dacc_SSE2( GenefxState *gfxs )
+{
+     if (gfxs->Ostep != 1) {
+          Sop_argb_to_Dacc( gfxs );
+          return;
+     }
+
+     argb_to_acc_SSE2( gfxs->Sop[0], gfxs->Dacc, gfxs->length, _mm_setzero_si128() );
+}
+
+static SSE2_FUNC void
+Sop_rgb32_to_Dacc_SSE2( GenefxState *gfxs )
+{
+     if (gfxs->Ostep != 1) {
+          Sop_rgb32_to_Dacc( gfxs );
+          return;
+     }
+
+     argb_to_acc_SSE2( gfxs->Sop[0], gfxs->Dacc, gfxs->length, _mm_set1_epi64x( 0x00ff000000000000ll ) );
+}
+
+static AVX2_FUNC void
+Sop_argb_to_Dacc_AVX2( GenefxState *gfxs )
+{
+     if (gfxs->Ostep != 1) {
+          Sop_argb_to_Dacc( gfxs );
+          return;
+     }
+
+     argb_to_acc_AVX2( gfxs->Sop[0], gfxs->Dacc, gfxs->length, _mm_setzero_si128() );
+}
+
+static AVX2_FUNC void
+Sop_rgb32_to_Dacc_AVX2( GenefxState *gfxs )
+{
+     if (gfxs->Ostep != 1) {
+          Sop_rgb32_to_Dacc( gfxs );
+          return;
+     }
+
+     argb_to_acc_AVX2( gfxs->Sop[0], gfxs->Dacc, gfxs->length, _mm_set1_epi64x( 0x00ff000000000000ll ) );
+}
+
+/**********************************************************************************************************************
+ ********************************* Sop_PFI_TEX_filter_to_Dacc *********************************************************
+ **********************************************************************************************************************/
+
+/* bilinear lookup of both rows at once, matching tex_filter_argb() */
+static inline SSE2_FUNC void
+argb_filter_to_acc_SSE2( GenefxState *gfxs, __m128i and, __m128i or )
+{
+     int                s     = gfxs->s;
+     int                t     = gfxs->t;
+     int                w     = gfxs->length + 1;
+     const u32         *S     = gfxs->Sop[0];
+     GenefxAccumulator *D     = gfxs->Dacc;
+     int                sp4   = gfxs->src_pitch / 4;
+     int                sw    = gfxs->src_width;
+     int                sh    = gfxs->src_height;
+     int                SperD = gfxs->SperD;
+     int                TperD = gfxs->TperD;
+     __m128i            zero  = _mm_setzero_si128();
+     __m128i            one   = _mm_set1_epi16( 256 );
+
+     while (--w) {
+          TEX_FILTER_SETUP();
+
+          __m128i l = _mm_unpacklo_epi8( _mm_unpacklo_epi32( _mm_cvtsi32_si128( S[y0*sp4+x0] ),
+                                                             _mm_cvtsi32_si128( S[y1*sp4+x0] ) ), zero );
+          __m128i r = _mm_unpacklo_epi8( _mm_unpacklo_epi32( _mm_cvtsi32_si128( S[y0*sp4+x1] ),
+                                                             _mm_cvtsi32_si128( S[y1*sp4+x1] ) ), zero );
+          __m128i f = _mm_set1_epi16( fx );
+          __m128i g = _mm_set1_epi16( fy );
+          __m128i h = _mm_srli_epi16( _mm_add_epi16( _mm_mullo_epi16( l, _mm_sub_epi16( one, f ) ),
+                                                     _mm_mullo_epi16( r, f ) ), 8 );
+          __m128i p = _mm_srli_epi16( _mm_add_epi16( _mm_mullo_epi16( h, _mm_sub_epi16( one, g ) ),
+                                                     _mm_mullo_epi16( _mm_srli_si128( h, 8 ), g ) ), 8 );
+
+          _mm_storel_epi64( (__m128i*) D, _mm_or_si128( _mm_and_si128( p, and ), or ) );
+
+          ++D;
+          s += SperD;
+          t += TperD;
+     }
+}
+
+static SSE2_FUNC void
+Sop_argb_TEX_filter_to_Dacc_SSE2( GenefxState *gfxs )
+{
+     argb_filter_to_acc_SSE2( gfxs, _mm_set1_epi32( -1 ), _mm_setzero_si128() );
+}
+
+static SSE2_FUNC void
+Sop_rgb32_TEX_filter_to_Dacc_SSE2( GenefxState *gfxs )
+{
+     argb_filter_to_acc_SSE2( gfxs, _mm_set1_epi64x( 0x0000ffffffffffffll ), _mm_set1_epi64x( 0x00ff000000000000ll ) );
+}
+
+/**********************************************************************************************************************
+ ********************************* Sacc_to_Aop_PFI ********************************************************************
+ **********************************************************************************************************************/
+
+static inline SSE2_FUNC __m128i
+acc_to_argb_SSE2( __m128i s0, __m128i s1, __m128i d, __m128i or )
+{
+     __m128i keep = _mm_packs_epi16( keep_SSE2( s0 ), keep_SSE2( s1 ) );
+     __m128i p    = _mm_or_si128( _mm_packus_epi16( clamp_SSE2( s0 ), clamp_SSE2( s1 ) ), or );
+
+     return select_SSE2( keep, p, d );
+}
+
+static inline SSE2_FUNC void
+acc_to_argb_SSE2_span( const GenefxAccumulator *S, u32 *D, int w, __m128i or )
+{
+     for (; w >= 4; w -= 4) {
+          __m128i s0 = _mm_loadu_si128( (const __m128i*) S );
+          __m128i s1 = _mm_loadu_si128( (const __m128i*) S + 1 );
+          __m128i d  = _mm_loadu_si128( (const __m128i*) D );
+
+          _mm_storeu_si128( (__m128i*) D, acc_to_argb_SSE2( s0, s1, d, or ) );
+
+          S += 4;
+          D += 4;
+     }
+
+     for (; w; w--) {
+          __m128i s0 = _mm_loadl_epi64( (const __m128i*) S++ );
+          __m128i d  = _mm_cvtsi32_si128( *D );
+
+          *D++ = _mm_cvtsi128_si32( acc_to_argb_SSE2( s0, _mm_setzero_si128(), d, or ) );
+     }
+}
+
+static inline AVX2_FUNC void
+acc_to_argb_AVX2_span( const GenefxAccumulator *S, u32 *D, int w, __m128i or )
+{
+     __m256i or2 = _mm256_broadcastsi128_si256( or );
+
+     for (; w >= 8; w -= 8) {
+          __m256i s0   = _mm256_loadu_si256( (const __m256i*) S );
+          __m256i s1   = _mm256_loadu_si256( (const __m256i*) S + 1 );
+          __m256i d    = _mm256_loadu_si256( (const __m256i*) D );
+          __m256i keep = _mm256_packs_epi16( keep_AVX2( s0 ), keep_AVX2( s1 ) );
+          __m256i p    = _mm256_packus_epi16( clamp_AVX2( s0 ), clamp_AVX2( s1 ) );
+
+          /* undo the per lane interleaving of the packs */
+          keep = _mm256_permute4x64_epi64( keep, _MM_SHUFFLE(3,1,2,0) );
+          p    = _mm256_permute4x64_epi64( p,    _MM_SHUFFLE(3,1,2,0) );
+
+          _mm256_storeu_si256( (__m256i*) D, select_AVX2( keep, _mm256_or_si256( p, or2 ), d ) );
+
+          S += 8;
+          D += 8;
+     }
+
+     acc_to_argb_SSE2_span( S, D, w, or );
+}
+
+static SSE2_FUNC void
+Sacc_to_Aop_argb_SSE2( GenefxState *gfxs )
+{
+     if (gfxs->Astep != 1) {
+          Sacc_to_Aop_argb( gfxs );
+          return;
+     }
+
+     acc_to_argb_SSE2_span( gfxs->Sacc, gfxs->Aop[0], gfxs->length, _mm_setzero_si128() );
+}
+
+static SSE2_FUNC void
+Sacc_to_Aop_rgb32_SSE2( GenefxState *gfxs )
+{
+     if (gfxs->Astep != 1) {
+          Sacc_to_Aop_rgb32( gfxs );
+          return;
+     }
+
+     acc_to_argb_SSE2_span( gfxs->Sacc, gfxs->Aop[0], gfxs->length, _mm_set1_epi32( 0xff000000 ) );
+}
+
+static AVX2_FUNC void
+Sacc_to_Aop_argb_AVX2( GenefxState *gfxs )
+{
+     if (gfxs->Astep != 1) {
+          Sacc_to_Aop_argb( gfxs );
+          return;
+     }
+
+     acc_to_argb_AVX2_span( gfxs->Sacc, gfxs->Aop[0], gfxs->length, _mm_setzero_si128() );
+}
+
+static AVX2_FUNC void
+Sacc_to_Aop_rgb32_AVX2( GenefxState *gfxs )
+{
+     if (gfxs->Astep != 1) {
+          Sacc_to_Aop_rgb32( gfxs );
+          return;
+     }
+
+     acc_to_argb_AVX2_span( gfxs->Sacc, gfxs->Aop[0], gfxs->length, _mm_set1_epi32( 0xff000000 ) );
+}
+
+/**********************************************************************************************************************
+ ********************************* Xacc_blend *************************************************************************
+ **********************************************************************************************************************/
+
+/*
+ * X = Y * F >> 8, F being either a constant (Sacc == NULL) or derived from the Sacc alpha: (a ^ xor) + add,
+ * i.e. xor = 0 and add = 1 for DSBF_SRCALPHA, xor = -1 and add = 0x101 for DSBF_INVSRCALPHA.
+ */
+
+static inline SSE2_FUNC void
+Xacc_blend_alpha_SSE2_span( const GenefxAccumulator *Y, GenefxAccumulator *X, const GenefxAccumulator *S, int w,
+                            __m128i f, __m128i add, __m128i xor )
+{
+     for (; w >= 2; w -= 2) {
+          __m128i y = _mm_loadu_si128( (const __m128i*) Y );
+
+          if (S) {
+               f = _mm_add_epi16( _mm_xor_si128( alpha_SSE2( _mm_loadu_si128( (const __m128i*) S ) ), xor ), add );
+               S += 2;
+          }
+
+          _mm_storeu_si128( (__m128i*) X, select_SSE2( keep_SSE2( y ), mul8_SSE2( y, f ), y ) );
+
+          X += 2;
+          Y += 2;
+     }
+
+     if (w) {
+          __m128i y = _mm_loadl_epi64( (const __m128i*) Y );
+
+          if (S)
+               f = _mm_add_epi16( _mm_xor_si128( alpha_SSE2( _mm_loadl_epi64( (const __m128i*) S ) ), xor ), add );
+
+          _mm_storel_epi64( (__m128i*) X, select_SSE2( keep_SSE2( y ), mul8_SSE2( y, f ), y ) );
+     }
+}
+
+static inline AVX2_FUNC void
+Xacc_blend_alpha_AVX2_span( const GenefxAccumulator *Y, GenefxAccumulator *X, const GenefxAccumulator *S, int w,
+                            __m128i f, __m128i add, __m128i xor )
+{
+     __m256i f2   = _mm256_broadcastsi128_si256( f );
+     __m256i add2 = _mm256_broadcastsi128_si256( add );
+     __m256i xor2 = _mm256_broadcastsi128_si256( xor );
+
+     for (; w >= 4; w -= 4) {
+          __m256i y = _mm256_loadu_si256( (const __m256i*) Y );
+
+          if (S) {
+               f2 = _mm256_add_epi16( _mm256_xor_si256( alpha_AVX2( _mm256_loadu_si256( (const __m256i*) S ) ), xor2 ),
+                                      add2 );
+               S += 4;
+          }
+
+          _mm256_storeu_si256( (__m256i*) X, select_AVX2( keep_AVX2( y ), mul8_AVX2( y, f2 ), y ) );
+
+          X += 4;
+          Y += 4;
+     }
+
+     Xacc_blend_alpha_SSE2_span( Y, X, S, w, f, add, xor );
+}
+
+static SSE2_FUNC void
+Xacc_blend_srcalpha_SSE2( GenefxState *gfxs )
+{
+     Xacc_blend_alpha_SSE2_span( gfxs->Yacc, gfxs->Xacc, gfxs->Sacc, gfxs->length,
+                                 _mm_set1_epi16( gfxs->color.a + 1 ), _mm_set1_epi16( 1 ), _mm_setzero_si128() );
+}
+
+static SSE2_FUNC void
+Xacc_blend_invsrcalpha_SSE2( GenefxState *gfxs )
+{
+     Xacc_blend_alpha_SSE2_span( gfxs->Yacc, gfxs->Xacc, gfxs->Sacc, gfxs->length,
+                                 _mm_set1_epi16( 0x100 - gfxs->color.a ), _mm_set1_epi16( 0x101 ),
+                                 _mm_set1_epi16( -1 ) );
+}
+
+static AVX2_FUNC void
+Xacc_blend_srcalpha_AVX2( GenefxState *gfxs )
+{
+     Xacc_blend_alpha_AVX2_span( gfxs->Yacc, gfxs->Xacc, gfxs->Sacc, gfxs->length,
+                                 _mm_set1_epi16( gfxs->color.a + 1 ), _mm_set1_epi16( 1 ), _mm_setzero_si128() );
+}
+
+static AVX2_FUNC void
+Xacc_blend_invsrcalpha_AVX2( GenefxState *gfxs )
+{
+     Xacc_blend_alpha_AVX2_span( gfxs->Yacc, gfxs->Xacc, gfxs->Sacc, gfxs->length,
+                                 _mm_set1_epi16( 0x100 - gfxs->color.a ), _mm_set1_epi16( 0x101 ),
+                                 _mm_set1_epi16( -1 ) );
+}
+
+/**********************************************************************************************************************
+ ********************************* Dacc_modulation ********************************************************************
+ **********************************************************************************************************************/
+
+/* factor 0x100 leaves a channel unchanged */
+static inline SSE2_FUNC void
+Dacc_modulate_SSE2_span( GenefxAccumulator *D, int w, __m128i f )
+{
+     for (; w >= 2; w -= 2) {
+          __m128i d = _mm_loadu_si128( (const __m128i*) D );
+
+          _mm_storeu_si128( (__m128i*) D, select_SSE2( keep_SSE2( d ), mul8_SSE2( d, f ), d ) );
+
+          D += 2;
+     }
+
+     if (w) {
+          __m128i d = _mm_loadl_epi64( (const __m128i*) D );
+
+          _mm_storel_epi64( (__m128i*) D, select_SSE2( keep_SSE2( d ), mul8_SSE2( d, f ), d ) );
+     }
+}
+
+static inline AVX2_FUNC void
+Dacc_modulate_AVX2_span( GenefxAccumulator *D, int w, __m128i f )
+{
+     __m256i f2 = _mm256_broadcastsi128_si256( f );
+
+     for (; w >= 4; w -= 4) {
+          __m256i d = _mm256_loadu_si256( (const __m256i*) D );
+
+          _mm256_storeu_si256( (__m256i*) D, select_AVX2( keep_AVX2( d ), mul8_AVX2( d, f2 ), d ) );
+
+          D += 4;
+     }
+
+     Dacc_modulate_SSE2_span( D, w, f );
+}
+
+static SSE2_FUNC void
+Dacc_modulate_alpha_SSE2( GenefxState *gfxs )
+{
+     Dacc_modulate_SSE2_span( gfxs->Dacc, gfxs->length, _mm_set_epi16( gfxs->Cacc.RGB.a, 0x100, 0x100, 0x100,
+                                                                       gfxs->Cacc.RGB.a, 0x100, 0x100, 0x100 ) );
+}
+
+static SSE2_FUNC void
+Dacc_modulate_rgb_SSE2( GenefxState *gfxs )
+{
+     GenefxAccumulator Cacc = gfxs->Cacc;
+
+     Dacc_modulate_SSE2_span( gfxs->Dacc, gfxs->length, _mm_set_epi16( 0x100, Cacc.RGB.r, Cacc.RGB.g, Cacc.RGB.b,
+                                                                       0x100, Cacc.RGB.r, Cacc.RGB.g, Cacc.RGB.b ) );
+}
+
+static SSE2_FUNC void
+Dacc_modulate_argb_SSE2( GenefxState *gfxs )
+{
+     GenefxAccumulator Cacc = gfxs->Cacc;
+
+     Dacc_modulate_SSE2_span( gfxs->Dacc, gfxs->length, _mm_set_epi16( Cacc.RGB.a, Cacc.RGB.r, Cacc.RGB.g, Cacc.RGB.b,
+                                                                       Cacc.RGB.a, Cacc.RGB.r, Cacc.RGB.g, Cacc.RGB.b ) );
+}
+
+static AVX2_FUNC void
+Dacc_modulate_alpha_AVX2( GenefxState *gfxs )
+{
+     Dacc_modulate_AVX2_span( gfxs->Dacc, gfxs->length, _mm_set_epi16( gfxs->Cacc.RGB.a, 0x100, 0x100, 0x100,
+                                                                       gfxs->Cacc.RGB.a, 0x100, 0x100, 0x100 ) );
+}
+
+static AVX2_FUNC void
+Dacc_modulate_rgb_AVX2( GenefxState *gfxs )
+{
+     GenefxAccumulator Cacc = gfxs->Cacc;
+
+     Dacc_modulate_AVX2_span( gfxs->Dacc, gfxs->length, _mm_set_epi16( 0x100, Cacc.RGB.r, Cacc.RGB.g, Cacc.RGB.b,
+                                                                       0x100, Cacc.RGB.r, Cacc.RGB.g, Cacc.RGB.b ) );
+}
+
+static AVX2_FUNC void
+Dacc_modulate_argb_AVX2( GenefxState *gfxs )
+{
+     GenefxAccumulator Cacc = gfxs->Cacc;
+
+     Dacc_modulate_AVX2_span( gfxs->Dacc, gfxs->length, _mm_set_epi16( Cacc.RGB.a, Cacc.RGB.r, Cacc.RGB.g, Cacc.RGB.b,
+                                                                       Cacc.RGB.a, Cacc.RGB.r, Cacc.RGB.g, Cacc.RGB.b ) );
+}
+
+/**********************************************************************************************************************
+ ********************************* Misc accumulator operations ********************************************************
+ **********************************************************************************************************************/
+
+static inline SSE2_FUNC __m128i
+premultiply_SSE2( __m128i d )
+{
+     __m128i rgb = _mm_set1_epi64x( 0x0000ffffffffffffll );
+     __m128i f   = _mm_add_epi16( alpha_SSE2( d ), _mm_set1_epi16( 1 ) );
+
+     return mul8_SSE2( d, select_SSE2( rgb, f, _mm_set1_epi16( 0x100 ) ) );
+}
+
+static SSE2_FUNC void
+Dacc_premultiply_SSE2( GenefxState *gfxs )
+{
+     int                w = gfxs->length;
+     GenefxAccumulator *D = gfxs->Dacc;
+
+     for (; w >= 2; w -= 2) {
+          __m128i d = _mm_loadu_si128( (const __m128i*) D );
+
+          _mm_storeu_si128( (__m128i*) D, select_SSE2( keep_SSE2( d ), premultiply_SSE2( d ), d ) );
+
+          D += 2;
+     }
+
+     if (w) {
+          __m128i d = _mm_loadl_epi64( (const __m128i*) D );
+
+          _mm_storel_epi64( (__m128i*) D, select_SSE2( keep_SSE2( d ), premultiply_SSE2( d ), d ) );
+     }
+}
+
+static AVX2_FUNC void
+Dacc_premultiply_AVX2( GenefxState *gfxs )
+{
+     int                w   = gfxs->length;
+     GenefxAccumulator *D   = gfxs->Dacc;
+     __m256i            rgb = _mm256_set1_epi64x( 0x0000ffffffffffffll );
+
+     for (; w >= 4; w -= 4) {
+          __m256i d = _mm256_loadu_si256( (const __m256i*) D );
+          __m256i f = _mm256_add_epi16( alpha_AVX2( d ), _mm256_set1_epi16( 1 ) );
+
+          f = select_AVX2( rgb, f, _mm256_set1_epi16( 0x100 ) );
+
+          _mm256_storeu_si256( (__m256i*) D, select_AVX2( keep_AVX2( d ), mul8_AVX2( d, f ), d ) );
+
+          D += 4;
+     }
+
+     for (; w; w--) {
+          __m128i d = _mm_loadl_epi64( (const __m128i*) D );
+
+          _mm_storel_epi64( (__m128i*) D++, select_SSE2( keep_SSE2( d ), premultiply_SSE2( d ), d ) );
+     }
+}
+
+/**********************************************************************************************************************/
+
+/*
+ * The color matrix is applied with 16 bit multiply-adds, splitting each factor into a signed upper and an unsigned
+ * lower byte. The 32 bit sums are exact for factors below 32.0 and offsets below 256.0, otherwise C code is used.
+ */
+#define COLORMATRIX_MAX_FACTOR 0x200000
+#define COLORMATRIX_MAX_OFFSET 0x1000000
+
+typedef struct {
+     __m128i hi;
+     __m128i lo;
+     __m128i offset;
+} ColorMatrixRow_SSE2;
+
+static inline SSE2_FUNC void
+colormatrix_row_init_SSE2( ColorMatrixRow_SSE2 *row, const s32 *m )
+{
+     row->hi     = _mm_set_epi16( 0, m[0] >> 8,   m[1] >> 8,   m[2] >> 8,
+                                  0, m[0] >> 8,   m[1] >> 8,   m[2] >> 8 );
+     row->lo     = _mm_set_epi16( 0, m[0] & 0xff, m[1] & 0xff, m[2] & 0xff,
+                                  0, m[0] & 0xff, m[1] & 0xff, m[2] & 0xff );
+     row->offset = _mm_set1_epi32( m[3] + 0x8000 );
+}
+
+/* one output channel of two accumulators in the lower two 32 bit lanes */
+static inline SSE2_FUNC __m128i
+colormatrix_row_SSE2( const ColorMatrixRow_SSE2 *row, __m128i d )
+{
+     __m128i sum = _mm_add_epi32( _mm_slli_epi32( _mm_madd_epi16( d, row->hi ), 8 ), _mm_madd_epi16( d, row->lo ) );
+
+     sum = _mm_add_epi32( sum, _mm_srli_epi64( sum, 32 ) );
+     sum = _mm_srai_epi32( _mm_add_epi32( sum, row->offset ), 16 );
+
+     return _mm_shuffle_epi32( sum, _MM_SHUFFLE(3,1,2,0) );
+}
+
+static inline SSE2_FUNC __m128i
+colormatrix_SSE2( const ColorMatrixRow_SSE2 *rows, __m128i d )
+{
+     __m128i r  = colormatrix_row_SSE2( &rows[0], d );
+     __m128i g  = colormatrix_row_SSE2( &rows[1], d );
+     __m128i b  = colormatrix_row_SSE2( &rows[2], d );
+     __m128i bg = _mm_unpacklo_epi32( b, g );
+     __m128i r0 = _mm_unpacklo_epi32( r, _mm_setzero_si128() );
+     __m128i x  = _mm_packs_epi32( _mm_unpacklo_epi64( bg, r0 ), _mm_unpackhi_epi64( bg, r0 ) );
+
+     x = _mm_min_epi16( _mm_max_epi16( x, _mm_setzero_si128() ), _mm_set1_epi16( 0xff ) );
+
+     /* keep alpha and accumulators having a flag */
+     x = select_SSE2( _mm_set1_epi64x( 0x0000ffffffffffffll ), x, d );
+
+     return select_SSE2( keep_SSE2( d ), x, d );
+}
+
+static SSE2_FUNC void
+Dacc_colormatrix_SSE2( GenefxState *gfxs )
+{
+     int                  i;
+     int                  w = gfxs->length;
+     GenefxAccumulator   *D = gfxs->Dacc;
+     const s32           *m = gfxs->colormatrix;
+     ColorMatrixRow_SSE2  rows[3];
+
+     for (i = 0; i < 12; i++) {
+          if (ABS( m[i] ) >= ((i & 3) == 3 ? COLORMATRIX_MAX_OFFSET : COLORMATRIX_MAX_FACTOR)) {
+               Dacc_colormatrix_C( gfxs );
+               return;
+          }
+     }
+
+     for (i = 0; i < 3; i++)
+          colormatrix_row_init_SSE2( &rows[i], m + i * 4 );
+
+     for (; w >= 2; w -= 2) {
+          __m128i d = _mm_loadu_si128( (const __m128i*) D );
+
+          _mm_storeu_si128( (__m128i*) D, colormatrix_SSE2( rows, d ) );
+
+          D += 2;
+     }
+
+     if (w) {
+          __m128i d = _mm_loadl_epi64( (const __m128i*) D );
+
+          _mm_storel_epi64( (__m128i*) D, colormatrix_SSE2( rows, d ) );
+     }
+}
+
+/**********************************************************************************************************************/
+
+/* D += S (Sacc != NULL) or D += SCacc */
+static inline SSE2_FUNC void
+add_to_Dacc_SSE2_span( GenefxAccumulator *D, const GenefxAccumulator *S, int w, __m128i s )
+{
+     for (; w >= 2; w -= 2) {
+          __m128i d = _mm_loadu_si128( (const __m128i*) D );
+
+          if (S) {
+               s  = _mm_loadu_si128( (const __m128i*) S );
+               S += 2;
+          }
+
+          _mm_storeu_si128( (__m128i*) D, select_SSE2( keep_SSE2( d ), _mm_add_epi16( d, s ), d ) );
+
+          D += 2;
+     }
+
+     if (w) {
+          __m128i d = _mm_loadl_epi64( (const __m128i*) D );
+
+          if (S)
+               s = _mm_loadl_epi64( (const __m128i*) S );
+
+          _mm_storel_epi64( (__m128i*) D, select_SSE2( keep_SSE2( d ), _mm_add_epi16( d, s ), d ) );
+     }
+}
+
+static inline AVX2_FUNC void
+add_to_Dacc_AVX2_span( GenefxAccumulator *D, const GenefxAccumulator *S, int w, __m128i s )
+{
+     __m256i s2 = _mm256_broadcastsi128_si256( s );
+
+     for (; w >= 4; w -= 4) {
+          __m256i d = _mm256_loadu_si256( (const __m256i*) D );
+
+          if (S) {
+               s2 = _mm256_loadu_si256( (const __m256i*) S );
+               S += 4;
+          }
+
+          _mm256_storeu_si256( (__m256i*) D, select_AVX2( keep_AVX2( d ), _mm256_add_epi16( d, s2 ), d ) );
+
+          D += 4;
+     }
+
+     add_to_Dacc_SSE2_span( D, S, w, s );
+}
+
+static SSE2_FUNC void
+SCacc_add_to_Dacc_SSE2( GenefxState *gfxs )
+{
+     GenefxAccumulator SCacc = gfxs->SCacc;
+
+     add_to_Dacc_SSE2_span( gfxs->Dacc, NULL, gfxs->length,
+                            _mm_set_epi16( SCacc.RGB.a, SCacc.RGB.r, SCacc.RGB.g, SCacc.RGB.b,
+                                           SCacc.RGB.a, SCacc.RGB.r, SCacc.RGB.g, SCacc.RGB.b ) );
+}
+
+static SSE2_FUNC void
+Sacc_add_to_Dacc_SSE2( GenefxState *gfxs )
+{
+     add_to_Dacc_SSE2_span( gfxs->Dacc, gfxs->Sacc, gfxs->length, _mm_setzero_si128() );
+}
+
+static AVX2_FUNC void
+SCacc_add_to_Dacc_AVX2( GenefxState *gfxs )
+{
+     GenefxAccumulator SCacc = gfxs->SCacc;
+
+     add_to_Dacc_AVX2_span( gfxs->Dacc, NULL, gfxs->length,
+                            _mm_set_epi16( SCacc.RGB.a, SCacc.RGB.r, SCacc.RGB.g, SCacc.RGB.b,
+                                           SCacc.RGB.a, SCacc.RGB.r, SCacc.RGB.g, SCacc.RGB.b ) );
+}
+
+static AVX2_FUNC void
+Sacc_add_to_Dacc_AVX2( GenefxState *gfxs )
+{
+     add_to_Dacc_AVX2_span( gfxs->Dacc, gfxs->Sacc, gfxs->length, _mm_setzero_si128() );
+}
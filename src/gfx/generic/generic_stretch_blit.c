@@ -21,6 +21,8 @@
 #include <core/palette.h>
 #include <gfx/convert.h>
 #include <gfx/generic/generic.h>
+#include <gfx/generic/generic_bands.h>
+#include <gfx/generic/generic_scale.h>
 #include <gfx/generic/generic_util.h>
 #include <gfx/util.h>
 
@@ -625,8 +627,6 @@ stretch_hvx( CardState    *state,
 
 /**********************************************************************************************************************/
 
-typedef void (*XopAdvanceFunc)( GenefxState *gfxs );
-
 void
 gStretchBlit( CardState    *state,
               DFBRectangle *srect,
@@ -645,6 +645,7 @@ gStretchBlit( CardState    *state,
      DFBRectangle             orect = *drect;
      bool                     rotated = false;
      DFBSurfaceBlittingFlags  rotflip_blittingflags;
+     GenefxLines              lines;
 
      D_ASSERT( state != NULL );
      D_ASSERT( state->gfxs != NULL );
@@ -668,6 +669,9 @@ gStretchBlit( CardState    *state,
 
      CHECK_PIPELINE();
 
+     if (state->render_options & (DSRO_SMOOTH_UPSCALE | DSRO_SMOOTH_DOWNSCALE) && Genefx_Scale( state, srect, drect ))
+          return;
+
 #if DFB_SMOOTH_SCALING
      if (state->render_options & (DSRO_SMOOTH_UPSCALE | DSRO_SMOOTH_DOWNSCALE) && stretch_hvx( state, srect, drect ))
           return;
@@ -850,18 +854,16 @@ gStretchBlit( CardState    *state,
      Genefx_Aop_xy( gfxs, Aop_X, Aop_Y );
      Genefx_Bop_xy( gfxs, Bop_X, Bop_Y );
 
-     while (h--) {
-          RUN_PIPELINE();
-
-          Aop_advance( gfxs );
+     lines.width       = MAX( srect->w, drect->w );
+     lines.height      = h;
+     lines.Aop_advance = Aop_advance;
+     lines.Bop_advance = Bop_advance;
+     lines.Mop_advance = NULL;
+     lines.Bop_phase   = iy;
+     lines.Bop_step    = rotated ? fx : fy;
+     lines.serial      = gfxs->src_org[0] == gfxs->dst_org[0];
 
-          iy += rotated ? fx : fy;
-
-          while (iy > 0xffff) {
-               iy -= 0x10000;
-               Bop_advance( gfxs );
-          }
-     }
+     Genefx_Lines_run( gfxs, &lines );
 
      Genefx_ABacc_flush( gfxs );
 }
@@ -17,7 +17,9 @@
 */
 
 #include <core/state.h>
+#include <direct/mem.h>
 #include <gfx/generic/generic.h>
+#include <gfx/generic/generic_bands.h>
 #include <gfx/generic/generic_texture_triangles.h>
 #include <gfx/generic/generic_util.h>
 
@@ -64,6 +66,49 @@ typedef struct {
           }                                  \
      } while (0)
 
+/*
+ * Get the vertex indices of the next triangle, advancing the index according to the formation.
+ */
+static bool
+triangle_next( int                  *index,
+               DFBTriangleFormation  formation,
+               int                   ret_i[3] )
+{
+     int i = *index;
+
+     if (i == 0 || formation == DTTF_LIST) {
+          ret_i[0] = i + 0;
+          ret_i[1] = i + 1;
+          ret_i[2] = i + 2;
+
+          *index = i + 3;
+
+          return true;
+     }
+
+     switch (formation) {
+          case DTTF_STRIP:
+               ret_i[0] = i - 2;
+               ret_i[1] = i - 1;
+               ret_i[2] = i + 0;
+               break;
+
+          case DTTF_FAN:
+               ret_i[0] = 0;
+               ret_i[1] = i - 1;
+               ret_i[2] = i + 0;
+               break;
+
+          default:
+               D_BUG( "unknown formation %u", formation );
+               return false;
+     }
+
+     *index = i + 1;
+
+     return true;
+}
+
 static void
 Genefx_TextureTriangleAffine( GenefxState        *gfxs,
                               GenefxVertexAffine *v0,
@@ -349,49 +394,16 @@ Genefx_TextureTrianglesAffine( CardState            *state,
      Genefx_Bop_xy( gfxs, 0, 0 );
 
      /* Render triangles. */
-     for (index = 0; index < num;) {
-          GenefxVertexAffine *v[3];
-
-          if (index == 0) {
-               v[0] = &vertices[index+0];
-               v[1] = &vertices[index+1];
-               v[2] = &vertices[index+2];
+     while (index < num) {
+          int i[3];
 
-               index += 3;
-          }
-          else {
-               switch (formation) {
-                    case DTTF_LIST:
-                         v[0] = &vertices[index+0];
-                         v[1] = &vertices[index+1];
-                         v[2] = &vertices[index+2];
-
-                         index += 3;
-                         break;
-
-                    case DTTF_STRIP:
-                         v[0] = &vertices[index-2];
-                         v[1] = &vertices[index-1];
-                         v[2] = &vertices[index+0];
-
-                         index += 1;
-                         break;
-
-                    case DTTF_FAN:
-                         v[0] = &vertices[0];
-                         v[1] = &vertices[index-1];
-                         v[2] = &vertices[index+0];
-
-                         index += 1;
-                         break;
-
-                    default:
-                         D_BUG( "unknown formation %u", formation );
-                         Genefx_ABacc_flush( gfxs );
-                         return;
-               }
+          if (!triangle_next( &index, formation, i )) {
+               Genefx_ABacc_flush( gfxs );
+               return;
           }
 
+          GenefxVertexAffine *v[3] = { &vertices[i[0]], &vertices[i[1]], &vertices[i[2]] };
+
           if (dfb_config->software_warn) {
                D_WARN( "TexTriangles (%d,%d-%d,%d-%d,%d) %6s, flags 0x%08x, color 0x%02x%02x%02x%02x <- (%4d,%4d) %6s",
                        v[0]->x, v[0]->y, v[1]->x, v[1]->y, v[2]->x, v[2]->y, dfb_pixelformat_name( gfxs->dst_format ),
@@ -405,3 +417,345 @@ Genefx_TextureTrianglesAffine( CardState            *state,
 
      Genefx_ABacc_flush( gfxs );
 }
+
+/**********************************************************************************************************************/
+
+/*
+ * Number of pixels between exact texture coordinates of perspective correct spans,
+ * the pipeline steps linearly in between.
+ */
+#define TEXTURE_SPAN_CHUNK 16
+
+typedef struct {
+     float           xa, ya;                     /* top vertex */
+     float           xb, yb;                     /* middle vertex */
+     float           xc, yc;                     /* bottom vertex */
+     bool            middle_left;                /* middle vertex is left of the long edge */
+
+     int             y1;                         /* first line */
+     int             y2;                         /* last line */
+
+     /* Plane equations relative to the top vertex. */
+     float           q,  q_dx,  q_dy;            /* 1 / w */
+     float           sq, sq_dx, sq_dy;           /* s / w */
+     float           tq, tq_dx, tq_dy;           /* t / w */
+
+     bool            perspective;
+} GenefxTriangle;
+
+typedef struct {
+     GenefxTriangle *triangles;
+     int             num;
+
+     DFBRegion       clip;
+     int             s_max;                      /* last valid texture coordinate (16.16) */
+     int             t_max;
+} GenefxTriangleBatch;
+
+static __inline__ int
+iceil( float f )
+{
+     int i = (int) f;
+
+     return (f > i) ? i + 1 : i;
+}
+
+static bool
+triangle_setup( GenefxTriangle     *tri,
+                const GenefxVertex *v0,
+                const GenefxVertex *v1,
+                const GenefxVertex *v2,
+                const DFBRegion    *clip )
+{
+     const GenefxVertex *a = v0, *b = v1, *c = v2, *tmp;
+     float               area, xl;
+     float               q0, q1, q2;
+     float               ds1, ds2, dt1, dt2, dq1, dq2;
+
+     /* Triangle sorting (vertical). */
+     if (b->y < a->y) {
+          tmp = a;
+          a   = b;
+          b   = tmp;
+     }
+     if (c->y < a->y) {
+          tmp = c;
+          c   = b;
+          b   = a;
+          a   = tmp;
+     }
+     else if (c->y < b->y) {
+          tmp = b;
+          b   = c;
+          c   = tmp;
+     }
+
+     area = (b->x - a->x) * (c->y - a->y) - (c->x - a->x) * (b->y - a->y);
+     if (area == 0.0f)
+          return false;
+
+     /* Pixel centers on or below the top edge and above the bottom edge. */
+     tri->y1 = iceil( MAX( a->y - 0.5f, clip->y1 ) );
+     tri->y2 = iceil( MIN( c->y - 0.5f, clip->y2 + 1 ) ) - 1;
+
+     if (tri->y1 > tri->y2)
+          return false;
+
+     if (MIN( a->x, MIN( b->x, c->x ) ) > clip->x2 + 1 || MAX( a->x, MAX( b->x, c->x ) ) < clip->x1)
+          return false;
+
+     tri->xa = a->x;
+     tri->ya = a->y;
+     tri->xb = b->x;
+     tri->yb = b->y;
+     tri->xc = c->x;
+     tri->yc = c->y;
+
+     xl = a->x + (b->y - a->y) * (c->x - a->x) / (c->y - a->y);
+
+     tri->middle_left = b->x < xl;
+
+     /* Interpolate the texture coordinates divided by w, unless all vertices have the same w. */
+     tri->perspective = a->w != b->w || a->w != c->w;
+
+     if (tri->perspective) {
+          q0 = (a->w > 0.0f) ? 1.0f / a->w : 1.0f;
+          q1 = (b->w > 0.0f) ? 1.0f / b->w : 1.0f;
+          q2 = (c->w > 0.0f) ? 1.0f / c->w : 1.0f;
+     }
+     else
+          q0 = q1 = q2 = 1.0f;
+
+     dq1 = q1 - q0;
+     dq2 = q2 - q0;
+     ds1 = b->s * q1 - a->s * q0;
+     ds2 = c->s * q2 - a->s * q0;
+     dt1 = b->t * q1 - a->t * q0;
+     dt2 = c->t * q2 - a->t * q0;
+
+     tri->q     = q0;
+     tri->q_dx  = (dq1 * (c->y - a->y) - dq2 * (b->y - a->y)) / area;
+     tri->q_dy  = (dq2 * (b->x - a->x) - dq1 * (c->x - a->x)) / area;
+     tri->sq    = a->s * q0;
+     tri->sq_dx = (ds1 * (c->y - a->y) - ds2 * (b->y - a->y)) / area;
+     tri->sq_dy = (ds2 * (b->x - a->x) - ds1 * (c->x - a->x)) / area;
+     tri->tq    = a->t * q0;
+     tri->tq_dx = (dt1 * (c->y - a->y) - dt2 * (b->y - a->y)) / area;
+     tri->tq_dy = (dt2 * (b->x - a->x) - dt1 * (c->x - a->x)) / area;
+
+     return true;
+}
+
+/*
+ * Texture coordinates (16.16) at the given pixel center, clamped to the texture.
+ */
+static __inline__ void
+triangle_sample( const GenefxTriangle      *tri,
+                 const GenefxTriangleBatch *batch,
+                 float                      x,
+                 float                      y,
+                 int                       *ret_s,
+                 int                       *ret_t )
+{
+     float dx = x - tri->xa;
+     float dy = y - tri->ya;
+     float s  = tri->sq + tri->sq_dx * dx + tri->sq_dy * dy;
+     float t  = tri->tq + tri->tq_dx * dx + tri->tq_dy * dy;
+
+     if (tri->perspective) {
+          float q = tri->q + tri->q_dx * dx + tri->q_dy * dy;
+
+          if (q < 1e-6f)
+               q = 1e-6f;
+
+          s /= q;
+          t /= q;
+     }
+
+     s *= 65536.0f;
+     t *= 65536.0f;
+
+     *ret_s = (s <= 0.0f) ? 0 : (s >= batch->s_max) ? batch->s_max : MIN( (int) s, batch->s_max );
+     *ret_t = (t <= 0.0f) ? 0 : (t >= batch->t_max) ? batch->t_max : MIN( (int) t, batch->t_max );
+}
+
+static void
+triangle_render( GenefxState               *gfxs,
+                 const GenefxTriangleBatch *batch,
+                 const GenefxTriangle      *tri,
+                 int                        y1,
+                 int                        y2 )
+{
+     const DFBRegion *clip = &batch->clip;
+     float            long_slope, top_slope = 0.0f, bottom_slope = 0.0f;
+     int              y;
+
+     long_slope = (tri->xc - tri->xa) / (tri->yc - tri->ya);
+
+     if (tri->yb > tri->ya)
+          top_slope = (tri->xb - tri->xa) / (tri->yb - tri->ya);
+
+     if (tri->yc > tri->yb)
+          bottom_slope = (tri->xc - tri->xb) / (tri->yc - tri->yb);
+
+     for (y = y1; y <= y2; y++) {
+          float yc = y + 0.5f;
+          float xlong, xshort;
+          int   x1, x2, x;
+          int   s, t;
+
+          xlong = tri->xa + (yc - tri->ya) * long_slope;
+
+          if (yc < tri->yb)
+               xshort = tri->xa + (yc - tri->ya) * top_slope;
+          else
+               xshort = tri->xb + (yc - tri->yb) * bottom_slope;
+
+          /* Pixel centers on or right of the left edge and left of the right edge. */
+          if (tri->middle_left) {
+               x1 = iceil( MAX( xshort - 0.5f, clip->x1 ) );
+               x2 = iceil( MIN( xlong - 0.5f, clip->x2 + 1 ) ) - 1;
+          }
+          else {
+               x1 = iceil( MAX( xlong - 0.5f, clip->x1 ) );
+               x2 = iceil( MIN( xshort - 0.5f, clip->x2 + 1 ) ) - 1;
+          }
+
+          if (x1 > x2)
+               continue;
+
+          triangle_sample( tri, batch, x1 + 0.5f, yc, &s, &t );
+
+          /* Split the span into chunks, the last one ends at the last pixel instead of the next chunk. */
+          for (x = x1; x <= x2;) {
+               int len = tri->perspective ? MIN( TEXTURE_SPAN_CHUNK, x2 - x + 1 ) : x2 - x + 1;
+               int next_s, next_t;
+               int steps;
+
+               if (x + len <= x2) {
+                    triangle_sample( tri, batch, x + len + 0.5f, yc, &next_s, &next_t );
+
+                    steps = len;
+               }
+               else {
+                    triangle_sample( tri, batch, x2 + 0.5f, yc, &next_s, &next_t );
+
+                    steps = MAX( len - 1, 1 );
+               }
+
+               gfxs->Dlen   = len;
+               gfxs->length = len;
+               gfxs->s      = s;
+               gfxs->t      = t;
+               gfxs->SperD  = (next_s - s) / steps;
+               gfxs->TperD  = (next_t - t) / steps;
+
+               Genefx_Aop_xy( gfxs, x, y );
+
+               RUN_PIPELINE();
+
+               s  = next_s;
+               t  = next_t;
+               x += len;
+          }
+     }
+}
+
+static void
+triangles_band( GenefxState *gfxs,
+                void        *ctx,
+                int          y,
+                int          height )
+{
+     const GenefxTriangleBatch *batch = ctx;
+     int                        y2    = y + height - 1;
+     int                        i;
+
+     for (i = 0; i < batch->num; i++) {
+          const GenefxTriangle *tri = &batch->triangles[i];
+
+          if (tri->y1 > y2 || tri->y2 < y)
+               continue;
+
+          triangle_render( gfxs, batch, tri, MAX( tri->y1, y ), MIN( tri->y2, y2 ) );
+     }
+}
+
+void
+Genefx_TextureTriangles( CardState            *state,
+                         GenefxVertex         *vertices,
+                         int                   num,
+                         DFBTriangleFormation  formation,
+                         const DFBRegion      *clip )
+{
+     GenefxState         *gfxs;
+     GenefxTriangleBatch  batch;
+     int                  index  = 0;
+     int                  y1     = clip->y2;
+     int                  y2     = clip->y1;
+     int                  pixels = 0;
+
+     D_ASSERT( state != NULL );
+     D_ASSERT( state->gfxs != NULL );
+     DFB_REGION_ASSERT( clip );
+
+     gfxs = state->gfxs;
+
+     CHECK_PIPELINE();
+
+     batch.triangles = D_MALLOC( num * sizeof(GenefxTriangle) );
+     if (!batch.triangles) {
+          D_OOM();
+          return;
+     }
+
+     batch.num   = 0;
+     batch.clip  = *clip;
+     batch.s_max = (gfxs->src_width << 16) - 1;
+     batch.t_max = (gfxs->src_height << 16) - 1;
+
+     /* Set up all triangles, binning them into bands by their lines. */
+     while (index < num) {
+          GenefxTriangle *tri = &batch.triangles[batch.num];
+          int             i[3];
+
+          if (!triangle_next( &index, formation, i ))
+               break;
+
+          if (dfb_config->software_warn) {
+               D_WARN( "TexTriangles (%.1f,%.1f-%.1f,%.1f-%.1f,%.1f) %6s, flags 0x%08x, color 0x%02x%02x%02x%02x <- "
+                       "(%4d,%4d) %6s", vertices[i[0]].x, vertices[i[0]].y, vertices[i[1]].x, vertices[i[1]].y,
+                       vertices[i[2]].x, vertices[i[2]].y, dfb_pixelformat_name( gfxs->dst_format ),
+                       state->blittingflags, state->color.a, state->color.r, state->color.g, state->color.b,
+                       state->source->config.size.w, state->source->config.size.h,
+                       dfb_pixelformat_name( gfxs->src_format ) );
+          }
+
+          if (!triangle_setup( tri, &vertices[i[0]], &vertices[i[1]], &vertices[i[2]], clip ))
+               continue;
+
+          y1 = MIN( y1, tri->y1 );
+          y2 = MAX( y2, tri->y2 );
+
+          pixels += (tri->y2 - tri->y1 + 1) * (MAX( tri->xa, MAX( tri->xb, tri->xc ) ) -
+                                               MIN( tri->xa, MIN( tri->xb, tri->xc ) ) + 1) / 2;
+
+          batch.num++;
+     }
+
+     if (batch.num && Genefx_ABacc_prepare( gfxs, state->destination->config.size.w )) {
+          /* Reset Bop to 0,0 as texture lookup accesses the whole buffer arbitrarily. */
+          Genefx_Bop_xy( gfxs, 0, 0 );
+
+          /* Render sequentially if the texture is the destination. */
+          if (gfxs->src_org[0] == gfxs->dst_org[0])
+               triangles_band( gfxs, &batch, y1, y2 - y1 + 1 );
+          else
+               Genefx_Bands_run( gfxs, state->destination->config.size.w, y1, y2 - y1 + 1, pixels,
+                                 triangles_band, &batch );
+
+          Genefx_ABacc_flush( gfxs );
+     }
+
+     D_FREE( batch.triangles );
+}
@@ -30,6 +30,14 @@ typedef struct {
      int t;
 } GenefxVertexAffine;
 
+typedef struct {
+     float x;                                    /* destination position (pixels) */
+     float y;
+     float w;                                    /* homogeneous coordinate, the texture is mapped affinely if equal */
+     float s;                                    /* texture position (pixels) */
+     float t;
+} GenefxVertex;
+
 /**********************************************************************************************************************/
 
 void Genefx_TextureTrianglesAffine( CardState            *state,
@@ -38,4 +46,13 @@ void Genefx_TextureTrianglesAffine( CardState            *state,
                                     DFBTriangleFormation  formation,
                                     const DFBRegion      *clip );
 
+/*
+ * Perspective correct texture mapping, filtered with smooth scaling render options.
+ */
+void Genefx_TextureTriangles      ( CardState            *state,
+                                    GenefxVertex         *vertices,
+                                    int                   num,
+                                    DFBTriangleFormation  formation,
+                                    const DFBRegion      *clip );
+
 #endif
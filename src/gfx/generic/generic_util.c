@@ -17,6 +17,7 @@
 */
 
 #include <gfx/generic/generic.h>
+#include <gfx/generic/generic_convolution.h>
 #include <gfx/generic/generic_util.h>
 
 /**********************************************************************************************************************/
@@ -842,6 +843,8 @@ Genefx_ABacc_prepare( GenefxState *gfxs, int width )
 void
 Genefx_ABacc_flush( GenefxState *gfxs )
 {
+     Genefx_Convolution_flush( gfxs );
+
      if (dfb_config->keep_accumulators >= 0 && gfxs->ABsize > dfb_config->keep_accumulators) {
           D_FREE( gfxs->ABstart );
 
@@ -24,6 +24,14 @@
 #include <direct/trace.h>
 #include <misc/conf.h>
 
+#ifdef USE_SSE
+#include <immintrin.h>
+
+/* SIMD kernels are compiled with per function target attributes, the instruction set is selected at runtime */
+#define SSE2_FUNC __attribute__((target("sse2")))
+#define AVX2_FUNC __attribute__((target("avx2")))
+#endif
+
 /**********************************************************************************************************************/
 
 #define CHECK_PIPELINE()                                                                                      \
@@ -56,6 +64,17 @@
                funcs[i]( gfxs );           \
      }
 
+/* expansion of color components to 8 bit by replicating the most significant bits */
+#define EXPAND_1to8(v) ((v) ? 0xff : 0x00)
+#define EXPAND_4to8(v) (((v) << 4) |  (v)      )
+#define EXPAND_5to8(v) (((v) << 3) | ((v) >> 2))
+#define EXPAND_6to8(v) (((v) << 2) | ((v) >> 4))
+#define EXPAND_7to8(v) (((v) << 1) | ((v) >> 6))
+
+/**********************************************************************************************************************/
+
+typedef void (*XopAdvanceFunc)( GenefxState *gfxs );
+
 /**********************************************************************************************************************/
 
 void Genefx_Aop_crab     ( GenefxState *gfxs );
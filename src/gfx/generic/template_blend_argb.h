@@ -0,0 +1,99 @@
+/*
+   This file is part of DirectFB.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+*/
+
+/*
+ * Blend a span of ARGB source pixels into the destination in a single pass, computing the same result as the
+ * accumulator pipeline for DSBLIT_BLEND_ALPHACHANNEL with DSBF_INVSRCALPHA as destination blend function.
+ *
+ * FUSED_FUNC        name of the function
+ * FUSED_COLORIZE    modulate the source color with the color (DSBLIT_COLORIZE)
+ * FUSED_PREMULTIPLY premultiply the source color with its alpha (DSBLIT_SRC_PREMULTIPLY)
+ * FUSED_SRCALPHA    use DSBF_SRCALPHA as source blend function instead of DSBF_ONE
+ *
+ * DST_TYPE, DST_LOAD(d,a,r,g,b), DST_STORE(a,r,g,b) and DST_KEEP(d) access the destination pixels.
+ */
+
+static void
+FUSED_FUNC( GenefxState *gfxs )
+{
+     int       w = gfxs->length + 1;
+     u32      *S = gfxs->Bop[0];
+     DST_TYPE *D = gfxs->Aop[0];
+#ifdef FUSED_COLORIZE
+     int       Cr = gfxs->Cacc.RGB.r;
+     int       Cg = gfxs->Cacc.RGB.g;
+     int       Cb = gfxs->Cacc.RGB.b;
+#endif
+
+     while (--w) {
+          u32 s  = *S++;
+          int sa = s >> 24;
+          int sr = (s >> 16) & 0xff;
+          int sg = (s >>  8) & 0xff;
+          int sb =  s        & 0xff;
+          int da, dr, dg, db;
+          int inv;
+
+#if defined(FUSED_SRCALPHA) || defined(FUSED_PREMULTIPLY)
+          /* Transparent source pixels leave the destination unchanged. */
+          if (!sa) {
+               DST_KEEP( *D );
+               ++D;
+               continue;
+          }
+#endif
+
+#ifdef FUSED_COLORIZE
+          sr = (Cr * sr) >> 8;
+          sg = (Cg * sg) >> 8;
+          sb = (Cb * sb) >> 8;
+#endif
+
+#ifdef FUSED_PREMULTIPLY
+          sr = ((sa + 1) * sr) >> 8;
+          sg = ((sa + 1) * sg) >> 8;
+          sb = ((sa + 1) * sb) >> 8;
+#endif
+
+          inv = 0x100 - sa;
+
+#ifdef FUSED_SRCALPHA
+          sr = ((sa + 1) * sr) >> 8;
+          sg = ((sa + 1) * sg) >> 8;
+          sb = ((sa + 1) * sb) >> 8;
+          sa = ((sa + 1) * sa) >> 8;
+#endif
+
+          DST_LOAD( *D, da, dr, dg, db );
+
+          da = sa + ((inv * da) >> 8);
+          dr = sr + ((inv * dr) >> 8);
+          dg = sg + ((inv * dg) >> 8);
+          db = sb + ((inv * db) >> 8);
+
+          *D++ = DST_STORE( (da & 0xff00) ? 0xff : da,
+                            (dr & 0xff00) ? 0xff : dr,
+                            (dg & 0xff00) ? 0xff : dg,
+                            (db & 0xff00) ? 0xff : db );
+     }
+}
+
+#undef FUSED_FUNC
+#undef FUSED_COLORIZE
+#undef FUSED_PREMULTIPLY
+#undef FUSED_SRCALPHA
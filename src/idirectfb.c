@@ -1720,6 +1720,23 @@ IDirectFB_GetSurface( IDirectFB         *thiz,
      return ret;
 }
 
+static DFBResult
+IDirectFB_GetGraphicsStats( IDirectFB                 *thiz,
+                            DFBGraphicsOperationStats *ret_stats,
+                            unsigned int               max,
+                            unsigned int              *ret_num,
+                            unsigned int              *ret_total )
+{
+     DIRECT_INTERFACE_GET_DATA( IDirectFB )
+
+     D_DEBUG_AT( DirectFB, "%s( %p, %p [%u] )\n", __FUNCTION__, thiz, ret_stats, max );
+
+     if ((!ret_stats && max) || !ret_num || !ret_total)
+          return DFB_INVARG;
+
+     return dfb_gfxcard_get_stats( ret_stats, max, ret_num, ret_total );
+}
+
 static void
 LoadBackgroundImage( IDirectFB       *dfb,
                      CoreWindowStack *stack,
@@ -2058,6 +2075,7 @@ IDirectFB_Construct( IDirectFB *thiz )
      thiz->WaitForSync            = IDirectFB_WaitForSync;
      thiz->GetInterface           = IDirectFB_GetInterface;
      thiz->GetSurface             = IDirectFB_GetSurface;
+     thiz->GetGraphicsStats       = IDirectFB_GetGraphicsStats;
 
      direct_mutex_init( &data->init_lock );
      direct_waitqueue_init( &data->init_wq );
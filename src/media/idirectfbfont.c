@@ -201,7 +201,7 @@ IDirectFBFont_GetKerning( IDirectFBFont *thiz,
           if (ret)
                goto error;
 
-          ret = data->font->GetKerning( data->font, prev_index, current_index, &x, &y );
+          ret = dfb_font_get_kerning( data->font, prev_index, current_index, NULL, &x, &y );
           if (ret)
                goto error;
      }
@@ -228,9 +228,10 @@ IDirectFBFont_GetStringWidth( IDirectFBFont *thiz,
                               int            bytes,
                               int           *ret_width )
 {
-     DFBResult ret;
-     int       xsize = 0;
-     int       ysize = 0;
+     DFBResult       ret;
+     CoreFontMeasure measure;
+     int             xsize = 0;
+     int             ysize = 0;
 
      DIRECT_INTERFACE_GET_DATA( IDirectFBFont )
 
@@ -242,17 +243,22 @@ IDirectFBFont_GetStringWidth( IDirectFBFont *thiz,
      if (bytes < 0)
           bytes = strlen( text );
 
+     if (dfb_font_measure_lookup( data->font, data->encoding, text, bytes, CFMF_WIDTH, 0, &measure )) {
+          *ret_width = measure.width;
+          return DFB_OK;
+     }
+
      if (bytes > 0) {
           int          i, num;
-          unsigned int prev = 0;
+          unsigned int prev   = 0;
+          bool         locked = false;
           unsigned int indices[bytes];
 
-          dfb_font_lock( data->font );
-
           /* Decode string to character indices. */
           ret = dfb_font_decode_text( data->font, data->encoding, text, bytes, indices, &num );
           if (ret) {
-               dfb_font_unlock( data->font );
+               if (locked)
+                    dfb_font_unlock( data->font );
                return ret;
           }
 
@@ -261,14 +267,13 @@ IDirectFBFont_GetStringWidth( IDirectFBFont *thiz,
                unsigned int   current = indices[i];
                CoreGlyphData *glyph;
 
-               if (dfb_font_get_glyph_data( data->font, current, 0, &glyph ) == DFB_OK) {
+               if (dfb_font_get_glyph_metrics( data->font, current, 0, &locked, &glyph ) == DFB_OK) {
                     int kx, ky;
 
                     xsize += glyph->xadvance;
                     ysize += glyph->yadvance;
 
-                    if (prev && data->font->GetKerning &&
-                        data->font->GetKerning( data->font, prev, current, &kx, &ky ) == DFB_OK) {
+                    if (prev && dfb_font_get_kerning( data->font, prev, current, &locked, &kx, &ky ) == DFB_OK) {
                          xsize += kx << 8;
                          ysize += ky << 8;
                     }
@@ -277,7 +282,8 @@ IDirectFBFont_GetStringWidth( IDirectFBFont *thiz,
                prev = current;
           }
 
-          dfb_font_unlock( data->font );
+          if (locked)
+               dfb_font_unlock( data->font );
      }
 
      if (!ysize) {
@@ -290,6 +296,11 @@ IDirectFBFont_GetStringWidth( IDirectFBFont *thiz,
           *ret_width = sqrt16( xsize * xsize + ysize * ysize ) / 4096.0f;
      }
 
+     measure.flags = CFMF_WIDTH;
+     measure.width = *ret_width;
+
+     dfb_font_measure_store( data->font, data->encoding, text, bytes, &measure );
+
      return DFB_OK;
 }
 
@@ -300,9 +311,13 @@ IDirectFBFont_GetStringExtents( IDirectFBFont *thiz,
                                 DFBRectangle  *ret_logical_rect,
                                 DFBRectangle  *ret_ink_rect )
 {
-     DFBResult ret;
-     int       xbaseline = 0;
-     int       ybaseline = 0;
+     DFBResult        ret;
+     CoreFontMeasure  measure;
+     DFBRectangle    *logical_rect = &measure.logical_rect;
+     DFBRectangle    *ink_rect     = &measure.ink_rect;
+     int              xbaseline    = 0;
+     int              ybaseline    = 0;
+     bool             locked       = false;
 
      DIRECT_INTERFACE_GET_DATA( IDirectFBFont )
 
@@ -317,10 +332,11 @@ IDirectFBFont_GetStringExtents( IDirectFBFont *thiz,
      if (bytes < 0)
           bytes = strlen( text );
 
-     if (ret_ink_rect)
-          memset( ret_ink_rect, 0, sizeof(DFBRectangle) );
+     if (dfb_font_measure_lookup( data->font, data->encoding, text, bytes, CFMF_EXTENTS, 0, &measure ))
+          goto out;
 
-     dfb_font_lock( data->font );
+     /* Calculate both rectangles for the cache. */
+     memset( ink_rect, 0, sizeof(DFBRectangle) );
 
      if (bytes > 0) {
           int          i, num;
@@ -330,7 +346,8 @@ IDirectFBFont_GetStringExtents( IDirectFBFont *thiz,
           /* Decode string to character indices. */
           ret = dfb_font_decode_text( data->font, data->encoding, text, bytes, indices, &num );
           if (ret) {
-               dfb_font_unlock( data->font );
+               if (locked)
+                    dfb_font_unlock( data->font );
                return ret;
           }
 
@@ -338,21 +355,18 @@ IDirectFBFont_GetStringExtents( IDirectFBFont *thiz,
                unsigned int   current = indices[i];
                CoreGlyphData *glyph;
 
-               if (dfb_font_get_glyph_data( data->font, current, 0, &glyph ) == DFB_OK) {
+               if (dfb_font_get_glyph_metrics( data->font, current, 0, &locked, &glyph ) == DFB_OK) {
                     int kx, ky;
 
-                    if (prev && data->font->GetKerning &&
-                        data->font->GetKerning( data->font, prev, current, &kx, &ky ) == DFB_OK) {
+                    if (prev && dfb_font_get_kerning( data->font, prev, current, &locked, &kx, &ky ) == DFB_OK) {
                          xbaseline += kx << 8;
                          ybaseline += ky << 8;
                     }
 
-                    if (ret_ink_rect) {
-                         DFBRectangle glyph_rect = { xbaseline + (glyph->left << 8), ybaseline + (glyph->top << 8),
-                                                     glyph->width << 8,              glyph->height << 8 };
+                    DFBRectangle glyph_rect = { xbaseline + (glyph->left << 8), ybaseline + (glyph->top << 8),
+                                                glyph->width << 8,              glyph->height << 8 };
 
-                         dfb_rectangle_union( ret_ink_rect, &glyph_rect );
-                    }
+                    dfb_rectangle_union( ink_rect, &glyph_rect );
 
                     xbaseline += glyph->xadvance;
                     ybaseline += glyph->yadvance;
@@ -362,48 +376,56 @@ IDirectFBFont_GetStringExtents( IDirectFBFont *thiz,
           }
      }
 
-     if (ret_logical_rect) {
-          /* We already have the text baseline vector in (xbaseline,ybaseline).
-             Find the ascender and descender vectors. */
-          int xascender =  data->font->ascender * data->font->up_unit_x;
-          int yascender =  data->font->ascender * data->font->up_unit_y;
-          int xdescender = data->font->descender * data->font->up_unit_x;
-          int ydescender = data->font->descender * data->font->up_unit_y;
-
-          /* Now find top/bottom and left/right points relative to the text. */
-          int top_left_x     = xascender;
-          int top_left_y     = yascender;
-          int bottom_left_x  = xdescender;
-          int bottom_left_y  = ydescender;
-          int top_right_x    = top_left_x    + (xbaseline >> 8);
-          int top_right_y    = top_left_y    + (ybaseline >> 8);
-          int bottom_right_x = bottom_left_x + (xbaseline >> 8);
-          int bottom_right_y = bottom_left_y + (ybaseline >> 8);
-
-          /* The logical rectangle is the bounding-box of these points. */
-          #define MIN4(a,b,c,d) (MIN( MIN( a, b ), MIN( c, d ) ))
-          #define MAX4(a,b,c,d) (MAX( MAX( a, b ), MAX( c, d ) ))
-          ret_logical_rect->x = MIN4( top_left_x, bottom_left_x, top_right_x, bottom_right_x );
-          ret_logical_rect->y = MIN4( top_left_y, bottom_left_y, top_right_y, bottom_right_y );
-          ret_logical_rect->w = MAX4( top_left_x, bottom_left_x, top_right_x, bottom_right_x ) - ret_logical_rect->x;
-          ret_logical_rect->h = MAX4( top_left_y, bottom_left_y, top_right_y, bottom_right_y ) - ret_logical_rect->y;
+     /* We already have the text baseline vector in (xbaseline,ybaseline).
+        Find the ascender and descender vectors. */
+     int xascender =  data->font->ascender * data->font->up_unit_x;
+     int yascender =  data->font->ascender * data->font->up_unit_y;
+     int xdescender = data->font->descender * data->font->up_unit_x;
+     int ydescender = data->font->descender * data->font->up_unit_y;
+
+     /* Now find top/bottom and left/right points relative to the text. */
+     int top_left_x     = xascender;
+     int top_left_y     = yascender;
+     int bottom_left_x  = xdescender;
+     int bottom_left_y  = ydescender;
+     int top_right_x    = top_left_x    + (xbaseline >> 8);
+     int top_right_y    = top_left_y    + (ybaseline >> 8);
+     int bottom_right_x = bottom_left_x + (xbaseline >> 8);
+     int bottom_right_y = bottom_left_y + (ybaseline >> 8);
+
+     /* The logical rectangle is the bounding-box of these points. */
+     #define MIN4(a,b,c,d) (MIN( MIN( a, b ), MIN( c, d ) ))
+     #define MAX4(a,b,c,d) (MAX( MAX( a, b ), MAX( c, d ) ))
+     logical_rect->x = MIN4( top_left_x, bottom_left_x, top_right_x, bottom_right_x );
+     logical_rect->y = MIN4( top_left_y, bottom_left_y, top_right_y, bottom_right_y );
+     logical_rect->w = MAX4( top_left_x, bottom_left_x, top_right_x, bottom_right_x ) - logical_rect->x;
+     logical_rect->h = MAX4( top_left_y, bottom_left_y, top_right_y, bottom_right_y ) - logical_rect->y;
+
+     if (ink_rect->w < 0) {
+          ink_rect->x +=  ink_rect->w;
+          ink_rect->w  = -ink_rect->w;
      }
+     ink_rect->x += (data->font->ascender * data->font->up_unit_x) / 256.0f;
+     ink_rect->y += (data->font->ascender * data->font->up_unit_y) / 256.0f;
 
-     if (ret_ink_rect) {
-          if (ret_ink_rect->w < 0) {
-               ret_ink_rect->x +=  ret_ink_rect->w;
-               ret_ink_rect->w  = -ret_ink_rect->w;
-          }
-          ret_ink_rect->x += (data->font->ascender * data->font->up_unit_x) / 256.0f;
-          ret_ink_rect->y += (data->font->ascender * data->font->up_unit_y) / 256.0f;
+     ink_rect->x >>= 8;
+     ink_rect->y >>= 8;
+     ink_rect->w >>= 8;
+     ink_rect->h >>= 8;
 
-          ret_ink_rect->x >>= 8;
-          ret_ink_rect->y >>= 8;
-          ret_ink_rect->w >>= 8;
-          ret_ink_rect->h >>= 8;
-     }
+     if (locked)
+          dfb_font_unlock( data->font );
 
-     dfb_font_unlock( data->font );
+     measure.flags = CFMF_EXTENTS;
+
+     dfb_font_measure_store( data->font, data->encoding, text, bytes, &measure );
+
+out:
+     if (ret_logical_rect)
+          *ret_logical_rect = measure.logical_rect;
+
+     if (ret_ink_rect)
+          *ret_ink_rect = measure.ink_rect;
 
      return DFB_OK;
 }
@@ -417,6 +439,7 @@ IDirectFBFont_GetGlyphExtents( IDirectFBFont *thiz,
      DFBResult      ret;
      CoreGlyphData *glyph;
      unsigned int   index;
+     bool           locked = false;
 
      DIRECT_INTERFACE_GET_DATA( IDirectFBFont )
 
@@ -425,15 +448,11 @@ IDirectFBFont_GetGlyphExtents( IDirectFBFont *thiz,
      if (!ret_rect && !ret_advance)
           return DFB_INVARG;
 
-     dfb_font_lock( data->font );
-
      ret = dfb_font_decode_character( data->font, data->encoding, character, &index );
-     if (ret) {
-          dfb_font_unlock( data->font );
+     if (ret)
           return ret;
-     }
 
-     if (dfb_font_get_glyph_data( data->font, index, 0, &glyph ) != DFB_OK) {
+     if (dfb_font_get_glyph_metrics( data->font, index, 0, &locked, &glyph ) != DFB_OK) {
           if (ret_rect)
                ret_rect->x = ret_rect->y = ret_rect->w = ret_rect->h = 0;
 
@@ -452,7 +471,8 @@ IDirectFBFont_GetGlyphExtents( IDirectFBFont *thiz,
                *ret_advance = glyph->xadvance >> 8;
      }
 
-     dfb_font_unlock( data->font );
+     if (locked)
+          dfb_font_unlock( data->font );
 
      return DFB_OK;
 }
@@ -466,20 +486,22 @@ IDirectFBFont_GetStringBreak( IDirectFBFont  *thiz,
                               int            *ret_str_length,
                               const char    **ret_next_line )
 {
-     DFBResult      ret;
-     const u8      *string;
-     const u8      *last;
-     const u8      *end;
-     CoreGlyphData *glyph;
-     int            kern_x;
-     int            kern_y;
-     int            length = 0;
-     int            xsize = 0;
-     int            ysize = 0;
-     int            width = 0;
-     unichar        current;
-     unsigned int   index;
-     unsigned int   prev  = 0;
+     DFBResult        ret;
+     CoreFontMeasure  measure;
+     const u8        *string;
+     const u8        *last;
+     const u8        *end;
+     CoreGlyphData   *glyph;
+     int              kern_x;
+     int              kern_y;
+     int              length = 0;
+     int              xsize  = 0;
+     int              ysize  = 0;
+     int              width  = 0;
+     unichar          current;
+     unsigned int     index;
+     unsigned int     prev   = 0;
+     bool             locked = false;
 
      DIRECT_INTERFACE_GET_DATA( IDirectFBFont )
 
@@ -500,13 +522,19 @@ IDirectFBFont_GetStringBreak( IDirectFBFont  *thiz,
           return DFB_OK;
      }
 
+     if (dfb_font_measure_lookup( data->font, data->encoding, text, bytes, CFMF_BREAK, max_width, &measure )) {
+          *ret_next_line  = measure.break_next < 0 ? NULL : text + measure.break_next;
+          *ret_str_length = measure.break_length;
+          *ret_width      = measure.break_width;
+
+          return DFB_OK;
+     }
+
      string = (const u8*) text;
      end    = string + bytes;
 
      *ret_next_line = NULL;
 
-     dfb_font_lock( data->font );
-
      do {
           *ret_width = width >> 8;
 
@@ -527,19 +555,17 @@ IDirectFBFont_GetStringBreak( IDirectFBFont  *thiz,
           if (ret)
                continue;
 
-          ret = dfb_font_get_glyph_data( data->font, index, 0, &glyph );
+          ret = dfb_font_get_glyph_metrics( data->font, index, 0, &locked, &glyph );
           if (ret)
                continue;
 
           xsize += glyph->xadvance;
           ysize += glyph->yadvance;
 
-          if (prev && data->font->GetKerning &&
-              data->font->GetKerning( data->font, prev, index, &kern_x, NULL ) == DFB_OK)
+          if (prev && dfb_font_get_kerning( data->font, prev, index, &locked, &kern_x, NULL ) == DFB_OK)
                width += kern_x << 8;
 
-          if (prev && data->font->GetKerning &&
-              data->font->GetKerning( data->font, prev, index, &kern_x, &kern_y) == DFB_OK) {
+          if (prev && dfb_font_get_kerning( data->font, prev, index, &locked, &kern_x, &kern_y ) == DFB_OK) {
                xsize += kern_x << 8;
                ysize += kern_y << 8;
           }
@@ -557,17 +583,15 @@ IDirectFBFont_GetStringBreak( IDirectFBFont  *thiz,
           prev = index;
      } while ((width >> 8) < max_width && string < end && current != 0x0a);
 
-     dfb_font_unlock( data->font );
+     if (locked)
+          dfb_font_unlock( data->font );
 
      if ((width >> 8) < max_width && string >= end) {
           *ret_next_line  = NULL;
           *ret_str_length = length;
           *ret_width      = width >> 8;
-
-          return DFB_OK;
      }
-
-     if (*ret_next_line == NULL) {
+     else if (*ret_next_line == NULL) {
           if (length == 1) {
                *ret_str_length = length;
                *ret_next_line  = (const char*) string;
@@ -579,6 +603,14 @@ IDirectFBFont_GetStringBreak( IDirectFBFont  *thiz,
           }
      }
 
+     measure.flags        = CFMF_BREAK;
+     measure.max_width    = max_width;
+     measure.break_width  = *ret_width;
+     measure.break_length = *ret_str_length;
+     measure.break_next   = *ret_next_line ? *ret_next_line - text : -1;
+
+     dfb_font_measure_store( data->font, data->encoding, text, bytes, &measure );
+
      return DFB_OK;
 }
 
@@ -694,6 +726,7 @@ IDirectFBFont_GetGlyphExtentsXY( IDirectFBFont *thiz,
      DFBResult      ret;
      CoreGlyphData *glyph;
      unsigned int   index;
+     bool           locked = false;
 
      DIRECT_INTERFACE_GET_DATA( IDirectFBFont )
 
@@ -702,15 +735,11 @@ IDirectFBFont_GetGlyphExtentsXY( IDirectFBFont *thiz,
      if (!ret_rect && !ret_xadvance && !ret_yadvance)
           return DFB_INVARG;
 
-     dfb_font_lock( data->font );
-
      ret = dfb_font_decode_character( data->font, data->encoding, character, &index );
-     if (ret) {
-          dfb_font_unlock( data->font );
+     if (ret)
           return ret;
-     }
 
-     if (dfb_font_get_glyph_data( data->font, index, 0, &glyph ) != DFB_OK) {
+     if (dfb_font_get_glyph_metrics( data->font, index, 0, &locked, &glyph ) != DFB_OK) {
           if (ret_rect)
                ret_rect->x = ret_rect->y = ret_rect->w = ret_rect->h = 0;
 
@@ -735,7 +764,8 @@ IDirectFBFont_GetGlyphExtentsXY( IDirectFBFont *thiz,
                *ret_yadvance = glyph->yadvance;
      }
 
-     dfb_font_unlock( data->font );
+     if (locked)
+          dfb_font_unlock( data->font );
 
      return DFB_OK;
 }
@@ -784,6 +814,9 @@ IDirectFBFont_Construct( IDirectFBFont *thiz, CoreFont *font )
      data->ref  = 1;
      data->font = font;
 
+     /* The font implementation is set up now. */
+     dfb_font_build_kerning_table( font );
+
      thiz->AddRef               = IDirectFBFont_AddRef;
      thiz->Release              = IDirectFBFont_Release;
      thiz->GetAscender          = IDirectFBFont_GetAscender;
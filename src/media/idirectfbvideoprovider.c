@@ -260,6 +260,18 @@ IDirectFBVideoProvider_SetDestination( IDirectFBVideoProvider *thiz,
      return DFB_UNIMPLEMENTED;
 }
 
+static DFBResult
+IDirectFBVideoProvider_GetStatistics( IDirectFBVideoProvider     *thiz,
+                                      DFBVideoProviderStatistics *ret_stats )
+{
+     if (!ret_stats)
+          return DFB_INVARG;
+
+     memset( ret_stats, 0, sizeof(DFBVideoProviderStatistics) );
+
+     return DFB_UNIMPLEMENTED;
+}
+
 static void
 IDirectFBVideoProvider_Construct( IDirectFBVideoProvider *thiz )
 {
@@ -293,6 +305,7 @@ IDirectFBVideoProvider_Construct( IDirectFBVideoProvider *thiz )
      thiz->SetBufferThresholds   = IDirectFBVideoProvider_SetBufferThresholds;
      thiz->GetBufferThresholds   = IDirectFBVideoProvider_GetBufferThresholds;
      thiz->SetDestination        = IDirectFBVideoProvider_SetDestination;
+     thiz->GetStatistics         = IDirectFBVideoProvider_GetStatistics;
 }
 
 DFBResult
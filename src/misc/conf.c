@@ -85,15 +85,21 @@ static const char *dfb_config_usage =
      "  [no-]software                  Enable software fallbacks (default enabled)\n"
      "  [no-]software-warn             Show warnings when doing/dropping software operations\n"
      "  [no-]software-trace            Show every stage of the software rendering pipeline\n"
+     "  software-threads=<n>           Number of worker threads splitting software operations into bands (default 0)\n"
+     "  [no-]software-driver           Use the threaded software graphics driver, if built (default disabled)\n"
      "  [no-]gfxcard-stats=[<ms>]      Print GPU usage statistics periodically (1000 ms if no period is specified)\n"
+     "                                 and count graphics operations for IDirectFB::GetGraphicsStats()\n"
      "  videoram-limit=<amount>        Limit the amount of Video RAM used (kilobytes)\n"
      "  [no-]gfx-emit-early            Early emit GFX commands to prevent being IDLE\n"
      "  [no-]startstop                 Issue StartDrawing/StopDrawing to driver\n"
      "  [no-]smooth-upscale            Enable smooth upscaling\n"
      "  [no-]smooth-downscale          Enable smooth downscaling\n"
+     "  smooth-scaler=<quality>        Set the software smooth scaler: 'fast' (bilinear/box, default), 'best' (Lanczos)\n"
+     "                                 or 'legacy'\n"
      "  keep-accumulators=<limit>      Free accumulators above the limit (default = 1024)\n"
      "                                 Setting -1 never frees accumulators until the state is destroyed\n"
      "  [no-]mmx                       Enable MMX assembly support (enabled by default if available)\n"
+     "  [no-]sse                       Enable SSE2/AVX2 support (enabled by default if available)\n"
      "  warn=<type[:<width>x<height>]> Print warnings on surface/window creations or surface buffer allocations\n"
      "                                 [ create-surface | create-window | allocate-buffer ]\n"
      "  [no-]surface-clear             Clear all surface buffers after creation\n"
@@ -134,9 +140,13 @@ static const char *dfb_config_usage =
      "  screenshot-dir=<directory>     Dump screen content on <Print> key presses\n"
      "  font-format=<pixelformat>      Set the preferred font format (default is 8 bit alpha)\n"
      "  [no-]font-premult              Enable premultiplied glyph images in ARGB format (default enabled)\n"
-     "  font-resource-id=<id>          Resource ID to use for font cache row surfaces\n"
-     "  max-font-rows=<number>         Maximum number of glyph cache rows (default = 99)\n"
-     "  max-font-row-width=<pixels>    Maximum width of glyph cache row surface (default = 2048)\n"
+     "  font-resource-id=<id>          Resource ID to use for font cache atlas surfaces\n"
+     "  max-font-rows=<number>         Glyph cache budget in rows of the font height (default = 99)\n"
+     "  max-font-row-width=<pixels>    Maximum width of glyph cache atlas surface (default = 2048)\n"
+     "  font-cache-dir=<directory>     Keep prewarmed glyph caches of fonts in this directory\n"
+     "  font-direct-glyphs=<number>    Glyph indices looked up without locking the font (default = 256)\n"
+     "  font-measure-cache=<number>    Cached string measurements per font (default = 256)\n"
+     "  [no-]font-kerning-table        Precompute kerning of the direct glyph indices (default enabled)\n"
      "\n";
 
 /**********************************************************************************************************************/
@@ -267,9 +277,12 @@ config_allocate()
 
      dfb_config->graphics_state_call_limit             = 5000;
 
+     dfb_config->smooth_scaler                         = DCSS_FAST;
+
      dfb_config->keep_accumulators                     = 1024;
 
      dfb_config->mmx                                   = true;
+     dfb_config->sse                                   = true;
 
      dfb_config->surface_shmpool_size                  = 64 * 1024 * 1024;
 
@@ -283,6 +296,9 @@ config_allocate()
      dfb_config->font_premult                          = true;
      dfb_config->max_font_rows                         = 99;
      dfb_config->max_font_row_width                    = 2048;
+     dfb_config->font_direct_glyphs                    = 256;
+     dfb_config->font_measure_cache                    = 256;
+     dfb_config->font_kerning_table                    = true;
 }
 
 static DFBResult
@@ -973,6 +989,28 @@ dfb_config_set( const char *name,
      if (strcmp( name, "no-software-trace" ) == 0) {
           dfb_config->software_trace = false;
      } else
+     if (strcmp( name, "software-threads" ) == 0) {
+          if (value) {
+               unsigned int threads;
+
+               if (sscanf( value, "%u", &threads ) < 1) {
+                    D_ERROR( "DirectFB/Config: '%s': Could not parse value!\n", name );
+                    return DFB_INVARG;
+               }
+
+               dfb_config->software_threads = threads;
+          }
+          else {
+               D_ERROR( "DirectFB/Config: '%s': No value specified!\n", name );
+               return DFB_INVARG;
+          }
+     } else
+     if (strcmp( name, "software-driver" ) == 0) {
+          dfb_config->software_driver = true;
+     } else
+     if (strcmp( name, "no-software-driver" ) == 0) {
+          dfb_config->software_driver = false;
+     } else
      if (strcmp( name, "gfxcard-stats" ) == 0) {
           if (value) {
                unsigned int interval;
@@ -1030,6 +1068,27 @@ dfb_config_set( const char *name,
      if (strcmp( name, "no-smooth-downscale" ) == 0) {
           dfb_config->render_options &= ~DSRO_SMOOTH_DOWNSCALE;
      } else
+     if (strcmp( name, "smooth-scaler" ) == 0) {
+          if (value) {
+               if (strcmp( value, "fast" ) == 0) {
+                    dfb_config->smooth_scaler = DCSS_FAST;
+               }
+               else if (strcmp( value, "best" ) == 0) {
+                    dfb_config->smooth_scaler = DCSS_BEST;
+               }
+               else if (strcmp( value, "legacy" ) == 0) {
+                    dfb_config->smooth_scaler = DCSS_LEGACY;
+               }
+               else {
+                    D_ERROR( "DirectFB/Config: '%s': Unknown scaler '%s'!\n", name, value );
+                    return DFB_INVARG;
+               }
+          }
+          else {
+               D_ERROR( "DirectFB/Config: '%s': No value specified!\n", name );
+               return DFB_INVARG;
+          }
+     } else
      if (strcmp( name, "keep-accumulators" ) == 0) {
           if (value) {
                int limit;
@@ -1052,6 +1111,12 @@ dfb_config_set( const char *name,
      if (strcmp( name, "no-mmx" ) == 0) {
           dfb_config->mmx = false;
      } else
+     if (strcmp( name, "sse" ) == 0) {
+          dfb_config->sse = true;
+     } else
+     if (strcmp( name, "no-sse" ) == 0) {
+          dfb_config->sse = false;
+     } else
      if (strcmp( name, "warn" ) == 0 || strcmp( name, "no-warn" ) == 0) {
           DFBConfigWarnFlags flags = DCWF_ALL;
 
@@ -1393,6 +1458,56 @@ dfb_config_set( const char *name,
                D_ERROR( "DirectFB/Config: '%s': No value specified!\n", name );
                return DFB_INVARG;
           }
+     } else
+     if (strcmp( name, "font-direct-glyphs" ) == 0) {
+          if (value) {
+               int glyphs;
+
+               if (sscanf( value, "%d", &glyphs ) < 1 || glyphs < 0) {
+                    D_ERROR( "DirectFB/Config: '%s': Could not parse value!\n", name );
+                    return DFB_INVARG;
+               }
+
+               dfb_config->font_direct_glyphs = glyphs;
+          }
+          else {
+               D_ERROR( "DirectFB/Config: '%s': No value specified!\n", name );
+               return DFB_INVARG;
+          }
+     } else
+     if (strcmp( name, "font-measure-cache" ) == 0) {
+          if (value) {
+               int entries;
+
+               if (sscanf( value, "%d", &entries ) < 1 || entries < 0) {
+                    D_ERROR( "DirectFB/Config: '%s': Could not parse value!\n", name );
+                    return DFB_INVARG;
+               }
+
+               dfb_config->font_measure_cache = entries;
+          }
+          else {
+               D_ERROR( "DirectFB/Config: '%s': No value specified!\n", name );
+               return DFB_INVARG;
+          }
+     } else
+     if (strcmp( name, "font-kerning-table" ) == 0) {
+          dfb_config->font_kerning_table = true;
+     } else
+     if (strcmp( name, "no-font-kerning-table" ) == 0) {
+          dfb_config->font_kerning_table = false;
+     } else
+     if (strcmp( name, "font-cache-dir" ) == 0) {
+          if (value) {
+               if (dfb_config->font_cache_dir)
+                    D_FREE( dfb_config->font_cache_dir );
+
+               dfb_config->font_cache_dir = D_STRDUP( value );
+          }
+          else {
+               D_ERROR( "DirectFB/Config: '%s': No directory name specified!\n", name );
+               return DFB_INVARG;
+          }
      }
      else {
           dfboption = false;
@@ -1590,6 +1705,9 @@ dfb_config_deinit()
      if (dfb_config->screenshot_dir)
           D_FREE( dfb_config->screenshot_dir );
 
+     if (dfb_config->font_cache_dir)
+          D_FREE( dfb_config->font_cache_dir );
+
      DFBConfigLayer *conf = dfb_config->config_layer;
      if (conf->palette)
           D_FREE( conf->palette );
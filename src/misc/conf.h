@@ -59,6 +59,12 @@ typedef enum {
      DCWF_ALL             = 0x00000013
 } DFBConfigWarnFlags;
 
+typedef enum {
+     DCSS_LEGACY          = 0,                   /* stretch_hvx() scalers (smooth-scaling build option) */
+     DCSS_FAST            = 1,                   /* bilinear upscaling, box filter downscaling */
+     DCSS_BEST            = 2                    /* bilinear upscaling, Lanczos downscaling */
+} DFBConfigSmoothScaler;
+
 typedef struct
 {
      char                       *system;
@@ -90,13 +96,17 @@ typedef struct
      bool                        hardware_only;
      bool                        software_warn;
      bool                        software_trace;
+     unsigned int                software_threads;
+     bool                        software_driver;
      unsigned int                gfxcard_stats;
      unsigned int                videoram_limit;
      bool                        gfx_emit_early;
      bool                        startstop;
      DFBSurfaceRenderOptions     render_options;
+     DFBConfigSmoothScaler       smooth_scaler;
      int                         keep_accumulators;
      bool                        mmx;
+     bool                        sse;
      struct {
           DFBConfigWarnFlags     flags;
           struct {
@@ -136,6 +146,10 @@ typedef struct
      unsigned long               font_resource_id;
      int                         max_font_rows;
      int                         max_font_row_width;
+     char                       *font_cache_dir;
+     int                         font_direct_glyphs;
+     int                         font_measure_cache;
+     bool                        font_kerning_table;
 } DFBConfig;
 
 /**********************************************************************************************************************/
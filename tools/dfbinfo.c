@@ -44,12 +44,18 @@ static const DirectFBScreenOutputConnectorsNames(connectors);
 static const DirectFBScreenOutputResolutionNames(resolutions);
 static const DirectFBScreenOutputSignalsNames(signals);
 
+static const DirectFBAccelerationMaskNames(accel_names);
+static const DirectFBPixelFormatNames(format_names);
+
 static IDirectFB *dfb = NULL;
 
+static DFBBoolean stats = DFB_FALSE;
+
 static DFBBoolean parse_command_line ( int argc, char *argv[] );
 static void       enum_input_devices ( void );
 static void       enum_screens ( void );
 static void       enum_video_modes ( void );
+static void       dump_graphics_stats( void );
 
 /**********************************************************************************************************************/
 
@@ -83,6 +89,9 @@ main( int argc, char *argv[] )
      enum_screens();
      enum_input_devices();
 
+     if (stats)
+          dump_graphics_stats();
+
      /* Release the main interface. */
      dfb->Release( dfb );
 
@@ -91,9 +100,40 @@ main( int argc, char *argv[] )
 
 /**********************************************************************************************************************/
 
+static void
+print_usage( const char *name )
+{
+     fprintf( stderr, "\nDirectFB Information\n\n" );
+     fprintf( stderr, "Usage: %s [options]\n\n", name );
+     fprintf( stderr, "Options:\n" );
+     fprintf( stderr, "  -s, --stats  Dump the counters of graphics operations (see gfxcard-stats)\n" );
+     fprintf( stderr, "  -h, --help   Show this help message\n" );
+     fprintf( stderr, "\n" );
+}
+
 static DFBBoolean
 parse_command_line( int argc, char *argv[] )
 {
+     int n;
+
+     for (n = 1; n < argc; n++) {
+          const char *a = argv[n];
+
+          if (strcmp( a, "-h" ) == 0 || strcmp( a, "--help" ) == 0) {
+               print_usage( argv[0] );
+               return DFB_FALSE;
+          }
+
+          if (strcmp( a, "-s" ) == 0 || strcmp( a, "--stats" ) == 0) {
+               stats = DFB_TRUE;
+               continue;
+          }
+
+          print_usage( argv[0] );
+
+          return DFB_FALSE;
+     }
+
      return DFB_TRUE;
 }
 
@@ -606,3 +646,94 @@ static void enum_video_modes()
      if (ret)
           DirectFBError( "IDirectFB::EnumVideoModes", ret );
 }
+
+/**********************************************************************************************************************/
+
+static const char *accel_name( DFBAccelerationMask accel )
+{
+     int i;
+
+     for (i = 0; accel_names[i].mask; i++) {
+          if (accel_names[i].mask == accel)
+               return accel_names[i].name;
+     }
+
+     return "?";
+}
+
+static const char *format_name( DFBSurfacePixelFormat format )
+{
+     int i;
+
+     for (i = 0; format_names[i].format; i++) {
+          if (format_names[i].format == format)
+               return format_names[i].name;
+     }
+
+     return "-";
+}
+
+static int compare_stats( const void *a, const void *b )
+{
+     const DFBGraphicsOperationStats *sa = a;
+     const DFBGraphicsOperationStats *sb = b;
+
+     /* Most time consuming operations first. */
+     if (sa->time != sb->time)
+          return sa->time > sb->time ? -1 : 1;
+
+     return 0;
+}
+
+static void dump_graphics_stats()
+{
+     DFBResult                  ret;
+     DFBGraphicsOperationStats *entries;
+     unsigned int               i, num, total;
+
+     ret = dfb->GetGraphicsStats( dfb, NULL, 0, &num, &total );
+     if (ret) {
+          DirectFBError( "IDirectFB::GetGraphicsStats", ret );
+          return;
+     }
+
+     printf( "Graphics Operations\n" );
+
+     if (!total) {
+          printf( "\n" );
+          return;
+     }
+
+     entries = calloc( total, sizeof(DFBGraphicsOperationStats) );
+     if (!entries) {
+          DirectFBError( "calloc", DFB_NOSYSTEMMEMORY );
+          return;
+     }
+
+     /* Entries may have been added meanwhile, only those fitting are written. */
+     ret = dfb->GetGraphicsStats( dfb, entries, total, &num, &total );
+     if (ret) {
+          DirectFBError( "IDirectFB::GetGraphicsStats", ret );
+          free( entries );
+          return;
+     }
+
+     qsort( entries, num, sizeof(DFBGraphicsOperationStats), compare_stats );
+
+     printf( "   %-16s %-10s %-10s %-10s %12s %14s %12s %10s\n",
+             "Function", "Source", "Dest", "Flags", "Calls", "Pixels", "Time [ms]", "Software" );
+
+     for (i = 0; i < num; i++) {
+          const DFBGraphicsOperationStats *entry = &entries[i];
+
+          printf( "   %-16s %-10s %-10s 0x%08x %12llu %14llu %8llu.%03llu %10llu\n",
+                  accel_name( entry->accel ), format_name( entry->source_format ),
+                  format_name( entry->destination_format ),
+                  DFB_BLITTING_FUNCTION( entry->accel ) ? entry->blitting_flags : entry->drawing_flags,
+                  entry->calls, entry->pixels, entry->time / 1000, entry->time % 1000, entry->software );
+     }
+
+     printf( "\n" );
+
+     free( entries );
+}